@@ -30,25 +30,43 @@ SOFTWARE.
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 #include "opencl/activation.h"
+#include "opencl/fusion.h"
+#include "opencl/loss.h"
 
 #endif
 
 namespace neural_network {
 
-	template <typename Metrics>
-	class activation_base : public layer_base<Metrics, Metrics>
+	template <typename Metrics, typename Number>
+	class activation_base : public layer_base<Metrics, Metrics, Number>
 	{
 	public:
-		typedef typename layer_base<Metrics, Metrics> base_type;
+		typedef typename layer_base<Metrics, Metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<false, true> memory_traits;
 
 		activation_base() 
 			: m_input(), base_type()
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_fusedKernelProgram(), m_fusedLossGradientKernelName()
+#endif
 		{}
 
 		void update_weights(
 			const number_type)
 		{}
 
+		template <class Layer>
+		void accumulate_update(
+			Layer&,
+			const number_type)
+		{}
+
+		template <class Layer>
+		void apply_update(
+			const Layer&)
+		{}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 		void update_weights(
@@ -56,18 +74,62 @@ namespace neural_network {
 			::boost::compute::command_queue&)
 		{}
 
+		// The producer applies the activation in its own kernel, so the input of the activation is
+		// never materialized and m_input is not set. The backward pass reads only the output.
+		template <class Epilogue, class Producer>
+		const output& process_fused(
+			Producer& producer,
+			const typename Producer::input& input,
+			::boost::compute::command_queue& queue)
+		{
+			producer.template process_fused<Epilogue>(input, m_output, queue);
+
+			return m_output;
+		}
+
+		template <class Epilogue>
+		const input& compute_fused_loss_gradient(
+			const output& truth,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			if (0 == m_fusedLossGradientKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedLossGradientKernelName = opencl::detail::layer_kernels::get_squared_error_loss_gradient_kernel_name();
+			}
+
+			opencl::detail::squared_error_loss::compute_gradient(
+				m_output,
+				truth,
+				m_gradient,
+				m_fusedKernelProgram,
+				m_fusedLossGradientKernelName,
+				context,
+				queue);
+
+			return m_gradient;
+		}
+
 #endif
 
 	protected:
 		input m_input;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+	private:
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedLossGradientKernelName;
+#endif
 	};
 
-	template <typename Metrics>
-	class relu_activation : public activation_base<Metrics>
+	template <typename Metrics, typename Number = float>
+	class relu_activation : public activation_base<Metrics, Number>
 	{
 	public:
-		typedef typename relu_activation<Metrics> this_type;
-		typedef typename activation_base<Metrics> base_type;
+		typedef typename relu_activation<Metrics, Number> this_type;
+		typedef typename activation_base<Metrics, Number> base_type;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::relu_activation_layer,
@@ -89,7 +151,7 @@ namespace neural_network {
 				m_output,
 				[](const number_type& i)
 				{
-					return std::max(i, 0.0f);
+					return std::max(i, number_type(0));
 				});
 
 			return m_output;
@@ -131,6 +193,8 @@ namespace neural_network {
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
+		typedef opencl::detail::relu_epilogue fused_epilogue;
+
 		const output& process(
 			const input& input,
 			::boost::compute::command_queue& queue)
@@ -236,12 +300,12 @@ namespace neural_network {
 #endif
 	};
 
-	template <typename Metrics>
-	class logistic_activation : public activation_base<Metrics>
+	template <typename Metrics, typename Number = float>
+	class logistic_activation : public activation_base<Metrics, Number>
 	{
 	public:
-		typedef typename logistic_activation<Metrics> this_type;
-		typedef typename activation_base<Metrics> base_type;
+		typedef typename logistic_activation<Metrics, Number> this_type;
+		typedef typename activation_base<Metrics, Number> base_type;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::logistic_activation_layer,
@@ -304,6 +368,8 @@ namespace neural_network {
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
+		typedef opencl::detail::logistic_epilogue fused_epilogue;
+
 		const output& process(
 			const input& input,
 			::boost::compute::command_queue& queue)
@@ -425,12 +491,12 @@ namespace neural_network {
 		}
 	};
 
-	template <typename Metrics>
-	class tanh_activation : public activation_base<Metrics>
+	template <typename Metrics, typename Number = float>
+	class tanh_activation : public activation_base<Metrics, Number>
 	{
 	public:
-		typedef typename tanh_activation<Metrics> this_type;
-		typedef typename activation_base<Metrics> base_type;
+		typedef typename tanh_activation<Metrics, Number> this_type;
+		typedef typename activation_base<Metrics, Number> base_type;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::tanh_activation_layer,
@@ -493,6 +559,8 @@ namespace neural_network {
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
+		typedef opencl::detail::tanh_epilogue fused_epilogue;
+
 		const output& process(
 			const input& input,
 			::boost::compute::command_queue& queue)
@@ -600,27 +668,27 @@ namespace neural_network {
 #endif
 	};
 
-	template <class Input, class... Args>
-	logistic_activation<Input> make_logistic_activation_layer(
+	template <class Input, class Number = float, class... Args>
+	logistic_activation<Input, Number> make_logistic_activation_layer(
 		Args&&... args)
 	{
-		typedef logistic_activation<Input> layer_type;
+		typedef logistic_activation<Input, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 
-	template <class Input, class... Args>
-	relu_activation<Input> make_relu_activation_layer(
+	template <class Input, class Number = float, class... Args>
+	relu_activation<Input, Number> make_relu_activation_layer(
 		Args&&... args)
 	{
-		typedef relu_activation<Input> layer_type;
+		typedef relu_activation<Input, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 
-	template <class Input, class... Args>
-	tanh_activation<Input> make_tanh_activation_layer(
+	template <class Input, class Number = float, class... Args>
+	tanh_activation<Input, Number> make_tanh_activation_layer(
 		Args&&... args)
 	{
-		typedef tanh_activation<Input> layer_type;
+		typedef tanh_activation<Input, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 }
@@ -24,11 +24,22 @@ SOFTWARE.
 
 #pragma once
 
+#include "number.h"
 #include "connected.h"
 #include "activation.h"
 #include "reshape.h"
+#include "layout.h"
 #include "pooling.h"
 #include "convolution.h"
+#include "separable.h"
 #include "loss.h"
+#include "memory.h"
 #include "network.h"
+#include "checkpoint.h"
+#include "quantization.h"
+#include "sparse.h"
+#include "embedding.h"
+#include "normalization.h"
 #include "ensemble.h"
+#include "parallel.h"
+#include "pipeline.h"
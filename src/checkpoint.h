@@ -0,0 +1,268 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include "memory.h"
+#include "network.h"
+
+namespace neural_network {
+
+	// Runs a segment of a network without keeping its activations for the backward pass. Only the
+	// input of the segment is kept, and the segment is processed again before its gradient is
+	// computed. The tensors of the segment live in a compact arena, and all checkpoints of a
+	// planned network share the same region of its arena.
+	template <class Network>
+	class checkpoint
+		: public layer_base<
+			typename Network::input::metrics,
+			typename Network::output::metrics,
+			typename Network::number_type>
+	{
+	public:
+		typedef typename checkpoint<Network> this_type;
+		typedef typename layer_base<typename Network::input::metrics, typename Network::output::metrics, typename Network::number_type> base_type;
+
+		typedef typename Network::training_memory_plan recompute_plan;
+
+		typedef typename detail::layer_memory<true, false, true, false, false, true> memory_traits;
+
+		enum : size_t { recompute_size = recompute_plan::compact_size };
+
+		checkpoint()
+			: base_type(), m_network(), m_input()
+		{
+			this->bind_recompute_memory(
+				detail::make_memory_arena<recompute_plan, number_type>(true));
+		}
+
+		checkpoint(
+			const Network& network)
+			: base_type(), m_network(network), m_input()
+		{
+			this->bind_recompute_memory(
+				detail::make_memory_arena<recompute_plan, number_type>(true));
+		}
+
+		const output& process(const input& input)
+		{
+			m_input = input;
+
+			m_network.process(input).transform(
+				m_output,
+				[](const number_type& value)
+				{
+					return value;
+				});
+
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			m_network.process(m_input);
+
+			m_network.compute_gradient(grad).transform(
+				m_gradient,
+				[](const number_type& value)
+				{
+					return value;
+				});
+
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate)
+		{
+			m_network.update_weights(rate);
+		}
+
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			m_network.accumulate_update(target.m_network, rate);
+		}
+
+		void apply_update(
+			const this_type& source)
+		{
+			m_network.apply_update(source.m_network);
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		// Processes a batch with a copy of the checkpoint for every input. The segments of the
+		// copies process the batch one layer at a time.
+		static void process_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const input*>& inputs,
+			std::vector<const output*>& results)
+		{
+			std::vector<Network*> networks(copies.size());
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				copies[k]->m_input = *inputs[k];
+				networks[k] = &copies[k]->m_network;
+			}
+
+			std::vector<const typename Network::output*> outputs(copies.size());
+			Network::process_batch(networks, inputs, outputs);
+
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				outputs[k]->transform(
+					copies[k]->m_output,
+					[](const number_type& value)
+					{
+						return value;
+					});
+
+				results[k] = &copies[k]->m_output;
+			}
+		}
+
+		static void compute_gradient_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const output*>& gradients,
+			std::vector<const input*>& results)
+		{
+			std::vector<Network*> networks(copies.size());
+			std::vector<const input*> inputs(copies.size());
+
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				networks[k] = &copies[k]->m_network;
+				inputs[k] = &copies[k]->m_input;
+			}
+
+			std::vector<const typename Network::output*> outputs(copies.size());
+			Network::process_batch(networks, inputs, outputs);
+
+			std::vector<const typename Network::input*> networkGradients(copies.size());
+			Network::compute_gradient_batch(networks, gradients, networkGradients);
+
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				networkGradients[k]->transform(
+					copies[k]->m_gradient,
+					[](const number_type& value)
+					{
+						return value;
+					});
+
+				results[k] = &copies[k]->m_gradient;
+			}
+		}
+
+		void bind_recompute_memory(
+			const detail::memory_arena<number_type>& arena)
+		{
+			m_network.plan_memory(memory_mode::training, arena);
+		}
+
+		// The checkpoint is serialized in the same format as the network it wraps.
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = Network::serializer::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& layer)
+			{
+				Network::serializer::read(in, layer.m_network);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& layer)
+			{
+				Network::serializer::write(out, layer.m_network);
+			}
+		};
+
+	private:
+		Network m_network;
+		input m_input;
+	};
+
+namespace detail {
+
+	template <class Network>
+	struct batch_processing<checkpoint<Network>>
+	{
+		typedef checkpoint<Network> checkpoint_type;
+
+		static void process(
+			std::vector<checkpoint_type*>& layers,
+			const std::vector<const typename checkpoint_type::input*>& inputs,
+			std::vector<const typename checkpoint_type::output*>& results)
+		{
+			checkpoint_type::process_batch(layers, inputs, results);
+		}
+
+		static void compute_gradient(
+			std::vector<checkpoint_type*>& layers,
+			const std::vector<const typename checkpoint_type::output*>& gradients,
+			std::vector<const typename checkpoint_type::input*>& results)
+		{
+			checkpoint_type::compute_gradient_batch(layers, gradients, results);
+		}
+	};
+}
+
+	template <class Network>
+	checkpoint<Network> make_checkpoint(
+		const Network& network)
+	{
+		typedef checkpoint<Network> layer_type;
+		return (layer_type(network));
+	}
+}
\ No newline at end of file
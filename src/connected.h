@@ -24,103 +24,207 @@ SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
+
 #include "layer.h"
+#include "number.h"
+#include "parallel.h"
 #include "serialization.h"
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 #include "opencl/connected.h"
+#include "opencl/fusion.h"
 
 #endif
 
 namespace neural_network {
 
-	template <typename InputMetrics, typename OutputMetrics>
-	class fully_connected : public layer_base<InputMetrics, OutputMetrics>
+namespace detail {
+
+	template <class Storage>
+	struct fully_connected_chunk;
+
+	template <>
+	struct fully_connected_chunk<float>
+	{
+		static const serialization::chunk_types value = serialization::chunk_types::fully_connected_layer;
+	};
+
+	template <>
+	struct fully_connected_chunk<double>
+	{
+		static const serialization::chunk_types value = serialization::chunk_types::fully_connected_layer;
+	};
+
+	template <>
+	struct fully_connected_chunk<algebra::half>
+	{
+		static const serialization::chunk_types value = serialization::chunk_types::half_fully_connected_layer;
+	};
+
+	template <>
+	struct fully_connected_chunk<algebra::bfloat16>
+	{
+		static const serialization::chunk_types value = serialization::chunk_types::bfloat16_fully_connected_layer;
+	};
+
+	// Number type the layer computes in for the given weights storage type.
+	template <class Storage>
+	struct fully_connected_number
+	{
+		typedef Storage type;
+	};
+
+	template <>
+	struct fully_connected_number<algebra::half>
+	{
+		typedef float type;
+	};
+
+	template <>
+	struct fully_connected_number<algebra::bfloat16>
+	{
+		typedef float type;
+	};
+
+	// Tensors of the same number type share the buffer, otherwise the values are converted.
+	template <class Weights>
+	void assign_weights(
+		const Weights& source,
+		Weights& destination)
+	{
+		destination = source;
+	}
+
+	template <class Source, class Destination>
+	void assign_weights(
+		const Source& source,
+		Destination& destination)
+	{
+		algebra::convert(source, destination);
+	}
+
+	template <const size_t Columns, class Weights>
+	void assign_weights_row(
+		const Weights&,
+		Weights&,
+		const size_t)
+	{
+	}
+
+	template <const size_t Columns, class Source, class Destination>
+	void assign_weights_row(
+		const Source& source,
+		Destination& destination,
+		const size_t row)
+	{
+		algebra::detail::convert(source.data() + row * Columns, destination.data() + row * Columns, Columns);
+	}
+}
+
+	// The layer computes in float or double, and stores the weights it reads in process and
+	// compute_gradient with the Storage number type. With half or bfloat16 storage the layer keeps
+	// float master weights for the update, and rounds them to the stored weights after every update.
+	// Such a layer is serialized with the stored weights.
+	//
+	// The update applies the product of the input and the output gradient directly to the weights,
+	// together with the regularization. Rows of the weights with a zero output gradient are only
+	// decayed. The decay accumulates in a scale of the row, which process and compute_gradient
+	// multiply into the dot products, and which is applied to the row by its next update.
+	template <typename InputMetrics, typename OutputMetrics, typename Storage = float>
+	class fully_connected : public layer_base<InputMetrics, OutputMetrics, typename detail::fully_connected_number<Storage>::type>
 	{
 	public:
-		typedef typename fully_connected<InputMetrics, OutputMetrics> this_type;
-		typedef typename layer_base<InputMetrics, OutputMetrics> base_type;
+		typedef typename fully_connected<InputMetrics, OutputMetrics, Storage> this_type;
+		typedef typename layer_base<InputMetrics, OutputMetrics, typename detail::fully_connected_number<Storage>::type> base_type;
+
+		typedef typename detail::layer_memory<true, false> memory_traits;
 
 		typedef typename algebra::metrics<input::data_size> reshaped_input;
 		typedef typename algebra::metrics<output::data_size> reshaped_output;
 
 		typedef typename algebra::metrics<
 			reshaped_output::data_size,
-			reshaped_input::data_size>::tensor_type weights_type;
-		typedef typename reshaped_output::tensor_type bias_type;
+			reshaped_input::data_size>::template tensor_of<number_type>::type weights_type;
+		typedef typename reshaped_output::template tensor_of<number_type>::type bias_type;
+		typedef typename weights_type::metrics::template tensor_of<Storage>::type stored_weights_type;
 	
 		typedef typename serialization::chunk_serializer<
-			serialization::chunk_types::fully_connected_layer,
+			detail::fully_connected_chunk<Storage>::value,
 			serialization::composite_serializer<
-				serialization::tensor_serializer<weights_type>,
+				serialization::tensor_serializer<stored_weights_type>,
 				serialization::tensor_serializer<bias_type>,
 				serialization::value_serializer<number_type>>
 		> serializer_impl_type;
 
 		fully_connected(
 			const number_type regularization = 0.000001f)
-				: base_type(), m_input(), m_weights(), m_weightsGradient(), m_bias(), m_biasGradient(), m_regularization(regularization)
+				: base_type(), m_input(), m_weights(), m_storedWeights(), m_rowScale(unit_scale), m_bias(), m_biasGradient(), m_scaledGradient(), m_updateInput(), m_accumulatedUpdate(), m_regularization(regularization)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-				, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsKernelName()
+				, m_weightsGradient(), m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{
+			detail::assign_weights(m_weights, m_storedWeights);
 		}
 
 		fully_connected(
 			std::function<number_type()> initializer,
 			const number_type regularization = 0.000001f)
-				: base_type(), m_input(), m_weights(initializer), m_weightsGradient(), m_bias(initializer), m_biasGradient(), m_regularization(regularization)
+				: base_type(), m_input(), m_weights(initializer), m_storedWeights(), m_rowScale(unit_scale), m_bias(initializer), m_biasGradient(), m_scaledGradient(), m_updateInput(), m_accumulatedUpdate(), m_regularization(regularization)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-				, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsKernelName()
+				, m_weightsGradient(), m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{
+			detail::assign_weights(m_weights, m_storedWeights);
 		}
 
 		const output& process(const input& input)
 		{
 			m_input = input;
 
-			reshaped_input::tensor_type rin = input.reshape<reshaped_input>();
-			reshaped_output::tensor_type rout = m_output.reshape<reshaped_output>();
+			auto rin = input.reshape<reshaped_input>();
+			auto rout = m_output.reshape<reshaped_output>();
 
-			for (size_t j = 0; j < rout.size<0>(); ++j)
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, &rin, &rout](const size_t j)
 			{
 				number_type sum = 0.0f;
 				for (size_t i = 0; i < rin.size<0>(); ++i)
 				{
-					sum += m_weights(j, i) * rin(i);
+					sum += m_storedWeights(j, i) * rin(i);
 				}
 
-				rout(j) = sum + m_bias(j);
-			}
+				rout(j) = sum * m_rowScale(j) + m_bias(j);
+			});
 
 			return m_output;
 		}
 
 		const input& compute_gradient(const output& grad)
 		{
-			reshaped_input::tensor_type rin = m_input.reshape<reshaped_input>();
-			reshaped_input::tensor_type rgradResult = m_gradient.reshape<reshaped_input>();
-			reshaped_output::tensor_type rgrad = grad.reshape<reshaped_output>();
+			auto rin = m_input.reshape<reshaped_input>();
+			auto rgradResult = m_gradient.reshape<reshaped_input>();
+			auto rgrad = grad.reshape<reshaped_output>();
+
+			// The input may not outlive the backward pass, so the update reads a copy of it.
+			std::copy(rin.data(), rin.data() + reshaped_input::data_size, m_updateInput.data());
+
+			for (size_t j = 0; j < rgrad.size<0>(); ++j)
+			{
+				m_biasGradient(j) = rgrad(j);
+				m_scaledGradient(j) = rgrad(j) * m_rowScale(j);
+			}
 
-			for (size_t i = 0; i < rgradResult.size<0>(); ++i)
+			parallel::parallel_for<reshaped_input::data_size, reshaped_output::data_size>([this, &rgradResult](const size_t i)
 			{
 				number_type sum = 0.0f;
-				for (size_t j = 0; j < rgrad.size<0>(); ++j)
+				for (size_t j = 0; j < m_scaledGradient.size<0>(); ++j)
 				{
-					sum += m_weights(j, i) * rgrad(j);
-
-					m_weightsGradient(j, i) = rin(i) * rgrad(j);
+					sum += m_storedWeights(j, i) * m_scaledGradient(j);
 				}
 
 				rgradResult(i) = sum;
-			}
-
-			for (size_t j = 0; j < rgrad.size<0>(); ++j)
-			{
-				m_biasGradient(j) = rgrad(j);
-			}
+			});
 
 			return m_gradient;
 		}
@@ -128,18 +232,134 @@ namespace neural_network {
 		void update_weights(
 			const number_type rate)
 		{
-			for (size_t i = 0; i < m_weights.size<0>(); ++i)
+			const number_type decay = 1 + m_regularization * rate;
+
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, rate, decay](const size_t j)
 			{
-				for (size_t j = 0; j < m_weights.size<1>(); ++j)
+				if (number_type(0) == m_biasGradient(j))
+				{
+					m_rowScale(j) *= decay;
+					return;
+				}
+
+				const number_type scale = m_rowScale(j) * decay;
+				const number_type step = m_biasGradient(j) * rate;
+
+				const number_type* values = m_updateInput.data();
+				number_type* row = m_weights.data() + j * reshaped_input::data_size;
+
+				for (size_t i = 0; i < reshaped_input::data_size; ++i)
 				{
-					m_weights(i, j) += (m_weightsGradient(i, j) + m_regularization * m_weights(i, j)) * rate;
+					row[i] = row[i] * scale + values[i] * step;
 				}
+
+				m_rowScale(j) = 1;
+				detail::assign_weights_row<reshaped_input::data_size>(m_weights, m_storedWeights, j);
+			});
+
+			for (size_t j = 0; j < m_bias.size<0>(); ++j)
+			{
+				m_bias(j) = m_bias(j) * decay + m_biasGradient(j) * rate;
+			}
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its micro-batches.
+		// Every row keeps the product of the inputs and its gradient, and the bias step.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			detail::accumulated_update<number_type>& update = target.m_accumulatedUpdate;
+
+			for (size_t j = 0; j < m_biasGradient.size<0>(); ++j)
+			{
+				if (number_type(0) != m_biasGradient(j))
+					update.row(j, reshaped_input::data_size + 1);
 			}
 
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, &update, rate](const size_t j)
+			{
+				number_type* row = update.find(j);
+				if (nullptr == row)
+					return;
+
+				const number_type step = m_biasGradient(j) * rate;
+				const number_type* values = m_updateInput.data();
+
+				for (size_t i = 0; i < reshaped_input::data_size; ++i)
+				{
+					row[i] += values[i] * step;
+				}
+
+				row[reshaped_input::data_size] += step;
+			});
+
+			update.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights, with the regularization of all accumulated passes. The update of a single
+		// pass matches update_weights. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			const detail::accumulated_update<number_type>& update = source.m_accumulatedUpdate;
+			const number_type decay = 1 + m_regularization * update.rate();
+
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, &update, decay](const size_t j)
+			{
+				const number_type* values = update.find(j);
+				if (nullptr == values)
+				{
+					m_rowScale(j) *= decay;
+					return;
+				}
+
+				const number_type scale = m_rowScale(j) * decay;
+				number_type* row = m_weights.data() + j * reshaped_input::data_size;
+
+				for (size_t i = 0; i < reshaped_input::data_size; ++i)
+				{
+					row[i] = row[i] * scale + values[i];
+				}
+
+				m_rowScale(j) = 1;
+				detail::assign_weights_row<reshaped_input::data_size>(m_weights, m_storedWeights, j);
+			});
+
 			for (size_t j = 0; j < m_bias.size<0>(); ++j)
 			{
-				m_bias(j) += (m_biasGradient(j) + m_regularization * m_bias(j)) * rate;
+				const number_type* values = update.find(j);
+				m_bias(j) = m_bias(j) * decay + ((nullptr == values) ? number_type(0) : values[reshaped_input::data_size]);
 			}
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
 		}
 
 		struct serializer
@@ -152,14 +372,32 @@ namespace neural_network {
 				std::istream& in,
 				value_type& layer)
 			{
-				serializer_impl_type::read(in, layer.m_weights, layer.m_bias, layer.m_regularization);
+				serializer_impl_type::read(in, layer.m_storedWeights, layer.m_bias, layer.m_regularization);
+				detail::assign_weights(layer.m_storedWeights, layer.m_weights);
+
+				layer.m_rowScale = bias_type(unit_scale);
+				layer.m_accumulatedUpdate.clear();
 			}
 
+			// Rows with a pending scale are written scaled, the layer itself is not changed.
 			static void write(
 				std::ostream& out,
 				const value_type& layer)
 			{
-				serializer_impl_type::write(out, layer.m_weights, layer.m_bias, layer.m_regularization);
+				if (!layer.has_pending_scale())
+				{
+					serializer_impl_type::write(out, layer.m_storedWeights, layer.m_bias, layer.m_regularization);
+				}
+				else
+				{
+					weights_type weights;
+					layer.get_scaled_weights(weights);
+
+					stored_weights_type stored;
+					detail::assign_weights(weights, stored);
+
+					serializer_impl_type::write(out, stored, layer.m_bias, layer.m_regularization);
+				}
 			}
 		};
 
@@ -186,6 +424,40 @@ namespace neural_network {
 			this->dispatch_update_weights<weights_type::data_size>(rate, queue);
 		}
 
+		enum : bool { supports_fused_epilogue = !(weights_type::data_size < opencl::detail::layer_kernels::min_matrix_size) };
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(supports_fused_epilogue, "Layer is too small to be processed on the device.");
+
+			m_input = input;
+
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::fully_connected_weights<Storage>::get_kernel_name();
+			}
+
+			reshaped_input::tensor_type rin = m_input.reshape<reshaped_input>();
+			reshaped_output::tensor_type rout = result.reshape<reshaped_output>();
+
+			opencl::detail::fully_connected::process(
+				rin,
+				get_device_weights(),
+				m_bias,
+				rout,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
 	private:
 		template <const size_t TensorSize>
 		const output& dispatch_process(
@@ -217,7 +489,7 @@ namespace neural_network {
 
 			opencl::detail::fully_connected::process(
 				rin,
-				m_weights,
+				get_device_weights(),
 				m_bias,
 				rout,
 				m_kernelProgram,
@@ -257,7 +529,7 @@ namespace neural_network {
 
 			opencl::detail::fully_connected::compute_gradient(
 				rin,
-				m_weights,
+				get_device_weights(),
 				rgrad,
 				rgradResult,
 				m_weightsGradient,
@@ -292,6 +564,7 @@ namespace neural_network {
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
+			apply_scale();
 
 			opencl::detail::fully_connected::update_weights(
 				m_weightsGradient,
@@ -304,6 +577,33 @@ namespace neural_network {
 				m_weightsKernelName,
 				context,
 				queue);
+
+			detail::assign_weights(m_weights, m_storedWeights);
+		}
+
+		// The device kernels read the stored weights as they are, so the forward and backward passes
+		// read a scaled copy of rows with a pending scale, and the update applies the scale to the
+		// float master weights.
+		stored_weights_type get_device_weights() const
+		{
+			if (!has_pending_scale())
+				return m_storedWeights;
+
+			weights_type weights;
+			get_scaled_weights(weights);
+
+			stored_weights_type storedWeights;
+			detail::assign_weights(weights, storedWeights);
+
+			return storedWeights;
+		}
+
+		void apply_scale()
+		{
+			for (size_t j = 0; j < m_rowScale.size<0>(); ++j)
+			{
+				apply_row_scale(j);
+			}
 		}
 
 		void initialize_opencl(
@@ -313,8 +613,8 @@ namespace neural_network {
 			{
 				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
 
-				m_processKernelName = opencl::detail::layer_kernels::get_fully_connected_kernel_name();
-				m_gradientKernelName = opencl::detail::layer_kernels::get_fully_connected_gradient_kernel_name();
+				m_processKernelName = opencl::detail::fully_connected_weights<Storage>::get_kernel_name();
+				m_gradientKernelName = opencl::detail::fully_connected_weights<Storage>::get_gradient_kernel_name();
 				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
 			}
 		}
@@ -322,29 +622,76 @@ namespace neural_network {
 #endif
 
 	private:
+		static number_type unit_scale()
+		{
+			return 1;
+		}
+
+		bool has_pending_scale() const
+		{
+			const number_type* scale = m_rowScale.data();
+			return !std::all_of(scale, scale + bias_type::data_size, [](const number_type& value) { return number_type(1) == value; });
+		}
+
+		void get_scaled_weights(
+			weights_type& weights) const
+		{
+			for (size_t j = 0; j < weights.size<0>(); ++j)
+			{
+				for (size_t i = 0; i < weights.size<1>(); ++i)
+				{
+					weights(j, i) = m_weights(j, i) * m_rowScale(j);
+				}
+			}
+		}
+
+		void apply_row_scale(
+			const size_t j)
+		{
+			if (number_type(1) == m_rowScale(j))
+				return;
+
+			number_type* row = m_weights.data() + j * reshaped_input::data_size;
+
+			for (size_t i = 0; i < reshaped_input::data_size; ++i)
+			{
+				row[i] *= m_rowScale(j);
+			}
+
+			m_rowScale(j) = 1;
+			detail::assign_weights_row<reshaped_input::data_size>(m_weights, m_storedWeights, j);
+		}
+
 		input m_input;
 		weights_type m_weights;
-		weights_type m_weightsGradient;
+		stored_weights_type m_storedWeights;
+		bias_type m_rowScale;
 		bias_type m_bias;
 		bias_type m_biasGradient;
+		bias_type m_scaledGradient;
+		typename reshaped_input::template tensor_of<number_type>::type m_updateInput;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
 		number_type m_regularization;
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	private:
+		weights_type m_weightsGradient;
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
 		std::string m_gradientKernelName;
 		std::string m_weightsKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
 
 #endif
 	};
 
-	template <class Input, class Output, class... Args>
-	fully_connected<Input, Output> make_fully_connected_layer(
+	template <class Input, class Output, class Storage = float, class... Args>
+	fully_connected<Input, Output, Storage> make_fully_connected_layer(
 		Args&&... args)
 	{
-		typedef fully_connected<Input, Output> _Ltype;
+		typedef fully_connected<Input, Output, Storage> _Ltype;
 		return (_Ltype(std::forward<Args>(args)...));
 	}
 }
\ No newline at end of file
@@ -26,11 +26,16 @@ SOFTWARE.
 
 #include "layer.h"
 #include "core.h"
+#include "layout.h"
+#include "winograd.h"
+#include "fft.h"
+#include "parallel.h"
 #include "serialization.h"
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 #include "opencl/convolution.h"
+#include "opencl/fusion.h"
 
 #endif
 
@@ -91,34 +96,59 @@ namespace detail {
 		Bias m_bias;
 	};
 
-	template <class Metrics, class Core, class Stride, const size_t Kernels>
+	// Direct convolution keeps no state derived from the weights.
+	struct direct_convolution_cache
+	{
+		void invalidate()
+		{
+		}
+	};
+
+	template <class Metrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Number>
 	struct convolution_1d
 	{
 		static_assert(Metrics::rank == 1, "Invalid metric rank for 1D convolution.");
 
-		typedef typename convolution_1d<Metrics, Core, Stride, Kernels> this_type;
+		typedef typename convolution_1d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics convolution_metrics;
-		typedef typename convolution_metrics::template expand<Kernels>::type::tensor_type output;
-		typedef typename Core::template expand<Kernels>::type::tensor_type kernel_weights;
-		typedef typename algebra::metrics<Kernels>::tensor_type bias;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics convolution_metrics;
+		typedef typename convolution_metrics::template expand<Kernels>::type::template tensor_of<Number>::type output;
+		typedef typename Core::template expand<Kernels>::type::template tensor_of<Number>::type kernel_weights;
+		typedef typename algebra::metrics<Kernels>::template tensor_of<Number>::type bias;
 		typedef typename convolution_kernels<kernel_weights, bias> weights_type;
 		typedef typename weights_type::serializer serializer;
 		typedef typename weights_type::number_type number_type;
 
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		enum : bool { is_fft = is_dense && !(Core::dimension_size < fft_convolution_min_core_size) };
+
+		enum : size_t {
+			kernel_work = convolution_metrics::data_size * Core::data_size,
+			input_row_work = Kernels * kernel_work / Metrics::dimension_size
+		};
+
+		typedef typename std::conditional<
+			is_fft,
+			fft_convolution_1d<input, kernel_weights, Stride::dimension_size>,
+			direct_convolution_cache
+		>::type weights_cache;
+
 		convolution_1d()
-			: m_weights()
+			: m_weights(), m_cache()
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_weightsKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{}
 
 		convolution_1d(
 			std::function<number_type()> initializer)
-				: m_weights(initializer)
+				: m_weights(initializer), m_cache()
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName()
+				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{
 		}
@@ -127,35 +157,76 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			for (size_t kernel = 0; kernel < result.size<0>(); ++kernel)
+			this->dispatch_host_process<is_fft>(input, result);
+		}
+
+		void compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient)
+		{
+			this->dispatch_host_compute_gradient<is_fft>(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const bool FFT>
+		void dispatch_host_process(
+			const input& input,
+			output& result,
+			std::enable_if_t<FFT>* = 0)
+		{
+			m_cache.process(m_weights.m_kernels, m_weights.m_bias, input, result);
+		}
+
+		template <const bool FFT>
+		void dispatch_host_process(
+			const input& input,
+			output& result,
+			std::enable_if_t<!FFT>* = 0)
+		{
+			parallel::parallel_for<Kernels, kernel_work>([this, &input, &result](const size_t kernel)
 			{
 				for (size_t stride = 0; stride < result.size<1>(); ++stride)
 				{
 					number_type sum = 0.0f;
 
-					const size_t baseX = stride * algebra::detail::dimension<Stride, 0>::size;
+					const size_t lastX = window_x::end(stride);
 
-					for (size_t x = 0; x < m_weights.m_kernels.size<1>(); ++x)
+					for (size_t x = window_x::begin(stride); x < lastX; ++x)
 					{
-						sum += m_weights.m_kernels(kernel, x) * input(baseX + x);
+						sum += m_weights.m_kernels(kernel, x) * input(window_x::offset(stride, x));
 					}
 
 					result(kernel, stride) = sum + m_weights.m_bias(kernel);
 				}
-			}
+			});
 		}
 
-		void compute_gradient(
+		template <const bool FFT>
+		void dispatch_host_compute_gradient(
 			const input& in,
 			const output& grad,
 			input& result,
 			kernel_weights& kernelGradient,
-			bias& biasGradient)
+			bias& biasGradient,
+			std::enable_if_t<FFT>* = 0)
+		{
+			m_cache.compute_gradient(m_weights.m_kernels, in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const bool FFT>
+		void dispatch_host_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			std::enable_if_t<!FFT>* = 0)
 		{
-			result.fill(0.0f);
 			kernelGradient.fill(0.0f);
 
-			for (size_t kernel = 0; kernel < grad.size<0>(); ++kernel)
+			parallel::parallel_for<Kernels, kernel_work>([&in, &grad, &kernelGradient, &biasGradient](const size_t kernel)
 			{
 				number_type sum = 0.0f;
 
@@ -164,17 +235,38 @@ namespace detail {
 					number_type g = grad(kernel, x);
 					sum += g;
 
-					const size_t baseX = x * algebra::detail::dimension<Stride, 0>::size;
+					const size_t lastI = window_x::end(x);
 
-					for (size_t i = 0; i < algebra::detail::dimension<Core, 0>::size; ++i)
+					for (size_t i = window_x::begin(x); i < lastI; ++i)
 					{
-						result(baseX + i) += g * m_weights.m_kernels(kernel, i);
-						kernelGradient(kernel, i) += g * in(baseX + i);
+						kernelGradient(kernel, i) += g * in(window_x::offset(x, i));
 					}
 				}
 
 				biasGradient(kernel) = sum;
-			}
+			});
+
+			// Every input element gathers its gradient in the same kernel and position order
+			// as a scatter over the output would, so the result does not depend on the split.
+			parallel::parallel_for<Metrics::dimension_size, input_row_work>([this, &grad, &result](const size_t inputX)
+			{
+				number_type sum = 0.0f;
+
+				const size_t lastX = window_x::last_position(inputX);
+
+				for (size_t kernel = 0; kernel < Kernels; ++kernel)
+				{
+					for (size_t x = window_x::first_position(inputX); x < lastX; ++x)
+					{
+						const size_t i = window_x::core_index(x, inputX);
+
+						if (i < window_x::core_size)
+							sum += grad(kernel, x) * m_weights.m_kernels(kernel, i);
+					}
+				}
+
+				result(inputX) = sum;
+			});
 		}
 
 		void update_weights(
@@ -191,6 +283,8 @@ namespace detail {
 
 				m_weights.m_bias(kernel) += biasGradient(kernel) * rate;
 			}
+
+			m_cache.invalidate();
 		}
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -201,7 +295,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(Kernels < 2)
+				(Kernels < 2) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -213,14 +307,56 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(Kernels < 2)
+				!(Kernels < 2) && is_dense
 			>* = 0)
 		{
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
 
-			opencl::detail::convolution::process_1d(
+			process_on_device(
+				input,
+				result,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::layer_kernels::get_1d_convolution_kernel_name();
+			}
+
+			process_on_device(
+				input,
+				result,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::process_batch_1d(
 				input,
 				m_weights.m_kernels,
 				m_weights.m_bias,
@@ -232,6 +368,68 @@ namespace detail {
 				queue);
 		}
 
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(Kernels < 2) || !is_dense
+			>* = 0)
+		{
+			this->compute_gradient(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(Kernels < 2) && is_dense
+			>* = 0)
+		{
+			compute_gradient_on_device(in, grad, result, kernelGradient, biasGradient, 1, queue);
+		}
+
+		template <class Input, class Output>
+		void compute_gradient_on_device(
+			const Input& in,
+			const Output& grad,
+			Input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			const size_t batchSize,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::compute_gradient_1d(
+				in,
+				m_weights.m_kernels,
+				grad,
+				result,
+				kernelGradient,
+				biasGradient,
+				algebra::detail::dimension<Metrics, 0>::size,
+				algebra::detail::dimension<convolution_metrics, 0>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				batchSize,
+				m_kernelProgram,
+				m_gradientKernelName,
+				m_weightsGradientKernelName,
+				context,
+				queue);
+		}
+
 		template<const size_t KernelSize>
 		void dispatch_update_weights(
 			const kernel_weights& kernelGradient,
@@ -269,6 +467,8 @@ namespace detail {
 				m_weightsKernelName,
 				context,
 				queue);
+
+			m_cache.invalidate();
 		}
 
 		void initialize_opencl(
@@ -280,51 +480,109 @@ namespace detail {
 
 				m_processKernelName = opencl::detail::layer_kernels::get_1d_convolution_kernel_name();
 				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_1d_convolution_gradient_kernel_name();
+				m_weightsGradientKernelName = opencl::detail::layer_kernels::get_1d_convolution_weights_gradient_kernel_name();
 			}
 		}
 
+		void process_on_device(
+			const input& input,
+			output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			opencl::detail::convolution::process_1d(
+				input,
+				m_weights.m_kernels,
+				m_weights.m_bias,
+				result,
+				algebra::detail::dimension<Stride, 0>::size,
+				program,
+				kernelName,
+				context,
+				queue);
+		}
+
 #endif
 
+		void invalidate_cache()
+		{
+			m_cache.invalidate();
+		}
+
 		weights_type m_weights;
 
+	private:
+		weights_cache m_cache;
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	private:
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
 		std::string m_weightsKernelName;
+		std::string m_gradientKernelName;
+		std::string m_weightsGradientKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
 
 #endif
 	};
 
-	template <class Metrics, class Core, class Stride, const size_t Kernels>
+	template <class Metrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Number>
 	struct convolution_2d
 	{
 		static_assert(Metrics::rank == 2, "Invalid metric rank for 2D convolution.");
 
-		typedef typename convolution_2d<Metrics, Core, Stride, Kernels> this_type;
+		typedef typename convolution_2d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics convolution_metrics;
-		typedef typename convolution_metrics::template expand<Kernels>::type::tensor_type output;
-		typedef typename Core::template expand<Kernels>::type::tensor_type kernel_weights;
-		typedef typename algebra::metrics<Kernels>::tensor_type bias;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics convolution_metrics;
+		typedef typename convolution_metrics::template expand<Kernels>::type::template tensor_of<Number>::type output;
+		typedef typename Core::template expand<Kernels>::type::template tensor_of<Number>::type kernel_weights;
+		typedef typename algebra::metrics<Kernels>::template tensor_of<Number>::type bias;
 		typedef typename convolution_kernels<kernel_weights, bias> weights_type;
 		typedef typename weights_type::serializer serializer;
 		typedef typename weights_type::number_type number_type;
 
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 1> window_y;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		enum : bool {
+			is_winograd = is_dense
+				&& (3 == algebra::detail::dimension<Core, 0>::size)
+				&& (3 == algebra::detail::dimension<Core, 1>::size)
+				&& (1 == algebra::detail::dimension<Stride, 0>::size)
+				&& (1 == algebra::detail::dimension<Stride, 1>::size)
+		};
+
+		typedef typename std::conditional<
+			is_winograd,
+			winograd_f2x2_3x3<kernel_weights>,
+			direct_convolution_cache
+		>::type weights_cache;
+
+		enum : size_t {
+			kernel_work = convolution_metrics::data_size * Core::data_size,
+			input_row_work = Kernels * kernel_work / algebra::detail::dimension<Metrics, 0>::size
+		};
+
 		convolution_2d()
-			: m_weights()
+			: m_weights(), m_cache()
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_processKernelName(), m_weightsKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{}
 
 		convolution_2d(
 			std::function<number_type()> initializer)
-				: m_weights(initializer)
+				: m_weights(initializer), m_cache()
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName()
+				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{
 		}
@@ -333,7 +591,35 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			for (size_t kernel = 0; kernel < result.size<0>(); ++kernel)
+			this->dispatch_host_process<is_winograd>(input, result);
+		}
+
+		void compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient)
+		{
+			this->dispatch_host_compute_gradient<is_winograd>(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const bool Winograd>
+		void dispatch_host_process(
+			const input& input,
+			output& result,
+			std::enable_if_t<Winograd>* = 0)
+		{
+			m_cache.process(m_weights.m_kernels, m_weights.m_bias, input, result);
+		}
+
+		template <const bool Winograd>
+		void dispatch_host_process(
+			const input& input,
+			output& result,
+			std::enable_if_t<!Winograd>* = 0)
+		{
+			parallel::parallel_for<Kernels, kernel_work>([this, &input, &result](const size_t kernel)
 			{
 				for (size_t strideX = 0; strideX < result.size<1>(); ++strideX)
 				{
@@ -341,34 +627,77 @@ namespace detail {
 					{
 						number_type sum = 0.0f;
 
-						const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-						const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+						const size_t lastX = window_x::end(strideX);
+						const size_t firstY = window_y::begin(strideY);
+						const size_t lastY = window_y::end(strideY);
 
-						for (size_t x = 0; x < m_weights.m_kernels.size<1>(); ++x)
+						for (size_t x = window_x::begin(strideX); x < lastX; ++x)
 						{
-							for (size_t y = 0; y < m_weights.m_kernels.size<2>(); ++y)
+							const size_t inputX = window_x::offset(strideX, x);
+
+							for (size_t y = firstY; y < lastY; ++y)
 							{
-								sum += m_weights.m_kernels(kernel, x, y) * input(baseX + x, baseY + y);
+								sum += m_weights.m_kernels(kernel, x, y) * input(inputX, window_y::offset(strideY, y));
 							}
 						}
 
 						result(kernel, strideX, strideY) = sum + m_weights.m_bias(kernel);
 					}
 				}
-			}
+			});
 		}
 
-		void compute_gradient(
+		template <const bool Winograd>
+		void dispatch_host_compute_gradient(
 			const input& in,
 			const output& grad,
 			input& result,
 			kernel_weights& kernelGradient,
-			bias& biasGradient)
+			bias& biasGradient,
+			std::enable_if_t<Winograd>* = 0)
+		{
+			m_cache.compute_gradient(m_weights.m_kernels, grad, result);
+
+			kernelGradient.fill(0.0f);
+
+			parallel::parallel_for<Kernels, kernel_work>([&in, &grad, &kernelGradient, &biasGradient](const size_t kernel)
+			{
+				number_type sum = 0.0f;
+
+				for (size_t x = 0; x < grad.size<1>(); ++x)
+				{
+					for (size_t y = 0; y < grad.size<2>(); ++y)
+					{
+						number_type g = grad(kernel, x, y);
+						sum += g;
+
+						for (size_t i = 0; i < 3; ++i)
+						{
+							for (size_t j = 0; j < 3; ++j)
+							{
+								kernelGradient(kernel, i, j) += g * in(x + i, y + j);
+							}
+						}
+					}
+				}
+
+				biasGradient(kernel) = sum;
+			});
+		}
+
+		template <const bool Winograd>
+		void dispatch_host_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			std::enable_if_t<!Winograd>* = 0)
 		{
 			result.fill(0.0f);
 			kernelGradient.fill(0.0f);
 
-			for (size_t kernel = 0; kernel < grad.size<0>(); ++kernel)
+			parallel::parallel_for<Kernels, kernel_work>([&in, &grad, &kernelGradient, &biasGradient](const size_t kernel)
 			{
 				number_type sum = 0.0f;
 
@@ -379,22 +708,54 @@ namespace detail {
 						number_type g = grad(kernel, x, y);
 						sum += g;
 
-						const size_t baseX = x * algebra::detail::dimension<Stride, 0>::size;
-						const size_t baseY = y * algebra::detail::dimension<Stride, 1>::size;
+						const size_t lastI = window_x::end(x);
+						const size_t firstJ = window_y::begin(y);
+						const size_t lastJ = window_y::end(y);
 
-						for (size_t i = 0; i < algebra::detail::dimension<Core, 0>::size; ++i)
+						for (size_t i = window_x::begin(x); i < lastI; ++i)
 						{
-							for (size_t j = 0; j < algebra::detail::dimension<Core, 1>::size; ++j)
+							const size_t inputX = window_x::offset(x, i);
+
+							for (size_t j = firstJ; j < lastJ; ++j)
 							{
-								result(baseX + i, baseY + j) += g * m_weights.m_kernels(kernel, i, j);
-								kernelGradient(kernel, i, j) += g * in(baseX + i, baseY + j);
+								kernelGradient(kernel, i, j) += g * in(inputX, window_y::offset(y, j));
 							}
 						}
 					}
 				}
 
 				biasGradient(kernel) = sum;
-			}
+			});
+
+			// Rows of the input gradient are gathered independently. Every element still receives
+			// its terms in the kernel and output position order of a scatter over the output.
+			parallel::parallel_for<algebra::detail::dimension<Metrics, 0>::size, input_row_work>([this, &grad, &result](const size_t inputX)
+			{
+				const size_t lastX = window_x::last_position(inputX);
+
+				for (size_t kernel = 0; kernel < Kernels; ++kernel)
+				{
+					for (size_t x = window_x::first_position(inputX); x < lastX; ++x)
+					{
+						const size_t i = window_x::core_index(x, inputX);
+
+						if (!(i < window_x::core_size))
+							continue;
+
+						for (size_t y = 0; y < grad.size<2>(); ++y)
+						{
+							number_type g = grad(kernel, x, y);
+
+							const size_t lastJ = window_y::end(y);
+
+							for (size_t j = window_y::begin(y); j < lastJ; ++j)
+							{
+								result(inputX, window_y::offset(y, j)) += g * m_weights.m_kernels(kernel, i, j);
+							}
+						}
+					}
+				}
+			});
 		}
 
 		void update_weights(
@@ -414,6 +775,8 @@ namespace detail {
 
 				m_weights.m_bias(kernel) += biasGradient(kernel) * rate;
 			}
+
+			m_cache.invalidate();
 		}
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -424,7 +787,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(Kernels < 2)
+				(Kernels < 2) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -436,14 +799,56 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(Kernels < 2)
+				!(Kernels < 2) && is_dense
 			>* = 0)
 		{
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
 
-			opencl::detail::convolution::process_2d(
+			process_on_device(
+				input,
+				result,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::layer_kernels::get_2d_convolution_kernel_name();
+			}
+
+			process_on_device(
+				input,
+				result,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::process_batch_2d(
 				input,
 				m_weights.m_kernels,
 				m_weights.m_bias,
@@ -456,7 +861,72 @@ namespace detail {
 				queue);
 		}
 
-		template<const size_t KernelSize>
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(Kernels < 2) || !is_dense
+			>* = 0)
+		{
+			this->compute_gradient(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(Kernels < 2) && is_dense
+			>* = 0)
+		{
+			compute_gradient_on_device(in, grad, result, kernelGradient, biasGradient, 1, queue);
+		}
+
+		template <class Input, class Output>
+		void compute_gradient_on_device(
+			const Input& in,
+			const Output& grad,
+			Input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			const size_t batchSize,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::compute_gradient_2d(
+				in,
+				m_weights.m_kernels,
+				grad,
+				result,
+				kernelGradient,
+				biasGradient,
+				algebra::detail::dimension<Metrics, 0>::size,
+				algebra::detail::dimension<Metrics, 1>::size,
+				algebra::detail::dimension<convolution_metrics, 0>::size,
+				algebra::detail::dimension<convolution_metrics, 1>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				batchSize,
+				m_kernelProgram,
+				m_gradientKernelName,
+				m_weightsGradientKernelName,
+				context,
+				queue);
+		}
+
+		template<const size_t KernelSize>
 		void dispatch_update_weights(
 			const kernel_weights& kernelGradient,
 			const bias& biasGradient,
@@ -493,6 +963,8 @@ namespace detail {
 				m_weightsKernelName,
 				context,
 				queue);
+
+			m_cache.invalidate();
 		}
 
 		void initialize_opencl(
@@ -504,43 +976,89 @@ namespace detail {
 
 				m_processKernelName = opencl::detail::layer_kernels::get_2d_convolution_kernel_name();
 				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_2d_convolution_gradient_kernel_name();
+				m_weightsGradientKernelName = opencl::detail::layer_kernels::get_2d_convolution_weights_gradient_kernel_name();
 			}
 		}
 
+		void process_on_device(
+			const input& input,
+			output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			opencl::detail::convolution::process_2d(
+				input,
+				m_weights.m_kernels,
+				m_weights.m_bias,
+				result,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				program,
+				kernelName,
+				context,
+				queue);
+		}
+
 #endif
 
+		void invalidate_cache()
+		{
+			m_cache.invalidate();
+		}
+
 		weights_type m_weights;
 
+	private:
+		weights_cache m_cache;
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	private:
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
 		std::string m_weightsKernelName;
+		std::string m_gradientKernelName;
+		std::string m_weightsGradientKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
 
 #endif
 	};
 
-	template <class Metrics, class Core, class Stride, const size_t Kernels>
+	template <class Metrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Number>
 	struct convolution_3d
 	{
 		static_assert(Metrics::rank == 3, "Invalid metric rank for 3D convolution.");
 
-		typedef typename convolution_3d<Metrics, Core, Stride, Kernels> this_type;
+		typedef typename convolution_3d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics convolution_metrics;
-		typedef typename convolution_metrics::template expand<Kernels>::type::tensor_type output;
-		typedef typename Core::template expand<Kernels>::type::tensor_type kernel_weights;
-		typedef typename algebra::metrics<Kernels>::tensor_type bias;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics convolution_metrics;
+		typedef typename convolution_metrics::template expand<Kernels>::type::template tensor_of<Number>::type output;
+		typedef typename Core::template expand<Kernels>::type::template tensor_of<Number>::type kernel_weights;
+		typedef typename algebra::metrics<Kernels>::template tensor_of<Number>::type bias;
 		typedef typename convolution_kernels<kernel_weights, bias> weights_type;
 		typedef typename weights_type::serializer serializer;
 		typedef typename weights_type::number_type number_type;
 
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 1> window_y;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 2> window_z;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		enum : size_t {
+			kernel_work = convolution_metrics::data_size * Core::data_size,
+			input_row_work = Kernels * kernel_work / algebra::detail::dimension<Metrics, 0>::size
+		};
+
 		convolution_3d()
 			: m_weights()
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_processKernelName(), m_weightsKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{}
 
@@ -548,7 +1066,7 @@ namespace detail {
 			std::function<number_type()> initializer)
 				: m_weights(initializer)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName()
+				, m_kernelProgram(), m_processKernelName(), m_weightsKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
 #endif
 		{
 		}
@@ -557,7 +1075,7 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			for (size_t kernel = 0; kernel < result.size<0>(); ++kernel)
+			parallel::parallel_for<Kernels, kernel_work>([this, &input, &result](const size_t kernel)
 			{
 				for (size_t strideX = 0; strideX < result.size<1>(); ++strideX)
 				{
@@ -567,17 +1085,23 @@ namespace detail {
 						{
 							number_type sum = 0.0f;
 
-							const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-							const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
-							const size_t baseZ = strideZ * algebra::detail::dimension<Stride, 2>::size;
+							const size_t lastX = window_x::end(strideX);
+							const size_t firstY = window_y::begin(strideY);
+							const size_t lastY = window_y::end(strideY);
+							const size_t firstZ = window_z::begin(strideZ);
+							const size_t lastZ = window_z::end(strideZ);
 
-							for (size_t x = 0; x < m_weights.m_kernels.size<1>(); ++x)
+							for (size_t x = window_x::begin(strideX); x < lastX; ++x)
 							{
-								for (size_t y = 0; y < m_weights.m_kernels.size<2>(); ++y)
+								const size_t inputX = window_x::offset(strideX, x);
+
+								for (size_t y = firstY; y < lastY; ++y)
 								{
-									for (size_t z = 0; z < m_weights.m_kernels.size<3>(); ++z)
+									const size_t inputY = window_y::offset(strideY, y);
+
+									for (size_t z = firstZ; z < lastZ; ++z)
 									{
-										sum += m_weights.m_kernels(kernel, x, y, z) * input(baseX + x, baseY + y, baseZ + z);
+										sum += m_weights.m_kernels(kernel, x, y, z) * input(inputX, inputY, window_z::offset(strideZ, z));
 									}
 								}
 							}
@@ -586,7 +1110,7 @@ namespace detail {
 						}
 					}
 				}
-			}
+			});
 		}
 
 		void compute_gradient(
@@ -599,7 +1123,7 @@ namespace detail {
 			result.fill(0.0f);
 			kernelGradient.fill(0.0f);
 
-			for (size_t kernel = 0; kernel < grad.size<0>(); ++kernel)
+			parallel::parallel_for<Kernels, kernel_work>([&in, &grad, &kernelGradient, &biasGradient](const size_t kernel)
 			{
 				number_type sum = 0.0f;
 
@@ -612,18 +1136,23 @@ namespace detail {
 							number_type g = grad(kernel, x, y, z);
 							sum += g;
 
-							const size_t baseX = x * algebra::detail::dimension<Stride, 0>::size;
-							const size_t baseY = y * algebra::detail::dimension<Stride, 1>::size;
-							const size_t baseZ = z * algebra::detail::dimension<Stride, 2>::size;
+							const size_t lastI = window_x::end(x);
+							const size_t firstJ = window_y::begin(y);
+							const size_t lastJ = window_y::end(y);
+							const size_t firstK = window_z::begin(z);
+							const size_t lastK = window_z::end(z);
 
-							for (size_t i = 0; i < algebra::detail::dimension<Core, 0>::size; ++i)
+							for (size_t i = window_x::begin(x); i < lastI; ++i)
 							{
-								for (size_t j = 0; j < algebra::detail::dimension<Core, 1>::size; ++j)
+								const size_t inputX = window_x::offset(x, i);
+
+								for (size_t j = firstJ; j < lastJ; ++j)
 								{
-									for (size_t k = 0; k < algebra::detail::dimension<Core, 2>::size; ++k)
+									const size_t inputY = window_y::offset(y, j);
+
+									for (size_t k = firstK; k < lastK; ++k)
 									{
-										result(baseX + i, baseY + j, baseZ + k) += g * m_weights.m_kernels(kernel, i, j, k);
-										kernelGradient(kernel, i, j, k) += g * in(baseX + i, baseY + j, baseZ + k);
+										kernelGradient(kernel, i, j, k) += g * in(inputX, inputY, window_z::offset(z, k));
 									}
 								}
 							}
@@ -632,7 +1161,46 @@ namespace detail {
 				}
 
 				biasGradient(kernel) = sum;
-			}
+			});
+
+			parallel::parallel_for<algebra::detail::dimension<Metrics, 0>::size, input_row_work>([this, &grad, &result](const size_t inputX)
+			{
+				const size_t lastX = window_x::last_position(inputX);
+
+				for (size_t kernel = 0; kernel < Kernels; ++kernel)
+				{
+					for (size_t x = window_x::first_position(inputX); x < lastX; ++x)
+					{
+						const size_t i = window_x::core_index(x, inputX);
+
+						if (!(i < window_x::core_size))
+							continue;
+
+						for (size_t y = 0; y < grad.size<2>(); ++y)
+						{
+							for (size_t z = 0; z < grad.size<3>(); ++z)
+							{
+								number_type g = grad(kernel, x, y, z);
+
+								const size_t firstJ = window_y::begin(y);
+								const size_t lastJ = window_y::end(y);
+								const size_t firstK = window_z::begin(z);
+								const size_t lastK = window_z::end(z);
+
+								for (size_t j = firstJ; j < lastJ; ++j)
+								{
+									const size_t inputY = window_y::offset(y, j);
+
+									for (size_t k = firstK; k < lastK; ++k)
+									{
+										result(inputX, inputY, window_z::offset(z, k)) += g * m_weights.m_kernels(kernel, i, j, k);
+									}
+								}
+							}
+						}
+					}
+				}
+			});
 		}
 
 		void update_weights(
@@ -665,7 +1233,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(Kernels < 2)
+				(Kernels < 2) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -677,14 +1245,56 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(Kernels < 2)
+				!(Kernels < 2) && is_dense
 			>* = 0)
 		{
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
 
-			opencl::detail::convolution::process_3d(
+			process_on_device(
+				input,
+				result,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::layer_kernels::get_3d_convolution_kernel_name();
+			}
+
+			process_on_device(
+				input,
+				result,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::process_batch_3d(
 				input,
 				m_weights.m_kernels,
 				m_weights.m_bias,
@@ -698,6 +1308,74 @@ namespace detail {
 				queue);
 		}
 
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(Kernels < 2) || !is_dense
+			>* = 0)
+		{
+			this->compute_gradient(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <const size_t Kernels>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(Kernels < 2) && is_dense
+			>* = 0)
+		{
+			compute_gradient_on_device(in, grad, result, kernelGradient, biasGradient, 1, queue);
+		}
+
+		template <class Input, class Output>
+		void compute_gradient_on_device(
+			const Input& in,
+			const Output& grad,
+			Input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			const size_t batchSize,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::compute_gradient_3d(
+				in,
+				m_weights.m_kernels,
+				grad,
+				result,
+				kernelGradient,
+				biasGradient,
+				algebra::detail::dimension<Metrics, 0>::size,
+				algebra::detail::dimension<Metrics, 1>::size,
+				algebra::detail::dimension<Metrics, 2>::size,
+				algebra::detail::dimension<convolution_metrics, 0>::size,
+				algebra::detail::dimension<convolution_metrics, 1>::size,
+				algebra::detail::dimension<convolution_metrics, 2>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				batchSize,
+				m_kernelProgram,
+				m_gradientKernelName,
+				m_weightsGradientKernelName,
+				context,
+				queue);
+		}
+
 		template<const size_t KernelSize>
 		void dispatch_update_weights(
 			const kernel_weights& kernelGradient,
@@ -746,11 +1424,39 @@ namespace detail {
 
 				m_processKernelName = opencl::detail::layer_kernels::get_3d_convolution_kernel_name();
 				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_3d_convolution_gradient_kernel_name();
+				m_weightsGradientKernelName = opencl::detail::layer_kernels::get_3d_convolution_weights_gradient_kernel_name();
 			}
 		}
 
+		void process_on_device(
+			const input& input,
+			output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			opencl::detail::convolution::process_3d(
+				input,
+				m_weights.m_kernels,
+				m_weights.m_bias,
+				result,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				program,
+				kernelName,
+				context,
+				queue);
+		}
+
 #endif
 
+		void invalidate_cache()
+		{
+		}
+
 		weights_type m_weights;
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -759,48 +1465,349 @@ namespace detail {
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
 		std::string m_weightsKernelName;
+		std::string m_gradientKernelName;
+		std::string m_weightsGradientKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
+
+#endif
+	};
+
+	// Convolution with the kernel dimension stored last, both in the weights and in the output tensor.
+	// Inputs of rank 1 and 2 are processed as rank 3 tensors with unit trailing dimensions. The
+	// innermost loops run over the kernels, which are contiguous in memory.
+	template <class Metrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Number>
+	struct convolution_channels_last
+	{
+		static_assert(1 <= Metrics::rank && Metrics::rank <= 3, "Channels last convolution is supported only for 1D, 2D or 3D tensors.");
+
+		typedef typename convolution_channels_last<Metrics, Core, Stride, Kernels, Padding, Dilation, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics convolution_metrics;
+		typedef typename algebra::detail::append_dimension<convolution_metrics, Kernels>::type::template tensor_of<Number>::type output;
+		typedef typename algebra::detail::append_dimension<Core, Kernels>::type::template tensor_of<Number>::type kernel_weights;
+		typedef typename algebra::metrics<Kernels>::template tensor_of<Number>::type bias;
+		typedef typename convolution_kernels<kernel_weights, bias> weights_type;
+		typedef typename weights_type::serializer serializer;
+		typedef typename weights_type::number_type number_type;
+
+		typedef typename algebra::detail::extend_shape<Metrics, 3, 1>::type volume_metrics;
+		typedef typename algebra::detail::extend_shape<Core, 3, 1>::type volume_core;
+		typedef typename algebra::detail::extend_shape<Stride, 3, 1>::type volume_stride;
+		typedef typename algebra::detail::extend_shape<Padding, 3, 0>::type volume_padding;
+		typedef typename algebra::detail::extend_shape<Dilation, 3, 1>::type volume_dilation;
+		typedef typename algebra::detail::append_dimension<typename algebra::detail::extend_shape<convolution_metrics, 3, 1>::type, Kernels>::type volume_output;
+		typedef typename algebra::detail::append_dimension<volume_core, Kernels>::type volume_weights;
+
+		typedef typename algebra::detail::core_window<volume_metrics, volume_core, volume_stride, volume_padding, volume_dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<volume_metrics, volume_core, volume_stride, volume_padding, volume_dilation, 1> window_y;
+		typedef typename algebra::detail::core_window<volume_metrics, volume_core, volume_stride, volume_padding, volume_dilation, 2> window_z;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		convolution_channels_last()
+			: m_weights()
+		{}
+
+		convolution_channels_last(
+			std::function<number_type()> initializer)
+				: m_weights(initializer)
+		{
+		}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			auto in = input.reshape<volume_metrics>();
+			auto out = result.reshape<volume_output>();
+			auto weights = m_weights.m_kernels.reshape<volume_weights>();
+
+			const number_type* biasValues = std::addressof(m_weights.m_bias(0));
+
+			for (size_t strideX = 0; strideX < out.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < out.size<1>(); ++strideY)
+				{
+					for (size_t strideZ = 0; strideZ < out.size<2>(); ++strideZ)
+					{
+						number_type* sum = std::addressof(out(strideX, strideY, strideZ, 0));
+
+						for (size_t kernel = 0; kernel < Kernels; ++kernel)
+						{
+							sum[kernel] = 0.0f;
+						}
+
+						const size_t lastX = window_x::end(strideX);
+						const size_t firstY = window_y::begin(strideY);
+						const size_t lastY = window_y::end(strideY);
+						const size_t firstZ = window_z::begin(strideZ);
+						const size_t lastZ = window_z::end(strideZ);
+
+						for (size_t x = window_x::begin(strideX); x < lastX; ++x)
+						{
+							const size_t inputX = window_x::offset(strideX, x);
+
+							for (size_t y = firstY; y < lastY; ++y)
+							{
+								const size_t inputY = window_y::offset(strideY, y);
+
+								for (size_t z = firstZ; z < lastZ; ++z)
+								{
+									const number_type value = in(inputX, inputY, window_z::offset(strideZ, z));
+									const number_type* w = std::addressof(weights(x, y, z, 0));
+
+									for (size_t kernel = 0; kernel < Kernels; ++kernel)
+									{
+										sum[kernel] += w[kernel] * value;
+									}
+								}
+							}
+						}
+
+						for (size_t kernel = 0; kernel < Kernels; ++kernel)
+						{
+							sum[kernel] += biasValues[kernel];
+						}
+					}
+				}
+			}
+		}
+
+		void compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient)
+		{
+			kernelGradient.fill(0.0f);
+			biasGradient.fill(0.0f);
+
+			accumulate_gradient(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		void update_weights(
+			const kernel_weights& kernelGradient,
+			const bias& biasGradient,
+			const number_type rate)
+		{
+			auto update = [rate](const number_type weight, const number_type gradient) { return weight + gradient * rate; };
+
+			m_weights.m_kernels.transform(kernelGradient, m_weights.m_kernels, update);
+			m_weights.m_bias.transform(biasGradient, m_weights.m_bias, update);
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&)
+		{
+			this->process(input, result);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& batch,
+			BatchOutput& result,
+			::boost::compute::command_queue&)
+		{
+			input item;
+			output itemResult;
+
+			for (size_t i = 0; i < BatchInput::metrics::dimension_size; ++i)
+			{
+				get_batch_item(batch, i, item);
+				this->process(item, itemResult);
+				set_batch_item(itemResult, i, result);
+			}
+		}
+
+		template <const size_t>
+		void dispatch_compute_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			::boost::compute::command_queue&)
+		{
+			this->compute_gradient(in, grad, result, kernelGradient, biasGradient);
+		}
+
+		template <class Input, class Output>
+		void compute_gradient_on_device(
+			const Input& in,
+			const Output& grad,
+			Input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient,
+			const size_t batchSize,
+			::boost::compute::command_queue&)
+		{
+			kernelGradient.fill(0.0f);
+			biasGradient.fill(0.0f);
+
+			input item;
+			input itemResult;
+			output itemGradient;
+
+			for (size_t i = 0; i < batchSize; ++i)
+			{
+				get_batch_item(in, i, item);
+				get_batch_item(grad, i, itemGradient);
+				accumulate_gradient(item, itemGradient, itemResult, kernelGradient, biasGradient);
+				set_batch_item(itemResult, i, result);
+			}
+		}
+
+		template <const size_t>
+		void dispatch_update_weights(
+			const kernel_weights& kernelGradient,
+			const bias& biasGradient,
+			const number_type rate,
+			::boost::compute::command_queue&)
+		{
+			this->update_weights(kernelGradient, biasGradient, rate);
+		}
 
 #endif
+
+		void invalidate_cache()
+		{
+		}
+
+		weights_type m_weights;
+
+	private:
+		void accumulate_gradient(
+			const input& in,
+			const output& grad,
+			input& result,
+			kernel_weights& kernelGradient,
+			bias& biasGradient)
+		{
+			result.fill(0.0f);
+
+			auto source = in.reshape<volume_metrics>();
+			auto inputGradient = result.reshape<volume_metrics>();
+			auto gradient = grad.reshape<volume_output>();
+			auto weights = m_weights.m_kernels.reshape<volume_weights>();
+			auto weightsGradient = kernelGradient.reshape<volume_weights>();
+
+			number_type* biasSum = std::addressof(biasGradient(0));
+
+			for (size_t x = 0; x < gradient.size<0>(); ++x)
+			{
+				for (size_t y = 0; y < gradient.size<1>(); ++y)
+				{
+					for (size_t z = 0; z < gradient.size<2>(); ++z)
+					{
+						const number_type* g = std::addressof(gradient(x, y, z, 0));
+
+						for (size_t kernel = 0; kernel < Kernels; ++kernel)
+						{
+							biasSum[kernel] += g[kernel];
+						}
+
+						const size_t lastI = window_x::end(x);
+						const size_t firstJ = window_y::begin(y);
+						const size_t lastJ = window_y::end(y);
+						const size_t firstK = window_z::begin(z);
+						const size_t lastK = window_z::end(z);
+
+						for (size_t i = window_x::begin(x); i < lastI; ++i)
+						{
+							const size_t inputX = window_x::offset(x, i);
+
+							for (size_t j = firstJ; j < lastJ; ++j)
+							{
+								const size_t inputY = window_y::offset(y, j);
+
+								for (size_t k = firstK; k < lastK; ++k)
+								{
+									const size_t inputZ = window_z::offset(z, k);
+									const number_type value = source(inputX, inputY, inputZ);
+									const number_type* w = std::addressof(weights(i, j, k, 0));
+									number_type* wg = std::addressof(weightsGradient(i, j, k, 0));
+
+									number_type sum = 0.0f;
+									for (size_t kernel = 0; kernel < Kernels; ++kernel)
+									{
+										wg[kernel] += g[kernel] * value;
+										sum += g[kernel] * w[kernel];
+									}
+
+									inputGradient(inputX, inputY, inputZ) += sum;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
 	};
 
-	template <class Metrics, class Core, class Stride, const size_t Kernels>
+	template <class Metrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Layout, class Number>
 	struct convolution_impl
 	{
 		static_assert(1 <= Metrics::rank == 1 && Metrics::rank <= 3, "Convolution is supported only for 1D, 2D or 3D tensors.");
 
 		typedef typename std::conditional<
-			Metrics::rank == 1,
-			convolution_1d<Metrics, Core, Stride, Kernels>,
+			std::is_same<Layout, layout::channels_last>::value,
+			convolution_channels_last<Metrics, Core, Stride, Kernels, Padding, Dilation, Number>,
 			typename std::conditional<
-				Metrics::rank == 2,
-				convolution_2d<Metrics, Core, Stride, Kernels>,
-				convolution_3d<Metrics, Core, Stride, Kernels>
+				Metrics::rank == 1,
+				convolution_1d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number>,
+				typename std::conditional<
+					Metrics::rank == 2,
+					convolution_2d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number>,
+					convolution_3d<Metrics, Core, Stride, Kernels, Padding, Dilation, Number>
+				>::type
 			>::type
 		>::type type;
 	};
 
 }
 
-template <class InputMetrics, class Core, class Stride, const size_t Kernels>
+template <
+		class InputMetrics,
+		class Core,
+		class Stride,
+		const size_t Kernels,
+		class Padding = typename algebra::detail::default_padding<InputMetrics::rank>::type,
+		class Dilation = typename algebra::detail::default_dilation<InputMetrics::rank>::type,
+		class Layout = layout::channels_first,
+		class Number = float>
 	class convolution 
 		: public layer_base<
 			InputMetrics,
-			typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels>::type::output::metrics>
+			typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number>::type::output::metrics,
+			Number>
 	{
 	public:
-		typedef typename convolution<InputMetrics, Core, Stride, Kernels> this_type;
-		typedef typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels>::type impl;
+		typedef typename convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number> this_type;
+		typedef typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number>::type impl;
 		typedef typename impl::serializer serializer_impl_type;
 
-		typedef typename layer_base<InputMetrics, typename impl::output::metrics> base_type;
+		typedef typename Layout input_layout;
+		typedef typename Layout output_layout;
+
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<true, false> memory_traits;
 
 		convolution()
-			: base_type(), m_impl(), m_input(), m_biasGradient()
+			: base_type(), m_impl(), m_input(), m_biasGradient(), m_kernelGradient(), m_accumulatedUpdate()
 		{}
 
 		convolution(
 			std::function<number_type()> initializer)
-			: base_type(), m_impl(initializer), m_input(), m_biasGradient()
+			: base_type(), m_impl(initializer), m_input(), m_biasGradient(), m_kernelGradient(), m_accumulatedUpdate()
 		{
 		}
 
@@ -832,6 +1839,54 @@ template <class InputMetrics, class Core, class Stride, const size_t Kernels>
 				rate);
 		}
 
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its micro-batches.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			target.m_accumulatedUpdate.add(0, m_kernelGradient, rate);
+			target.m_accumulatedUpdate.add(1, m_biasGradient, rate);
+			target.m_accumulatedUpdate.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			source.m_accumulatedUpdate.add_to(0, m_impl.m_weights.m_kernels);
+			source.m_accumulatedUpdate.add_to(1, m_impl.m_weights.m_bias);
+			m_impl.invalidate_cache();
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
 		struct serializer
 		{
 			typedef this_type value;
@@ -843,6 +1898,8 @@ template <class InputMetrics, class Core, class Stride, const size_t Kernels>
 				value& layer)
 			{
 				serializer_impl_type::read(in, layer.m_impl.m_weights);
+				layer.m_impl.invalidate_cache();
+				layer.m_accumulatedUpdate.clear();
 			}
 
 			static void write(
@@ -866,9 +1923,67 @@ template <class InputMetrics, class Core, class Stride, const size_t Kernels>
 
 		const input& compute_gradient(
 			const output& gradient,
-			::boost::compute::command_queue&)
+			::boost::compute::command_queue& queue)
 		{
-			return this->compute_gradient(gradient);
+			m_impl.dispatch_compute_gradient<Kernels>(
+				m_input,
+				gradient,
+				m_gradient,
+				m_kernelGradient,
+				m_biasGradient,
+				queue);
+
+			return m_gradient;
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(detail::is_batch_of<BatchInput, InputMetrics>::value, "Invalid batch input tensor.");
+			static_assert(detail::is_batch_of<BatchOutput, typename impl::output::metrics>::value, "Invalid batch output tensor.");
+			static_assert(BatchInput::metrics::dimension_size == BatchOutput::metrics::dimension_size, "Input and output batch sizes do not match.");
+			static_assert(impl::is_dense, "Batch processing is not supported for padded or dilated convolution.");
+
+			m_impl.process_batch(input, result, queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void compute_gradient(
+			const BatchInput& input,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(detail::is_batch_of<BatchInput, InputMetrics>::value, "Invalid batch input tensor.");
+			static_assert(detail::is_batch_of<BatchOutput, typename impl::output::metrics>::value, "Invalid batch gradient tensor.");
+			static_assert(BatchInput::metrics::dimension_size == BatchOutput::metrics::dimension_size, "Input and gradient batch sizes do not match.");
+			static_assert(impl::is_dense, "Batch processing is not supported for padded or dilated convolution.");
+
+			m_impl.compute_gradient_on_device(
+				input,
+				gradient,
+				result,
+				m_kernelGradient,
+				m_biasGradient,
+				BatchInput::metrics::dimension_size,
+				queue);
+		}
+
+		enum : bool { supports_fused_epilogue = !(Kernels < 2) && impl::is_dense && std::is_same<Layout, layout::channels_first>::value };
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(supports_fused_epilogue, "Layer is too small to be processed on the device.");
+
+			m_input = input;
+			m_impl.template process_fused<Epilogue>(input, result, queue);
 		}
 
 		void update_weights(
@@ -889,13 +2004,23 @@ template <class InputMetrics, class Core, class Stride, const size_t Kernels>
 		input m_input;
 		typename impl::bias m_biasGradient;
 		typename impl::kernel_weights m_kernelGradient;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
 	};
 
-	template <class Input, class Core, class Stride, const size_t Kernels, class... Args>
-	convolution<Input, Core, Stride, Kernels> make_convolution_layer(
+	template <
+		class Input,
+		class Core,
+		class Stride,
+		const size_t Kernels,
+		class Padding = typename algebra::detail::default_padding<Input::rank>::type,
+		class Dilation = typename algebra::detail::default_dilation<Input::rank>::type,
+		class Layout = layout::channels_first,
+		class Number = float,
+		class... Args>
+	convolution<Input, Core, Stride, Kernels, Padding, Dilation, Layout, Number> make_convolution_layer(
 		Args&&... args)
 	{
-		typedef convolution<Input, Core, Stride, Kernels> layer_type;
+		typedef convolution<Input, Core, Stride, Kernels, Padding, Dilation, Layout, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 }
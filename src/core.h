@@ -28,8 +28,119 @@ SOFTWARE.
 
 namespace neural_network {
 namespace algebra {
+
+	// Per-dimension padding sizes. Unlike metrics, zero values are allowed.
+	template <const size_t Size, const size_t... Args>
+	struct padding : public padding<Args...>
+	{
+		typedef typename padding<Size, Args...> this_type;
+		typedef typename padding<Args...> base_type;
+
+		enum {
+			rank = base_type::rank + 1,
+			dimension_size = Size };
+	};
+
+	template <const size_t Size>
+	struct padding<Size>
+	{
+		typedef typename padding<Size> this_type;
+		typedef typename padding<Size> base_type;
+
+		enum {
+			rank = 1,
+			dimension_size = Size };
+	};
+
 namespace detail {
 
+	template <template <size_t...> class Shape, const size_t Value, const size_t Rank, const size_t... Sizes>
+	struct uniform_shape
+	{
+		typedef typename uniform_shape<Shape, Value, (Rank - 1), Value, Sizes...>::type type;
+	};
+
+	template <template <size_t...> class Shape, const size_t Value, const size_t... Sizes>
+	struct uniform_shape<Shape, Value, 0, Sizes...>
+	{
+		typedef typename Shape<Sizes...> type;
+	};
+
+	template <const size_t Rank>
+	struct default_padding
+	{
+		typedef typename uniform_shape<padding, 0, Rank>::type type;
+	};
+
+	template <const size_t Rank>
+	struct default_dilation
+	{
+		typedef typename uniform_shape<metrics, 1, Rank>::type type;
+	};
+
+	template <class Shape, const size_t Value>
+	struct append_dimension;
+
+	template <template <size_t...> class Shape, const size_t... Sizes, const size_t Value>
+	struct append_dimension<Shape<Sizes...>, Value>
+	{
+		typedef typename Shape<Sizes..., Value> type;
+	};
+
+	// Appends dimensions of the given size until the shape reaches the requested rank.
+	template <class Shape, const size_t Rank, const size_t Value, const bool Extend = (Shape::rank < Rank)>
+	struct extend_shape
+	{
+		typedef typename extend_shape<typename append_dimension<Shape, Value>::type, Rank, Value>::type type;
+	};
+
+	template <class Shape, const size_t Rank, const size_t Value>
+	struct extend_shape<Shape, Rank, Value, false>
+	{
+		typedef typename Shape type;
+	};
+
+	template <class Shape>
+	struct move_first_dimension_last;
+
+	template <template <size_t...> class Shape, const size_t First, const size_t... Sizes>
+	struct move_first_dimension_last<Shape<First, Sizes...>>
+	{
+		typedef typename Shape<Sizes..., First> type;
+	};
+
+	template <class Shape, const size_t Count = (Shape::rank - 1)>
+	struct move_last_dimension_first
+	{
+		typedef typename move_last_dimension_first<typename move_first_dimension_last<Shape>::type, (Count - 1)>::type type;
+	};
+
+	template <class Shape>
+	struct move_last_dimension_first<Shape, 0>
+	{
+		typedef typename Shape type;
+	};
+
+	// True when the core is applied without padding or dilation in every dimension.
+	template <typename Padding, typename Dilation, const size_t Rank = Padding::rank>
+	struct is_dense_core
+	{
+		enum : bool {
+			value = (0 == Padding::dimension_size)
+				&& (1 == Dilation::dimension_size)
+				&& is_dense_core<typename Padding::base_type, typename Dilation::base_type, (Rank - 1)>::value
+		};
+	};
+
+	template <typename Padding, typename Dilation>
+	struct is_dense_core<Padding, Dilation, 1>
+	{
+		enum : bool {
+			value = (0 == Padding::dimension_size)
+				&& (1 == Dilation::dimension_size)
+		};
+	};
+
 	template <typename Metrics, typename Core, typename Stride, const size_t Rank>
 	struct apply_core_with_stride
 	{
@@ -65,6 +176,123 @@ namespace detail {
 
 		typedef typename metrics<(Metrics::dimension_size - Core::dimension_size + Stride::dimension_size) / Stride::dimension_size> metrics;
 	};
+
+	template <typename Metrics, typename Core, typename Stride, typename Padding, typename Dilation, const size_t Rank>
+	struct apply_core_with_padding
+	{
+		static_assert(Rank == Metrics::rank, "Rank mismatch.");
+		static_assert(Core::rank == Metrics::rank, "Core rank must be the same as the input tensor rank.");
+		static_assert(Core::rank == Stride::rank, "Stride rank must be the same as the core rank.");
+		static_assert(Core::rank == Padding::rank, "Padding rank must be the same as the core rank.");
+		static_assert(Core::rank == Dilation::rank, "Dilation rank must be the same as the core rank.");
+
+		enum : size_t {
+			input_size = Metrics::dimension_size + 2 * Padding::dimension_size,
+			core_size = Dilation::dimension_size * (Core::dimension_size - 1) + 1
+		};
+
+		static_assert(core_size <= input_size, "Dilated core dimension must be the same or smaller then the padded input tensor dimension.");
+		static_assert(Stride::dimension_size <= core_size, "Stride dimension must be the same or smaller then the dilated core dimension.");
+		static_assert(2 * Padding::dimension_size <= core_size, "Padding must not exceed half of the dilated core dimension.");
+
+		static_assert((input_size - core_size) % Stride::dimension_size <= Padding::dimension_size, "Current core and stride size cause some data in the input tensor to be ignored.");
+
+		typedef typename apply_core_with_padding<
+			typename Metrics::base_type, typename Core::base_type, typename Stride::base_type, typename Padding::base_type, typename Dilation::base_type, (Rank - 1)>
+				::metrics inner_metrics;
+
+		typedef typename inner_metrics::
+			template expand<((input_size - core_size) / Stride::dimension_size) + 1>
+				::type metrics;
+	};
+
+	template <typename Metrics, typename Core, typename Stride, typename Padding, typename Dilation>
+	struct apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, 1>
+	{
+		static_assert(1 == Metrics::rank, "Rank mismatch.");
+		static_assert(Core::rank == Metrics::rank, "Core rank must be the same as the input tensor rank.");
+		static_assert(Core::rank == Stride::rank, "Stride rank must be the same as the core rank.");
+		static_assert(Core::rank == Padding::rank, "Padding rank must be the same as the core rank.");
+		static_assert(Core::rank == Dilation::rank, "Dilation rank must be the same as the core rank.");
+
+		enum : size_t {
+			input_size = Metrics::dimension_size + 2 * Padding::dimension_size,
+			core_size = Dilation::dimension_size * (Core::dimension_size - 1) + 1
+		};
+
+		static_assert(core_size <= input_size, "Dilated core dimension must be the same or smaller then the padded input tensor dimension.");
+		static_assert(Stride::dimension_size <= core_size, "Stride dimension must be the same or smaller then the dilated core dimension.");
+		static_assert(2 * Padding::dimension_size <= core_size, "Padding must not exceed half of the dilated core dimension.");
+
+		static_assert((input_size - core_size) % Stride::dimension_size <= Padding::dimension_size, "Current core and stride size cause some data in the input tensor to be ignored.");
+
+		typedef typename metrics<((input_size - core_size) / Stride::dimension_size) + 1> metrics;
+	};
+
+	// Range of core elements that fall inside the input tensor for a given output position.
+	// Padded elements are skipped instead of being read from a zero-filled copy of the input.
+	template <typename Metrics, typename Core, typename Stride, typename Padding, typename Dilation, const size_t Dimension>
+	struct core_window
+	{
+		enum : size_t {
+			input_size = dimension<Metrics, Dimension>::size,
+			core_size = dimension<Core, Dimension>::size,
+			stride_size = dimension<Stride, Dimension>::size,
+			padding_size = dimension<Padding, Dimension>::size,
+			dilation_size = dimension<Dilation, Dimension>::size
+		};
+
+		static size_t begin(const size_t position)
+		{
+			const size_t base = position * stride_size;
+
+			return (base < padding_size)
+				? ((padding_size - base + dilation_size - 1) / dilation_size)
+				: 0;
+		}
+
+		static size_t end(const size_t position)
+		{
+			const size_t base = position * stride_size;
+
+			return (base + (core_size - 1) * dilation_size < input_size + padding_size)
+				? core_size
+				: ((input_size + padding_size - base + dilation_size - 1) / dilation_size);
+		}
+
+		static size_t offset(const size_t position, const size_t index)
+		{
+			return (position * stride_size) + (index * dilation_size) - padding_size;
+		}
+
+		enum : size_t { output_size = ((input_size + 2 * padding_size - dilation_size * (core_size - 1) - 1) / stride_size) + 1 };
+
+		// Range of output positions with a core that may cover the given input position.
+		static size_t first_position(const size_t inputPosition)
+		{
+			const size_t extent = (core_size - 1) * dilation_size;
+
+			return (inputPosition + padding_size < extent)
+				? 0
+				: ((inputPosition + padding_size - extent + stride_size - 1) / stride_size);
+		}
+
+		static size_t last_position(const size_t inputPosition)
+		{
+			const size_t last = ((inputPosition + padding_size) / stride_size) + 1;
+
+			return (last < output_size) ? last : output_size;
+		}
+
+		// Core element that maps the output position to the input position, or core_size if the
+		// input position falls between dilated core elements.
+		static size_t core_index(const size_t position, const size_t inputPosition)
+		{
+			const size_t distance = inputPosition + padding_size - (position * stride_size);
+
+			return (0 == distance % dilation_size) ? (distance / dilation_size) : core_size;
+		}
+	};
 }
 }
 }
\ No newline at end of file
@@ -0,0 +1,472 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+#include "layer.h"
+#include "parallel.h"
+#include "serialization.h"
+
+namespace neural_network {
+
+namespace detail {
+
+	// Maps a file for reading and writing. A new file is created with the given size, and an
+	// existing file must have that size.
+	class mapped_file
+	{
+	public:
+		mapped_file(
+			const std::string& path,
+			const size_t size)
+			: m_size(size), m_data(nullptr)
+#if defined(_WIN32)
+			, m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#else
+			, m_file(-1)
+#endif
+		{
+#if defined(_WIN32)
+			m_file = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (INVALID_HANDLE_VALUE == m_file)
+				throw std::ios_base::failure("Failed to open embedding table file.");
+
+			LARGE_INTEGER fileSize;
+			if ((0 == ::GetFileSizeEx(m_file, &fileSize))
+				|| ((0 != fileSize.QuadPart) && (static_cast<ULONGLONG>(fileSize.QuadPart) != static_cast<ULONGLONG>(size))))
+			{
+				close();
+				throw std::ios_base::failure("Invalid size of embedding table file.");
+			}
+
+			const ULONGLONG mappingSize = static_cast<ULONGLONG>(size);
+			m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize), nullptr);
+			if (nullptr != m_mapping)
+			{
+				m_data = ::MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+			}
+#else
+			m_file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			if (m_file < 0)
+				throw std::ios_base::failure("Failed to open embedding table file.");
+
+			struct stat status;
+			if ((0 != ::fstat(m_file, &status))
+				|| ((0 != status.st_size) && (static_cast<size_t>(status.st_size) != size)))
+			{
+				close();
+				throw std::ios_base::failure("Invalid size of embedding table file.");
+			}
+
+			if ((0 == status.st_size) && (0 != ::ftruncate(m_file, static_cast<off_t>(size))))
+			{
+				close();
+				throw std::ios_base::failure("Failed to resize embedding table file.");
+			}
+
+			void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+			if (MAP_FAILED != data)
+			{
+				m_data = data;
+			}
+#endif
+			if (nullptr == m_data)
+			{
+				close();
+				throw std::ios_base::failure("Failed to map embedding table file.");
+			}
+		}
+
+		~mapped_file()
+		{
+			close();
+		}
+
+		void* data() const
+		{
+			return m_data;
+		}
+
+	private:
+		mapped_file(const mapped_file&);
+		mapped_file& operator=(const mapped_file&);
+
+		void close()
+		{
+#if defined(_WIN32)
+			if (nullptr != m_data)
+				::UnmapViewOfFile(m_data);
+
+			if (nullptr != m_mapping)
+				::CloseHandle(m_mapping);
+
+			if (INVALID_HANDLE_VALUE != m_file)
+				::CloseHandle(m_file);
+
+			m_mapping = nullptr;
+			m_file = INVALID_HANDLE_VALUE;
+#else
+			if (nullptr != m_data)
+				::munmap(m_data, m_size);
+
+			if (m_file >= 0)
+				::close(m_file);
+
+			m_file = -1;
+#endif
+			m_data = nullptr;
+		}
+
+		size_t m_size;
+		void* m_data;
+
+#if defined(_WIN32)
+		HANDLE m_file;
+		HANDLE m_mapping;
+#else
+		int m_file;
+#endif
+	};
+
+	// Serializes the rows of an embedding table in the format of a tensor with the given metrics,
+	// so that tables in memory and mapped tables share the format.
+	template <class Metrics, class Number>
+	struct embedding_table_serializer : public serialization::detail::serializer_base
+	{
+		typedef typename serialization::metrics_serializer<Metrics> metrics_serializer_type;
+		typedef Number* value_type;
+
+		enum : size_t { serialized_data_size = metrics_serializer_type::serialized_data_size + sizeof(Number) * Metrics::data_size };
+
+		static void read(
+			std::istream& in,
+			value_type& table)
+		{
+			metrics_serializer_type::read(in);
+
+			if (!in.read(reinterpret_cast<char*>(table), sizeof(Number) * Metrics::data_size))
+				throw_io_error("Failed to read embedding table.");
+		}
+
+		static void write(
+			std::ostream& out,
+			const value_type& table)
+		{
+			metrics_serializer_type::write(out);
+
+			if (!out.write(reinterpret_cast<const char*>(table), sizeof(Number) * Metrics::data_size))
+				throw_io_error("Failed to write embedding table.");
+		}
+	};
+}
+
+	// Maps every index of the input to a row of Dimension weights of a table with Vocabulary rows.
+	// The indices have no gradient. The backward pass sums the output gradient of every row that
+	// was read, and the update changes only those rows, together with their regularization.
+	// The table is kept in memory, or mapped from a file for tables larger than the memory.
+	// Copies of the layer share the table.
+	template <class InputMetrics, const size_t Vocabulary, const size_t Dimension, class Number = float>
+	class embedding
+	{
+	public:
+		typedef typename embedding<InputMetrics, Vocabulary, Dimension, Number> this_type;
+
+		typedef typename InputMetrics::template tensor_of<std::uint32_t>::type input;
+		typedef typename algebra::metrics<InputMetrics::data_size, Dimension>::template tensor_of<Number>::type output;
+		typedef Number number_type;
+
+		typedef typename detail::layer_memory<true, false, false> memory_traits;
+
+		typedef typename algebra::metrics<Vocabulary, Dimension> table_metrics;
+		typedef typename table_metrics::template tensor_of<number_type>::type weights_type;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::embedding_layer,
+			serialization::composite_serializer<
+				detail::embedding_table_serializer<table_metrics, number_type>,
+				serialization::value_serializer<number_type>>
+		> serializer_impl_type;
+
+		embedding(
+			const number_type regularization = 0.000001f)
+			: m_output(), m_gradient(), m_weights(), m_file(), m_table(m_weights.data()), m_indices(), m_order(), m_rows(), m_rowGradients(), m_accumulatedUpdate(), m_regularization(regularization)
+		{
+		}
+
+		embedding(
+			std::function<number_type()> initializer,
+			const number_type regularization = 0.000001f)
+			: m_output(), m_gradient(), m_weights(initializer), m_file(), m_table(m_weights.data()), m_indices(), m_order(), m_rows(), m_rowGradients(), m_accumulatedUpdate(), m_regularization(regularization)
+		{
+		}
+
+		// Maps the table from a file, which is created with zero weights when it does not exist.
+		embedding(
+			const std::string& path,
+			const number_type regularization = 0.000001f)
+			: m_output(), m_gradient(), m_weights(typename weights_type::buffer_ptr()), m_file(std::make_shared<detail::mapped_file>(path, sizeof(number_type) * table_metrics::data_size)),
+			m_table(static_cast<number_type*>(m_file->data())), m_indices(), m_order(), m_rows(), m_rowGradients(), m_accumulatedUpdate(), m_regularization(regularization)
+		{
+		}
+
+		// Maps the table from a file, and writes the initial weights to it.
+		embedding(
+			const std::string& path,
+			std::function<number_type()> initializer,
+			const number_type regularization = 0.000001f)
+			: m_output(), m_gradient(), m_weights(typename weights_type::buffer_ptr()), m_file(std::make_shared<detail::mapped_file>(path, sizeof(number_type) * table_metrics::data_size)),
+			m_table(static_cast<number_type*>(m_file->data())), m_indices(), m_order(), m_rows(), m_rowGradients(), m_accumulatedUpdate(), m_regularization(regularization)
+		{
+			std::generate(m_table, m_table + table_metrics::data_size, initializer);
+		}
+
+		const output& get_output() const
+		{
+			return m_output;
+		}
+
+		const input& get_gradient() const
+		{
+			return m_gradient;
+		}
+
+		const output& process(const input& input)
+		{
+			const std::uint32_t* indices = input.data();
+			number_type* result = m_output.data();
+
+			for (size_t k = 0; k < InputMetrics::data_size; ++k)
+			{
+				if (false == (indices[k] < Vocabulary))
+					throw std::invalid_argument("Index out of range.");
+
+				const number_type* row = m_table + static_cast<size_t>(indices[k]) * Dimension;
+				std::copy(row, row + Dimension, result + k * Dimension);
+			}
+
+			std::copy(indices, indices + InputMetrics::data_size, m_indices.data());
+
+			return m_output;
+		}
+
+		// Sums the gradient of the rows read by the last input, in the order of their indices.
+		const input& compute_gradient(const output& grad)
+		{
+			const std::uint32_t* indices = m_indices.data();
+			const number_type* gradient = grad.data();
+
+			m_order.clear();
+			for (size_t k = 0; k < InputMetrics::data_size; ++k)
+			{
+				m_order.push_back(std::make_pair(indices[k], k));
+			}
+
+			std::sort(m_order.begin(), m_order.end());
+
+			m_rows.clear();
+			m_rowGradients.clear();
+
+			for (const std::pair<std::uint32_t, size_t>& entry : m_order)
+			{
+				if (m_rows.empty() || (m_rows.back() != entry.first))
+				{
+					m_rows.push_back(entry.first);
+					m_rowGradients.resize(m_rows.size() * Dimension, number_type(0));
+				}
+
+				number_type* sum = m_rowGradients.data() + (m_rows.size() - 1) * Dimension;
+				const number_type* row = gradient + entry.second * Dimension;
+
+				for (size_t d = 0; d < Dimension; ++d)
+				{
+					sum[d] += row[d];
+				}
+			}
+
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate)
+		{
+			const number_type decay = 1 + m_regularization * rate;
+
+			for (size_t r = 0; r < m_rows.size(); ++r)
+			{
+				number_type* row = m_table + static_cast<size_t>(m_rows[r]) * Dimension;
+				const number_type* gradient = m_rowGradients.data() + r * Dimension;
+
+				for (size_t d = 0; d < Dimension; ++d)
+				{
+					row[d] = row[d] * decay + gradient[d] * rate;
+				}
+			}
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same table can process its micro-batches.
+		// Every updated row also keeps the sum of the rates of its own regularization.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			detail::accumulated_update<number_type>& update = target.m_accumulatedUpdate;
+
+			for (size_t r = 0; r < m_rows.size(); ++r)
+			{
+				number_type* sum = update.row(m_rows[r], Dimension + 1);
+				const number_type* gradient = m_rowGradients.data() + r * Dimension;
+
+				for (size_t d = 0; d < Dimension; ++d)
+				{
+					sum[d] += gradient[d] * rate;
+				}
+
+				sum[Dimension] += rate;
+			}
+
+			update.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same table. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			auto apply = [this](const size_t index, const number_type* sum)
+			{
+				const number_type decay = 1 + m_regularization * sum[Dimension];
+				number_type* row = m_table + index * Dimension;
+
+				for (size_t d = 0; d < Dimension; ++d)
+				{
+					row[d] = row[d] * decay + sum[d];
+				}
+			};
+
+			source.m_accumulatedUpdate.for_each(apply);
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type& layer)
+			{
+				serializer_impl_type::read(in, layer.m_table, layer.m_regularization);
+				layer.m_accumulatedUpdate.clear();
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type& layer)
+			{
+				serializer_impl_type::write(out, layer.m_table, layer.m_regularization);
+			}
+		};
+
+	private:
+		output m_output;
+		input m_gradient;
+
+		weights_type m_weights;
+		std::shared_ptr<detail::mapped_file> m_file;
+		number_type* m_table;
+
+		// Copy of the last input, which may not outlive the backward pass.
+		input m_indices;
+
+		std::vector<std::pair<std::uint32_t, size_t>> m_order;
+		std::vector<std::uint32_t> m_rows;
+		std::vector<number_type> m_rowGradients;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
+
+		number_type m_regularization;
+	};
+
+	template <class Input, const size_t Vocabulary, const size_t Dimension, class Number = float, class... Args>
+	embedding<Input, Vocabulary, Dimension, Number> make_embedding_layer(
+		Args&&... args)
+	{
+		typedef embedding<Input, Vocabulary, Dimension, Number> _Ltype;
+		return (_Ltype(std::forward<Args>(args)...));
+	}
+}
\ No newline at end of file
@@ -25,11 +25,17 @@ SOFTWARE.
 #pragma once
 
 #include "layer.h"
+#include "memory.h"
+#include "parallel.h"
 #include "serialization.h"
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
+#include <future>
+#include <vector>
+
 #include "opencl/layer_kernels.h"
+#include "opencl/devices.h"
 
 #endif
 
@@ -65,12 +71,11 @@ namespace detail {
 	}
 
 	template <class Network, class Gradient>
-	void compute_gradient_and_add_result(
+	const typename Network::input& compute_network_gradient(
 		Network& network,
 		const size_t index,
 		const Gradient& grad,
-		typename Network::output& local,
-		typename Network::input& result)
+		typename Network::output& local)
 	{
 		typedef typename algebra::metrics<Network::output::data_size> reshaped_local_metrics;
 		typedef typename Gradient::metrics::shrink::type shrink_metrics;
@@ -87,18 +92,41 @@ namespace detail {
 
 		// Reshaped tensors share the same data, therefore
 		// data in 'local' tensor is initialized by the loop above.
-		auto localResult = network.compute_gradient(local);
+		return network.compute_gradient(local);
+	}
 
-		// result = result + localResult
-		localResult.transform(
+	template <class Tensor>
+	void add_network_gradient(
+		const Tensor& local,
+		Tensor& result)
+	{
+		// result = result + local
+		local.transform(
 			result,
 			result,
-			[](const typename Network::number_type& l, const typename Network::number_type& r)
+			[](const typename Tensor::number_type& l, const typename Tensor::number_type& r)
 			{
 				return r + l;
 			});
 	}
 
+	template <class Network, class Gradient>
+	void compute_gradient_and_add_result(
+		Network& network,
+		const size_t index,
+		const Gradient& grad,
+		typename Network::output& local,
+		typename Network::input& result)
+	{
+		add_network_gradient(
+			compute_network_gradient(
+				network,
+				index,
+				grad,
+				local),
+			result);
+	}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	template <class Network, class Output>
@@ -130,12 +158,11 @@ namespace detail {
 	}
 
 	template <class Network, class Gradient>
-	void compute_gradient_and_add_result_on_device(
+	const typename Network::input& compute_network_gradient_on_device(
 		Network& network,
 		const size_t index,
 		const Gradient& grad,
 		typename Network::output& local,
-		typename Network::input& result,
 		::boost::compute::command_queue& queue)
 	{
 		typedef typename algebra::metrics<Network::output::data_size> reshaped_local_metrics;
@@ -153,16 +180,35 @@ namespace detail {
 
 		// Reshaped tensors share the same data, therefore
 		// data in 'local' tensor is initialized by the loop above.
-		auto localResult = network.compute_gradient(local, queue);
+		return network.compute_gradient(local, queue);
+	}
 
-		// result = result + localResult
-		localResult.transform(
-			result,
-			result,
-			[](const typename Network::number_type& l, const typename Network::number_type& r)
-		{
-			return r + l;
-		});
+	template <class Network, class Gradient>
+	void compute_gradient_and_add_result_on_device(
+		Network& network,
+		const size_t index,
+		const Gradient& grad,
+		typename Network::output& local,
+		typename Network::input& result,
+		::boost::compute::command_queue& queue)
+	{
+		add_network_gradient(
+			compute_network_gradient_on_device(
+				network,
+				index,
+				grad,
+				local,
+				queue),
+			result);
+	}
+
+	// Members of the ensemble are distributed over the command queues in round-robin order.
+	inline bool is_assigned_to_queue(
+		const size_t index,
+		const size_t queue,
+		const size_t queueCount)
+	{
+		return (index % queueCount) == queue;
 	}
 
 #endif
@@ -181,16 +227,16 @@ namespace detail {
 
 		typedef typename Network::input input;
 		typedef typename base_type::common_output common_output;
-		typedef typename base_type::common_output::metrics::template expand<ensemble_size>::type::tensor_type output;
+		typedef typename base_type::common_output::metrics::template expand<ensemble_size>::type::template tensor_of<typename Network::number_type>::type output;
 
 		typedef typename input::number_type number_type;
 
 		network_ensemble_impl()
-			: m_network()
+			: m_network(), m_local(), m_localResult(nullptr)
 		{}
 
 		network_ensemble_impl(const Network& n, const Args&... args)
-			: base_type(args...), m_network(n)
+			: base_type(args...), m_network(n), m_local(), m_localResult(nullptr)
 		{}
 
 		template <class Output>
@@ -231,6 +277,84 @@ namespace detail {
 			base_type::update_weights(rate);
 		}
 
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			m_network.accumulate_update(target.m_network, rate);
+
+			base_type::accumulate_update(target, rate);
+		}
+
+		void apply_update(
+			const this_type& source)
+		{
+			m_network.apply_update(source.m_network);
+
+			base_type::apply_update(source);
+		}
+
+		template <class Output>
+		void process(
+			const input& input,
+			Output& output,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, &input, &output]()
+			{
+				process_and_copy_network_result(
+					m_network,
+					this_type::ensemble_size - 1,
+					input,
+					output);
+			});
+
+			base_type::process(input, output, tasks);
+		}
+
+		template <class Output>
+		void compute_gradient(
+			const Output& grad,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, &grad]()
+			{
+				m_localResult = &compute_network_gradient(
+					m_network,
+					this_type::ensemble_size - 1,
+					grad,
+					m_local);
+			});
+
+			base_type::compute_gradient(grad, tasks);
+		}
+
+		template <class Gradient>
+		void add_gradients(
+			Gradient& result) const
+		{
+			add_network_gradient(*m_localResult, result);
+
+			base_type::add_gradients(result);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, rate]() { m_network.update_weights(rate); });
+
+			base_type::update_weights(rate, tasks);
+		}
+
+		void plan_memory(
+			const memory_mode mode)
+		{
+			m_network.plan_memory(mode);
+
+			base_type::plan_memory(mode);
+		}
+
 		struct serializer
 		{
 			typedef this_type value_type;
@@ -272,6 +396,8 @@ namespace detail {
 				input,
 				output,
 				queue);
+
+			base_type::process(input, output, queue);
 		}
 
 		template <class Output, class LocalGradient, class Gradient>
@@ -301,10 +427,65 @@ namespace detail {
 			base_type::update_weights(rate, queue);
 		}
 
+		template <class Output>
+		void process(
+			const input& input,
+			Output& output,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				process_and_copy_network_result_on_device(
+					m_network,
+					this_type::ensemble_size - 1,
+					input,
+					output,
+					queues[queue]);
+			}
+
+			base_type::process(input, output, queues, queue);
+		}
+
+		template <class Output>
+		void compute_gradient(
+			const Output& grad,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				m_localResult = &compute_network_gradient_on_device(
+					m_network,
+					this_type::ensemble_size - 1,
+					grad,
+					m_local,
+					queues[queue]);
+			}
+
+			base_type::compute_gradient(grad, queues, queue);
+		}
+
+		void update_weights(
+			const number_type rate,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				m_network.update_weights(rate, queues[queue]);
+			}
+
+			base_type::update_weights(rate, queues, queue);
+		}
+
 #endif
 
 	private:
 		Network m_network;
+
+		common_output m_local;
+		const input* m_localResult;
 	};
 
 	template <class Network>
@@ -317,16 +498,16 @@ namespace detail {
 
 		typedef typename Network::input input;
 		typedef typename Network::output common_output;
-		typedef typename Network::output::metrics::template expand<ensemble_size>::type::tensor_type output;
+		typedef typename Network::output::metrics::template expand<ensemble_size>::type::template tensor_of<typename Network::number_type>::type output;
 
 		typedef typename input::number_type number_type;
 
 		network_ensemble_impl()
-			: m_network()
+			: m_network(), m_local(), m_localResult(nullptr)
 		{}
 
 		network_ensemble_impl(const Network& n)
-			: m_network(n)
+			: m_network(n), m_local(), m_localResult(nullptr)
 		{}
 
 		template <class Output>
@@ -361,6 +542,70 @@ namespace detail {
 			m_network.update_weights(rate);
 		}
 
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			m_network.accumulate_update(target.m_network, rate);
+		}
+
+		void apply_update(
+			const this_type& source)
+		{
+			m_network.apply_update(source.m_network);
+		}
+
+		template <class Output>
+		void process(
+			const input& input,
+			Output& output,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, &input, &output]()
+			{
+				process_and_copy_network_result(
+					m_network,
+					this_type::ensemble_size - 1,
+					input,
+					output);
+			});
+		}
+
+		template <class Output>
+		void compute_gradient(
+			const Output& grad,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, &grad]()
+			{
+				m_localResult = &compute_network_gradient(
+					m_network,
+					this_type::ensemble_size - 1,
+					grad,
+					m_local);
+			});
+		}
+
+		template <class Gradient>
+		void add_gradients(
+			Gradient& result) const
+		{
+			add_network_gradient(*m_localResult, result);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::task_group& tasks)
+		{
+			tasks.run([this, rate]() { m_network.update_weights(rate); });
+		}
+
+		void plan_memory(
+			const memory_mode mode)
+		{
+			m_network.plan_memory(mode);
+		}
+
 		struct serializer
 		{
 			typedef this_type value_type;
@@ -421,10 +666,59 @@ namespace detail {
 			m_network.update_weights(rate, queue);
 		}
 
+		template <class Output>
+		void process(
+			const input& input,
+			Output& output,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				process_and_copy_network_result_on_device(
+					m_network,
+					this_type::ensemble_size - 1,
+					input,
+					output,
+					queues[queue]);
+			}
+		}
+
+		template <class Output>
+		void compute_gradient(
+			const Output& grad,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				m_localResult = &compute_network_gradient_on_device(
+					m_network,
+					this_type::ensemble_size - 1,
+					grad,
+					m_local,
+					queues[queue]);
+			}
+		}
+
+		void update_weights(
+			const number_type rate,
+			std::vector<::boost::compute::command_queue>& queues,
+			const size_t queue)
+		{
+			if (is_assigned_to_queue(this_type::ensemble_size - 1, queue, queues.size()))
+			{
+				m_network.update_weights(rate, queues[queue]);
+			}
+		}
+
 #endif
 
 	private:
 		Network m_network;
+
+		common_output m_local;
+		const input* m_localResult;
 	};
 	
 }
@@ -445,6 +739,8 @@ namespace detail {
 
 		typedef typename input::number_type number_type;
 
+		typedef typename detail::layer_memory<true, true, false, false, true> memory_traits;
+
 		network_ensemble()
 			: m_ensemble(), m_output(), m_gradient(), m_local()
 		{
@@ -474,6 +770,61 @@ namespace detail {
 			m_ensemble.update_weights(rate);
 		}
 
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			m_ensemble.accumulate_update(target.m_ensemble, rate);
+		}
+
+		void apply_update(
+			const this_type& source)
+		{
+			m_ensemble.apply_update(source.m_ensemble);
+		}
+
+		// Members of the ensemble run as tasks on the pool of the context, and their gradients
+		// are added in the same order as in the sequential case.
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::task_group tasks(context);
+			m_ensemble.process(input, m_output, tasks);
+			tasks.wait();
+
+			return m_output;
+		}
+
+		const input& compute_gradient(
+			const output& grad,
+			parallel::execution_context& context)
+		{
+			parallel::task_group tasks(context);
+			m_ensemble.compute_gradient(grad, tasks);
+			tasks.wait();
+
+			m_gradient.fill(0.0f);
+			m_ensemble.add_gradients(m_gradient);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::task_group tasks(context);
+			m_ensemble.update_weights(rate, tasks);
+			tasks.wait();
+		}
+
+		// Every member gets its own arena, so that the members can still run in parallel.
+		void plan_memory(
+			const memory_mode mode)
+		{
+			m_ensemble.plan_memory(mode);
+		}
+
 		struct serializer
 		{
 			typedef this_type value_type;
@@ -521,6 +872,82 @@ namespace detail {
 			m_ensemble.update_weights(rate, queue);
 		}
 
+		const output& process(
+			const input& input,
+			std::vector<::boost::compute::command_queue>& queues)
+		{
+			run_on_queues(
+				queues,
+				[this, &input, &queues](const size_t queue)
+				{
+					m_ensemble.process(input, m_output, queues, queue);
+				});
+
+			return m_output;
+		}
+
+		const input& compute_gradient(
+			const output& grad,
+			std::vector<::boost::compute::command_queue>& queues)
+		{
+			run_on_queues(
+				queues,
+				[this, &grad, &queues](const size_t queue)
+				{
+					m_ensemble.compute_gradient(grad, queues, queue);
+				});
+
+			m_gradient.fill(0.0f);
+			m_ensemble.add_gradients(m_gradient);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate,
+			std::vector<::boost::compute::command_queue>& queues)
+		{
+			run_on_queues(
+				queues,
+				[this, rate, &queues](const size_t queue)
+				{
+					m_ensemble.update_weights(rate, queues, queue);
+				});
+		}
+
+	private:
+		template <class Function>
+		static void run_on_queues(
+			const std::vector<::boost::compute::command_queue>& queues,
+			Function function)
+		{
+			if (queues.empty())
+			{
+				throw std::invalid_argument("At least one command queue is required.");
+			}
+
+			const size_t count = std::min<size_t>(queues.size(), ensemble_type::ensemble_size);
+
+			std::vector<std::future<void>> tasks;
+			tasks.reserve(count);
+
+			for (size_t queue = 0; queue < count; ++queue)
+			{
+				tasks.push_back(
+					std::async(std::launch::async, function, queue));
+			}
+
+			// Wait for all members before rethrowing the first failure.
+			for (auto& task : tasks)
+			{
+				task.wait();
+			}
+
+			for (auto& task : tasks)
+			{
+				task.get();
+			}
+		}
+
 #endif
 
 	private:
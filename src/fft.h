@@ -0,0 +1,572 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <vector>
+
+#include "tensor.h"
+
+namespace neural_network {
+namespace detail {
+
+	// 1D convolution cores with at least this many elements are applied in the frequency domain.
+	enum : size_t { fft_convolution_min_core_size = 64 };
+
+	template <const size_t A, const size_t B>
+	struct min_size
+	{
+		enum : size_t { value = (A < B) ? A : B };
+	};
+
+	// Smallest size of the form 2^a * 3^b * 5^c that is not less than Size. Such a size is either
+	// one, or a radix times the smallest such size that is not less than Size divided by the radix.
+	template <const size_t Size, const bool Done = (Size <= 1)>
+	struct next_fft_size
+	{
+		enum : size_t {
+			value = min_size<
+				2 * next_fft_size<(Size + 1) / 2>::value,
+				min_size<
+					3 * next_fft_size<(Size + 2) / 3>::value,
+					5 * next_fft_size<(Size + 4) / 5>::value>::value>::value
+		};
+	};
+
+	template <const size_t Size>
+	struct next_fft_size<Size, true>
+	{
+		enum : size_t { value = 1 };
+	};
+
+	// Mixed radix FFT of a complex sequence with a size of the form 2^a * 3^b * 5^c. The sequence
+	// is split recursively by the radices, and every stage combines the sub-transforms with a
+	// radix-4, radix-2, radix-3 or radix-5 butterfly.
+	template <typename Number>
+	class complex_fft
+	{
+	public:
+		typedef std::complex<Number> complex_type;
+
+		explicit complex_fft(
+			const size_t size)
+			: m_size(size), m_radices(), m_twiddles(size), m_buffer(size)
+		{
+			const double pi = 3.14159265358979323846;
+
+			for (size_t i = 0; i < m_twiddles.size(); ++i)
+			{
+				const double angle = -2.0 * pi * static_cast<double>(i) / static_cast<double>(size);
+				m_twiddles[i] = complex_type(static_cast<Number>(std::cos(angle)), static_cast<Number>(std::sin(angle)));
+			}
+
+			const size_t radices[] = { 4, 2, 3, 5 };
+
+			size_t rest = size;
+			for (const size_t radix : radices)
+			{
+				while (0 == rest % radix)
+				{
+					m_radices.push_back(radix);
+					rest /= radix;
+				}
+			}
+
+			if (1 != rest)
+				throw std::invalid_argument("FFT size must be a product of 2, 3 and 5.");
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+
+		void forward(
+			complex_type* data)
+		{
+			if (m_radices.empty())
+				return;
+
+			std::copy(data, data + m_size, m_buffer.begin());
+
+			transform(data, m_buffer.data(), 1, 0);
+		}
+
+		void inverse(
+			complex_type* data)
+		{
+			for (size_t i = 0; i < m_size; ++i)
+			{
+				data[i] = std::conj(data[i]);
+			}
+
+			forward(data);
+
+			const Number scale = static_cast<Number>(1) / static_cast<Number>(m_size);
+			for (size_t i = 0; i < m_size; ++i)
+			{
+				data[i] = std::conj(data[i]) * scale;
+			}
+		}
+
+	private:
+		// Plain product, without the special handling of infinite values in std::complex.
+		static complex_type multiply(
+			const complex_type& a,
+			const complex_type& b)
+		{
+			return complex_type(
+				a.real() * b.real() - a.imag() * b.imag(),
+				a.real() * b.imag() + a.imag() * b.real());
+		}
+
+		// Product with -i.
+		static complex_type rotate(
+			const complex_type& a)
+		{
+			return complex_type(a.imag(), -a.real());
+		}
+
+		// Writes the transform of every stride-th element of the input to the output. The output
+		// holds the sub-transforms of the radix one after another before they are combined.
+		void transform(
+			complex_type* output,
+			const complex_type* input,
+			const size_t stride,
+			const size_t stage)
+		{
+			const size_t radix = m_radices[stage];
+			const size_t count = m_size / (stride * radix);
+
+			if (1 == count)
+			{
+				for (size_t q = 0; q < radix; ++q)
+				{
+					output[q] = input[q * stride];
+				}
+			}
+			else
+			{
+				for (size_t q = 0; q < radix; ++q)
+				{
+					transform(output + q * count, input + q * stride, stride * radix, stage + 1);
+				}
+			}
+
+			switch (radix)
+			{
+			case 2:
+				radix_2(output, stride, count);
+				break;
+			case 3:
+				radix_3(output, stride, count);
+				break;
+			case 4:
+				radix_4(output, stride, count);
+				break;
+			default:
+				radix_5(output, stride, count);
+				break;
+			}
+		}
+
+		// Element i of sub-transform q is multiplied by the twiddle factor of i * q * stride.
+		complex_type twiddled(
+			const complex_type* data,
+			const size_t stride,
+			const size_t count,
+			const size_t i,
+			const size_t q) const
+		{
+			return multiply(data[i + q * count], m_twiddles[i * q * stride]);
+		}
+
+		void radix_2(
+			complex_type* data,
+			const size_t stride,
+			const size_t count) const
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				const complex_type t = twiddled(data, stride, count, i, 1);
+
+				data[i + count] = data[i] - t;
+				data[i] += t;
+			}
+		}
+
+		void radix_3(
+			complex_type* data,
+			const size_t stride,
+			const size_t count) const
+		{
+			const Number half = static_cast<Number>(0.5);
+			const Number sin1 = static_cast<Number>(0.86602540378443864676);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const complex_type a0 = data[i];
+				const complex_type a1 = twiddled(data, stride, count, i, 1);
+				const complex_type a2 = twiddled(data, stride, count, i, 2);
+
+				const complex_type sum = a1 + a2;
+				const complex_type t = a0 - half * sum;
+				const complex_type d = sin1 * rotate(a1 - a2);
+
+				data[i] = a0 + sum;
+				data[i + count] = t + d;
+				data[i + 2 * count] = t - d;
+			}
+		}
+
+		void radix_4(
+			complex_type* data,
+			const size_t stride,
+			const size_t count) const
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				const complex_type a0 = data[i];
+				const complex_type a1 = twiddled(data, stride, count, i, 1);
+				const complex_type a2 = twiddled(data, stride, count, i, 2);
+				const complex_type a3 = twiddled(data, stride, count, i, 3);
+
+				const complex_type s02 = a0 + a2;
+				const complex_type d02 = a0 - a2;
+				const complex_type s13 = a1 + a3;
+				const complex_type d13 = rotate(a1 - a3);
+
+				data[i] = s02 + s13;
+				data[i + count] = d02 + d13;
+				data[i + 2 * count] = s02 - s13;
+				data[i + 3 * count] = d02 - d13;
+			}
+		}
+
+		void radix_5(
+			complex_type* data,
+			const size_t stride,
+			const size_t count) const
+		{
+			const Number cos1 = static_cast<Number>(0.30901699437494742410);
+			const Number cos2 = static_cast<Number>(-0.80901699437494742410);
+			const Number sin1 = static_cast<Number>(0.95105651629515357212);
+			const Number sin2 = static_cast<Number>(0.58778525229247312917);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const complex_type a0 = data[i];
+				const complex_type a1 = twiddled(data, stride, count, i, 1);
+				const complex_type a2 = twiddled(data, stride, count, i, 2);
+				const complex_type a3 = twiddled(data, stride, count, i, 3);
+				const complex_type a4 = twiddled(data, stride, count, i, 4);
+
+				const complex_type s14 = a1 + a4;
+				const complex_type s23 = a2 + a3;
+				const complex_type d14 = rotate(a1 - a4);
+				const complex_type d23 = rotate(a2 - a3);
+
+				const complex_type t1 = a0 + cos1 * s14 + cos2 * s23;
+				const complex_type t2 = a0 + cos2 * s14 + cos1 * s23;
+				const complex_type u1 = sin1 * d14 + sin2 * d23;
+				const complex_type u2 = sin2 * d14 - sin1 * d23;
+
+				data[i] = a0 + s14 + s23;
+				data[i + count] = t1 + u1;
+				data[i + 2 * count] = t2 + u2;
+				data[i + 3 * count] = t2 - u2;
+				data[i + 4 * count] = t1 - u1;
+			}
+		}
+
+		size_t m_size;
+		std::vector<size_t> m_radices;
+		std::vector<complex_type> m_twiddles;
+		std::vector<complex_type> m_buffer;
+	};
+
+	// FFT of a real sequence with an even size. The sequence is packed into a complex sequence
+	// of half the size, and only the first size / 2 + 1 elements of the spectrum are kept.
+	template <typename Number>
+	class real_fft
+	{
+	public:
+		typedef std::complex<Number> complex_type;
+
+		explicit real_fft(
+			const size_t size)
+			: m_half(size / 2), m_fft(size / 2), m_twiddles(size / 2 + 1), m_buffer(size / 2)
+		{
+			const double pi = 3.14159265358979323846;
+
+			for (size_t i = 0; i < m_twiddles.size(); ++i)
+			{
+				const double angle = -2.0 * pi * static_cast<double>(i) / static_cast<double>(size);
+				m_twiddles[i] = complex_type(static_cast<Number>(std::cos(angle)), static_cast<Number>(std::sin(angle)));
+			}
+		}
+
+		size_t size() const
+		{
+			return 2 * m_half;
+		}
+
+		size_t spectrum_size() const
+		{
+			return m_half + 1;
+		}
+
+		// Elements past the given length are treated as zero.
+		void forward(
+			const Number* input,
+			const size_t length,
+			complex_type* spectrum)
+		{
+			for (size_t i = 0; i < m_half; ++i)
+			{
+				const Number re = (2 * i < length) ? input[2 * i] : static_cast<Number>(0);
+				const Number im = (2 * i + 1 < length) ? input[2 * i + 1] : static_cast<Number>(0);
+
+				m_buffer[i] = complex_type(re, im);
+			}
+
+			m_fft.forward(m_buffer.data());
+
+			const complex_type j(0, 1);
+			for (size_t k = 0; k <= m_half; ++k)
+			{
+				const complex_type z = m_buffer[k % m_half];
+				const complex_type zc = std::conj(m_buffer[(m_half - k) % m_half]);
+
+				const complex_type even = static_cast<Number>(0.5) * (z + zc);
+				const complex_type odd = static_cast<Number>(-0.5) * j * (z - zc);
+
+				spectrum[k] = even + m_twiddles[k] * odd;
+			}
+		}
+
+		void inverse(
+			const complex_type* spectrum,
+			Number* output,
+			const size_t length)
+		{
+			const complex_type j(0, 1);
+			for (size_t k = 0; k < m_half; ++k)
+			{
+				const complex_type x = spectrum[k];
+				const complex_type xc = std::conj(spectrum[m_half - k]);
+
+				const complex_type even = static_cast<Number>(0.5) * (x + xc);
+				const complex_type odd = static_cast<Number>(0.5) * (x - xc) * std::conj(m_twiddles[k]);
+
+				m_buffer[k] = even + j * odd;
+			}
+
+			m_fft.inverse(m_buffer.data());
+
+			for (size_t i = 0; i < m_half; ++i)
+			{
+				if (2 * i < length)
+					output[2 * i] = m_buffer[i].real();
+
+				if (2 * i + 1 < length)
+					output[2 * i + 1] = m_buffer[i].imag();
+			}
+		}
+
+	private:
+		size_t m_half;
+		complex_fft<Number> m_fft;
+		std::vector<complex_type> m_twiddles;
+		std::vector<complex_type> m_buffer;
+	};
+
+	// 1D convolution in the frequency domain. Correlation of the input with every kernel is
+	// computed as a product of spectra, with the FFT size large enough to avoid wrap-around for
+	// all valid output positions. Kernel spectra are cached until the weights change.
+	template <class Input, class KernelWeights, const size_t Stride>
+	class fft_convolution_1d
+	{
+	public:
+		typedef typename KernelWeights::number_type number_type;
+		typedef std::complex<number_type> complex_type;
+
+		enum : size_t {
+			input_size = Input::metrics::dimension_size,
+			kernels = KernelWeights::metrics::dimension_size,
+			core_size = KernelWeights::metrics::base_type::dimension_size,
+			output_size = (input_size - core_size) / Stride + 1,
+			fft_size = 2 * next_fft_size<(input_size + 1) / 2>::value,
+			spectrum_size = fft_size / 2 + 1
+		};
+
+		fft_convolution_1d()
+			: m_fft(fft_size), m_spectra(kernels * spectrum_size), m_inputSpectrum(spectrum_size), m_gradientSpectrum(spectrum_size), m_accumulated(spectrum_size), m_product(spectrum_size), m_signal(fft_size), m_valid(false)
+		{
+		}
+
+		void invalidate()
+		{
+			m_valid = false;
+		}
+
+		template <class Bias, class Output>
+		void process(
+			const KernelWeights& weights,
+			const Bias& bias,
+			const Input& input,
+			Output& result)
+		{
+			transform_weights(weights);
+			transform_input(input);
+
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				const complex_type* spectrum = kernel_spectrum(kernel);
+
+				for (size_t k = 0; k < m_product.size(); ++k)
+				{
+					m_product[k] = m_inputSpectrum[k] * std::conj(spectrum[k]);
+				}
+
+				m_fft.inverse(m_product.data(), m_signal.data(), fft_size);
+
+				for (size_t x = 0; x < output_size; ++x)
+				{
+					result(kernel, x) = m_signal[x * Stride] + bias(kernel);
+				}
+			}
+		}
+
+		// Gradient is spread back to every stride position, so the input gradient is a convolution
+		// of that sequence with the kernel, and the kernel gradient is its correlation with the input.
+		template <class Output, class Bias>
+		void compute_gradient(
+			const KernelWeights& weights,
+			const Input& input,
+			const Output& gradient,
+			Input& result,
+			KernelWeights& kernelGradient,
+			Bias& biasGradient)
+		{
+			transform_weights(weights);
+			transform_input(input);
+
+			std::fill(m_accumulated.begin(), m_accumulated.end(), complex_type(0, 0));
+
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				number_type sum = 0.0f;
+
+				std::fill(m_signal.begin(), m_signal.end(), static_cast<number_type>(0));
+				for (size_t x = 0; x < output_size; ++x)
+				{
+					const number_type g = gradient(kernel, x);
+
+					m_signal[x * Stride] = g;
+					sum += g;
+				}
+
+				biasGradient(kernel) = sum;
+
+				m_fft.forward(m_signal.data(), fft_size, m_gradientSpectrum.data());
+
+				const complex_type* spectrum = kernel_spectrum(kernel);
+
+				for (size_t k = 0; k < m_product.size(); ++k)
+				{
+					m_accumulated[k] += m_gradientSpectrum[k] * spectrum[k];
+					m_product[k] = m_inputSpectrum[k] * std::conj(m_gradientSpectrum[k]);
+				}
+
+				m_fft.inverse(m_product.data(), m_signal.data(), fft_size);
+
+				for (size_t i = 0; i < core_size; ++i)
+				{
+					kernelGradient(kernel, i) = m_signal[i];
+				}
+			}
+
+			m_fft.inverse(m_accumulated.data(), m_signal.data(), fft_size);
+
+			for (size_t x = 0; x < input_size; ++x)
+			{
+				result(x) = m_signal[x];
+			}
+		}
+
+	private:
+		void transform_weights(
+			const KernelWeights& weights)
+		{
+			if (m_valid)
+				return;
+
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				for (size_t i = 0; i < core_size; ++i)
+				{
+					m_signal[i] = weights(kernel, i);
+				}
+
+				m_fft.forward(m_signal.data(), core_size, m_spectra.data() + kernel * spectrum_size);
+			}
+
+			m_valid = true;
+		}
+
+		void transform_input(
+			const Input& input)
+		{
+			for (size_t i = 0; i < input_size; ++i)
+			{
+				m_signal[i] = input(i);
+			}
+
+			m_fft.forward(m_signal.data(), input_size, m_inputSpectrum.data());
+		}
+
+		const complex_type* kernel_spectrum(
+			const size_t kernel) const
+		{
+			return m_spectra.data() + kernel * spectrum_size;
+		}
+
+		real_fft<number_type> m_fft;
+		std::vector<complex_type> m_spectra;
+		std::vector<complex_type> m_inputSpectrum;
+		std::vector<complex_type> m_gradientSpectrum;
+		std::vector<complex_type> m_accumulated;
+		std::vector<complex_type> m_product;
+		std::vector<number_type> m_signal;
+		bool m_valid;
+	};
+
+}
+}
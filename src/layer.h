@@ -24,16 +24,226 @@ SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "tensor.h"
 
 namespace neural_network {
 
-	template <typename InputMetrics, typename OutputMetrics>
+namespace detail {
+
+	template <class T>
+	struct make_void
+	{
+		typedef void type;
+	};
+
+	template <class Batch, class Metrics>
+	struct is_batch_of
+	{
+		enum : bool {
+			value = std::is_same<
+				typename Batch::metrics,
+				typename Metrics::template expand<Batch::metrics::dimension_size>::type
+			>::value
+		};
+	};
+
+	template <class Batch, class Item>
+	void get_batch_item(
+		const Batch& batch,
+		const size_t index,
+		Item& item)
+	{
+		auto rows = batch.reshape<algebra::metrics<Batch::metrics::dimension_size, Item::data_size>>();
+		auto row = item.reshape<algebra::metrics<Item::data_size>>();
+
+		for (size_t i = 0; i < Item::data_size; ++i)
+		{
+			row(i) = rows(index, i);
+		}
+	}
+
+	template <class Batch, class Item>
+	void set_batch_item(
+		const Item& item,
+		const size_t index,
+		Batch& batch)
+	{
+		auto rows = batch.reshape<algebra::metrics<Batch::metrics::dimension_size, Item::data_size>>();
+		auto row = item.reshape<algebra::metrics<Item::data_size>>();
+
+		for (size_t i = 0; i < Item::data_size; ++i)
+		{
+			rows(index, i) = row(i);
+		}
+	}
+
+	// Describes which tensors of a layer its backward pass reads, so that a network can share the
+	// output and gradient tensors of its layers. Layers that bind buffers write every element of
+	// their output and gradient tensors, and layers that alias their input return a view of it.
+	// Recomputing layers rebuild their internal tensors in the backward pass, so they can share
+	// one region of the arena.
+	template <const bool GradientUsesInput, const bool GradientUsesOutput, const bool BindsBuffers = true, const bool AliasesInput = false, const bool PlansMemory = false, const bool Recomputes = false>
+	struct layer_memory
+	{
+		enum : bool {
+			gradient_uses_input = GradientUsesInput,
+			gradient_uses_output = GradientUsesOutput,
+			binds_buffers = BindsBuffers,
+			aliases_input = AliasesInput,
+			plans_memory = PlansMemory,
+			recomputes = Recomputes
+		};
+	};
+
+	// Update of the weights of a layer accumulated over the micro-batches of a batch, when the
+	// micro-batches are processed by copies of the layer. The update is kept in slots for the rows
+	// it touches, which are allocated with zero values on first use, together with the number of
+	// accumulated passes and the sum of their rates. Slot pointers stay valid until the next slot
+	// is allocated.
+	template <class Number>
+	class accumulated_update
+	{
+	public:
+		accumulated_update()
+			: m_slots(), m_values(), m_rate(0), m_count(0)
+		{
+		}
+
+		size_t count() const
+		{
+			return m_count;
+		}
+
+		Number rate() const
+		{
+			return m_rate;
+		}
+
+		void add_rate(
+			const Number rate)
+		{
+			m_rate += rate;
+			m_count += 1;
+		}
+
+		Number* row(
+			const size_t index,
+			const size_t width)
+		{
+			auto slot = m_slots.find(index);
+			if (m_slots.end() != slot)
+				return m_values.data() + slot->second;
+
+			const size_t offset = m_values.size();
+
+			m_slots.emplace(index, offset);
+			m_values.resize(offset + width, Number(0));
+
+			return m_values.data() + offset;
+		}
+
+		Number* find(
+			const size_t index)
+		{
+			auto slot = m_slots.find(index);
+			return (m_slots.end() == slot) ? nullptr : (m_values.data() + slot->second);
+		}
+
+		const Number* find(
+			const size_t index) const
+		{
+			auto slot = m_slots.find(index);
+			return (m_slots.end() == slot) ? nullptr : (m_values.data() + slot->second);
+		}
+
+		// Adds the values of the tensor multiplied by the rate to the slot of the index.
+		template <class Tensor>
+		void add(
+			const size_t index,
+			const Tensor& values,
+			const Number rate)
+		{
+			const Number* source = values.data();
+			Number* sum = row(index, Tensor::data_size);
+
+			for (size_t i = 0; i < Tensor::data_size; ++i)
+			{
+				sum[i] += source[i] * rate;
+			}
+		}
+
+		// Copies the slot of the index to the tensor, which is zero for a slot that was not used.
+		template <class Tensor>
+		void get(
+			const size_t index,
+			Tensor& values) const
+		{
+			const Number* sum = find(index);
+
+			if (nullptr == sum)
+			{
+				values.fill(0);
+			}
+			else
+			{
+				std::copy(sum, sum + Tensor::data_size, values.data());
+			}
+		}
+
+		// Adds the slot of the index to the tensor.
+		template <class Tensor>
+		void add_to(
+			const size_t index,
+			Tensor& values) const
+		{
+			const Number* sum = find(index);
+			if (nullptr == sum)
+				return;
+
+			Number* target = values.data();
+
+			for (size_t i = 0; i < Tensor::data_size; ++i)
+			{
+				target[i] += sum[i];
+			}
+		}
+
+		template <class Visitor>
+		void for_each(
+			Visitor& visitor) const
+		{
+			for (const std::pair<const size_t, size_t>& slot : m_slots)
+			{
+				visitor(slot.first, m_values.data() + slot.second);
+			}
+		}
+
+		void clear()
+		{
+			m_slots.clear();
+			m_values.clear();
+			m_rate = 0;
+			m_count = 0;
+		}
+
+	private:
+		std::unordered_map<size_t, size_t> m_slots;
+		std::vector<Number> m_values;
+		Number m_rate;
+		size_t m_count;
+	};
+}
+
+	template <typename InputMetrics, typename OutputMetrics, typename Number = float>
 	class layer_base
 	{
 	public:
-		typedef typename InputMetrics::tensor_type input;
-		typedef typename OutputMetrics::tensor_type output;
+		typedef typename InputMetrics::template tensor_of<Number>::type input;
+		typedef typename OutputMetrics::template tensor_of<Number>::type output;
 
 		static_assert(
 			std::is_same<typename input::number_type, typename output::number_type>::value,
@@ -41,6 +251,8 @@ namespace neural_network {
 
 		typedef typename input::number_type number_type;
 
+		typedef typename detail::layer_memory<true, true> memory_traits;
+
 		layer_base()
 			: m_output(), m_gradient()
 		{}
@@ -55,6 +267,18 @@ namespace neural_network {
 			return m_gradient;
 		}
 
+		void bind_output(
+			const output& buffer)
+		{
+			m_output = buffer;
+		}
+
+		void bind_gradient(
+			const input& buffer)
+		{
+			m_gradient = buffer;
+		}
+
 	protected:
 		output m_output;
 		input m_gradient;
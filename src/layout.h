@@ -0,0 +1,312 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include "layer.h"
+#include "core.h"
+#include "serialization.h"
+
+namespace neural_network {
+
+namespace layout {
+
+	// Channel or kernel dimension is the first, outermost dimension of the tensor.
+	struct channels_first {};
+
+	// Channel or kernel dimension is the last dimension of the tensor, so the values
+	// of all channels at one position are stored next to each other.
+	struct channels_last {};
+}
+
+namespace detail {
+
+	template <class Metrics, class Layout>
+	struct layout_conversion_metrics;
+
+	template <class Metrics>
+	struct layout_conversion_metrics<Metrics, layout::channels_last>
+	{
+		typedef typename algebra::detail::move_first_dimension_last<Metrics>::type output_metrics;
+		typedef typename layout::channels_first input_layout;
+
+		enum : size_t {
+			rows = Metrics::dimension_size,
+			columns = Metrics::data_size / Metrics::dimension_size
+		};
+	};
+
+	template <class Metrics>
+	struct layout_conversion_metrics<Metrics, layout::channels_first>
+	{
+		typedef typename algebra::detail::move_last_dimension_first<Metrics>::type output_metrics;
+		typedef typename layout::channels_last input_layout;
+
+		enum : size_t {
+			rows = Metrics::data_size / algebra::detail::dimension<Metrics, (Metrics::rank - 1)>::size,
+			columns = algebra::detail::dimension<Metrics, (Metrics::rank - 1)>::size
+		};
+	};
+
+	template <const size_t Rows, const size_t Columns, class Input, class Output>
+	void transpose(
+		const Input& input,
+		Output& result)
+	{
+		auto source = input.reshape<algebra::metrics<Rows, Columns>>();
+		auto target = result.reshape<algebra::metrics<Columns, Rows>>();
+
+		for (size_t row = 0; row < Rows; ++row)
+		{
+			for (size_t column = 0; column < Columns; ++column)
+			{
+				target(column, row) = source(row, column);
+			}
+		}
+	}
+
+	template <typename Conversion>
+	struct layout_conversion_serializer_impl
+	{
+		typedef typename Conversion value_type;
+
+		typedef typename serialization::metrics_serializer<typename Conversion::input::metrics> input_metrics_serializer_type;
+		typedef typename serialization::metrics_serializer<typename Conversion::output::metrics> ouput_metrics_serializer_type;
+
+		enum : size_t {
+			serialized_data_size =
+				input_metrics_serializer_type::serialized_data_size
+				+ ouput_metrics_serializer_type::serialized_data_size
+		};
+
+		static void read(
+			std::istream& in,
+			value_type&)
+		{
+			input_metrics_serializer_type::read(in);
+			ouput_metrics_serializer_type::read(in);
+		}
+
+		static void write(
+			std::ostream& out,
+			const value_type&)
+		{
+			input_metrics_serializer_type::write(out);
+			ouput_metrics_serializer_type::write(out);
+		}
+	};
+}
+
+	// Moves the channel dimension of the input tensor to the position required by the Layout.
+	template <typename InputMetrics, typename Layout, typename Number = float>
+	class layout_conversion 
+		: public layer_base<
+			InputMetrics,
+			typename detail::layout_conversion_metrics<InputMetrics, Layout>::output_metrics,
+			Number>
+	{
+	public:
+		typedef typename layout_conversion<InputMetrics, Layout, Number> this_type;
+		typedef typename detail::layout_conversion_metrics<InputMetrics, Layout> conversion_metrics;
+		typedef typename layer_base<InputMetrics, typename conversion_metrics::output_metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename conversion_metrics::input_layout input_layout;
+		typedef typename Layout output_layout;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::layout_conversion_layer,
+			detail::layout_conversion_serializer_impl<this_type>
+		> serializer;
+
+		const output& process(const input& input)
+		{
+			detail::transpose<conversion_metrics::rows, conversion_metrics::columns>(input, m_output);
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			detail::transpose<conversion_metrics::columns, conversion_metrics::rows>(grad, m_gradient);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type)
+		{}
+
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue&)
+		{
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue&)
+		{
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			::boost::compute::command_queue&)
+		{
+			this->update_weights(rate);
+		}
+
+#endif
+	};
+
+namespace detail {
+
+	template <class Layer, class = void>
+	struct input_layout
+	{
+		typedef typename layout::channels_first type;
+	};
+
+	template <class Layer>
+	struct input_layout<Layer, typename make_void<typename Layer::input_layout>::type>
+	{
+		typedef typename Layer::input_layout type;
+	};
+
+	template <class Layer, class = void>
+	struct output_layout
+	{
+		typedef typename layout::channels_first type;
+	};
+
+	template <class Layer>
+	struct output_layout<Layer, typename make_void<typename Layer::output_layout>::type>
+	{
+		typedef typename Layer::output_layout type;
+	};
+
+	// Passes the output of a layer to the next layer unchanged.
+	template <class Metrics, class Number>
+	struct identity_layout
+	{
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename Metrics::template tensor_of<Number>::type output;
+
+		typedef typename layer_memory<false, false, false, true> memory_traits;
+
+		const output& process(const input& input)
+		{
+			return input;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			return grad;
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue&)
+		{
+			return input;
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue&)
+		{
+			return gradient;
+		}
+
+#endif
+	};
+
+	// Selects the layout conversion between two adjacent layers of a network. The conversion is
+	// inserted only when the output and input tensors differ just by the position of the channel
+	// dimension, and one of the layers declares a channels last layout.
+	template <class Layer, class Next>
+	struct layout_adapter
+	{
+		typedef typename Layer::output::metrics output_metrics;
+		typedef typename Next::input::metrics input_metrics;
+		typedef typename Layer::number_type number_type;
+
+		enum : bool {
+			is_same_metrics = std::is_same<output_metrics, input_metrics>::value,
+			to_channels_first = !is_same_metrics
+				&& std::is_same<typename output_layout<Layer>::type, layout::channels_last>::value
+				&& std::is_same<typename algebra::detail::move_last_dimension_first<output_metrics>::type, input_metrics>::value,
+			to_channels_last = !is_same_metrics
+				&& !to_channels_first
+				&& std::is_same<typename input_layout<Next>::type, layout::channels_last>::value
+				&& std::is_same<typename algebra::detail::move_first_dimension_last<output_metrics>::type, input_metrics>::value,
+			is_identity = !to_channels_first && !to_channels_last
+		};
+
+		typedef typename std::conditional<
+			to_channels_first,
+			layout_conversion<output_metrics, layout::channels_first, number_type>,
+			typename std::conditional<
+				to_channels_last,
+				layout_conversion<output_metrics, layout::channels_last, number_type>,
+				identity_layout<output_metrics, number_type>
+			>::type
+		>::type type;
+	};
+
+	// Extends a channels last shape to rank 3 by inserting dimensions of the given size before the channel dimension.
+	template <class Shape, const size_t Value>
+	struct extend_channels_last_shape
+	{
+		typedef typename algebra::detail::move_first_dimension_last<
+			typename algebra::detail::extend_shape<
+				typename algebra::detail::move_last_dimension_first<Shape>::type, 3, Value
+			>::type
+		>::type type;
+	};
+}
+
+	template <class Input, class Layout, class Number = float, class... Args>
+	layout_conversion<Input, Layout, Number> make_layout_conversion_layer(
+		Args&&... args)
+	{
+		typedef layout_conversion<Input, Layout, Number> layer_type;
+		return (layer_type(std::forward<Args>(args)...));
+	}
+}
@@ -34,12 +34,12 @@ SOFTWARE.
 
 namespace neural_network {
 
-	template <typename ValueMetrics>
+	template <typename ValueMetrics, typename Number = float>
 	class squared_error_loss
 	{
 	public:
-		typedef typename squared_error_loss<ValueMetrics> this_type;
-		typedef typename ValueMetrics::tensor_type tensor_type;
+		typedef typename squared_error_loss<ValueMetrics, Number> this_type;
+		typedef typename ValueMetrics::template tensor_of<Number>::type tensor_type;
 		typedef typename tensor_type::number_type number_type;
 
 		squared_error_loss()
@@ -0,0 +1,408 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "layer.h"
+
+namespace neural_network {
+
+	// Both plans share the gradients and the outputs of hidden layers, but only training plans
+	// keep every output that the backward pass reads.
+	enum class memory_mode
+	{
+		inference,
+		training
+	};
+
+namespace detail {
+
+	template <class... Layers>
+	struct memory_units
+	{
+	};
+
+	template <class Layer, class Adapter, class Units>
+	struct prepend_memory_units;
+
+	template <class Layer, class Adapter, class... Units>
+	struct prepend_memory_units<Layer, Adapter, memory_units<Units...>>
+	{
+		typedef typename memory_units<Layer, Adapter, Units...> type;
+	};
+
+	// Layers that do not describe their memory keep their own tensors.
+	template <class Layer, class = void>
+	struct memory_traits_of
+	{
+		typedef typename layer_memory<true, true, false> type;
+	};
+
+	template <class Layer>
+	struct memory_traits_of<Layer, typename make_void<typename Layer::memory_traits>::type>
+	{
+		typedef typename Layer::memory_traits type;
+	};
+
+	template <const size_t A, const size_t B>
+	struct static_max
+	{
+		enum : size_t { value = (A < B) ? B : A };
+	};
+
+	// Liveness of the tensors around a layer, computed from the end of the network. The output
+	// escapes when it is the output of the network, and it is needed when the backward pass reads it.
+	template <const memory_mode Mode, class Layer, class... Layers>
+	struct memory_liveness;
+
+	template <const memory_mode Mode, class Layer, class Next, class... Layers>
+	struct memory_liveness<Mode, Layer, Next, Layers...>
+	{
+		typedef typename memory_traits_of<Layer>::type traits;
+		typedef typename memory_liveness<Mode, Next, Layers...> next;
+
+		enum : bool {
+			is_training = (memory_mode::training == Mode),
+			output_escapes = next::input_escapes,
+			output_needed = is_training && (traits::gradient_uses_output || next::input_needed),
+			input_escapes = traits::aliases_input && output_escapes,
+			input_needed = traits::aliases_input ? output_needed : (is_training && traits::gradient_uses_input)
+		};
+	};
+
+	template <const memory_mode Mode, class Layer>
+	struct memory_liveness<Mode, Layer>
+	{
+		typedef typename memory_traits_of<Layer>::type traits;
+
+		enum : bool {
+			is_training = (memory_mode::training == Mode),
+			output_escapes = true,
+			output_needed = is_training && traits::gradient_uses_output,
+			input_escapes = traits::aliases_input,
+			input_needed = traits::aliases_input ? output_needed : (is_training && traits::gradient_uses_input)
+		};
+	};
+
+	template <class Layer, const bool Recomputes>
+	struct memory_recompute_size
+	{
+		enum : size_t { value = 0 };
+	};
+
+	template <class Layer>
+	struct memory_recompute_size<Layer, true>
+	{
+		enum : size_t { value = Layer::recompute_size };
+	};
+
+	// Assigns the tensors of a layer to one of the two slots of the arena. The input of a layer
+	// is the output of the closest preceding layer that owns a slot, so alternating the slots of
+	// consecutive outputs, and of consecutive gradients, keeps the input and the result of every
+	// step apart. Outputs and gradients that escape or stay alive keep their own memory, which
+	// starts at the given private offset when the whole network is bound to a compact arena.
+	template <const memory_mode Mode, const size_t Outputs, const bool GradientEscapes, const size_t Private, class Layer, class... Layers>
+	struct memory_plan_step;
+
+	template <const memory_mode Mode, const size_t Outputs, const bool GradientEscapes, const size_t Private, class Layer, class Next, class... Layers>
+	struct memory_plan_step<Mode, Outputs, GradientEscapes, Private, Layer, Next, Layers...>
+	{
+		typedef typename memory_traits_of<Layer>::type traits;
+		typedef typename memory_liveness<Mode, Layer, Next, Layers...> liveness;
+
+		static const memory_mode mode = Mode;
+
+		enum : bool {
+			output_in_slot = traits::binds_buffers && !liveness::output_escapes && !liveness::output_needed,
+			gradient_in_slot = traits::binds_buffers && !GradientEscapes,
+			output_is_private = traits::binds_buffers && !output_in_slot,
+			gradient_is_private = traits::binds_buffers && !gradient_in_slot
+		};
+
+		enum : size_t {
+			output_size = Layer::output::data_size,
+			gradient_size = Layer::input::data_size,
+			output_offset = Private,
+			gradient_offset = Private + (output_is_private ? output_size : 0),
+			next_offset = gradient_offset + (gradient_is_private ? gradient_size : 0)
+		};
+
+		typedef typename memory_plan_step<
+			Mode,
+			Outputs + (output_in_slot ? 1 : 0),
+			GradientEscapes && traits::aliases_input,
+			next_offset,
+			Next,
+			Layers...> next;
+
+		enum : size_t {
+			output_slot = Outputs % 2,
+			gradient_slot = next::gradients % 2,
+			gradients = next::gradients + (gradient_in_slot ? 1 : 0),
+			slot_size_0 = static_max<
+				static_max<next::slot_size_0, (output_in_slot && 0 == output_slot) ? output_size : 0>::value,
+				(gradient_in_slot && 0 == gradient_slot) ? gradient_size : 0>::value,
+			slot_size_1 = static_max<
+				static_max<next::slot_size_1, (output_in_slot && 1 == output_slot) ? output_size : 0>::value,
+				(gradient_in_slot && 1 == gradient_slot) ? gradient_size : 0>::value,
+			recompute_size = static_max<next::recompute_size, memory_recompute_size<Layer, traits::recomputes>::value>::value,
+			buffer_size = next::buffer_size + (traits::binds_buffers ? output_size + gradient_size : 0),
+			private_size = next::private_size + (next_offset - Private)
+		};
+	};
+
+	template <const memory_mode Mode, const size_t Outputs, const bool GradientEscapes, const size_t Private, class Layer>
+	struct memory_plan_step<Mode, Outputs, GradientEscapes, Private, Layer>
+	{
+		typedef typename memory_traits_of<Layer>::type traits;
+		typedef typename memory_liveness<Mode, Layer> liveness;
+
+		static const memory_mode mode = Mode;
+
+		enum : bool {
+			output_in_slot = false,
+			gradient_in_slot = traits::binds_buffers && !GradientEscapes,
+			output_is_private = traits::binds_buffers,
+			gradient_is_private = traits::binds_buffers && !gradient_in_slot
+		};
+
+		enum : size_t {
+			output_size = Layer::output::data_size,
+			gradient_size = Layer::input::data_size,
+			output_offset = Private,
+			gradient_offset = Private + (output_is_private ? output_size : 0),
+			next_offset = gradient_offset + (gradient_is_private ? gradient_size : 0),
+			output_slot = 0,
+			gradient_slot = 0,
+			gradients = gradient_in_slot ? 1 : 0,
+			slot_size_0 = gradient_in_slot ? gradient_size : 0,
+			slot_size_1 = 0,
+			recompute_size = memory_recompute_size<Layer, traits::recomputes>::value,
+			buffer_size = traits::binds_buffers ? output_size + gradient_size : 0,
+			private_size = next_offset - Private
+		};
+	};
+
+	template <const memory_mode Mode, class Units>
+	struct memory_plan;
+
+	// The arena holds the two slots, followed by the region shared by the recomputing layers and,
+	// in a compact arena, by the private tensors.
+	template <const memory_mode Mode, class... Units>
+	struct memory_plan<Mode, memory_units<Units...>>
+	{
+		typedef typename memory_plan_step<Mode, 0, true, 0, Units...> first;
+
+		enum : size_t {
+			slot_size_0 = first::slot_size_0,
+			slot_size_1 = first::slot_size_1,
+			recompute_size = first::recompute_size,
+			arena_size = slot_size_0 + slot_size_1 + recompute_size,
+			buffer_size = first::buffer_size,
+			private_size = first::private_size,
+			compact_size = arena_size + private_size
+		};
+	};
+
+	// Storage shared by the planned tensors of a network. Views keep the storage alive.
+	template <class Number>
+	class memory_arena
+	{
+	public:
+		typedef typename std::vector<Number> storage_type;
+
+		memory_arena(
+			const std::shared_ptr<storage_type>& storage,
+			const size_t offset,
+			const size_t slotSize0,
+			const size_t slotSize1,
+			const size_t recomputeSize,
+			const bool compact)
+			: m_storage(storage), m_offset(offset), m_slotSize0(slotSize0), m_recomputeSize(recomputeSize), m_privateOffset(slotSize0 + slotSize1 + recomputeSize), m_compact(compact)
+		{}
+
+		bool is_compact() const
+		{
+			return m_compact;
+		}
+
+		template <class Tensor>
+		Tensor slot(
+			const size_t index) const
+		{
+			return this->view<Tensor>((0 == index) ? 0 : m_slotSize0);
+		}
+
+		template <class Tensor>
+		Tensor at(
+			const size_t offset) const
+		{
+			return this->view<Tensor>(m_privateOffset + offset);
+		}
+
+		// Compact arena of a recomputing layer, which shares the recompute region with other layers.
+		template <class Plan>
+		memory_arena region() const
+		{
+			return memory_arena(
+				m_storage,
+				m_offset + m_privateOffset - m_recomputeSize,
+				Plan::slot_size_0,
+				Plan::slot_size_1,
+				Plan::recompute_size,
+				true);
+		}
+
+	private:
+		template <class Tensor>
+		Tensor view(
+			const size_t offset) const
+		{
+			typedef typename Tensor::buffer_type buffer_type;
+			typedef typename Tensor::buffer_ptr buffer_ptr;
+
+			return Tensor(
+				buffer_ptr(
+					m_storage,
+					reinterpret_cast<buffer_type*>(m_storage->data() + m_offset + offset)));
+		}
+
+	private:
+		std::shared_ptr<storage_type> m_storage;
+		size_t m_offset;
+		size_t m_slotSize0;
+		size_t m_recomputeSize;
+		size_t m_privateOffset;
+		bool m_compact;
+	};
+
+	template <class Plan, class Number>
+	memory_arena<Number> make_memory_arena(
+		const bool compact)
+	{
+		typedef typename memory_arena<Number>::storage_type storage_type;
+
+		return memory_arena<Number>(
+			std::make_shared<storage_type>(compact ? Plan::compact_size : Plan::arena_size),
+			0,
+			Plan::slot_size_0,
+			Plan::slot_size_1,
+			Plan::recompute_size,
+			compact);
+	}
+
+	template <class Tensor, class Number>
+	Tensor make_planned_tensor(
+		const memory_arena<Number>& arena,
+		const bool inSlot,
+		const size_t slot,
+		const size_t offset)
+	{
+		if (inSlot)
+		{
+			return arena.template slot<Tensor>(slot);
+		}
+
+		return arena.is_compact() ? arena.template at<Tensor>(offset) : Tensor();
+	}
+
+	template <class Step, class Layer, class Number>
+	void bind_layer_buffers(
+		Layer& layer,
+		const memory_arena<Number>& arena,
+		std::true_type)
+	{
+		layer.bind_output(
+			make_planned_tensor<typename Layer::output>(arena, Step::output_in_slot, Step::output_slot, Step::output_offset));
+
+		layer.bind_gradient(
+			make_planned_tensor<typename Layer::input>(arena, Step::gradient_in_slot, Step::gradient_slot, Step::gradient_offset));
+	}
+
+	template <class Step, class Layer, class Number>
+	void bind_layer_buffers(
+		Layer&,
+		const memory_arena<Number>&,
+		std::false_type)
+	{
+	}
+
+	template <class Step, class Layer>
+	void plan_layer_memory(
+		Layer& layer,
+		std::true_type)
+	{
+		layer.plan_memory(Step::mode);
+	}
+
+	template <class Step, class Layer>
+	void plan_layer_memory(
+		Layer&,
+		std::false_type)
+	{
+	}
+
+	template <class Step, class Layer, class Number>
+	void bind_recompute_memory(
+		Layer& layer,
+		const memory_arena<Number>& arena,
+		std::true_type)
+	{
+		layer.bind_recompute_memory(
+			arena.template region<typename Layer::recompute_plan>());
+	}
+
+	template <class Step, class Layer, class Number>
+	void bind_recompute_memory(
+		Layer&,
+		const memory_arena<Number>&,
+		std::false_type)
+	{
+	}
+
+	template <class Step, class Layer, class Number>
+	void bind_layer_memory(
+		Layer& layer,
+		const memory_arena<Number>& arena)
+	{
+		bind_layer_buffers<Step>(
+			layer,
+			arena,
+			std::integral_constant<bool, Step::traits::binds_buffers>());
+
+		plan_layer_memory<Step>(
+			layer,
+			std::integral_constant<bool, Step::traits::plans_memory>());
+
+		bind_recompute_memory<Step>(
+			layer,
+			arena,
+			std::integral_constant<bool, Step::traits::recomputes>());
+	}
+}
+}
\ No newline at end of file
@@ -24,11 +24,17 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+
+#include "layout.h"
+#include "memory.h"
+#include "parallel.h"
 #include "serialization.h"
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 #include "opencl/layer_kernels.h"
+#include "loss.h"
 
 #endif
 
@@ -36,6 +42,39 @@ namespace neural_network {
 
 namespace detail {
 
+	template <class... Layers>
+	struct layer_list
+	{
+	};
+
+	// Processes a batch with a copy of the layer for every input. Layers that normalize over the
+	// batch see the inputs of all copies, other layers process every input with its own copy.
+	template <class Layer>
+	struct batch_processing
+	{
+		static void process(
+			std::vector<Layer*>& layers,
+			const std::vector<const typename Layer::input*>& inputs,
+			std::vector<const typename Layer::output*>& results)
+		{
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				results[k] = &layers[k]->process(*inputs[k]);
+			}
+		}
+
+		static void compute_gradient(
+			std::vector<Layer*>& layers,
+			const std::vector<const typename Layer::output*>& gradients,
+			std::vector<const typename Layer::input*>& results)
+		{
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				results[k] = &layers[k]->compute_gradient(*gradients[k]);
+			}
+		}
+	};
+
 	template <class Network, class Loss>
 	void train_network(
 		Network& net,
@@ -52,6 +91,20 @@ namespace detail {
 		net.update_weights(-std::abs(rate));
 	}
 
+	template <class Network, class Loss>
+	void train_network(
+		Network& net,
+		const typename Network::input& input,
+		const typename Network::output& truth,
+		Loss& loss,
+		const typename Network::number_type rate,
+		parallel::execution_context& context)
+	{
+		parallel::context_scope scope(context);
+
+		train_network(net, input, truth, loss, rate);
+	}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	template <class Network, class Loss>
@@ -63,16 +116,50 @@ namespace detail {
 		const typename Network::number_type rate,
 		::boost::compute::command_queue& queue)
 	{
-		net.compute_gradient(
-			loss.compute_gradient(
-				net.process(input, queue),
-				truth,
-				queue),
+		net.compute_loss_gradient(
+			net.process(input, queue),
+			truth,
+			loss,
 			queue);
 
 		net.update_weights(-std::abs(rate), queue);
 	}
 
+	// Layer produces its output with one of the fusable kernels and the next layer
+	// is an element-wise activation that can be applied in the same kernel.
+	template <class Layer, class Next, class = void>
+	struct is_fused_epilogue_pair : std::false_type
+	{
+	};
+
+	template <class Layer, class Next>
+	struct is_fused_epilogue_pair<
+		Layer,
+		Next,
+		typename std::enable_if<
+			Layer::supports_fused_epilogue,
+			typename make_void<typename Next::fused_epilogue>::type
+		>::type> : std::true_type
+	{
+	};
+
+	// Gradient of the squared error loss can be combined with the gradient of the final activation.
+	template <class Layer, class Loss, class = void>
+	struct is_fused_loss : std::false_type
+	{
+	};
+
+	template <class Layer>
+	struct is_fused_loss<
+		Layer,
+		squared_error_loss<typename Layer::output::metrics>,
+		typename std::enable_if<
+			!(Layer::output::data_size < opencl::detail::layer_kernels::block_size),
+			typename make_void<typename Layer::fused_epilogue>::type
+		>::type> : std::true_type
+	{
+	};
+
 #endif
 
 }
@@ -83,33 +170,48 @@ namespace detail {
 	public:
 		typedef typename network<Layer, Args...> this_type;
 		typedef typename network<Args...> base_type;
+		typedef typename Layer layer_type;
 
 		typedef typename Layer::input input;
 		typedef typename base_type::output output;
 
-		static_assert(std::is_same<typename Layer::output, typename base_type::input>::value, "Output of the current layer does not match input of the next layer.");
+		typedef typename detail::input_layout<Layer>::type input_layout;
+		typedef typename base_type::output_layout output_layout;
+
+		typedef typename detail::layout_adapter<Layer, typename base_type::layer_type> layout_adapter;
+		typedef typename layout_adapter::type adapter_type;
+
+		static_assert(std::is_same<typename adapter_type::output, typename base_type::input>::value, "Output of the current layer does not match input of the next layer.");
 
 		typedef typename Layer::number_type number_type;
 
+		typedef typename detail::prepend_memory_units<Layer, adapter_type, typename base_type::memory_units>::type memory_units;
+		typedef typename detail::memory_plan<memory_mode::inference, memory_units> inference_memory_plan;
+		typedef typename detail::memory_plan<memory_mode::training, memory_units> training_memory_plan;
+
+		typedef typename detail::layer_memory<true, true, false, false, true> memory_traits;
+
 		network()
-			: base_type(), m_layer()
+			: base_type(), m_layer(), m_adapter()
 		{}
 
 		network(const Layer& layer, const Args&... args)
-			: base_type(args...), m_layer(layer)
+			: base_type(args...), m_layer(layer), m_adapter()
 		{
 		}
 
 		const output& process(const input& input)
 		{
 			return base_type::process(
-				m_layer.process(input));
+				m_adapter.process(
+					m_layer.process(input)));
 		}
 
 		const input& compute_gradient(const output& grad)
 		{
 			return m_layer.compute_gradient(
-				base_type::compute_gradient(grad));
+				m_adapter.compute_gradient(
+					base_type::compute_gradient(grad)));
 		}
 
 		void update_weights(
@@ -119,6 +221,25 @@ namespace detail {
 			m_layer.update_weights(rate);
 		}
 
+		// Adds the update of the last backward pass to the update that the layers of the target
+		// accumulate for a batch. The target is a network with the same weights.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			base_type::accumulate_update(target, rate);
+			m_layer.accumulate_update(target.m_layer, rate);
+		}
+
+		// Applies the update accumulated by the layers of the source, which is this network or a
+		// network with the same weights. A network that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			base_type::apply_update(source);
+			m_layer.apply_update(source.m_layer);
+		}
+
 		template <class Loss>
 		void train(
 			const typename input& input,
@@ -129,6 +250,132 @@ namespace detail {
 			detail::train_network(*this, input, truth, loss, rate);
 		}
 
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		template <class Loss>
+		void train(
+			const typename input& input,
+			const typename output& truth,
+			Loss& loss,
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			detail::train_network(*this, input, truth, loss, rate, context);
+		}
+
+		// Binds the outputs and gradients of the layers to a shared arena. A network planned for
+		// inference must be planned for training again before it is trained.
+		void plan_memory(
+			const memory_mode mode)
+		{
+			this->plan_memory(
+				mode,
+				(memory_mode::training == mode)
+					? detail::make_memory_arena<training_memory_plan, number_type>(false)
+					: detail::make_memory_arena<inference_memory_plan, number_type>(false));
+		}
+
+		// The arena must be made for the plan of the same mode.
+		void plan_memory(
+			const memory_mode mode,
+			const detail::memory_arena<number_type>& arena)
+		{
+			if (memory_mode::training == mode)
+			{
+				this->bind_memory<typename training_memory_plan::first>(arena);
+			}
+			else
+			{
+				this->bind_memory<typename inference_memory_plan::first>(arena);
+			}
+		}
+
+		// Calls the visitor with every layer of the network in order. Nested networks are passed
+		// to the visitor as layers.
+		template <class Visitor>
+		void visit(
+			Visitor& visitor)
+		{
+			visitor(m_layer);
+			base_type::visit(visitor);
+		}
+
+		// Processes a batch with a copy of the network for every input, one layer at a time, so
+		// that every layer processes the whole batch before the next one.
+		static void process_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const input*>& inputs,
+			std::vector<const output*>& results)
+		{
+			std::vector<Layer*> layers(copies.size());
+			std::vector<base_type*> next(copies.size());
+
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				layers[k] = &copies[k]->m_layer;
+				next[k] = copies[k];
+			}
+
+			std::vector<const typename Layer::output*> outputs(copies.size());
+			detail::batch_processing<Layer>::process(layers, inputs, outputs);
+
+			std::vector<const typename base_type::input*> adapted(copies.size());
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				adapted[k] = &copies[k]->m_adapter.process(*outputs[k]);
+			}
+
+			base_type::process_batch(next, adapted, results);
+		}
+
+		static void compute_gradient_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const output*>& gradients,
+			std::vector<const input*>& results)
+		{
+			std::vector<Layer*> layers(copies.size());
+			std::vector<base_type*> next(copies.size());
+
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				layers[k] = &copies[k]->m_layer;
+				next[k] = copies[k];
+			}
+
+			std::vector<const typename base_type::input*> nextGradients(copies.size());
+			base_type::compute_gradient_batch(next, gradients, nextGradients);
+
+			std::vector<const typename Layer::output*> adapted(copies.size());
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				adapted[k] = &copies[k]->m_adapter.compute_gradient(*nextGradients[k]);
+			}
+
+			detail::batch_processing<Layer>::compute_gradient(layers, adapted, results);
+		}
+
 		struct serializer
 		{
 			typedef this_type value;
@@ -162,17 +409,40 @@ namespace detail {
 			const input& input,
 			::boost::compute::command_queue& queue)
 		{
-			return base_type::process(
-				m_layer.process(input, queue),
-				queue);
+			return this->dispatch_process(
+				input,
+				queue,
+				std::integral_constant<
+					bool,
+					detail::is_fused_epilogue_pair<Layer, typename base_type::layer_type>::value && layout_adapter::is_identity>());
 		}
 
 		const input& compute_gradient(
 			const output& gradient,
 			::boost::compute::command_queue& queue)
 		{
+			opencl::profiling_scope scope(m_layer);
+
+			return m_layer.compute_gradient(
+				m_adapter.compute_gradient(
+					base_type::compute_gradient(gradient, queue),
+					queue),
+				queue);
+		}
+
+		template <class Loss>
+		const input& compute_loss_gradient(
+			const output& result,
+			const output& truth,
+			Loss& loss,
+			::boost::compute::command_queue& queue)
+		{
+			opencl::profiling_scope scope(m_layer);
+
 			return m_layer.compute_gradient(
-				base_type::compute_gradient(gradient, queue),
+				m_adapter.compute_gradient(
+					base_type::compute_loss_gradient(result, truth, loss, queue),
+					queue),
 				queue);
 		}
 
@@ -180,6 +450,8 @@ namespace detail {
 			const number_type rate,
 			::boost::compute::command_queue& queue)
 		{
+			opencl::profiling_scope scope(m_layer);
+
 			base_type::update_weights(rate, queue);
 			m_layer.update_weights(rate, queue);
 		}
@@ -195,10 +467,58 @@ namespace detail {
 			detail::train_network(*this, input, truth, loss, rate, queue);
 		}
 
+	protected:
+		template <class Producer>
+		const output& process_fused_from(
+			Producer& producer,
+			const typename Producer::input& input,
+			::boost::compute::command_queue& queue)
+		{
+			return base_type::process(
+				m_layer.template process_fused<typename Layer::fused_epilogue>(producer, input, queue),
+				queue);
+		}
+
+	private:
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue& queue,
+			std::false_type)
+		{
+			opencl::profiling_scope scope(m_layer);
+
+			return base_type::process(
+				m_adapter.process(
+					m_layer.process(input, queue),
+					queue),
+				queue);
+		}
+
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue& queue,
+			std::true_type)
+		{
+			opencl::profiling_scope scope(m_layer);
+
+			return base_type::process_fused_from(m_layer, input, queue);
+		}
+
 #endif
 
+	protected:
+		template <class Step>
+		void bind_memory(
+			const detail::memory_arena<number_type>& arena)
+		{
+			detail::bind_layer_memory<Step>(m_layer, arena);
+			detail::bind_layer_memory<typename Step::next>(m_adapter, arena);
+			base_type::template bind_memory<typename Step::next::next>(arena);
+		}
+
 	private:
 		Layer m_layer;
+		adapter_type m_adapter;
 	};
 
 	template <class Layer>
@@ -206,12 +526,22 @@ namespace detail {
 	{
 	public:
 		typedef typename network<Layer> this_type;
+		typedef typename Layer layer_type;
 
 		typedef typename Layer::input input;
 		typedef typename Layer::output output;
 
+		typedef typename detail::input_layout<Layer>::type input_layout;
+		typedef typename detail::output_layout<Layer>::type output_layout;
+
 		typedef typename Layer::number_type number_type;
 
+		typedef typename detail::memory_units<Layer> memory_units;
+		typedef typename detail::memory_plan<memory_mode::inference, memory_units> inference_memory_plan;
+		typedef typename detail::memory_plan<memory_mode::training, memory_units> training_memory_plan;
+
+		typedef typename detail::layer_memory<true, true, false, false, true> memory_traits;
+
 		network()
 			: m_layer()
 		{}
@@ -237,6 +567,19 @@ namespace detail {
 			m_layer.update_weights(rate);
 		}
 
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			m_layer.accumulate_update(target.m_layer, rate);
+		}
+
+		void apply_update(
+			const this_type& source)
+		{
+			m_layer.apply_update(source.m_layer);
+		}
+
 		template <class Loss>
 		void train(
 			const typename input& input,
@@ -247,6 +590,100 @@ namespace detail {
 			detail::train_network(*this, input, truth, loss, rate);
 		}
 
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		template <class Loss>
+		void train(
+			const typename input& input,
+			const typename output& truth,
+			Loss& loss,
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			detail::train_network(*this, input, truth, loss, rate, context);
+		}
+
+		void plan_memory(
+			const memory_mode mode)
+		{
+			this->plan_memory(
+				mode,
+				(memory_mode::training == mode)
+					? detail::make_memory_arena<training_memory_plan, number_type>(false)
+					: detail::make_memory_arena<inference_memory_plan, number_type>(false));
+		}
+
+		void plan_memory(
+			const memory_mode mode,
+			const detail::memory_arena<number_type>& arena)
+		{
+			if (memory_mode::training == mode)
+			{
+				this->bind_memory<typename training_memory_plan::first>(arena);
+			}
+			else
+			{
+				this->bind_memory<typename inference_memory_plan::first>(arena);
+			}
+		}
+
+		template <class Visitor>
+		void visit(
+			Visitor& visitor)
+		{
+			visitor(m_layer);
+		}
+
+		static void process_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const input*>& inputs,
+			std::vector<const output*>& results)
+		{
+			std::vector<Layer*> layers(copies.size());
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				layers[k] = &copies[k]->m_layer;
+			}
+
+			detail::batch_processing<Layer>::process(layers, inputs, results);
+		}
+
+		static void compute_gradient_batch(
+			std::vector<this_type*>& copies,
+			const std::vector<const output*>& gradients,
+			std::vector<const input*>& results)
+		{
+			std::vector<Layer*> layers(copies.size());
+			for (size_t k = 0; k < copies.size(); ++k)
+			{
+				layers[k] = &copies[k]->m_layer;
+			}
+
+			detail::batch_processing<Layer>::compute_gradient(layers, gradients, results);
+		}
+
 		struct serializer
 		{
 			typedef this_type value;
@@ -274,6 +711,8 @@ namespace detail {
 			const input& input,
 			::boost::compute::command_queue& queue)
 		{
+			opencl::profiling_scope scope(m_layer);
+
 			return m_layer.process(input, queue);
 		}
 
@@ -281,13 +720,34 @@ namespace detail {
 			const output& gradient,
 			::boost::compute::command_queue& queue)
 		{
+			opencl::profiling_scope scope(m_layer);
+
 			return m_layer.compute_gradient(gradient, queue);
 		}
 
+		template <class Loss>
+		const input& compute_loss_gradient(
+			const output& result,
+			const output& truth,
+			Loss& loss,
+			::boost::compute::command_queue& queue)
+		{
+			opencl::profiling_scope scope(m_layer);
+
+			return this->dispatch_compute_loss_gradient(
+				result,
+				truth,
+				loss,
+				queue,
+				detail::is_fused_loss<Layer, Loss>());
+		}
+
 		void update_weights(
 			const number_type rate,
 			::boost::compute::command_queue& queue)
 		{
+			opencl::profiling_scope scope(m_layer);
+
 			m_layer.update_weights(rate, queue);
 		}
 
@@ -302,12 +762,80 @@ namespace detail {
 			detail::train_network(*this, input, truth, loss, rate, queue);
 		}
 
+	protected:
+		template <class Producer>
+		const output& process_fused_from(
+			Producer& producer,
+			const typename Producer::input& input,
+			::boost::compute::command_queue& queue)
+		{
+			return m_layer.template process_fused<typename Layer::fused_epilogue>(producer, input, queue);
+		}
+
+	private:
+		template <class Loss>
+		const input& dispatch_compute_loss_gradient(
+			const output& result,
+			const output& truth,
+			Loss& loss,
+			::boost::compute::command_queue& queue,
+			std::false_type)
+		{
+			return m_layer.compute_gradient(
+				loss.compute_gradient(result, truth, queue),
+				queue);
+		}
+
+		template <class Loss>
+		const input& dispatch_compute_loss_gradient(
+			const output&,
+			const output& truth,
+			Loss&,
+			::boost::compute::command_queue& queue,
+			std::true_type)
+		{
+			return m_layer.template compute_fused_loss_gradient<typename Layer::fused_epilogue>(truth, queue);
+		}
+
 #endif
 
+	protected:
+		template <class Step>
+		void bind_memory(
+			const detail::memory_arena<number_type>& arena)
+		{
+			detail::bind_layer_memory<Step>(m_layer, arena);
+		}
+
 	private:
 		Layer m_layer;
 	};
 
+namespace detail {
+
+	template <class... Layers>
+	struct batch_processing<network<Layers...>>
+	{
+		typedef network<Layers...> network_type;
+
+		static void process(
+			std::vector<network_type*>& layers,
+			const std::vector<const typename network_type::input*>& inputs,
+			std::vector<const typename network_type::output*>& results)
+		{
+			network_type::process_batch(layers, inputs, results);
+		}
+
+		static void compute_gradient(
+			std::vector<network_type*>& layers,
+			const std::vector<const typename network_type::output*>& gradients,
+			std::vector<const typename network_type::input*>& results)
+		{
+			network_type::compute_gradient_batch(layers, gradients, results);
+		}
+	};
+}
+
 	template <class... Layers>
 	network<Layers...> make_network(
 		Layers&&... args)
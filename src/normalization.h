@@ -0,0 +1,965 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#include "layer.h"
+#include "parallel.h"
+#include "serialization.h"
+#include "connected.h"
+#include "convolution.h"
+#include "layout.h"
+#include "network.h"
+#include "checkpoint.h"
+
+namespace neural_network {
+
+	// Normalizes every channel of the input with the mean and variance of the channel, and applies
+	// a learned scale and shift. The channel is the first dimension of the input, or the last one
+	// for channels last layout. A batch processed with process_batch is normalized with the
+	// statistics of the batch, and its backward pass differentiates through them. The running
+	// statistics follow the statistics of the batches, and normalize a single input, so inference
+	// computes a constant transform. The backward pass of a single input treats the running
+	// statistics as constants and leaves them unchanged.
+	template <class Metrics, class Layout = layout::channels_first, class Number = float>
+	class batch_normalization : public layer_base<Metrics, Metrics, Number>
+	{
+	public:
+		typedef typename batch_normalization<Metrics, Layout, Number> this_type;
+		typedef typename layer_base<Metrics, Metrics, Number> base_type;
+
+		typedef typename Layout input_layout;
+		typedef typename Layout output_layout;
+
+		typedef typename detail::layer_memory<true, false> memory_traits;
+
+		enum : size_t {
+			channels = std::is_same<Layout, layout::channels_last>::value
+				? algebra::detail::dimension<Metrics, (Metrics::rank - 1)>::size
+				: Metrics::dimension_size,
+			positions = Metrics::data_size / channels
+		};
+
+		typedef typename algebra::metrics<channels>::template tensor_of<number_type>::type channel_type;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::batch_normalization_layer,
+			serialization::composite_serializer<
+				serialization::tensor_serializer<channel_type>,
+				serialization::tensor_serializer<channel_type>,
+				serialization::tensor_serializer<channel_type>,
+				serialization::tensor_serializer<channel_type>,
+				serialization::value_serializer<number_type>,
+				serialization::value_serializer<number_type>>
+		> serializer_impl_type;
+
+		batch_normalization(
+			const number_type momentum = 0.01f,
+			const number_type epsilon = 0.00001f)
+			: base_type(), m_input(), m_gamma(unit), m_beta(), m_mean(), m_variance(unit), m_scale(), m_shift(),
+			m_gammaGradient(), m_betaGradient(), m_batchMean(), m_batchVariance(), m_batchStatistics(false), m_accumulatedUpdate(), m_momentum(momentum), m_epsilon(epsilon)
+		{
+		}
+
+		// Returns the channel of an element of the input or output tensor.
+		static size_t channel_of(
+			const size_t index)
+		{
+			return std::is_same<Layout, layout::channels_last>::value
+				? (index % channels)
+				: (index / positions);
+		}
+
+		// Computes the scale and shift of every channel with the running statistics, so that the
+		// output for a single input is input * scale + shift.
+		void get_transform(
+			channel_type& scale,
+			channel_type& shift) const
+		{
+			for (size_t c = 0; c < channels; ++c)
+			{
+				scale(c) = m_gamma(c) / std::sqrt(m_variance(c) + m_epsilon);
+				shift(c) = m_beta(c) - scale(c) * m_mean(c);
+			}
+		}
+
+		const output& process(const input& input)
+		{
+			m_input = input;
+			m_batchStatistics = false;
+
+			get_transform(m_scale, m_shift);
+			apply_transform();
+
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			const number_type* values = m_input.data();
+			const number_type* gradient = grad.data();
+			number_type* result = m_gradient.data();
+
+			m_gammaGradient.fill(0);
+			m_betaGradient.fill(0);
+
+			for (size_t i = 0; i < Metrics::data_size; ++i)
+			{
+				const size_t c = channel_of(i);
+
+				m_gammaGradient(c) += gradient[i] * (values[i] - m_mean(c));
+				m_betaGradient(c) += gradient[i];
+
+				result[i] = gradient[i] * m_scale(c);
+			}
+
+			for (size_t c = 0; c < channels; ++c)
+			{
+				m_gammaGradient(c) /= std::sqrt(m_variance(c) + m_epsilon);
+			}
+
+			return m_gradient;
+		}
+
+		// Processes a batch with a copy of the layer for every input. Every input is normalized
+		// with the mean and the biased variance of its channel over all inputs of the batch.
+		static void process_batch(
+			std::vector<this_type*>& layers,
+			const std::vector<const input*>& inputs,
+			std::vector<const output*>& results)
+		{
+			const number_type count = static_cast<number_type>(layers.size() * positions);
+
+			channel_type mean;
+			channel_type variance;
+
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				const number_type* values = inputs[k]->data();
+
+				for (size_t i = 0; i < Metrics::data_size; ++i)
+				{
+					mean(channel_of(i)) += values[i];
+				}
+			}
+
+			for (size_t c = 0; c < channels; ++c)
+			{
+				mean(c) /= count;
+			}
+
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				const number_type* values = inputs[k]->data();
+
+				for (size_t i = 0; i < Metrics::data_size; ++i)
+				{
+					const size_t c = channel_of(i);
+					variance(c) += (values[i] - mean(c)) * (values[i] - mean(c));
+				}
+			}
+
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				this_type& layer = *layers[k];
+
+				layer.m_input = *inputs[k];
+				layer.m_batchStatistics = true;
+
+				for (size_t c = 0; c < channels; ++c)
+				{
+					layer.m_batchMean(c) = mean(c);
+					layer.m_batchVariance(c) = variance(c) / count;
+
+					layer.m_scale(c) = layer.m_gamma(c) / std::sqrt(layer.m_batchVariance(c) + layer.m_epsilon);
+					layer.m_shift(c) = layer.m_beta(c) - layer.m_scale(c) * mean(c);
+				}
+
+				layer.apply_transform();
+				results[k] = &layer.m_output;
+			}
+		}
+
+		// The statistics of the batch depend on every input, so the gradient of an input is
+		// reduced by the mean gradient of the batch, and by the mean gradient of the scale along
+		// the normalized input.
+		static void compute_gradient_batch(
+			std::vector<this_type*>& layers,
+			const std::vector<const output*>& gradients,
+			std::vector<const input*>& results)
+		{
+			const number_type count = static_cast<number_type>(layers.size() * positions);
+
+			channel_type gammaGradient;
+			channel_type betaGradient;
+
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				this_type& layer = *layers[k];
+
+				const number_type* values = layer.m_input.data();
+				const number_type* gradient = gradients[k]->data();
+
+				layer.m_gammaGradient.fill(0);
+				layer.m_betaGradient.fill(0);
+
+				for (size_t i = 0; i < Metrics::data_size; ++i)
+				{
+					const size_t c = channel_of(i);
+
+					layer.m_gammaGradient(c) += gradient[i] * layer.normalize(values[i], c);
+					layer.m_betaGradient(c) += gradient[i];
+				}
+
+				for (size_t c = 0; c < channels; ++c)
+				{
+					gammaGradient(c) += layer.m_gammaGradient(c);
+					betaGradient(c) += layer.m_betaGradient(c);
+				}
+			}
+
+			for (size_t k = 0; k < layers.size(); ++k)
+			{
+				this_type& layer = *layers[k];
+
+				const number_type* values = layer.m_input.data();
+				const number_type* gradient = gradients[k]->data();
+				number_type* result = layer.m_gradient.data();
+
+				for (size_t i = 0; i < Metrics::data_size; ++i)
+				{
+					const size_t c = channel_of(i);
+
+					result[i] = layer.m_scale(c) * (gradient[i]
+						- betaGradient(c) / count
+						- layer.normalize(values[i], c) * gammaGradient(c) / count);
+				}
+
+				results[k] = &layer.m_gradient;
+			}
+		}
+
+		// The running statistics move towards the statistics of the last batch.
+		void update_weights(
+			const number_type rate)
+		{
+			for (size_t c = 0; c < channels; ++c)
+			{
+				m_gamma(c) += m_gammaGradient(c) * rate;
+				m_beta(c) += m_betaGradient(c) * rate;
+			}
+
+			if (m_batchStatistics)
+			{
+				for (size_t c = 0; c < channels; ++c)
+				{
+					m_mean(c) += (m_batchMean(c) - m_mean(c)) * m_momentum;
+					m_variance(c) += (m_batchVariance(c) - m_variance(c)) * m_momentum;
+				}
+			}
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its inputs. The
+		// statistics of a batch are kept in one slot with the number of passes that added them.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			detail::accumulated_update<number_type>& update = target.m_accumulatedUpdate;
+
+			update.add(0, m_gammaGradient, rate);
+			update.add(1, m_betaGradient, rate);
+
+			if (m_batchStatistics)
+			{
+				number_type* statistics = update.row(2, 2 * channels + 1);
+
+				for (size_t c = 0; c < channels; ++c)
+				{
+					statistics[c] += m_batchMean(c);
+					statistics[channels + c] += m_batchVariance(c);
+				}
+
+				statistics[2 * channels] += 1;
+			}
+
+			update.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights. The running statistics are moved once, towards the mean statistics of the
+		// batches. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			const detail::accumulated_update<number_type>& update = source.m_accumulatedUpdate;
+
+			update.add_to(0, m_gamma);
+			update.add_to(1, m_beta);
+
+			const number_type* statistics = update.find(2);
+			if (nullptr != statistics)
+			{
+				const number_type count = statistics[2 * channels];
+
+				for (size_t c = 0; c < channels; ++c)
+				{
+					m_mean(c) += (statistics[c] / count - m_mean(c)) * m_momentum;
+					m_variance(c) += (statistics[channels + c] / count - m_variance(c)) * m_momentum;
+				}
+			}
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type& layer)
+			{
+				serializer_impl_type::read(in, layer.m_gamma, layer.m_beta, layer.m_mean, layer.m_variance, layer.m_momentum, layer.m_epsilon);
+				layer.m_batchStatistics = false;
+				layer.m_accumulatedUpdate.clear();
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type& layer)
+			{
+				serializer_impl_type::write(out, layer.m_gamma, layer.m_beta, layer.m_mean, layer.m_variance, layer.m_momentum, layer.m_epsilon);
+			}
+		};
+
+	private:
+		static number_type unit()
+		{
+			return 1;
+		}
+
+		// Normalized value of the input with the statistics of the last batch.
+		number_type normalize(
+			const number_type value,
+			const size_t c) const
+		{
+			return (value - m_batchMean(c)) / std::sqrt(m_batchVariance(c) + m_epsilon);
+		}
+
+		void apply_transform()
+		{
+			const number_type* values = m_input.data();
+			number_type* result = m_output.data();
+
+			for (size_t i = 0; i < Metrics::data_size; ++i)
+			{
+				const size_t c = channel_of(i);
+				result[i] = values[i] * m_scale(c) + m_shift(c);
+			}
+		}
+
+		input m_input;
+
+		channel_type m_gamma;
+		channel_type m_beta;
+		channel_type m_mean;
+		channel_type m_variance;
+
+		channel_type m_scale;
+		channel_type m_shift;
+
+		channel_type m_gammaGradient;
+		channel_type m_betaGradient;
+		channel_type m_batchMean;
+		channel_type m_batchVariance;
+		bool m_batchStatistics;
+
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
+
+		number_type m_momentum;
+		number_type m_epsilon;
+	};
+
+	template <class Metrics, class Layout = layout::channels_first, class Number = float, class... Args>
+	batch_normalization<Metrics, Layout, Number> make_batch_normalization_layer(
+		Args&&... args)
+	{
+		typedef batch_normalization<Metrics, Layout, Number> _Ltype;
+		return (_Ltype(std::forward<Args>(args)...));
+	}
+
+namespace detail {
+
+	template <class Metrics, class Layout, class Number>
+	struct batch_processing<batch_normalization<Metrics, Layout, Number>>
+	{
+		typedef batch_normalization<Metrics, Layout, Number> layer_type;
+
+		static void process(
+			std::vector<layer_type*>& layers,
+			const std::vector<const typename layer_type::input*>& inputs,
+			std::vector<const typename layer_type::output*>& results)
+		{
+			layer_type::process_batch(layers, inputs, results);
+		}
+
+		static void compute_gradient(
+			std::vector<layer_type*>& layers,
+			const std::vector<const typename layer_type::output*>& gradients,
+			std::vector<const typename layer_type::input*>& results)
+		{
+			layer_type::compute_gradient_batch(layers, gradients, results);
+		}
+	};
+}
+
+	// Trains a network on batches with a copy of the network for every input of a batch. The
+	// copies process a batch one layer at a time, so that batch normalization layers normalize it
+	// with its own statistics. Gradients of the inputs are averaged, and the weights are updated
+	// once per batch. Batch normalization layers in network ensembles use their running statistics.
+	// The first copy is the network of the trainer, which processes single inputs, and the other
+	// copies follow its weights when it is read.
+	template <class Network>
+	class batch_trainer
+	{
+	public:
+		typedef typename batch_trainer<Network> this_type;
+		typedef typename Network network_type;
+
+		typedef typename Network::input input;
+		typedef typename Network::output output;
+
+		typedef typename Network::number_type number_type;
+
+		batch_trainer()
+			: m_networks()
+		{
+			m_networks.push_back(std::make_unique<Network>());
+		}
+
+		explicit batch_trainer(
+			const Network& network)
+			: batch_trainer()
+		{
+			std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+
+			Network::serializer::write(stream, network);
+			this_type::serializer::read(stream, *this);
+		}
+
+		Network& get_network()
+		{
+			return *m_networks.front();
+		}
+
+		const Network& get_network() const
+		{
+			return *m_networks.front();
+		}
+
+		const output& process(
+			const input& input)
+		{
+			return m_networks.front()->process(input);
+		}
+
+		template <class InputBatch, class OutputBatch, class Loss>
+		void train(
+			const InputBatch& inputs,
+			const OutputBatch& truth,
+			Loss& loss,
+			const number_type rate)
+		{
+			static_assert(detail::is_batch_of<InputBatch, typename input::metrics>::value, "Input batch does not match network input.");
+			static_assert(detail::is_batch_of<OutputBatch, typename output::metrics>::value, "Truth batch does not match network output.");
+			static_assert(InputBatch::metrics::dimension_size == OutputBatch::metrics::dimension_size, "Input and truth batch sizes do not match.");
+
+			const size_t size = InputBatch::metrics::dimension_size;
+			this->add_copies(size);
+
+			std::vector<Network*> copies(size);
+			std::vector<input> values(size);
+			std::vector<const input*> batch(size);
+
+			for (size_t k = 0; k < size; ++k)
+			{
+				copies[k] = m_networks[k].get();
+
+				detail::get_batch_item(inputs, k, values[k]);
+				batch[k] = &values[k];
+			}
+
+			std::vector<const output*> results(size);
+			Network::process_batch(copies, batch, results);
+
+			std::vector<output> gradients(size);
+			std::vector<const output*> batchGradients(size);
+
+			for (size_t k = 0; k < size; ++k)
+			{
+				output expected;
+				detail::get_batch_item(truth, k, expected);
+
+				loss.compute_gradient(*results[k], expected).transform(
+					gradients[k],
+					[](const number_type& value)
+					{
+						return value;
+					});
+
+				batchGradients[k] = &gradients[k];
+			}
+
+			std::vector<const input*> inputGradients(size);
+			Network::compute_gradient_batch(copies, batchGradients, inputGradients);
+
+			const number_type batchRate = -std::abs(rate) / static_cast<number_type>(size);
+
+			for (size_t k = 0; k < size; ++k)
+			{
+				copies[k]->accumulate_update(*copies.front(), batchRate);
+			}
+
+			for (size_t k = 1; k < m_networks.size(); ++k)
+			{
+				m_networks[k]->apply_update(*m_networks.front());
+			}
+
+			m_networks.front()->apply_update(*m_networks.front());
+		}
+
+		template <class InputBatch, class OutputBatch, class Loss>
+		void train(
+			const InputBatch& inputs,
+			const OutputBatch& truth,
+			Loss& loss,
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->train(inputs, truth, loss, rate);
+		}
+
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = Network::serializer::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& trainer)
+			{
+				Network::serializer::read(in, *trainer.m_networks.front());
+				trainer.synchronize(1);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& trainer)
+			{
+				Network::serializer::write(out, *trainer.m_networks.front());
+			}
+		};
+
+	private:
+		// Adds the copies for a batch of the given size with the weights of the first copy.
+		void add_copies(
+			const size_t size)
+		{
+			const size_t first = m_networks.size();
+			if (!(first < size))
+				return;
+
+			while (m_networks.size() < size)
+			{
+				m_networks.push_back(std::make_unique<Network>());
+			}
+
+			synchronize(first);
+		}
+
+		// Reads the weights of the first copy into the copies starting with the given one.
+		void synchronize(
+			const size_t first)
+		{
+			std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			Network::serializer::write(stream, *m_networks.front());
+
+			for (size_t copy = first; copy < m_networks.size(); ++copy)
+			{
+				stream.clear();
+				stream.seekg(0);
+
+				Network::serializer::read(stream, *m_networks[copy]);
+			}
+		}
+
+		std::vector<std::unique_ptr<Network>> m_networks;
+	};
+
+	template <class Network>
+	batch_trainer<Network> make_batch_trainer(
+		const Network& network)
+	{
+		return batch_trainer<Network>(network);
+	}
+
+namespace detail {
+
+	// Batch normalization that can follow the layer and be folded into its weights.
+	template <class Layer>
+	struct batch_normalization_of
+	{
+		typedef batch_normalization<
+			typename Layer::output::metrics,
+			typename output_layout<Layer>::type,
+			typename Layer::number_type> type;
+	};
+
+	template <class Layer>
+	struct can_fold_batch_normalization : public std::false_type
+	{
+	};
+
+	template <class InputMetrics, class OutputMetrics, class Storage>
+	struct can_fold_batch_normalization<fully_connected<InputMetrics, OutputMetrics, Storage>> : public std::true_type
+	{
+	};
+
+	template <class InputMetrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Layout, class Number>
+	struct can_fold_batch_normalization<convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number>> : public std::true_type
+	{
+	};
+
+	template <class Layer, class Next>
+	struct folds_batch_normalization
+	{
+		enum : bool {
+			value = can_fold_batch_normalization<Layer>::value
+				&& std::is_same<Next, typename batch_normalization_of<Layer>::type>::value
+		};
+	};
+
+	template <class Layer>
+	struct folded_layer
+	{
+		typedef Layer type;
+	};
+
+	// Removes the batch normalization layers that are folded, and maps the kept layers.
+	template <class Folded, class... Layers>
+	struct fold_layers;
+
+	template <class... Folded>
+	struct fold_layers<layer_list<Folded...>>
+	{
+		typedef network<Folded...> type;
+	};
+
+	template <class... Folded, class Layer>
+	struct fold_layers<layer_list<Folded...>, Layer>
+	{
+		typedef network<Folded..., typename folded_layer<Layer>::type> type;
+	};
+
+	template <class... Folded, class Layer, class Next, class... Layers>
+	struct fold_layers<layer_list<Folded...>, Layer, Next, Layers...>
+		: public std::conditional<
+			folds_batch_normalization<Layer, Next>::value,
+			fold_layers<layer_list<Folded..., typename folded_layer<Layer>::type>, Layers...>,
+			fold_layers<layer_list<Folded..., typename folded_layer<Layer>::type>, Next, Layers...>
+		>::type
+	{
+	};
+
+	template <class... Layers>
+	struct folded_layer<network<Layers...>>
+	{
+		typedef typename fold_layers<layer_list<>, Layers...>::type type;
+	};
+
+	// A checkpoint is serialized in the format of its network, so the network takes its place.
+	template <class Network>
+	struct folded_layer<checkpoint<Network>>
+	{
+		typedef typename folded_layer<Network>::type type;
+	};
+
+	// Appends a flag for every layer of the folded network in the order of visit, which is set
+	// when the layer absorbs the batch normalization that follows it.
+	template <class... Layers>
+	struct batch_normalization_folds
+	{
+		static void append(std::vector<bool>&)
+		{
+		}
+	};
+
+	template <class Layer, class Next>
+	struct layer_folds
+	{
+		static void append(std::vector<bool>& folds)
+		{
+			folds.push_back(folds_batch_normalization<Layer, Next>::value);
+		}
+	};
+
+	template <class Next, class... Layers>
+	struct layer_folds<network<Layers...>, Next>
+	{
+		static void append(std::vector<bool>& folds)
+		{
+			batch_normalization_folds<Layers...>::append(folds);
+		}
+	};
+
+	template <class Next, class Network>
+	struct layer_folds<checkpoint<Network>, Next>
+	{
+		static void append(std::vector<bool>& folds)
+		{
+			layer_folds<Network, Next>::append(folds);
+		}
+	};
+
+	template <class Layer>
+	struct batch_normalization_folds<Layer>
+	{
+		static void append(std::vector<bool>& folds)
+		{
+			layer_folds<Layer, void>::append(folds);
+		}
+	};
+
+	template <class Layer, class Next, class... Layers>
+	struct batch_normalization_folds<Layer, Next, Layers...>
+	{
+		static void append(std::vector<bool>& folds)
+		{
+			layer_folds<Layer, Next>::append(folds);
+
+			std::conditional<
+				folds_batch_normalization<Layer, Next>::value,
+				batch_normalization_folds<Layers...>,
+				batch_normalization_folds<Next, Layers...>
+			>::type::append(folds);
+		}
+	};
+
+	template <class InputMetrics, class OutputMetrics, class Storage, class Normalization>
+	void fold_normalization(
+		fully_connected<InputMetrics, OutputMetrics, Storage>& layer,
+		const Normalization& normalization)
+	{
+		typedef fully_connected<InputMetrics, OutputMetrics, Storage> layer_type;
+
+		typename Normalization::channel_type scale;
+		typename Normalization::channel_type shift;
+		normalization.get_transform(scale, shift);
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		serialization::write(stream, layer);
+
+		typename layer_type::stored_weights_type stored;
+		typename layer_type::weights_type weights;
+		typename layer_type::bias_type bias;
+		typename layer_type::number_type regularization = 0.0f;
+
+		layer_type::serializer_impl_type::read(stream, stored, bias, regularization);
+		assign_weights(stored, weights);
+
+		for (size_t j = 0; j < layer_type::reshaped_output::data_size; ++j)
+		{
+			const size_t c = Normalization::channel_of(j);
+
+			for (size_t i = 0; i < layer_type::reshaped_input::data_size; ++i)
+			{
+				weights(j, i) *= scale(c);
+			}
+
+			bias(j) = bias(j) * scale(c) + shift(c);
+		}
+
+		assign_weights(weights, stored);
+
+		std::stringstream folded(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		layer_type::serializer_impl_type::write(folded, stored, bias, regularization);
+		serialization::read(folded, layer);
+	}
+
+	// The channels of the normalization are the kernels of the convolution.
+	template <class InputMetrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation, class Layout, class Number, class Normalization>
+	void fold_normalization(
+		convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number>& layer,
+		const Normalization& normalization)
+	{
+		typedef typename convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation, Layout, Number>::impl impl;
+		typedef typename impl::weights_type weights_type;
+		typedef typename weights_type::serializer weights_serializer;
+
+		enum : size_t { kernel_size = impl::kernel_weights::data_size / Kernels };
+
+		typename Normalization::channel_type scale;
+		typename Normalization::channel_type shift;
+		normalization.get_transform(scale, shift);
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		serialization::write(stream, layer);
+
+		weights_type weights;
+		weights_serializer::read(stream, weights);
+
+		Number* kernels = weights.m_kernels.data();
+		for (size_t i = 0; i < impl::kernel_weights::data_size; ++i)
+		{
+			const size_t k = std::is_same<Layout, layout::channels_last>::value ? (i % Kernels) : (i / kernel_size);
+			kernels[i] *= scale(k);
+		}
+
+		for (size_t k = 0; k < Kernels; ++k)
+		{
+			weights.m_bias(k) = weights.m_bias(k) * scale(k) + shift(k);
+		}
+
+		std::stringstream folded(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		weights_serializer::write(folded, weights);
+		serialization::read(folded, layer);
+	}
+
+	// Reads the layers of a folded network from a serialized network with batch normalization,
+	// and folds every batch normalization into the layer before it.
+	class batch_normalization_folding
+	{
+	public:
+		batch_normalization_folding(
+			std::istream& in,
+			const std::vector<bool>& folds)
+			: m_in(in), m_folds(folds), m_layer(0)
+		{
+		}
+
+		template <class... Layers>
+		void operator()(
+			network<Layers...>& layer)
+		{
+			layer.visit(*this);
+		}
+
+		template <class Layer>
+		void operator()(
+			Layer& layer)
+		{
+			serialization::read(m_in, layer);
+
+			if (m_folds[m_layer++])
+			{
+				fold(layer, std::integral_constant<bool, can_fold_batch_normalization<Layer>::value>());
+			}
+		}
+
+	private:
+		template <class Layer>
+		void fold(
+			Layer& layer,
+			std::true_type)
+		{
+			typename batch_normalization_of<Layer>::type normalization;
+			serialization::read(m_in, normalization);
+
+			fold_normalization(layer, normalization);
+		}
+
+		template <class Layer>
+		void fold(
+			Layer&,
+			std::false_type)
+		{
+		}
+
+		std::istream& m_in;
+		const std::vector<bool>& m_folds;
+		size_t m_layer;
+	};
+}
+
+	// Converts a trained network for inference. Every batch normalization layer that follows
+	// a fully connected or convolution layer with the same output tensor is folded into the
+	// weights and bias of that layer, and removed from the network. Layers of network ensembles
+	// are not folded.
+	template <class... Layers>
+	typename detail::folded_layer<network<Layers...>>::type fold_batch_normalization(
+		const network<Layers...>& network)
+	{
+		typedef typename detail::folded_layer<neural_network::network<Layers...>>::type result_type;
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		serialization::write(stream, network);
+
+		std::vector<bool> folds;
+		detail::batch_normalization_folds<Layers...>::append(folds);
+
+		result_type result;
+		detail::batch_normalization_folding folding(stream, folds);
+		result.visit(folding);
+
+		return result;
+	}
+}
\ No newline at end of file
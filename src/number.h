@@ -0,0 +1,346 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define NEURAL_NET_F16C
+#endif
+
+#if defined(NEURAL_NET_F16C) || defined(__AVX2__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+#include "tensor.h"
+
+namespace neural_network {
+namespace algebra {
+
+namespace detail {
+
+	inline std::uint32_t float_bits(
+		const float value)
+	{
+		std::uint32_t result;
+		std::memcpy(std::addressof(result), std::addressof(value), sizeof(result));
+
+		return result;
+	}
+
+	inline float bits_float(
+		const std::uint32_t bits)
+	{
+		float result;
+		std::memcpy(std::addressof(result), std::addressof(bits), sizeof(result));
+
+		return result;
+	}
+
+	// Rounds to the nearest even half value. Values too large for half become infinity.
+	inline std::uint16_t float_to_half(
+		const float value)
+	{
+#if defined(NEURAL_NET_F16C)
+		return static_cast<std::uint16_t>(_mm_extract_epi16(_mm_cvtps_ph(_mm_set_ss(value), _MM_FROUND_TO_NEAREST_INT), 0));
+#else
+		std::uint32_t bits = float_bits(value);
+
+		const std::uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		std::uint32_t result;
+		if (bits >= (143u << 23))
+		{
+			result = (bits > (255u << 23)) ? 0x7e00u : 0x7c00u;
+		}
+		else if (bits < (113u << 23))
+		{
+			// Adding the magic value aligns the mantissa of a subnormal half with the lowest bits
+			// of the float, and the float addition rounds it to the nearest even.
+			const std::uint32_t magic = 126u << 23;
+			result = float_bits(bits_float(bits) + bits_float(magic)) - magic;
+		}
+		else
+		{
+			const std::uint32_t odd = (bits >> 13) & 1u;
+			result = (bits + (static_cast<std::uint32_t>(15 - 127) << 23) + 0xfffu + odd) >> 13;
+		}
+
+		return static_cast<std::uint16_t>(result | (sign >> 16));
+#endif
+	}
+
+	inline float half_to_float(
+		const std::uint16_t value)
+	{
+#if defined(NEURAL_NET_F16C)
+		return _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(value)));
+#else
+		const std::uint32_t exponent = 0x7c00u << 13;
+
+		std::uint32_t bits = static_cast<std::uint32_t>(value & 0x7fffu) << 13;
+		const std::uint32_t valueExponent = bits & exponent;
+
+		bits += static_cast<std::uint32_t>(127 - 15) << 23;
+
+		if (valueExponent == exponent)
+		{
+			bits += static_cast<std::uint32_t>(128 - 16) << 23;
+		}
+		else if (0 == valueExponent)
+		{
+			bits += 1u << 23;
+			bits = float_bits(bits_float(bits) - bits_float(113u << 23));
+		}
+
+		return bits_float(bits | (static_cast<std::uint32_t>(value & 0x8000u) << 16));
+#endif
+	}
+
+	// Rounds to the nearest even bfloat16 value and keeps NaN values quiet. Subnormal values are
+	// flushed to zero, as the AVX512-BF16 conversion does.
+	inline std::uint16_t float_to_bfloat16(
+		const float value)
+	{
+		const std::uint32_t bits = float_bits(value);
+
+		if ((bits & 0x7fffffffu) > 0x7f800000u)
+			return static_cast<std::uint16_t>((bits >> 16) | 0x40u);
+
+		if (0 == (bits & 0x7f800000u))
+			return static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+
+		return static_cast<std::uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+	}
+
+	inline float bfloat16_to_float(
+		const std::uint16_t value)
+	{
+		return bits_float(static_cast<std::uint32_t>(value) << 16);
+	}
+}
+
+	// 16-bit IEEE 754 number that stores a float value with an 11-bit significand.
+	class half
+	{
+	public:
+		half()
+			: m_bits(0)
+		{
+		}
+
+		half(const float value)
+			: m_bits(detail::float_to_half(value))
+		{
+		}
+
+		operator float() const
+		{
+			return detail::half_to_float(m_bits);
+		}
+
+		std::uint16_t bits() const
+		{
+			return m_bits;
+		}
+
+		static half from_bits(
+			const std::uint16_t bits)
+		{
+			half result;
+			result.m_bits = bits;
+
+			return result;
+		}
+
+	private:
+		std::uint16_t m_bits;
+	};
+
+	// 16-bit number with the exponent range of float and an 8-bit significand.
+	class bfloat16
+	{
+	public:
+		bfloat16()
+			: m_bits(0)
+		{
+		}
+
+		bfloat16(const float value)
+			: m_bits(detail::float_to_bfloat16(value))
+		{
+		}
+
+		operator float() const
+		{
+			return detail::bfloat16_to_float(m_bits);
+		}
+
+		std::uint16_t bits() const
+		{
+			return m_bits;
+		}
+
+		static bfloat16 from_bits(
+			const std::uint16_t bits)
+		{
+			bfloat16 result;
+			result.m_bits = bits;
+
+			return result;
+		}
+
+	private:
+		std::uint16_t m_bits;
+	};
+
+	static_assert(sizeof(half) == sizeof(std::uint16_t), "Half must be stored in 16 bits.");
+	static_assert(sizeof(bfloat16) == sizeof(std::uint16_t), "Bfloat16 must be stored in 16 bits.");
+
+namespace detail {
+
+	template <class From, class To>
+	void convert(
+		const From* source,
+		To* destination,
+		const size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			destination[i] = static_cast<To>(source[i]);
+		}
+	}
+
+	template <class Number>
+	void convert(
+		const Number* source,
+		Number* destination,
+		const size_t size)
+	{
+		std::copy(source, source + size, destination);
+	}
+
+	inline void convert(
+		const float* source,
+		half* destination,
+		const size_t size)
+	{
+		size_t i = 0;
+
+#if defined(NEURAL_NET_F16C)
+		for (; i + 8 <= size; i += 8)
+		{
+			_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(destination + i),
+				_mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+		}
+#endif
+
+		for (; i < size; ++i)
+		{
+			destination[i] = half(source[i]);
+		}
+	}
+
+	inline void convert(
+		const half* source,
+		float* destination,
+		const size_t size)
+	{
+		size_t i = 0;
+
+#if defined(NEURAL_NET_F16C)
+		for (; i + 8 <= size; i += 8)
+		{
+			_mm256_storeu_ps(
+				destination + i,
+				_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i))));
+		}
+#endif
+
+		for (; i < size; ++i)
+		{
+			destination[i] = source[i];
+		}
+	}
+
+	inline void convert(
+		const float* source,
+		bfloat16* destination,
+		const size_t size)
+	{
+		size_t i = 0;
+
+#if defined(__AVX512BF16__) && defined(__AVX512VL__)
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m128bh values = _mm256_cvtneps_pbh(_mm256_loadu_ps(source + i));
+			std::memcpy(destination + i, std::addressof(values), sizeof(values));
+		}
+#endif
+
+		for (; i < size; ++i)
+		{
+			destination[i] = bfloat16(source[i]);
+		}
+	}
+
+	inline void convert(
+		const bfloat16* source,
+		float* destination,
+		const size_t size)
+	{
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= size; i += 8)
+		{
+			const __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+			_mm256_storeu_ps(destination + i, _mm256_castsi256_ps(_mm256_slli_epi32(values, 16)));
+		}
+#endif
+
+		for (; i < size; ++i)
+		{
+			destination[i] = source[i];
+		}
+	}
+}
+
+	// Converts the values of a tensor to another number type. Conversion to half and bfloat16
+	// rounds to the nearest even value, conversion between float and double uses static_cast.
+	template <class From, class To, const size_t... Metrics>
+	void convert(
+		const basic_tensor<From, Metrics...>& source,
+		basic_tensor<To, Metrics...>& destination)
+	{
+		detail::convert(source.data(), destination.data(), basic_tensor<From, Metrics...>::data_size);
+	}
+}
+}
\ No newline at end of file
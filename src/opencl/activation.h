@@ -30,6 +30,60 @@ namespace neural_network {
 namespace opencl {
 namespace detail {
 
+	struct relu_epilogue
+	{
+		static inline std::string get_name()
+		{
+			return "relu";
+		}
+
+		static inline std::string get_activation_expression()
+		{
+			return "(((x) > 0.0f) ? (x) : 0.0f)";
+		}
+
+		static inline std::string get_gradient_expression()
+		{
+			return "(((f) > 0.0f) ? (g) : 0.0f)";
+		}
+	};
+
+	struct logistic_epilogue
+	{
+		static inline std::string get_name()
+		{
+			return "logistic";
+		}
+
+		static inline std::string get_activation_expression()
+		{
+			return "(((x) > 0.0f) ? (1.0f / (1.0f + exp(-(x)))) : (exp(x) / (1.0f + exp(x))))";
+		}
+
+		static inline std::string get_gradient_expression()
+		{
+			return "((g) * (f) * (1.0f - (f)))";
+		}
+	};
+
+	struct tanh_epilogue
+	{
+		static inline std::string get_name()
+		{
+			return "tanh";
+		}
+
+		static inline std::string get_activation_expression()
+		{
+			return "tanh(x)";
+		}
+
+		static inline std::string get_gradient_expression()
+		{
+			return "((g) * (1.0f - (f) * (f)))";
+		}
+	};
+
 	struct generic_activation
 	{
 		template <typename Input, typename Output>
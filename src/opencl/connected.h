@@ -30,6 +30,80 @@ namespace neural_network {
 namespace opencl {
 namespace detail {
 
+	// Kernels of the fully connected layer for the number type it stores the weights with. The
+	// kernels read half and bfloat16 weights as 16-bit values, and compute in float.
+	template <class Storage>
+	struct fully_connected_weights
+	{
+		static std::string get_kernel_name()
+		{
+			return layer_kernels::get_fully_connected_kernel_name();
+		}
+
+		static std::string get_gradient_kernel_name()
+		{
+			return layer_kernels::get_fully_connected_gradient_kernel_name();
+		}
+
+		template <typename Weights>
+		static ::boost::compute::mapped_view<float> get_device_view(
+			const typename Weights& weights,
+			const ::boost::compute::context& context)
+		{
+			return weights.get_device_view(context);
+		}
+	};
+
+	template <>
+	struct fully_connected_weights<algebra::half>
+	{
+		static std::string get_kernel_name()
+		{
+			return layer_kernels::get_half_fully_connected_kernel_name();
+		}
+
+		static std::string get_gradient_kernel_name()
+		{
+			return layer_kernels::get_half_fully_connected_gradient_kernel_name();
+		}
+
+		template <typename Weights>
+		static ::boost::compute::mapped_view<std::uint16_t> get_device_view(
+			const typename Weights& weights,
+			const ::boost::compute::context& context)
+		{
+			return ::boost::compute::mapped_view<std::uint16_t>(
+				reinterpret_cast<const std::uint16_t*>(weights.data()),
+				Weights::data_size,
+				context);
+		}
+	};
+
+	template <>
+	struct fully_connected_weights<algebra::bfloat16>
+	{
+		static std::string get_kernel_name()
+		{
+			return layer_kernels::get_bfloat16_fully_connected_kernel_name();
+		}
+
+		static std::string get_gradient_kernel_name()
+		{
+			return layer_kernels::get_bfloat16_fully_connected_gradient_kernel_name();
+		}
+
+		template <typename Weights>
+		static ::boost::compute::mapped_view<std::uint16_t> get_device_view(
+			const typename Weights& weights,
+			const ::boost::compute::context& context)
+		{
+			return ::boost::compute::mapped_view<std::uint16_t>(
+				reinterpret_cast<const std::uint16_t*>(weights.data()),
+				Weights::data_size,
+				context);
+		}
+	};
+
 	struct fully_connected
 	{
 		template <typename Input, typename Output, typename Weights>
@@ -44,7 +118,7 @@ namespace detail {
 			::boost::compute::command_queue& queue)
 		{
 			auto inputView = input.get_device_view(context);
-			auto weightsView = weights.get_device_view(context);
+			auto weightsView = fully_connected_weights<typename Weights::number_type>::get_device_view(weights, context);
 			auto biasView = bias.get_device_view(context);
 			auto outputView = output.get_device_view(context);
 
@@ -60,13 +134,13 @@ namespace detail {
 				queue);
 		}
 
-		template <typename Input, typename Output, typename Weights>
+		template <typename Input, typename Output, typename Weights, typename WeightsGradient>
 		static void compute_gradient(
 			const typename Input& input,
 			const typename Weights& weights,
 			const typename Output& gradient,
 			typename Input& resultGradient,
-			typename Weights& weightsGradient,
+			typename WeightsGradient& weightsGradient,
 			typename Output& biasGradient,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
@@ -74,7 +148,7 @@ namespace detail {
 			::boost::compute::command_queue& queue)
 		{
 			auto inputView = input.get_device_view(context);
-			auto weightsView = weights.get_device_view(context);
+			auto weightsView = fully_connected_weights<typename Weights::number_type>::get_device_view(weights, context);
 			auto gradientView = gradient.get_device_view(context);
 			auto resultGradientView = resultGradient.get_device_view(context);
 			auto weightsGradientView = weightsGradient.get_device_view(context);
@@ -58,6 +58,8 @@ namespace detail {
 				weights.size<1>(),
 				result.size<1>(),
 				strideSizeX,
+				Input::data_size,
+				1,
 				program,
 				kernelName,
 				queue);
@@ -94,6 +96,8 @@ namespace detail {
 				result.size<2>(),
 				strideSizeX,
 				strideSizeY,
+				Input::data_size,
+				1,
 				program,
 				kernelName,
 				queue);
@@ -135,11 +139,325 @@ namespace detail {
 				strideSizeX,
 				strideSizeY,
 				strideSizeZ,
+				Input::data_size,
+				1,
 				program,
 				kernelName,
 				queue);
 		}
 
+		template < typename BatchInput, typename BatchOutput, typename Weights, typename Bias>
+		static void process_batch_1d(
+			const typename BatchInput& input,
+			const typename Weights& weights,
+			const typename Bias& bias,
+			typename BatchOutput& result,
+			const size_t strideSizeX,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto biasView = bias.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_1d_convolution_kernel(
+				inputView,
+				weightsView,
+				biasView,
+				resultView,
+				weights.size<0>(),
+				weights.size<1>(),
+				result.size<2>(),
+				strideSizeX,
+				input.size<1>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput, typename Weights, typename Bias>
+		static void process_batch_2d(
+			const typename BatchInput& input,
+			const typename Weights& weights,
+			const typename Bias& bias,
+			typename BatchOutput& result,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto biasView = bias.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_2d_convolution_kernel(
+				inputView,
+				weightsView,
+				biasView,
+				resultView,
+				input.size<2>(),
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				result.size<2>(),
+				result.size<3>(),
+				strideSizeX,
+				strideSizeY,
+				input.size<1>() * input.size<2>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput, typename Weights, typename Bias>
+		static void process_batch_3d(
+			const typename BatchInput& input,
+			const typename Weights& weights,
+			const typename Bias& bias,
+			typename BatchOutput& result,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto biasView = bias.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_3d_convolution_kernel(
+				inputView,
+				weightsView,
+				biasView,
+				resultView,
+				input.size<2>(),
+				input.size<3>(),
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				weights.size<3>(),
+				result.size<2>(),
+				result.size<3>(),
+				result.size<4>(),
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				input.size<1>() * input.size<2>() * input.size<3>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output, typename Weights, typename Bias>
+		static void compute_gradient_1d(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Output& gradient,
+			typename Input& result,
+			typename Weights& weightsGradient,
+			typename Bias& biasGradient,
+			const size_t inputSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& gradientKernelName,
+			const std::string& weightsGradientKernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			auto weightsGradientView = weightsGradient.get_device_view(context);
+			auto biasGradientView = biasGradient.get_device_view(context);
+
+			layer_kernels::execute_1d_convolution_gradient_kernel(
+				gradientView,
+				weightsView,
+				resultView,
+				inputSizeX,
+				weights.size<0>(),
+				weights.size<1>(),
+				stridesX,
+				strideSizeX,
+				batchSize,
+				program,
+				gradientKernelName,
+				queue);
+
+			layer_kernels::execute_1d_convolution_weights_gradient_kernel(
+				inputView,
+				gradientView,
+				weightsGradientView,
+				biasGradientView,
+				inputSizeX,
+				weights.size<0>(),
+				weights.size<1>(),
+				stridesX,
+				strideSizeX,
+				batchSize,
+				program,
+				weightsGradientKernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output, typename Weights, typename Bias>
+		static void compute_gradient_2d(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Output& gradient,
+			typename Input& result,
+			typename Weights& weightsGradient,
+			typename Bias& biasGradient,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& gradientKernelName,
+			const std::string& weightsGradientKernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			auto weightsGradientView = weightsGradient.get_device_view(context);
+			auto biasGradientView = biasGradient.get_device_view(context);
+
+			layer_kernels::execute_2d_convolution_gradient_kernel(
+				gradientView,
+				weightsView,
+				resultView,
+				inputSizeX,
+				inputSizeY,
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				stridesX,
+				stridesY,
+				strideSizeX,
+				strideSizeY,
+				batchSize,
+				program,
+				gradientKernelName,
+				queue);
+
+			layer_kernels::execute_2d_convolution_weights_gradient_kernel(
+				inputView,
+				gradientView,
+				weightsGradientView,
+				biasGradientView,
+				inputSizeX,
+				inputSizeY,
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				stridesX,
+				stridesY,
+				strideSizeX,
+				strideSizeY,
+				batchSize,
+				program,
+				weightsGradientKernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output, typename Weights, typename Bias>
+		static void compute_gradient_3d(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Output& gradient,
+			typename Input& result,
+			typename Weights& weightsGradient,
+			typename Bias& biasGradient,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& gradientKernelName,
+			const std::string& weightsGradientKernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			auto weightsGradientView = weightsGradient.get_device_view(context);
+			auto biasGradientView = biasGradient.get_device_view(context);
+
+			layer_kernels::execute_3d_convolution_gradient_kernel(
+				gradientView,
+				weightsView,
+				resultView,
+				inputSizeX,
+				inputSizeY,
+				inputSizeZ,
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				weights.size<3>(),
+				stridesX,
+				stridesY,
+				stridesZ,
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				batchSize,
+				program,
+				gradientKernelName,
+				queue);
+
+			layer_kernels::execute_3d_convolution_weights_gradient_kernel(
+				inputView,
+				gradientView,
+				weightsGradientView,
+				biasGradientView,
+				inputSizeX,
+				inputSizeY,
+				inputSizeZ,
+				weights.size<0>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				weights.size<3>(),
+				stridesX,
+				stridesY,
+				stridesZ,
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				batchSize,
+				program,
+				weightsGradientKernelName,
+				queue);
+		}
+
 		template <typename Weights, typename Bias>
 		static void update_weights(
 			const typename Weights& weightsGradient,
@@ -0,0 +1,71 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "layer_kernels.h"
+
+namespace neural_network {
+namespace opencl {
+
+	// Creates a command queue with its own context for every device in the list.
+	inline std::vector<::boost::compute::command_queue> make_command_queues(
+		const std::vector<::boost::compute::device>& devices)
+	{
+		std::vector<::boost::compute::command_queue> queues;
+		queues.reserve(devices.size());
+
+		for (const auto& device : devices)
+		{
+			::boost::compute::context context(device);
+			queues.push_back(::boost::compute::command_queue(context, device));
+		}
+
+		return queues;
+	}
+
+	// Partitions the device into sub-devices with the specified number of compute units
+	// each, and creates a command queue for every sub-device in a single shared context.
+	inline std::vector<::boost::compute::command_queue> make_sub_device_queues(
+		const ::boost::compute::device& device,
+		const size_t computeUnits)
+	{
+		auto subDevices = device.partition_equally(computeUnits);
+		::boost::compute::context context(subDevices);
+
+		std::vector<::boost::compute::command_queue> queues;
+		queues.reserve(subDevices.size());
+
+		for (const auto& subDevice : subDevices)
+		{
+			queues.push_back(::boost::compute::command_queue(context, subDevice));
+		}
+
+		return queues;
+	}
+
+}
+}
@@ -0,0 +1,64 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "layer_kernels.h"
+
+namespace neural_network {
+namespace opencl {
+namespace detail {
+
+	struct kernel_fusion
+	{
+		template <class Epilogue>
+		static ::boost::compute::program make_program(
+			const ::boost::compute::context& context)
+		{
+			std::lock_guard<std::mutex> lock(layer_kernels::get_program_cache_mutex());
+
+			auto cache = ::boost::compute::program_cache::get_global_cache(context);
+			std::string cacheKey = "neural_net_fused_kernels_" + Epilogue::get_name();
+			::boost::optional<::boost::compute::program> program = cache->get(cacheKey);
+
+			if (!program)
+			{
+				std::string source =
+					layer_kernels::get_epilogue_source(
+						Epilogue::get_activation_expression(),
+						Epilogue::get_gradient_expression())
+					+ layer_kernels::get_fusable_kernels_source();
+
+				program = ::boost::compute::program::build_with_source(source, context, layer_kernels::get_build_options());
+
+				cache->insert(cacheKey, *program);
+			}
+
+			return *program;
+		}
+	};
+
+}
+}
+}
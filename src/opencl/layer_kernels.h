@@ -33,6 +33,11 @@ SOFTWARE.
 
 #pragma warning (pop)
 
+#include <cstdint>
+#include <mutex>
+
+#include "profiling.h"
+
 namespace neural_network {
 namespace opencl {
 namespace detail {
@@ -52,9 +57,62 @@ namespace detail {
 			return ((size + block_size - 1) / block_size);
 		}
 
+		static std::string get_epilogue_source(
+			const std::string& activation,
+			const std::string& gradient)
+		{
+			std::stringstream source;
+			source
+				<< "#define NEURAL_NET_EPILOGUE(x) " << activation << std::endl
+				<< "#define NEURAL_NET_EPILOGUE_GRADIENT(f, g) " << gradient << std::endl;
+
+			return source.str();
+		}
+
+		static std::string get_argmax_source(
+			const std::string& indexType)
+		{
+			std::stringstream source;
+			source
+				<< "#undef NEURAL_NET_ARGMAX_TYPE" << std::endl
+				<< "#undef NEURAL_NET_ARGMAX_KERNEL" << std::endl
+				<< "#define NEURAL_NET_ARGMAX_TYPE " << indexType << std::endl
+				<< "#define NEURAL_NET_ARGMAX_KERNEL(name) name##_" << indexType << std::endl;
+
+			return source.str();
+		}
+
+		static inline std::string get_argmax_type_name(std::uint8_t)
+		{
+			return "uchar";
+		}
+
+		static inline std::string get_argmax_type_name(std::uint16_t)
+		{
+			return "ushort";
+		}
+
+		static std::string get_build_options()
+		{
+			std::stringstream options;
+			options << "-DBLOCK_SIZE=" << block_size;
+
+			return options.str();
+		}
+
+		// Program cache is not thread-safe, while ensemble members may initialize
+		// their kernels concurrently when they run on different command queues.
+		static std::mutex& get_program_cache_mutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
 		static ::boost::compute::program make_program(
 			const ::boost::compute::context& context)
 		{
+			std::lock_guard<std::mutex> lock(get_program_cache_mutex());
+
 			auto cache = ::boost::compute::program_cache::get_global_cache(context);
 			std::string cacheKey = "neural_net_layer_kernels";
 			::boost::optional<::boost::compute::program> program = cache->get(cacheKey);
@@ -186,29 +244,42 @@ namespace detail {
 						}
 					}
 
-					__kernel void neural_net_fully_connected_kernel(
+					__kernel void neural_net_fully_connected_gradient_kernel(
 						__global const float * vIn,
 						__global const float * mWeights,
-						__global const float * vBias,
+						__global const float * vGradient,
 						__global float * vResult,
+						__global float * mWeightsGradient,
+						__global float * vBiasGradient,
 						int rows,
 						int cols)
 					{
-						int row = get_global_id(0);
-						int off = row * cols;
+						int col = get_global_id(0);
+						int off = col;
 
 						float sum = 0.0f;
-						for (int col = 0; col < cols; ++col)
+						float inVal = vIn[col];
+
+						for (int row = 0; row < rows; ++row)
 						{
-							sum += mWeights[off + col] * vIn[col];
+							float gVal = vGradient[row];
+
+							sum += mWeights[off] * gVal;
+							mWeightsGradient[off] = inVal * gVal;
+							off += cols;
+
+							if (col == 0)
+							{
+								vBiasGradient[row] = gVal;
+							}
 						}
 
-						vResult[row] = sum + vBias[row];
+						vResult[col] = sum;
 					}
 
-					__kernel void neural_net_fully_connected_gradient_kernel(
+					__kernel void neural_net_half_fully_connected_gradient_kernel(
 						__global const float * vIn,
-						__global const float * mWeights,
+						__global const half * mWeights,
 						__global const float * vGradient,
 						__global float * vResult,
 						__global float * mWeightsGradient,
@@ -226,7 +297,7 @@ namespace detail {
 						{
 							float gVal = vGradient[row];
 
-							sum += mWeights[off] * gVal;
+							sum += vload_half(off, mWeights) * gVal;
 							mWeightsGradient[off] = inVal * gVal;
 							off += cols;
 
@@ -239,30 +310,44 @@ namespace detail {
 						vResult[col] = sum;
 					}
 
-					__kernel void neural_net_update_weights_kernel(
-						__global const float * gradient,
-						__global float * weights,
-						float rate,
-						float regularization,
-						int length)
+					__kernel void neural_net_bfloat16_fully_connected_gradient_kernel(
+						__global const float * vIn,
+						__global const ushort * mWeights,
+						__global const float * vGradient,
+						__global float * vResult,
+						__global float * mWeightsGradient,
+						__global float * vBiasGradient,
+						int rows,
+						int cols)
 					{
-						int pos = get_global_id(0) * BLOCK_SIZE;
-						int end = pos + BLOCK_SIZE;
-						if (length < end)
-						{
-							end = length;
-						}
+						int col = get_global_id(0);
+						int off = col;
 
-						for (; pos < end; ++pos)
+						float sum = 0.0f;
+						float inVal = vIn[col];
+
+						for (int row = 0; row < rows; ++row)
 						{
-							weights[pos] += (gradient[pos] + regularization * weights[pos]) * rate;
+							float gVal = vGradient[row];
+
+							sum += as_float((uint)mWeights[off] << 16) * gVal;
+							mWeightsGradient[off] = inVal * gVal;
+							off += cols;
+
+							if (col == 0)
+							{
+								vBiasGradient[row] = gVal;
+							}
 						}
+
+						vResult[col] = sum;
 					}
 
-					__kernel void neural_net_squared_error_loss_gradient_kernel(
-						__global const float * vResult,
-						__global const float * vTruth,
-						__global float * vGradient,
+					__kernel void neural_net_update_weights_kernel(
+						__global const float * gradient,
+						__global float * weights,
+						float rate,
+						float regularization,
 						int length)
 					{
 						int pos = get_global_id(0) * BLOCK_SIZE;
@@ -274,725 +359,2960 @@ namespace detail {
 
 						for (; pos < end; ++pos)
 						{
-							vGradient[pos] = vResult[pos] - vTruth[pos];
+							weights[pos] += (gradient[pos] + regularization * weights[pos]) * rate;
 						}
 					}
 
-					__kernel void neural_net_1d_convolution_kernel(
+					__kernel void neural_net_1d_max_pooling_gradient_kernel(
 						__global const float * vInput,
-						__global const float * mKernels,
-						__global const float * vBias,
+						__global const float * vGradient,
 						__global float * vResult,
-						int kernelSizeX,
-						int nStridesX,
-						int strideSizeX)
+						int inputSizeX,
+						int coreSizeX,
+						int strideSizeX,
+						int nStridesX)
 					{
-						int iKernel = get_global_id(0);
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
 
-						int resultBase = iKernel * nStridesX;
-						int kernelBase = iKernel * kernelSizeX;
+						vInput += iBatch * inputSizeX;
+						vGradient += iBatch * nStridesX;
 
-						for (int strideX = 0; strideX < nStridesX; ++strideX)
-						{
-							float sum = 0.0f;
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+
+						float sum = 0.0f;
 
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
 							int baseX = strideX * strideSizeX;
 
-							for (int x = 0; x < kernelSizeX; ++x)
+							float max = vInput[baseX];
+							int maxX = baseX;
+
+							for (int x = 1; x < coreSizeX; ++x)
 							{
-								sum += mKernels[kernelBase + x] * vInput[baseX + x];
+								float e = vInput[baseX + x];
+								if (max < e)
+								{
+									max = e;
+									maxX = baseX + x;
+								}
 							}
 
-							vResult[resultBase + strideX] = sum + vBias[iKernel];
+							if (maxX == posX)
+							{
+								sum += vGradient[strideX];
+							}
 						}
+
+						vResult[get_global_id(0)] = sum;
 					}
 
-					__kernel void neural_net_2d_convolution_kernel(
+					__kernel void neural_net_2d_max_pooling_gradient_kernel(
 						__global const float * vInput,
-						__global const float * mKernels,
-						__global const float * vBias,
+						__global const float * vGradient,
 						__global float * vResult,
-						int inputSizeY,
-						int kernelSizeX,
-						int kernelSizeY,
-						int nStridesX,
-						int nStridesY,
+						int inputSizeX,
+						int coreSizeX,
+						int coreSizeY,
 						int strideSizeX,
-						int strideSizeY)
+						int strideSizeY,
+						int nStridesX)
 					{
-						int iKernel = get_global_id(0);
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
+						int posY = get_global_id(1);
 
-						int resultBase = iKernel * nStridesX * nStridesY;
-						int kernelBase = iKernel * kernelSizeX * kernelSizeY;
+						int inputSizeY = get_global_size(1);
+						int nStridesY = ((inputSizeY - coreSizeY) / strideSizeY) + 1;
 
-						for (int strideX = 0; strideX < nStridesX; ++strideX)
-						{
-							int resultBaseY = resultBase + (strideX * nStridesY);
+						vInput += iBatch * inputSizeX * inputSizeY;
+						vGradient += iBatch * nStridesX * nStridesY;
 
-							for (int strideY = 0; strideY < nStridesY; ++strideY)
-							{
-								float sum = 0.0f;
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < coreSizeY) ? 0 : ((posY - coreSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+
+						int pos = (posX * inputSizeY) + posY;
+
+						float sum = 0.0f;
 
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							for (int strideY = firstY; strideY <= lastY; ++strideY)
+							{
 								int baseX = strideX * strideSizeX;
 								int baseY = strideY * strideSizeY;
 
-								for (int x = 0; x < kernelSizeX; ++x)
+								int maxPos = baseX * inputSizeY + baseY;
+								float max = vInput[maxPos];
+
+								for (int x = 0; x < coreSizeX; ++x)
 								{
-									int kernelBaseY = kernelBase + (x * kernelSizeY);
-									int inputBaseY = ((baseX + x) * inputSizeY) + baseY;
+									int inputBaseY = (baseX + x) * inputSizeY + baseY;
 
-									for (int y = 0; y < kernelSizeY; ++y)
+									for (int y = 0; y < coreSizeY; ++y)
 									{
-										sum += mKernels[kernelBaseY + y] * vInput[inputBaseY + y];
+										int inputY = inputBaseY + y;
+										float e = vInput[inputY];
+										if (max < e)
+										{
+											max = e;
+											maxPos = inputY;
+										}
 									}
 								}
 
-								vResult[resultBaseY + strideY] = sum + vBias[iKernel];
+								if (maxPos == pos)
+								{
+									sum += vGradient[(strideX * nStridesY) + strideY];
+								}
 							}
 						}
+
+						vResult[(get_global_id(0) * inputSizeY) + posY] = sum;
 					}
 
-					__kernel void neural_net_3d_convolution_kernel(
+					__kernel void neural_net_3d_max_pooling_gradient_kernel(
 						__global const float * vInput,
-						__global const float * mKernels,
-						__global const float * vBias,
+						__global const float * vGradient,
 						__global float * vResult,
-						int inputSizeY,
-						int inputSizeZ,
-						int kernelSizeX,
-						int kernelSizeY,
-						int kernelSizeZ,
-						int nStridesX,
-						int nStridesY,
-						int nStridesZ,
+						int inputSizeX,
+						int coreSizeX,
+						int coreSizeY,
+						int coreSizeZ,
 						int strideSizeX,
 						int strideSizeY,
-						int strideSizeZ)
+						int strideSizeZ,
+						int nStridesX)
 					{
-						int iKernel = get_global_id(0);
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
+						int posY = get_global_id(1);
+						int posZ = get_global_id(2);
 
-						int resultBase = iKernel * nStridesX * nStridesY * nStridesZ;
-						int kernelBase = iKernel * kernelSizeX * kernelSizeY * kernelSizeZ;
+						int inputSizeY = get_global_size(1);
+						int inputSizeZ = get_global_size(2);
+						int nStridesY = ((inputSizeY - coreSizeY) / strideSizeY) + 1;
+						int nStridesZ = ((inputSizeZ - coreSizeZ) / strideSizeZ) + 1;
 
-						for (int strideX = 0; strideX < nStridesX; ++strideX)
-						{
-							int resultBaseY = resultBase + (strideX * nStridesY * nStridesZ);
+						vInput += iBatch * inputSizeX * inputSizeY * inputSizeZ;
+						vGradient += iBatch * nStridesX * nStridesY * nStridesZ;
 
-							for (int strideY = 0; strideY < nStridesY; ++strideY)
-							{
-								int resultBaseZ = resultBaseY + (strideY * nStridesZ);
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < coreSizeY) ? 0 : ((posY - coreSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+						int firstZ = (posZ < coreSizeZ) ? 0 : ((posZ - coreSizeZ) / strideSizeZ) + 1;
+						int lastZ = min(posZ / strideSizeZ, nStridesZ - 1);
 
-								for (int strideZ = 0; strideZ < nStridesZ; ++strideZ)
-								{
-									float sum = 0.0f;
+						int pos = (((posX * inputSizeY) + posY) * inputSizeZ) + posZ;
+
+						float sum = 0.0f;
 
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							for (int strideY = firstY; strideY <= lastY; ++strideY)
+							{
+								for (int strideZ = firstZ; strideZ <= lastZ; ++strideZ)
+								{
 									int baseX = strideX * strideSizeX;
 									int baseY = strideY * strideSizeY;
 									int baseZ = strideZ * strideSizeZ;
 
-									for (int x = 0; x < kernelSizeX; ++x)
+									int maxPos = (baseX * inputSizeY + baseY) * inputSizeZ + baseZ;
+									float max = vInput[maxPos];
+
+									for (int x = 0; x < coreSizeX; ++x)
 									{
-										int kernelBaseY = kernelBase + (x * kernelSizeY * kernelSizeZ);
-										int inputBaseY = (((baseX + x) * inputSizeY) + baseY) * inputSizeZ;
+										int inputBaseY = ((baseX + x) * inputSizeY + baseY) * inputSizeZ;
 
-										for (int y = 0; y < kernelSizeY; ++y)
+										for (int y = 0; y < coreSizeY; ++y)
 										{
-											int kernelBaseZ = kernelBaseY + (y * kernelSizeZ);
 											int inputBaseZ = inputBaseY + (y * inputSizeZ) + baseZ;
 
-											for (int z = 0; z < kernelSizeZ; ++z)
+											for (int z = 0; z < coreSizeZ; ++z)
 											{
-												sum += mKernels[kernelBaseZ + z] * vInput[inputBaseZ + z];
+												int inputZ = inputBaseZ + z;
+												float e = vInput[inputZ];
+												if (max < e)
+												{
+													max = e;
+													maxPos = inputZ;
+												}
 											}
 										}
 									}
 
-									vResult[resultBaseZ + strideZ] = sum + vBias[iKernel];
+									if (maxPos == pos)
+									{
+										sum += vGradient[(((strideX * nStridesY) + strideY) * nStridesZ) + strideZ];
+									}
 								}
 							}
 						}
+
+						vResult[(((get_global_id(0) * inputSizeY) + posY) * inputSizeZ) + posZ] = sum;
 					}
 
-					__kernel void neural_net_1d_max_pooling_kernel(
-						__global const float * vInput,
+					__kernel void neural_net_1d_convolution_gradient_kernel(
+						__global const float * vGradient,
+						__global const float * mKernels,
 						__global float * vResult,
-						__global float * vMask,
-						int coreSizeX,
+						int inputSizeX,
+						int kernels,
+						int kernelSizeX,
+						int nStridesX,
 						int strideSizeX)
 					{
-						int strideX = get_global_id(0);
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
 
-						int baseX = strideX * strideSizeX;
+						vGradient += iBatch * kernels * nStridesX;
 
-						float max = vInput[baseX];
-						int maxX = baseX;
+						int firstX = (posX < kernelSizeX) ? 0 : ((posX - kernelSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
 
-						for (int x = 1; x < coreSizeX; ++x)
+						float sum = 0.0f;
+
+						for (int iKernel = 0; iKernel < kernels; ++iKernel)
 						{
-							int curX = baseX + x;
-							float e = vInput[curX];
-							if (max < e)
+							int gradientBase = iKernel * nStridesX;
+							int kernelBase = iKernel * kernelSizeX;
+
+							for (int strideX = firstX; strideX <= lastX; ++strideX)
 							{
-								max = e;
-								maxX = curX;
+								sum += vGradient[gradientBase + strideX] * mKernels[kernelBase + posX - (strideX * strideSizeX)];
 							}
 						}
 
-						vResult[strideX] = max;
-						vMask[maxX] = 1.0f;
+						vResult[get_global_id(0)] = sum;
 					}
 
-					__kernel void neural_net_2d_max_pooling_kernel(
-						__global const float * vInput,
+					__kernel void neural_net_2d_convolution_gradient_kernel(
+						__global const float * vGradient,
+						__global const float * mKernels,
 						__global float * vResult,
-						__global float * vMask,
-						int inputSizeY,
-						int coreSizeX,
-						int coreSizeY,
+						int inputSizeX,
+						int kernels,
+						int kernelSizeX,
+						int kernelSizeY,
+						int nStridesX,
+						int nStridesY,
 						int strideSizeX,
 						int strideSizeY)
 					{
-						int strideX = get_global_id(0);
-						int strideY = get_global_id(1);
-						
-						int baseX = strideX * strideSizeX;
-						int baseY = strideY * strideSizeY;
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
+						int posY = get_global_id(1);
 
-						int maxPos = baseX * inputSizeY + baseY;
-						float max = vInput[maxPos];
+						vGradient += iBatch * kernels * nStridesX * nStridesY;
 
-						for (int x = 0; x < coreSizeX; ++x)
+						int firstX = (posX < kernelSizeX) ? 0 : ((posX - kernelSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < kernelSizeY) ? 0 : ((posY - kernelSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+
+						float sum = 0.0f;
+
+						for (int iKernel = 0; iKernel < kernels; ++iKernel)
 						{
-							int inputBaseY = (baseX + x) * inputSizeY + baseY;
+							int gradientBase = iKernel * nStridesX * nStridesY;
+							int kernelBase = iKernel * kernelSizeX * kernelSizeY;
 
-							for (int y = 0; y < coreSizeY; ++y)
+							for (int strideX = firstX; strideX <= lastX; ++strideX)
 							{
-								int inputY = inputBaseY + y;
-								float e = vInput[inputY];
-								if (max < e)
+								int kernelBaseY = kernelBase + ((posX - (strideX * strideSizeX)) * kernelSizeY);
+
+								for (int strideY = firstY; strideY <= lastY; ++strideY)
 								{
-									max = e;
-									maxPos = inputY;
+									sum += vGradient[gradientBase + (strideX * nStridesY) + strideY] * mKernels[kernelBaseY + posY - (strideY * strideSizeY)];
 								}
 							}
 						}
 
-						vResult[(strideX * get_global_size(1)) + strideY] = max;
-						vMask[maxPos] = 1.0f;
+						vResult[(get_global_id(0) * get_global_size(1)) + posY] = sum;
 					}
 
-					__kernel void neural_net_3d_max_pooling_kernel(
-						__global const float * vInput,
+					__kernel void neural_net_3d_convolution_gradient_kernel(
+						__global const float * vGradient,
+						__global const float * mKernels,
 						__global float * vResult,
-						__global float * vMask,
-						int inputSizeY,
-						int inputSizeZ,
-						int coreSizeX,
-						int coreSizeY,
-						int coreSizeZ,
+						int inputSizeX,
+						int kernels,
+						int kernelSizeX,
+						int kernelSizeY,
+						int kernelSizeZ,
+						int nStridesX,
+						int nStridesY,
+						int nStridesZ,
 						int strideSizeX,
 						int strideSizeY,
 						int strideSizeZ)
 					{
-						int strideX = get_global_id(0);
-						int strideY = get_global_id(1);
-						int strideZ = get_global_id(2);
+						int iBatch = get_global_id(0) / inputSizeX;
+						int posX = get_global_id(0) % inputSizeX;
+						int posY = get_global_id(1);
+						int posZ = get_global_id(2);
 
-						int baseX = strideX * strideSizeX;
-						int baseY = strideY * strideSizeY;
-						int baseZ = strideZ * strideSizeZ;
+						vGradient += iBatch * kernels * nStridesX * nStridesY * nStridesZ;
 
-						int maxPos = (baseX * inputSizeY + baseY) * inputSizeZ + baseZ;
-						float max = vInput[maxPos];
+						int firstX = (posX < kernelSizeX) ? 0 : ((posX - kernelSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < kernelSizeY) ? 0 : ((posY - kernelSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+						int firstZ = (posZ < kernelSizeZ) ? 0 : ((posZ - kernelSizeZ) / strideSizeZ) + 1;
+						int lastZ = min(posZ / strideSizeZ, nStridesZ - 1);
 
-						for (int x = 0; x < coreSizeX; ++x)
+						float sum = 0.0f;
+
+						for (int iKernel = 0; iKernel < kernels; ++iKernel)
 						{
-							int inputBaseY = ((baseX + x) * inputSizeY + baseY) * inputSizeZ;
+							int gradientBase = iKernel * nStridesX * nStridesY * nStridesZ;
+							int kernelBase = iKernel * kernelSizeX * kernelSizeY * kernelSizeZ;
 
-							for (int y = 0; y < coreSizeY; ++y)
+							for (int strideX = firstX; strideX <= lastX; ++strideX)
 							{
-								int inputBaseZ = inputBaseY + (y * inputSizeZ) + baseZ;
+								int gradientBaseY = gradientBase + (strideX * nStridesY * nStridesZ);
+								int kernelBaseY = kernelBase + ((posX - (strideX * strideSizeX)) * kernelSizeY * kernelSizeZ);
 
-								for (int z = 0; z < coreSizeZ; ++z)
-								{ 
-									int inputZ = inputBaseZ + z;
-									float e = vInput[inputZ];
-									if (max < e)
+								for (int strideY = firstY; strideY <= lastY; ++strideY)
+								{
+									int gradientBaseZ = gradientBaseY + (strideY * nStridesZ);
+									int kernelBaseZ = kernelBaseY + ((posY - (strideY * strideSizeY)) * kernelSizeZ);
+
+									for (int strideZ = firstZ; strideZ <= lastZ; ++strideZ)
 									{
-										max = e;
-										maxPos = inputZ;
+										sum += vGradient[gradientBaseZ + strideZ] * mKernels[kernelBaseZ + posZ - (strideZ * strideSizeZ)];
 									}
 								}
 							}
 						}
 
-						vResult[(((strideX * get_global_size(1)) + strideY) * get_global_size(2)) + strideZ] = max;
-						vMask[maxPos] = 1.0f;
+						vResult[(((get_global_id(0) * get_global_size(1)) + posY) * get_global_size(2)) + posZ] = sum;
 					}
 
-				);
+					__kernel void neural_net_1d_convolution_weights_gradient_kernel(
+						__global const float * vInput,
+						__global const float * vGradient,
+						__global float * mKernelsGradient,
+						__global float * vBiasGradient,
+						int inputSizeX,
+						int nStridesX,
+						int strideSizeX,
+						int batchSize)
+					{
+						int iKernel = get_global_id(0);
+						int x = get_global_id(1);
 
-				std::stringstream options;
-				options << "-DBLOCK_SIZE=" << block_size;
+						int kernels = get_global_size(0);
+						int kernelSizeX = get_global_size(1);
 
-				program = ::boost::compute::program::build_with_source(source, context, options.str());
+						float total = 0.0f;
+						float biasTotal = 0.0f;
 
-				cache->insert(cacheKey, *program);
-			}
+						for (int iBatch = 0; iBatch < batchSize; ++iBatch)
+						{
+							int inputBase = iBatch * inputSizeX;
+							int gradientBase = ((iBatch * kernels) + iKernel) * nStridesX;
 
-			return *program;
-		}
+							float sum = 0.0f;
+							float biasSum = 0.0f;
 
-		static void execute_activation_kernel(
-			::boost::compute::mapped_view<float>& inputView,
-			::boost::compute::mapped_view<float>& resultView,
-			const size_t dataSize,
-			const ::boost::compute::program& program,
+							for (int strideX = 0; strideX < nStridesX; ++strideX)
+							{
+								float g = vGradient[gradientBase + strideX];
+								biasSum += g;
+								sum += g * vInput[inputBase + (strideX * strideSizeX) + x];
+							}
+
+							total += sum;
+							biasTotal += biasSum;
+						}
+
+						mKernelsGradient[(iKernel * kernelSizeX) + x] = total;
+
+						if (0 == x)
+						{
+							vBiasGradient[iKernel] = biasTotal;
+						}
+					}
+
+					__kernel void neural_net_2d_convolution_weights_gradient_kernel(
+						__global const float * vInput,
+						__global const float * vGradient,
+						__global float * mKernelsGradient,
+						__global float * vBiasGradient,
+						int inputSizeX,
+						int inputSizeY,
+						int nStridesX,
+						int nStridesY,
+						int strideSizeX,
+						int strideSizeY,
+						int batchSize)
+					{
+						int iKernel = get_global_id(0);
+						int x = get_global_id(1);
+						int y = get_global_id(2);
+
+						int kernels = get_global_size(0);
+						int kernelSizeX = get_global_size(1);
+						int kernelSizeY = get_global_size(2);
+
+						float total = 0.0f;
+						float biasTotal = 0.0f;
+
+						for (int iBatch = 0; iBatch < batchSize; ++iBatch)
+						{
+							int inputBase = iBatch * inputSizeX * inputSizeY;
+							int gradientBase = ((iBatch * kernels) + iKernel) * nStridesX * nStridesY;
+
+							float sum = 0.0f;
+							float biasSum = 0.0f;
+
+							for (int strideX = 0; strideX < nStridesX; ++strideX)
+							{
+								int inputBaseY = inputBase + (((strideX * strideSizeX) + x) * inputSizeY) + y;
+
+								for (int strideY = 0; strideY < nStridesY; ++strideY)
+								{
+									float g = vGradient[gradientBase + (strideX * nStridesY) + strideY];
+									biasSum += g;
+									sum += g * vInput[inputBaseY + (strideY * strideSizeY)];
+								}
+							}
+
+							total += sum;
+							biasTotal += biasSum;
+						}
+
+						mKernelsGradient[(((iKernel * kernelSizeX) + x) * kernelSizeY) + y] = total;
+
+						if ((0 == x) && (0 == y))
+						{
+							vBiasGradient[iKernel] = biasTotal;
+						}
+					}
+
+					__kernel void neural_net_3d_convolution_weights_gradient_kernel(
+						__global const float * vInput,
+						__global const float * vGradient,
+						__global float * mKernelsGradient,
+						__global float * vBiasGradient,
+						int inputSizeX,
+						int inputSizeY,
+						int inputSizeZ,
+						int kernelSizeX,
+						int nStridesX,
+						int nStridesY,
+						int nStridesZ,
+						int strideSizeX,
+						int strideSizeY,
+						int strideSizeZ,
+						int batchSize)
+					{
+						int iKernel = get_global_id(0) / kernelSizeX;
+						int x = get_global_id(0) % kernelSizeX;
+						int y = get_global_id(1);
+						int z = get_global_id(2);
+
+						int kernels = get_global_size(0) / kernelSizeX;
+						int kernelSizeY = get_global_size(1);
+						int kernelSizeZ = get_global_size(2);
+
+						float total = 0.0f;
+						float biasTotal = 0.0f;
+
+						for (int iBatch = 0; iBatch < batchSize; ++iBatch)
+						{
+							int inputBase = iBatch * inputSizeX * inputSizeY * inputSizeZ;
+							int gradientBase = ((iBatch * kernels) + iKernel) * nStridesX * nStridesY * nStridesZ;
+
+							float sum = 0.0f;
+							float biasSum = 0.0f;
+
+							for (int strideX = 0; strideX < nStridesX; ++strideX)
+							{
+								int inputBaseY = inputBase + (((strideX * strideSizeX) + x) * inputSizeY * inputSizeZ);
+
+								for (int strideY = 0; strideY < nStridesY; ++strideY)
+								{
+									int inputBaseZ = inputBaseY + (((strideY * strideSizeY) + y) * inputSizeZ) + z;
+
+									for (int strideZ = 0; strideZ < nStridesZ; ++strideZ)
+									{
+										float g = vGradient[gradientBase + (((strideX * nStridesY) + strideY) * nStridesZ) + strideZ];
+										biasSum += g;
+										sum += g * vInput[inputBaseZ + (strideZ * strideSizeZ)];
+									}
+								}
+							}
+
+							total += sum;
+							biasTotal += biasSum;
+						}
+
+						mKernelsGradient[(((get_global_id(0) * kernelSizeY) + y) * kernelSizeZ) + z] = total;
+
+						if ((0 == x) && (0 == y) && (0 == z))
+						{
+							vBiasGradient[iKernel] = biasTotal;
+						}
+					}
+
+					__kernel void neural_net_1d_average_pooling_kernel(
+						__global const float * vInput,
+						__global float * vResult,
+						int coreSizeX,
+						int strideSizeX,
+						float scale)
+					{
+						int strideX = get_global_id(0);
+						int baseX = strideX * strideSizeX;
+
+						float sum = 0.0f;
+						for (int x = 0; x < coreSizeX; ++x)
+						{
+							sum += vInput[baseX + x];
+						}
+
+						vResult[strideX] = sum * scale;
+					}
+
+					__kernel void neural_net_2d_average_pooling_kernel(
+						__global const float * vInput,
+						__global float * vResult,
+						int inputSizeY,
+						int coreSizeX,
+						int coreSizeY,
+						int strideSizeX,
+						int strideSizeY,
+						float scale)
+					{
+						int strideX = get_global_id(0);
+						int strideY = get_global_id(1);
+
+						int baseX = strideX * strideSizeX;
+						int baseY = strideY * strideSizeY;
+
+						float sum = 0.0f;
+						for (int x = 0; x < coreSizeX; ++x)
+						{
+							int inputBaseY = (baseX + x) * inputSizeY + baseY;
+
+							for (int y = 0; y < coreSizeY; ++y)
+							{
+								sum += vInput[inputBaseY + y];
+							}
+						}
+
+						vResult[(strideX * get_global_size(1)) + strideY] = sum * scale;
+					}
+
+					__kernel void neural_net_3d_average_pooling_kernel(
+						__global const float * vInput,
+						__global float * vResult,
+						int inputSizeY,
+						int inputSizeZ,
+						int coreSizeX,
+						int coreSizeY,
+						int coreSizeZ,
+						int strideSizeX,
+						int strideSizeY,
+						int strideSizeZ,
+						float scale)
+					{
+						int strideX = get_global_id(0);
+						int strideY = get_global_id(1);
+						int strideZ = get_global_id(2);
+
+						int baseX = strideX * strideSizeX;
+						int baseY = strideY * strideSizeY;
+						int baseZ = strideZ * strideSizeZ;
+
+						float sum = 0.0f;
+						for (int x = 0; x < coreSizeX; ++x)
+						{
+							int inputBaseY = ((baseX + x) * inputSizeY + baseY) * inputSizeZ;
+
+							for (int y = 0; y < coreSizeY; ++y)
+							{
+								int inputBaseZ = inputBaseY + (y * inputSizeZ) + baseZ;
+
+								for (int z = 0; z < coreSizeZ; ++z)
+								{
+									sum += vInput[inputBaseZ + z];
+								}
+							}
+						}
+
+						vResult[(((strideX * get_global_size(1)) + strideY) * get_global_size(2)) + strideZ] = sum * scale;
+					}
+
+					__kernel void neural_net_1d_average_pooling_gradient_kernel(
+						__global const float * vGradient,
+						__global float * vResult,
+						int coreSizeX,
+						int strideSizeX,
+						int nStridesX,
+						float scale)
+					{
+						int posX = get_global_id(0);
+
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+
+						float sum = 0.0f;
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							sum += vGradient[strideX] * scale;
+						}
+
+						vResult[posX] = sum;
+					}
+
+					__kernel void neural_net_2d_average_pooling_gradient_kernel(
+						__global const float * vGradient,
+						__global float * vResult,
+						int coreSizeX,
+						int coreSizeY,
+						int strideSizeX,
+						int strideSizeY,
+						int nStridesX,
+						int nStridesY,
+						float scale)
+					{
+						int posX = get_global_id(0);
+						int posY = get_global_id(1);
+
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < coreSizeY) ? 0 : ((posY - coreSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+
+						float sum = 0.0f;
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							for (int strideY = firstY; strideY <= lastY; ++strideY)
+							{
+								sum += vGradient[(strideX * nStridesY) + strideY] * scale;
+							}
+						}
+
+						vResult[(posX * get_global_size(1)) + posY] = sum;
+					}
+
+					__kernel void neural_net_3d_average_pooling_gradient_kernel(
+						__global const float * vGradient,
+						__global float * vResult,
+						int coreSizeX,
+						int coreSizeY,
+						int coreSizeZ,
+						int strideSizeX,
+						int strideSizeY,
+						int strideSizeZ,
+						int nStridesX,
+						int nStridesY,
+						int nStridesZ,
+						float scale)
+					{
+						int posX = get_global_id(0);
+						int posY = get_global_id(1);
+						int posZ = get_global_id(2);
+
+						int firstX = (posX < coreSizeX) ? 0 : ((posX - coreSizeX) / strideSizeX) + 1;
+						int lastX = min(posX / strideSizeX, nStridesX - 1);
+						int firstY = (posY < coreSizeY) ? 0 : ((posY - coreSizeY) / strideSizeY) + 1;
+						int lastY = min(posY / strideSizeY, nStridesY - 1);
+						int firstZ = (posZ < coreSizeZ) ? 0 : ((posZ - coreSizeZ) / strideSizeZ) + 1;
+						int lastZ = min(posZ / strideSizeZ, nStridesZ - 1);
+
+						float sum = 0.0f;
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							for (int strideY = firstY; strideY <= lastY; ++strideY)
+							{
+								for (int strideZ = firstZ; strideZ <= lastZ; ++strideZ)
+								{
+									sum += vGradient[(((strideX * nStridesY) + strideY) * nStridesZ) + strideZ] * scale;
+								}
+							}
+						}
+
+						vResult[(((posX * get_global_size(1)) + posY) * get_global_size(2)) + posZ] = sum;
+					}
+
+					__kernel void neural_net_global_average_pooling_kernel(
+						__global const float * vInput,
+						__global float * vResult,
+						int size,
+						float scale)
+					{
+						int channel = get_global_id(0);
+
+						vInput += channel * size;
+
+						float sum = 0.0f;
+						for (int i = 0; i < size; ++i)
+						{
+							sum += vInput[i];
+						}
+
+						vResult[channel] = sum * scale;
+					}
+
+					__kernel void neural_net_global_average_pooling_gradient_kernel(
+						__global const float * vGradient,
+						__global float * vResult,
+						int size,
+						float scale)
+					{
+						int pos = get_global_id(0);
+
+						vResult[pos] = vGradient[pos / size] * scale;
+					}
+
+					__kernel void neural_net_depthwise_convolution_gradient_kernel(
+						__global const float * vGradient,
+						__global const float * mKernels,
+						__global float * vResult,
+						int kernelSizeX,
+						int kernelSizeY,
+						int nStridesX,
+						int nStridesY,
+						int strideSizeX,
+						int strideSizeY,
+						int paddingX,
+						int paddingY,
+						int dilationX,
+						int dilationY)
+					{
+						int channel = get_global_id(0);
+						int posX = get_global_id(1);
+						int posY = get_global_id(2);
+
+						int offsetX = posX + paddingX;
+						int offsetY = posY + paddingY;
+						int spanX = (kernelSizeX - 1) * dilationX;
+						int spanY = (kernelSizeY - 1) * dilationY;
+
+						int firstX = (offsetX < spanX) ? 0 : ((offsetX - spanX + strideSizeX - 1) / strideSizeX);
+						int lastX = min(nStridesX - 1, offsetX / strideSizeX);
+						int firstY = (offsetY < spanY) ? 0 : ((offsetY - spanY + strideSizeY - 1) / strideSizeY);
+						int lastY = min(nStridesY - 1, offsetY / strideSizeY);
+
+						vGradient += channel * nStridesX * nStridesY;
+						mKernels += channel * kernelSizeX * kernelSizeY;
+
+						float sum = 0.0f;
+						for (int strideX = firstX; strideX <= lastX; ++strideX)
+						{
+							int tapX = offsetX - (strideX * strideSizeX);
+							if (0 != (tapX % dilationX))
+							{
+								continue;
+							}
+
+							int kernelBaseY = (tapX / dilationX) * kernelSizeY;
+							int gradientBaseY = strideX * nStridesY;
+
+							for (int strideY = firstY; strideY <= lastY; ++strideY)
+							{
+								int tapY = offsetY - (strideY * strideSizeY);
+								if (0 == (tapY % dilationY))
+								{
+									sum += vGradient[gradientBaseY + strideY] * mKernels[kernelBaseY + (tapY / dilationY)];
+								}
+							}
+						}
+
+						vResult[(((channel * get_global_size(1)) + posX) * get_global_size(2)) + posY] = sum;
+					}
+
+					__kernel void neural_net_depthwise_convolution_weights_gradient_kernel(
+						__global const float * vInput,
+						__global const float * vGradient,
+						__global float * mKernelsGradient,
+						__global float * vBiasGradient,
+						int inputSizeX,
+						int inputSizeY,
+						int nStridesX,
+						int nStridesY,
+						int strideSizeX,
+						int strideSizeY,
+						int paddingX,
+						int paddingY,
+						int dilationX,
+						int dilationY)
+					{
+						int channel = get_global_id(0);
+						int x = get_global_id(1);
+						int y = get_global_id(2);
+
+						vInput += channel * inputSizeX * inputSizeY;
+						vGradient += channel * nStridesX * nStridesY;
+
+						float sum = 0.0f;
+						float biasSum = 0.0f;
+						for (int strideX = 0; strideX < nStridesX; ++strideX)
+						{
+							int inputX = (strideX * strideSizeX) + (x * dilationX) - paddingX;
+							int validX = (0 <= inputX) && (inputX < inputSizeX);
+							int gradientBaseY = strideX * nStridesY;
+
+							for (int strideY = 0; strideY < nStridesY; ++strideY)
+							{
+								float g = vGradient[gradientBaseY + strideY];
+								biasSum += g;
+
+								int inputY = (strideY * strideSizeY) + (y * dilationY) - paddingY;
+								if (validX && (0 <= inputY) && (inputY < inputSizeY))
+								{
+									sum += g * vInput[(inputX * inputSizeY) + inputY];
+								}
+							}
+						}
+
+						mKernelsGradient[(((channel * get_global_size(1)) + x) * get_global_size(2)) + y] = sum;
+
+						if ((0 == x) && (0 == y))
+						{
+							vBiasGradient[channel] = biasSum;
+						}
+					}
+
+					__kernel void neural_net_pointwise_convolution_gradient_kernel(
+						__global const float * vGradient,
+						__global const float * mWeights,
+						__global float * vResult,
+						int kernels)
+					{
+						int channel = get_global_id(0);
+						int pos = get_global_id(1);
+						int channels = get_global_size(0);
+						int positions = get_global_size(1);
+
+						float sum = 0.0f;
+						for (int iKernel = 0; iKernel < kernels; ++iKernel)
+						{
+							sum += vGradient[(iKernel * positions) + pos] * mWeights[(iKernel * channels) + channel];
+						}
+
+						vResult[(channel * positions) + pos] = sum;
+					}
+
+					__kernel void neural_net_pointwise_convolution_weights_gradient_kernel(
+						__global const float * vInput,
+						__global const float * vGradient,
+						__global float * mWeightsGradient,
+						__global float * vBiasGradient,
+						int positions)
+					{
+						int iKernel = get_global_id(0);
+						int channel = get_global_id(1);
+
+						vInput += channel * positions;
+						vGradient += iKernel * positions;
+
+						float sum = 0.0f;
+						for (int pos = 0; pos < positions; ++pos)
+						{
+							sum += vGradient[pos] * vInput[pos];
+						}
+
+						mWeightsGradient[(iKernel * get_global_size(1)) + channel] = sum;
+
+						if (0 == channel)
+						{
+							float biasSum = 0.0f;
+							for (int pos = 0; pos < positions; ++pos)
+							{
+								biasSum += vGradient[pos];
+							}
+
+							vBiasGradient[iKernel] = biasSum;
+						}
+					}
+				);
+
+				source = get_epilogue_source("(x)", "(g)")
+					+ source
+					+ get_fusable_kernels_source()
+					+ get_argmax_source(get_argmax_type_name(std::uint8_t()))
+					+ get_max_pooling_kernels_source()
+					+ get_argmax_source(get_argmax_type_name(std::uint16_t()))
+					+ get_max_pooling_kernels_source();
+
+				program = ::boost::compute::program::build_with_source(source, context, get_build_options());
+
+				cache->insert(cacheKey, *program);
+			}
+
+			return *program;
+		}
+
+		// Kernels that end with a element-wise store of the result. The store is wrapped into 
+		// NEURAL_NET_EPILOGUE / NEURAL_NET_EPILOGUE_GRADIENT macros, so the following activation
+		// layer can be folded into the same kernel. See kernel_fusion in fusion.h.
+		static std::string get_fusable_kernels_source()
+		{
+			return BOOST_COMPUTE_STRINGIZE_SOURCE(
+
+				__kernel void neural_net_fully_connected_kernel(
+					__global const float * vIn,
+					__global const float * mWeights,
+					__global const float * vBias,
+					__global float * vResult,
+					int rows,
+					int cols)
+				{
+					int row = get_global_id(0);
+					int off = row * cols;
+
+					float sum = 0.0f;
+					for (int col = 0; col < cols; ++col)
+					{
+						sum += mWeights[off + col] * vIn[col];
+					}
+
+					vResult[row] = NEURAL_NET_EPILOGUE(sum + vBias[row]);
+				}
+
+				__kernel void neural_net_half_fully_connected_kernel(
+					__global const float * vIn,
+					__global const half * mWeights,
+					__global const float * vBias,
+					__global float * vResult,
+					int rows,
+					int cols)
+				{
+					int row = get_global_id(0);
+					int off = row * cols;
+
+					float sum = 0.0f;
+					for (int col = 0; col < cols; ++col)
+					{
+						sum += vload_half(off + col, mWeights) * vIn[col];
+					}
+
+					vResult[row] = NEURAL_NET_EPILOGUE(sum + vBias[row]);
+				}
+
+				__kernel void neural_net_bfloat16_fully_connected_kernel(
+					__global const float * vIn,
+					__global const ushort * mWeights,
+					__global const float * vBias,
+					__global float * vResult,
+					int rows,
+					int cols)
+				{
+					int row = get_global_id(0);
+					int off = row * cols;
+
+					float sum = 0.0f;
+					for (int col = 0; col < cols; ++col)
+					{
+						sum += as_float((uint)mWeights[off + col] << 16) * vIn[col];
+					}
+
+					vResult[row] = NEURAL_NET_EPILOGUE(sum + vBias[row]);
+				}
+
+				__kernel void neural_net_squared_error_loss_gradient_kernel(
+					__global const float * vResult,
+					__global const float * vTruth,
+					__global float * vGradient,
+					int length)
+				{
+					int pos = get_global_id(0) * BLOCK_SIZE;
+					int end = pos + BLOCK_SIZE;
+					if (length < end)
+					{
+						end = length;
+					}
+
+					for (; pos < end; ++pos)
+					{
+						vGradient[pos] = NEURAL_NET_EPILOGUE_GRADIENT(vResult[pos], vResult[pos] - vTruth[pos]);
+					}
+				}
+
+				__kernel void neural_net_1d_convolution_kernel(
+					__global const float * vInput,
+					__global const float * mKernels,
+					__global const float * vBias,
+					__global float * vResult,
+					int kernelSizeX,
+					int nStridesX,
+					int strideSizeX,
+					int inputSize)
+				{
+					int iKernel = get_global_id(0);
+					int iBatch = get_global_id(1);
+
+					vInput += iBatch * inputSize;
+
+					int resultBase = ((iBatch * get_global_size(0)) + iKernel) * nStridesX;
+					int kernelBase = iKernel * kernelSizeX;
+
+					for (int strideX = 0; strideX < nStridesX; ++strideX)
+					{
+						float sum = 0.0f;
+
+						int baseX = strideX * strideSizeX;
+
+						for (int x = 0; x < kernelSizeX; ++x)
+						{
+							sum += mKernels[kernelBase + x] * vInput[baseX + x];
+						}
+
+						vResult[resultBase + strideX] = NEURAL_NET_EPILOGUE(sum + vBias[iKernel]);
+					}
+				}
+
+				__kernel void neural_net_2d_convolution_kernel(
+					__global const float * vInput,
+					__global const float * mKernels,
+					__global const float * vBias,
+					__global float * vResult,
+					int inputSizeY,
+					int kernelSizeX,
+					int kernelSizeY,
+					int nStridesX,
+					int nStridesY,
+					int strideSizeX,
+					int strideSizeY,
+					int inputSize)
+				{
+					int iKernel = get_global_id(0);
+					int iBatch = get_global_id(1);
+
+					vInput += iBatch * inputSize;
+
+					int resultBase = ((iBatch * get_global_size(0)) + iKernel) * nStridesX * nStridesY;
+					int kernelBase = iKernel * kernelSizeX * kernelSizeY;
+
+					for (int strideX = 0; strideX < nStridesX; ++strideX)
+					{
+						int resultBaseY = resultBase + (strideX * nStridesY);
+
+						for (int strideY = 0; strideY < nStridesY; ++strideY)
+						{
+							float sum = 0.0f;
+
+							int baseX = strideX * strideSizeX;
+							int baseY = strideY * strideSizeY;
+
+							for (int x = 0; x < kernelSizeX; ++x)
+							{
+								int kernelBaseY = kernelBase + (x * kernelSizeY);
+								int inputBaseY = ((baseX + x) * inputSizeY) + baseY;
+
+								for (int y = 0; y < kernelSizeY; ++y)
+								{
+									sum += mKernels[kernelBaseY + y] * vInput[inputBaseY + y];
+								}
+							}
+
+							vResult[resultBaseY + strideY] = NEURAL_NET_EPILOGUE(sum + vBias[iKernel]);
+						}
+					}
+				}
+
+				__kernel void neural_net_3d_convolution_kernel(
+					__global const float * vInput,
+					__global const float * mKernels,
+					__global const float * vBias,
+					__global float * vResult,
+					int inputSizeY,
+					int inputSizeZ,
+					int kernelSizeX,
+					int kernelSizeY,
+					int kernelSizeZ,
+					int nStridesX,
+					int nStridesY,
+					int nStridesZ,
+					int strideSizeX,
+					int strideSizeY,
+					int strideSizeZ,
+					int inputSize)
+				{
+					int iKernel = get_global_id(0);
+					int iBatch = get_global_id(1);
+
+					vInput += iBatch * inputSize;
+
+					int resultBase = ((iBatch * get_global_size(0)) + iKernel) * nStridesX * nStridesY * nStridesZ;
+					int kernelBase = iKernel * kernelSizeX * kernelSizeY * kernelSizeZ;
+
+					for (int strideX = 0; strideX < nStridesX; ++strideX)
+					{
+						int resultBaseY = resultBase + (strideX * nStridesY * nStridesZ);
+
+						for (int strideY = 0; strideY < nStridesY; ++strideY)
+						{
+							int resultBaseZ = resultBaseY + (strideY * nStridesZ);
+
+							for (int strideZ = 0; strideZ < nStridesZ; ++strideZ)
+							{
+								float sum = 0.0f;
+
+								int baseX = strideX * strideSizeX;
+								int baseY = strideY * strideSizeY;
+								int baseZ = strideZ * strideSizeZ;
+
+								for (int x = 0; x < kernelSizeX; ++x)
+								{
+									int kernelBaseY = kernelBase + (x * kernelSizeY * kernelSizeZ);
+									int inputBaseY = (((baseX + x) * inputSizeY) + baseY) * inputSizeZ;
+
+									for (int y = 0; y < kernelSizeY; ++y)
+									{
+										int kernelBaseZ = kernelBaseY + (y * kernelSizeZ);
+										int inputBaseZ = inputBaseY + (y * inputSizeZ) + baseZ;
+
+										for (int z = 0; z < kernelSizeZ; ++z)
+										{
+											sum += mKernels[kernelBaseZ + z] * vInput[inputBaseZ + z];
+										}
+									}
+								}
+
+								vResult[resultBaseZ + strideZ] = NEURAL_NET_EPILOGUE(sum + vBias[iKernel]);
+							}
+						}
+					}
+				}
+
+				__kernel void neural_net_depthwise_convolution_kernel(
+					__global const float * vInput,
+					__global const float * mKernels,
+					__global const float * vBias,
+					__global float * vResult,
+					int inputSizeX,
+					int inputSizeY,
+					int kernelSizeX,
+					int kernelSizeY,
+					int strideSizeX,
+					int strideSizeY,
+					int paddingX,
+					int paddingY,
+					int dilationX,
+					int dilationY)
+				{
+					int channel = get_global_id(0);
+					int strideX = get_global_id(1);
+					int strideY = get_global_id(2);
+
+					int baseX = strideX * strideSizeX - paddingX;
+					int baseY = strideY * strideSizeY - paddingY;
+
+					int firstX = (baseX < 0) ? ((dilationX - 1 - baseX) / dilationX) : 0;
+					int lastX = min(kernelSizeX, (inputSizeX - baseX + dilationX - 1) / dilationX);
+					int firstY = (baseY < 0) ? ((dilationY - 1 - baseY) / dilationY) : 0;
+					int lastY = min(kernelSizeY, (inputSizeY - baseY + dilationY - 1) / dilationY);
+
+					vInput += channel * inputSizeX * inputSizeY;
+					mKernels += channel * kernelSizeX * kernelSizeY;
+
+					float sum = 0.0f;
+					for (int x = firstX; x < lastX; ++x)
+					{
+						int kernelBaseY = x * kernelSizeY;
+						int inputBaseY = ((baseX + x * dilationX) * inputSizeY) + baseY;
+
+						for (int y = firstY; y < lastY; ++y)
+						{
+							sum += mKernels[kernelBaseY + y] * vInput[inputBaseY + y * dilationY];
+						}
+					}
+
+					vResult[(((channel * get_global_size(1)) + strideX) * get_global_size(2)) + strideY] = NEURAL_NET_EPILOGUE(sum + vBias[channel]);
+				}
+
+				__kernel void neural_net_pointwise_convolution_kernel(
+					__global const float * vInput,
+					__global const float * mWeights,
+					__global const float * vBias,
+					__global float * vResult,
+					int channels)
+				{
+					int iKernel = get_global_id(0);
+					int pos = get_global_id(1);
+					int positions = get_global_size(1);
+
+					mWeights += iKernel * channels;
+
+					float sum = 0.0f;
+					for (int channel = 0; channel < channels; ++channel)
+					{
+						sum += mWeights[channel] * vInput[(channel * positions) + pos];
+					}
+
+					vResult[(iKernel * positions) + pos] = NEURAL_NET_EPILOGUE(sum + vBias[iKernel]);
+				}
+
+			);
+		}
+		static void execute_activation_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t dataSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(dataSize));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				get_block_count(dataSize),
+				0));
+
+			dispatch.finish(resultView);
+		}
+
+		static void execute_activation_gradient_kernel(
+			::boost::compute::mapped_view<float>& outputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t dataSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, outputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(dataSize));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				get_block_count(dataSize),
+				0));
+
+			dispatch.finish(resultView);
+		}
+
+		// Max pooling kernels store the position of the maximum within the core as a compact
+		// index, so they are built once per index type. See get_argmax_source.
+		static std::string get_max_pooling_kernels_source()
+		{
+			return BOOST_COMPUTE_STRINGIZE_SOURCE(
+
+				__kernel void NEURAL_NET_ARGMAX_KERNEL(neural_net_1d_max_pooling_kernel)(
+					__global const float * vInput,
+					__global float * vResult,
+					__global NEURAL_NET_ARGMAX_TYPE * vArgmax,
+					int coreSizeX,
+					int strideSizeX,
+					int nStridesX,
+					int inputSize)
+				{
+					int iBatch = get_global_id(0) / nStridesX;
+					int strideX = get_global_id(0) % nStridesX;
+
+					vInput += iBatch * inputSize;
+
+					int baseX = strideX * strideSizeX;
+
+					float max = vInput[baseX];
+					int maxX = 0;
+
+					for (int x = 1; x < coreSizeX; ++x)
+					{
+						float e = vInput[baseX + x];
+						if (max < e)
+						{
+							max = e;
+							maxX = x;
+						}
+					}
+
+					vResult[get_global_id(0)] = max;
+					vArgmax[get_global_id(0)] = (NEURAL_NET_ARGMAX_TYPE)maxX;
+				}
+
+				__kernel void NEURAL_NET_ARGMAX_KERNEL(neural_net_2d_max_pooling_kernel)(
+					__global const float * vInput,
+					__global float * vResult,
+					__global NEURAL_NET_ARGMAX_TYPE * vArgmax,
+					int inputSizeY,
+					int coreSizeX,
+					int coreSizeY,
+					int strideSizeX,
+					int strideSizeY,
+					int nStridesX,
+					int inputSize)
+				{
+					int iBatch = get_global_id(0) / nStridesX;
+					int strideX = get_global_id(0) % nStridesX;
+					int strideY = get_global_id(1);
+
+					vInput += iBatch * inputSize;
+
+					int baseX = strideX * strideSizeX;
+					int baseY = strideY * strideSizeY;
+
+					float max = vInput[baseX * inputSizeY + baseY];
+					int maxPos = 0;
+
+					for (int x = 0; x < coreSizeX; ++x)
+					{
+						int inputBaseY = (baseX + x) * inputSizeY + baseY;
+
+						for (int y = 0; y < coreSizeY; ++y)
+						{
+							float e = vInput[inputBaseY + y];
+							if (max < e)
+							{
+								max = e;
+								maxPos = (x * coreSizeY) + y;
+							}
+						}
+					}
+
+					int pos = (get_global_id(0) * get_global_size(1)) + strideY;
+
+					vResult[pos] = max;
+					vArgmax[pos] = (NEURAL_NET_ARGMAX_TYPE)maxPos;
+				}
+
+				__kernel void NEURAL_NET_ARGMAX_KERNEL(neural_net_3d_max_pooling_kernel)(
+					__global const float * vInput,
+					__global float * vResult,
+					__global NEURAL_NET_ARGMAX_TYPE * vArgmax,
+					int inputSizeY,
+					int inputSizeZ,
+					int coreSizeX,
+					int coreSizeY,
+					int coreSizeZ,
+					int strideSizeX,
+					int strideSizeY,
+					int strideSizeZ,
+					int nStridesX,
+					int inputSize)
+				{
+					int iBatch = get_global_id(0) / nStridesX;
+					int strideX = get_global_id(0) % nStridesX;
+					int strideY = get_global_id(1);
+					int strideZ = get_global_id(2);
+
+					vInput += iBatch * inputSize;
+
+					int baseX = strideX * strideSizeX;
+					int baseY = strideY * strideSizeY;
+					int baseZ = strideZ * strideSizeZ;
+
+					float max = vInput[(baseX * inputSizeY + baseY) * inputSizeZ + baseZ];
+					int maxPos = 0;
+
+					for (int x = 0; x < coreSizeX; ++x)
+					{
+						int inputBaseY = ((baseX + x) * inputSizeY + baseY) * inputSizeZ;
+
+						for (int y = 0; y < coreSizeY; ++y)
+						{
+							int inputBaseZ = inputBaseY + (y * inputSizeZ) + baseZ;
+
+							for (int z = 0; z < coreSizeZ; ++z)
+							{
+								float e = vInput[inputBaseZ + z];
+								if (max < e)
+								{
+									max = e;
+									maxPos = (((x * coreSizeY) + y) * coreSizeZ) + z;
+								}
+							}
+						}
+					}
+
+					int pos = (((get_global_id(0) * get_global_size(1)) + strideY) * get_global_size(2)) + strideZ;
+
+					vResult[pos] = max;
+					vArgmax[pos] = (NEURAL_NET_ARGMAX_TYPE)maxPos;
+				}
+
+			);
+		}
+
+		static inline std::string get_relu_kernel_name()
+		{
+			return "neural_net_relu_kernel";
+		}
+
+		static inline std::string get_relu_gradient_kernel_name()
+		{
+			return "neural_net_relu_gradient_kernel";
+		}
+
+		static inline std::string get_logistic_kernel_name()
+		{
+			return "neural_net_logistic_kernel";
+		}
+
+		static inline std::string get_logistic_gradient_kernel_name()
+		{
+			return "neural_net_logistic_gradient_kernel";
+		}
+
+		static inline std::string get_tanh_kernel_name()
+		{
+			return "neural_net_tanh_kernel";
+		}
+
+		static inline std::string get_tanh_gradient_kernel_name()
+		{
+			return "neural_net_tanh_gradient_kernel";
+		}
+
+		template <class WeightsView>
+		static void execute_fully_connected_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			WeightsView& weightsView,
+			::boost::compute::mapped_view<float>& biasView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t rows,
+			const size_t columns,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, weightsView.get_buffer());
+			kernel.set_arg(2, biasView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(rows));
+			kernel.set_arg(5, static_cast<int>(columns));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(kernel, 0, rows, 0));
+			dispatch.finish(resultView);
+		}
+
+		template <class WeightsView>
+		static void execute_fully_connected_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			WeightsView& weightsView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<float>& weightsGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t rows,
+			const size_t columns,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, weightsView.get_buffer());
+			kernel.set_arg(2, gradientView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, weightsGradientView.get_buffer());
+			kernel.set_arg(5, biasGradientView.get_buffer());
+			kernel.set_arg(6, static_cast<int>(rows));
+			kernel.set_arg(7, static_cast<int>(columns));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(kernel, 0, columns, 0));
+			dispatch.finish(resultView, weightsGradientView, biasGradientView);
+		}
+
+		static void execute_generic_update_weights_kernel(
+			::boost::compute::mapped_view<float>& weightsGradientView,
+			::boost::compute::mapped_view<float>& weightsView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			::boost::compute::mapped_view<float>& biasView,
+			const size_t weightsLength,
+			const size_t biasLenth,
+			const float rate,
+			const float regularization,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto weightsKernel = program.create_kernel(kernelName);
+
+			weightsKernel.set_arg(0, weightsGradientView.get_buffer());
+			weightsKernel.set_arg(1, weightsView.get_buffer());
+			weightsKernel.set_arg(2, rate);
+			weightsKernel.set_arg(3, regularization);
+			weightsKernel.set_arg(4, static_cast<int>(weightsLength));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(weightsKernel, 0, get_block_count(weightsLength), 0));
+
+			auto biasKernel = program.create_kernel(kernelName);
+
+			biasKernel.set_arg(0, biasGradientView.get_buffer());
+			biasKernel.set_arg(1, biasView.get_buffer());
+			biasKernel.set_arg(2, rate);
+			biasKernel.set_arg(3, regularization);
+			biasKernel.set_arg(4, static_cast<int>(biasLenth));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(biasKernel, 0, get_block_count(biasLenth), 0));
+
+			dispatch.finish(weightsView, biasView);
+		}
+
+		static inline std::string get_fully_connected_kernel_name()
+		{
+			return "neural_net_fully_connected_kernel";
+		}
+
+		static inline std::string get_fully_connected_gradient_kernel_name()
+		{
+			return "neural_net_fully_connected_gradient_kernel";
+		}
+
+		static inline std::string get_half_fully_connected_kernel_name()
+		{
+			return "neural_net_half_fully_connected_kernel";
+		}
+
+		static inline std::string get_half_fully_connected_gradient_kernel_name()
+		{
+			return "neural_net_half_fully_connected_gradient_kernel";
+		}
+
+		static inline std::string get_bfloat16_fully_connected_kernel_name()
+		{
+			return "neural_net_bfloat16_fully_connected_kernel";
+		}
+
+		static inline std::string get_bfloat16_fully_connected_gradient_kernel_name()
+		{
+			return "neural_net_bfloat16_fully_connected_gradient_kernel";
+		}
+
+		static inline std::string get_update_weights_kernel_name()
+		{
+			return "neural_net_update_weights_kernel";
+		}
+
+		static void execute_squared_error_loss_gradient_kernel(
+			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<float>& truthView,
+			::boost::compute::mapped_view<float>& gradientView,
+			const size_t length,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, resultView.get_buffer());
+			kernel.set_arg(1, truthView.get_buffer());
+			kernel.set_arg(2, gradientView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(length));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(kernel, 0, get_block_count(length), 0));
+			dispatch.finish(gradientView);
+		}
+
+		static inline std::string get_squared_error_loss_gradient_kernel_name()
+		{
+			return "neural_net_squared_error_loss_gradient_kernel";
+		}
+
+		static void execute_1d_convolution_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& biasView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t strides,
+			const size_t strideSizeX,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, biasView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(kernelSizeX));
+			kernel.set_arg(5, static_cast<int>(strides));
+			kernel.set_arg(6, static_cast<int>(strideSizeX));
+			kernel.set_arg(7, static_cast<int>(inputSize));
+
+			const size_t map_global_work_size[2] = { kernels, batchSize };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_1d_convolution_kernel_name()
+		{
+			return "neural_net_1d_convolution_kernel";
+		}
+
+		static void execute_2d_convolution_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& biasView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeY,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, biasView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeY));
+			kernel.set_arg(5, static_cast<int>(kernelSizeX));
+			kernel.set_arg(6, static_cast<int>(kernelSizeY));
+			kernel.set_arg(7, static_cast<int>(stridesX));
+			kernel.set_arg(8, static_cast<int>(stridesY));
+			kernel.set_arg(9, static_cast<int>(strideSizeX));
+			kernel.set_arg(10, static_cast<int>(strideSizeY));
+			kernel.set_arg(11, static_cast<int>(inputSize));
+
+			const size_t map_global_work_size[2] = { kernels, batchSize };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_2d_convolution_kernel_name()
+		{
+			return "neural_net_2d_convolution_kernel";
+		}
+
+		static void execute_3d_convolution_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& biasView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t kernelSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, biasView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeY));
+			kernel.set_arg(5, static_cast<int>(inputSizeZ));
+			kernel.set_arg(6, static_cast<int>(kernelSizeX));
+			kernel.set_arg(7, static_cast<int>(kernelSizeY));
+			kernel.set_arg(8, static_cast<int>(kernelSizeZ));
+			kernel.set_arg(9, static_cast<int>(stridesX));
+			kernel.set_arg(10, static_cast<int>(stridesY));
+			kernel.set_arg(11, static_cast<int>(stridesZ));
+			kernel.set_arg(12, static_cast<int>(strideSizeX));
+			kernel.set_arg(13, static_cast<int>(strideSizeY));
+			kernel.set_arg(14, static_cast<int>(strideSizeZ));
+			kernel.set_arg(15, static_cast<int>(inputSize));
+
+			const size_t map_global_work_size[2] = { kernels, batchSize };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_3d_convolution_kernel_name()
+		{
+			return "neural_net_3d_convolution_kernel";
+		}
+
+		static void execute_1d_convolution_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(kernels));
+			kernel.set_arg(5, static_cast<int>(kernelSizeX));
+			kernel.set_arg(6, static_cast<int>(stridesX));
+			kernel.set_arg(7, static_cast<int>(strideSizeX));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				inputSizeX * batchSize,
+				0));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_1d_convolution_gradient_kernel_name()
+		{
+			return "neural_net_1d_convolution_gradient_kernel";
+		}
+
+		static void execute_2d_convolution_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(kernels));
+			kernel.set_arg(5, static_cast<int>(kernelSizeX));
+			kernel.set_arg(6, static_cast<int>(kernelSizeY));
+			kernel.set_arg(7, static_cast<int>(stridesX));
+			kernel.set_arg(8, static_cast<int>(stridesY));
+			kernel.set_arg(9, static_cast<int>(strideSizeX));
+			kernel.set_arg(10, static_cast<int>(strideSizeY));
+
+			const size_t map_global_work_size[2] = { inputSizeX * batchSize, inputSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_2d_convolution_gradient_kernel_name()
+		{
+			return "neural_net_2d_convolution_gradient_kernel";
+		}
+
+		static void execute_3d_convolution_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t kernelSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, kernelView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(kernels));
+			kernel.set_arg(5, static_cast<int>(kernelSizeX));
+			kernel.set_arg(6, static_cast<int>(kernelSizeY));
+			kernel.set_arg(7, static_cast<int>(kernelSizeZ));
+			kernel.set_arg(8, static_cast<int>(stridesX));
+			kernel.set_arg(9, static_cast<int>(stridesY));
+			kernel.set_arg(10, static_cast<int>(stridesZ));
+			kernel.set_arg(11, static_cast<int>(strideSizeX));
+			kernel.set_arg(12, static_cast<int>(strideSizeY));
+			kernel.set_arg(13, static_cast<int>(strideSizeZ));
+
+			const size_t map_global_work_size[3] = { inputSizeX * batchSize, inputSizeY, inputSizeZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_3d_convolution_gradient_kernel_name()
+		{
+			return "neural_net_3d_convolution_gradient_kernel";
+		}
+
+		static void execute_1d_convolution_weights_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t inputSizeX,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, kernelGradientView.get_buffer());
+			kernel.set_arg(3, biasGradientView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeX));
+			kernel.set_arg(5, static_cast<int>(stridesX));
+			kernel.set_arg(6, static_cast<int>(strideSizeX));
+			kernel.set_arg(7, static_cast<int>(batchSize));
+
+			const size_t map_global_work_size[2] = { kernels, kernelSizeX };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(kernelGradientView, biasGradientView);
+		}
+
+		static inline std::string get_1d_convolution_weights_gradient_kernel_name()
+		{
+			return "neural_net_1d_convolution_weights_gradient_kernel";
+		}
+
+		static void execute_2d_convolution_weights_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, kernelGradientView.get_buffer());
+			kernel.set_arg(3, biasGradientView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeX));
+			kernel.set_arg(5, static_cast<int>(inputSizeY));
+			kernel.set_arg(6, static_cast<int>(stridesX));
+			kernel.set_arg(7, static_cast<int>(stridesY));
+			kernel.set_arg(8, static_cast<int>(strideSizeX));
+			kernel.set_arg(9, static_cast<int>(strideSizeY));
+			kernel.set_arg(10, static_cast<int>(batchSize));
+
+			const size_t map_global_work_size[3] = { kernels, kernelSizeX, kernelSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(kernelGradientView, biasGradientView);
+		}
+
+		static inline std::string get_2d_convolution_weights_gradient_kernel_name()
+		{
+			return "neural_net_2d_convolution_weights_gradient_kernel";
+		}
+
+		static void execute_3d_convolution_weights_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t kernels,
+			const size_t kernelSizeX,
+			const size_t kernelSizeY,
+			const size_t kernelSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, kernelGradientView.get_buffer());
+			kernel.set_arg(3, biasGradientView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeX));
+			kernel.set_arg(5, static_cast<int>(inputSizeY));
+			kernel.set_arg(6, static_cast<int>(inputSizeZ));
+			kernel.set_arg(7, static_cast<int>(kernelSizeX));
+			kernel.set_arg(8, static_cast<int>(stridesX));
+			kernel.set_arg(9, static_cast<int>(stridesY));
+			kernel.set_arg(10, static_cast<int>(stridesZ));
+			kernel.set_arg(11, static_cast<int>(strideSizeX));
+			kernel.set_arg(12, static_cast<int>(strideSizeY));
+			kernel.set_arg(13, static_cast<int>(strideSizeZ));
+			kernel.set_arg(14, static_cast<int>(batchSize));
+
+			const size_t map_global_work_size[3] = { kernels * kernelSizeX, kernelSizeY, kernelSizeZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(kernelGradientView, biasGradientView);
+		}
+
+		static inline std::string get_3d_convolution_weights_gradient_kernel_name()
+		{
+			return "neural_net_3d_convolution_weights_gradient_kernel";
+		}
+
+		template <typename Index>
+		static void execute_1d_max_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<Index>& argmaxView,
+			const size_t coreSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, argmaxView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(coreSizeX));
+			kernel.set_arg(4, static_cast<int>(strideSizeX));
+			kernel.set_arg(5, static_cast<int>(stridesX));
+			kernel.set_arg(6, static_cast<int>(inputSize));
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				stridesX * batchSize,
+				0));
+
+			dispatch.finish(resultView, argmaxView);
+		}
+
+		template <typename Index>
+		static inline std::string get_1d_max_pooling_kernel_name()
+		{
+			return "neural_net_1d_max_pooling_kernel_" + get_argmax_type_name(Index());
+		}
+
+		template <typename Index>
+		static void execute_2d_max_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<Index>& argmaxView,
+			const size_t inputSizeY,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, argmaxView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeY));
+			kernel.set_arg(4, static_cast<int>(coreSizeX));
+			kernel.set_arg(5, static_cast<int>(coreSizeY));
+			kernel.set_arg(6, static_cast<int>(strideSizeX));
+			kernel.set_arg(7, static_cast<int>(strideSizeY));
+			kernel.set_arg(8, static_cast<int>(stridesX));
+			kernel.set_arg(9, static_cast<int>(inputSize));
+
+			const size_t map_global_work_size[2] = { stridesX * batchSize, stridesY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView, argmaxView);
+		}
+
+		template <typename Index>
+		static inline std::string get_2d_max_pooling_kernel_name()
+		{
+			return "neural_net_2d_max_pooling_kernel_" + get_argmax_type_name(Index());
+		}
+
+		template <typename Index>
+		static void execute_3d_max_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<Index>& argmaxView,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t inputSize,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
 			kernel.set_arg(1, resultView.get_buffer());
-			kernel.set_arg(2, static_cast<int>(dataSize));
+			kernel.set_arg(2, argmaxView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeY));
+			kernel.set_arg(4, static_cast<int>(inputSizeZ));
+			kernel.set_arg(5, static_cast<int>(coreSizeX));
+			kernel.set_arg(6, static_cast<int>(coreSizeY));
+			kernel.set_arg(7, static_cast<int>(coreSizeZ));
+			kernel.set_arg(8, static_cast<int>(strideSizeX));
+			kernel.set_arg(9, static_cast<int>(strideSizeY));
+			kernel.set_arg(10, static_cast<int>(strideSizeZ));
+			kernel.set_arg(11, static_cast<int>(stridesX));
+			kernel.set_arg(12, static_cast<int>(inputSize));
 
-			queue.enqueue_1d_range_kernel(
+			const size_t map_global_work_size[3] = { stridesX * batchSize, stridesY, stridesZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
 				kernel,
+				3,
 				0,
-				get_block_count(dataSize),
-				0);
+				map_global_work_size,
+				nullptr));
 
-			queue.finish();
+			dispatch.finish(resultView, argmaxView);
 		}
 
-		static void execute_activation_gradient_kernel(
-			::boost::compute::mapped_view<float>& outputView,
+		template <typename Index>
+		static inline std::string get_3d_max_pooling_kernel_name()
+		{
+			return "neural_net_3d_max_pooling_kernel_" + get_argmax_type_name(Index());
+		}
+
+		static void execute_1d_max_pooling_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
 			::boost::compute::mapped_view<float>& gradientView,
 			::boost::compute::mapped_view<float>& resultView,
-			const size_t dataSize,
+			const size_t inputSizeX,
+			const size_t coreSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t batchSize,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
-			kernel.set_arg(0, outputView.get_buffer());
+			kernel.set_arg(0, inputView.get_buffer());
 			kernel.set_arg(1, gradientView.get_buffer());
 			kernel.set_arg(2, resultView.get_buffer());
-			kernel.set_arg(3, static_cast<int>(dataSize));
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(coreSizeX));
+			kernel.set_arg(5, static_cast<int>(strideSizeX));
+			kernel.set_arg(6, static_cast<int>(stridesX));
 
-			queue.enqueue_1d_range_kernel(
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
 				kernel,
 				0,
-				get_block_count(dataSize),
-				0);
+				inputSizeX * batchSize,
+				0));
 
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_relu_kernel_name()
+		static inline std::string get_1d_max_pooling_gradient_kernel_name()
 		{
-			return "neural_net_relu_kernel";
+			return "neural_net_1d_max_pooling_gradient_kernel";
 		}
 
-		static inline std::string get_relu_gradient_kernel_name()
+		static void execute_2d_max_pooling_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
 		{
-			return "neural_net_relu_gradient_kernel";
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(coreSizeX));
+			kernel.set_arg(5, static_cast<int>(coreSizeY));
+			kernel.set_arg(6, static_cast<int>(strideSizeX));
+			kernel.set_arg(7, static_cast<int>(strideSizeY));
+			kernel.set_arg(8, static_cast<int>(stridesX));
+
+			const size_t map_global_work_size[2] = { inputSizeX * batchSize, inputSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_logistic_kernel_name()
+		static inline std::string get_2d_max_pooling_gradient_kernel_name()
 		{
-			return "neural_net_logistic_kernel";
+			return "neural_net_2d_max_pooling_gradient_kernel";
 		}
 
-		static inline std::string get_logistic_gradient_kernel_name()
+		static void execute_3d_max_pooling_gradient_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const size_t batchSize,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
 		{
-			return "neural_net_logistic_gradient_kernel";
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(inputSizeX));
+			kernel.set_arg(4, static_cast<int>(coreSizeX));
+			kernel.set_arg(5, static_cast<int>(coreSizeY));
+			kernel.set_arg(6, static_cast<int>(coreSizeZ));
+			kernel.set_arg(7, static_cast<int>(strideSizeX));
+			kernel.set_arg(8, static_cast<int>(strideSizeY));
+			kernel.set_arg(9, static_cast<int>(strideSizeZ));
+			kernel.set_arg(10, static_cast<int>(stridesX));
+
+			const size_t map_global_work_size[3] = { inputSizeX * batchSize, inputSizeY, inputSizeZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_tanh_kernel_name()
+		static inline std::string get_3d_max_pooling_gradient_kernel_name()
 		{
-			return "neural_net_tanh_kernel";
+			return "neural_net_3d_max_pooling_gradient_kernel";
 		}
 
-		static inline std::string get_tanh_gradient_kernel_name()
+		static void execute_1d_average_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t coreSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
 		{
-			return "neural_net_tanh_gradient_kernel";
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(coreSizeX));
+			kernel.set_arg(3, static_cast<int>(strideSizeX));
+			kernel.set_arg(4, scale);
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				stridesX,
+				0));
+
+			dispatch.finish(resultView);
 		}
 
-		static void execute_fully_connected_kernel(
+		static inline std::string get_1d_average_pooling_kernel_name()
+		{
+			return "neural_net_1d_average_pooling_kernel";
+		}
+
+		static void execute_2d_average_pooling_kernel(
 			::boost::compute::mapped_view<float>& inputView,
-			::boost::compute::mapped_view<float>& weightsView,
-			::boost::compute::mapped_view<float>& biasView,
 			::boost::compute::mapped_view<float>& resultView,
-			const size_t rows,
-			const size_t columns,
+			const size_t inputSizeY,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const float scale,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, weightsView.get_buffer());
-			kernel.set_arg(2, biasView.get_buffer());
-			kernel.set_arg(3, resultView.get_buffer());
-			kernel.set_arg(4, static_cast<int>(rows));
-			kernel.set_arg(5, static_cast<int>(columns));
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(inputSizeY));
+			kernel.set_arg(3, static_cast<int>(coreSizeX));
+			kernel.set_arg(4, static_cast<int>(coreSizeY));
+			kernel.set_arg(5, static_cast<int>(strideSizeX));
+			kernel.set_arg(6, static_cast<int>(strideSizeY));
+			kernel.set_arg(7, scale);
+
+			const size_t map_global_work_size[2] = { stridesX, stridesY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_2d_average_pooling_kernel_name()
+		{
+			return "neural_net_2d_average_pooling_kernel";
+		}
+
+		static void execute_3d_average_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(inputSizeY));
+			kernel.set_arg(3, static_cast<int>(inputSizeZ));
+			kernel.set_arg(4, static_cast<int>(coreSizeX));
+			kernel.set_arg(5, static_cast<int>(coreSizeY));
+			kernel.set_arg(6, static_cast<int>(coreSizeZ));
+			kernel.set_arg(7, static_cast<int>(strideSizeX));
+			kernel.set_arg(8, static_cast<int>(strideSizeY));
+			kernel.set_arg(9, static_cast<int>(strideSizeZ));
+			kernel.set_arg(10, scale);
+
+			const size_t map_global_work_size[3] = { stridesX, stridesY, stridesZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_3d_average_pooling_kernel_name()
+		{
+			return "neural_net_3d_average_pooling_kernel";
+		}
+
+		static void execute_1d_average_pooling_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t coreSizeX,
+			const size_t stridesX,
+			const size_t strideSizeX,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(coreSizeX));
+			kernel.set_arg(3, static_cast<int>(strideSizeX));
+			kernel.set_arg(4, static_cast<int>(stridesX));
+			kernel.set_arg(5, scale);
+
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				inputSizeX,
+				0));
+
+			dispatch.finish(resultView);
+		}
+
+		static inline std::string get_1d_average_pooling_gradient_kernel_name()
+		{
+			return "neural_net_1d_average_pooling_gradient_kernel";
+		}
+
+		static void execute_2d_average_pooling_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+		{
+			kernel_dispatch dispatch(kernelName, queue);
+
+			auto kernel = program.create_kernel(kernelName);
+
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(coreSizeX));
+			kernel.set_arg(3, static_cast<int>(coreSizeY));
+			kernel.set_arg(4, static_cast<int>(strideSizeX));
+			kernel.set_arg(5, static_cast<int>(strideSizeY));
+			kernel.set_arg(6, static_cast<int>(stridesX));
+			kernel.set_arg(7, static_cast<int>(stridesY));
+			kernel.set_arg(8, scale);
+
+			const size_t map_global_work_size[2] = { inputSizeX, inputSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				2,
+				0,
+				map_global_work_size,
+				nullptr));
 
-			queue.enqueue_1d_range_kernel(kernel, 0, rows, 0);
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static void execute_fully_connected_gradient_kernel(
-			::boost::compute::mapped_view<float>& inputView,
-			::boost::compute::mapped_view<float>& weightsView,
+		static inline std::string get_2d_average_pooling_gradient_kernel_name()
+		{
+			return "neural_net_2d_average_pooling_gradient_kernel";
+		}
+
+		static void execute_3d_average_pooling_gradient_kernel(
 			::boost::compute::mapped_view<float>& gradientView,
 			::boost::compute::mapped_view<float>& resultView,
-			::boost::compute::mapped_view<float>& weightsGradientView,
-			::boost::compute::mapped_view<float>& biasGradientView,
-			const size_t rows,
-			const size_t columns,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
+			const size_t inputSizeZ,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t stridesX,
+			const size_t stridesY,
+			const size_t stridesZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const float scale,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
-			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, weightsView.get_buffer());
-			kernel.set_arg(2, gradientView.get_buffer());
-			kernel.set_arg(3, resultView.get_buffer());
-			kernel.set_arg(4, weightsGradientView.get_buffer());
-			kernel.set_arg(5, biasGradientView.get_buffer());
-			kernel.set_arg(6, static_cast<int>(rows));
-			kernel.set_arg(7, static_cast<int>(columns));
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(coreSizeX));
+			kernel.set_arg(3, static_cast<int>(coreSizeY));
+			kernel.set_arg(4, static_cast<int>(coreSizeZ));
+			kernel.set_arg(5, static_cast<int>(strideSizeX));
+			kernel.set_arg(6, static_cast<int>(strideSizeY));
+			kernel.set_arg(7, static_cast<int>(strideSizeZ));
+			kernel.set_arg(8, static_cast<int>(stridesX));
+			kernel.set_arg(9, static_cast<int>(stridesY));
+			kernel.set_arg(10, static_cast<int>(stridesZ));
+			kernel.set_arg(11, scale);
+
+			const size_t map_global_work_size[3] = { inputSizeX, inputSizeY, inputSizeZ };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
 
-			queue.enqueue_1d_range_kernel(kernel, 0, columns, 0);
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static void execute_generic_update_weights_kernel(
-			::boost::compute::mapped_view<float>& weightsGradientView,
-			::boost::compute::mapped_view<float>& weightsView,
-			::boost::compute::mapped_view<float>& biasGradientView,
-			::boost::compute::mapped_view<float>& biasView,
-			const size_t weightsLength,
-			const size_t biasLenth,
-			const float rate,
-			const float regularization,
+		static inline std::string get_3d_average_pooling_gradient_kernel_name()
+		{
+			return "neural_net_3d_average_pooling_gradient_kernel";
+		}
+
+		static void execute_global_average_pooling_kernel(
+			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t channels,
+			const size_t size,
+			const float scale,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
-			auto weightsKernel = program.create_kernel(kernelName);
-
-			weightsKernel.set_arg(0, weightsGradientView.get_buffer());
-			weightsKernel.set_arg(1, weightsView.get_buffer());
-			weightsKernel.set_arg(2, rate);
-			weightsKernel.set_arg(3, regularization);
-			weightsKernel.set_arg(4, static_cast<int>(weightsLength));
-
-			queue.enqueue_1d_range_kernel(weightsKernel, 0, get_block_count(weightsLength), 0);
-
-			auto biasKernel = program.create_kernel(kernelName);
-
-			biasKernel.set_arg(0, biasGradientView.get_buffer());
-			biasKernel.set_arg(1, biasView.get_buffer());
-			biasKernel.set_arg(2, rate);
-			biasKernel.set_arg(3, regularization);
-			biasKernel.set_arg(4, static_cast<int>(biasLenth));
+			kernel_dispatch dispatch(kernelName, queue);
 
-			queue.enqueue_1d_range_kernel(biasKernel, 0, get_block_count(biasLenth), 0);
+			auto kernel = program.create_kernel(kernelName);
 
-			queue.finish();
-		}
+			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(size));
+			kernel.set_arg(3, scale);
 
-		static inline std::string get_fully_connected_kernel_name()
-		{
-			return "neural_net_fully_connected_kernel";
-		}
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				channels,
+				0));
 
-		static inline std::string get_fully_connected_gradient_kernel_name()
-		{
-			return "neural_net_fully_connected_gradient_kernel";
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_update_weights_kernel_name()
+		static inline std::string get_global_average_pooling_kernel_name()
 		{
-			return "neural_net_update_weights_kernel";
+			return "neural_net_global_average_pooling_kernel";
 		}
 
-		static void execute_squared_error_loss_gradient_kernel(
-			::boost::compute::mapped_view<float>& resultView,
-			::boost::compute::mapped_view<float>& truthView,
+		static void execute_global_average_pooling_gradient_kernel(
 			::boost::compute::mapped_view<float>& gradientView,
-			const size_t length,
+			::boost::compute::mapped_view<float>& resultView,
+			const size_t channels,
+			const size_t size,
+			const float scale,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
-			kernel.set_arg(0, resultView.get_buffer());
-			kernel.set_arg(1, truthView.get_buffer());
-			kernel.set_arg(2, gradientView.get_buffer());
-			kernel.set_arg(3, static_cast<int>(length));
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, resultView.get_buffer());
+			kernel.set_arg(2, static_cast<int>(size));
+			kernel.set_arg(3, scale);
 
-			queue.enqueue_1d_range_kernel(kernel, 0, get_block_count(length), 0);
-			queue.finish();
+			dispatch.enqueued(queue.enqueue_1d_range_kernel(
+				kernel,
+				0,
+				channels * size,
+				0));
+
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_squared_error_loss_gradient_kernel_name()
+		static inline std::string get_global_average_pooling_gradient_kernel_name()
 		{
-			return "neural_net_squared_error_loss_gradient_kernel";
+			return "neural_net_global_average_pooling_gradient_kernel";
 		}
 
-		static void execute_1d_convolution_kernel(
+		static void execute_depthwise_convolution_kernel(
 			::boost::compute::mapped_view<float>& inputView,
 			::boost::compute::mapped_view<float>& kernelView,
 			::boost::compute::mapped_view<float>& biasView,
 			::boost::compute::mapped_view<float>& resultView,
-			const size_t kernels,
+			const size_t channels,
+			const size_t inputSizeX,
+			const size_t inputSizeY,
 			const size_t kernelSizeX,
-			const size_t strides,
+			const size_t kernelSizeY,
+			const size_t stridesX,
+			const size_t stridesY,
 			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t paddingX,
+			const size_t paddingY,
+			const size_t dilationX,
+			const size_t dilationY,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
 			kernel.set_arg(1, kernelView.get_buffer());
 			kernel.set_arg(2, biasView.get_buffer());
 			kernel.set_arg(3, resultView.get_buffer());
-			kernel.set_arg(4, static_cast<int>(kernelSizeX));
-			kernel.set_arg(5, static_cast<int>(strides));
-			kernel.set_arg(6, static_cast<int>(strideSizeX));
+			kernel.set_arg(4, static_cast<int>(inputSizeX));
+			kernel.set_arg(5, static_cast<int>(inputSizeY));
+			kernel.set_arg(6, static_cast<int>(kernelSizeX));
+			kernel.set_arg(7, static_cast<int>(kernelSizeY));
+			kernel.set_arg(8, static_cast<int>(strideSizeX));
+			kernel.set_arg(9, static_cast<int>(strideSizeY));
+			kernel.set_arg(10, static_cast<int>(paddingX));
+			kernel.set_arg(11, static_cast<int>(paddingY));
+			kernel.set_arg(12, static_cast<int>(dilationX));
+			kernel.set_arg(13, static_cast<int>(dilationY));
+
+			const size_t map_global_work_size[3] = { channels, stridesX, stridesY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
 
-			queue.enqueue_1d_range_kernel(kernel, 0, kernels, 0);
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_1d_convolution_kernel_name()
+		static inline std::string get_depthwise_convolution_kernel_name()
 		{
-			return "neural_net_1d_convolution_kernel";
+			return "neural_net_depthwise_convolution_kernel";
 		}
 
-		static void execute_2d_convolution_kernel(
-			::boost::compute::mapped_view<float>& inputView,
+		static void execute_depthwise_convolution_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
 			::boost::compute::mapped_view<float>& kernelView,
-			::boost::compute::mapped_view<float>& biasView,
 			::boost::compute::mapped_view<float>& resultView,
+			const size_t channels,
+			const size_t inputSizeX,
 			const size_t inputSizeY,
-			const size_t kernels,
 			const size_t kernelSizeX,
 			const size_t kernelSizeY,
 			const size_t stridesX,
 			const size_t stridesY,
 			const size_t strideSizeX,
 			const size_t strideSizeY,
+			const size_t paddingX,
+			const size_t paddingY,
+			const size_t dilationX,
+			const size_t dilationY,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
-			kernel.set_arg(0, inputView.get_buffer());
+			kernel.set_arg(0, gradientView.get_buffer());
 			kernel.set_arg(1, kernelView.get_buffer());
-			kernel.set_arg(2, biasView.get_buffer());
-			kernel.set_arg(3, resultView.get_buffer());
-			kernel.set_arg(4, static_cast<int>(inputSizeY));
-			kernel.set_arg(5, static_cast<int>(kernelSizeX));
-			kernel.set_arg(6, static_cast<int>(kernelSizeY));
-			kernel.set_arg(7, static_cast<int>(stridesX));
-			kernel.set_arg(8, static_cast<int>(stridesY));
-			kernel.set_arg(9, static_cast<int>(strideSizeX));
-			kernel.set_arg(10, static_cast<int>(strideSizeY));
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(kernelSizeX));
+			kernel.set_arg(4, static_cast<int>(kernelSizeY));
+			kernel.set_arg(5, static_cast<int>(stridesX));
+			kernel.set_arg(6, static_cast<int>(stridesY));
+			kernel.set_arg(7, static_cast<int>(strideSizeX));
+			kernel.set_arg(8, static_cast<int>(strideSizeY));
+			kernel.set_arg(9, static_cast<int>(paddingX));
+			kernel.set_arg(10, static_cast<int>(paddingY));
+			kernel.set_arg(11, static_cast<int>(dilationX));
+			kernel.set_arg(12, static_cast<int>(dilationY));
+
+			const size_t map_global_work_size[3] = { channels, inputSizeX, inputSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
 
-			queue.enqueue_1d_range_kernel(kernel, 0, kernels, 0);
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_2d_convolution_kernel_name()
+		static inline std::string get_depthwise_convolution_gradient_kernel_name()
 		{
-			return "neural_net_2d_convolution_kernel";
+			return "neural_net_depthwise_convolution_gradient_kernel";
 		}
 
-		static void execute_3d_convolution_kernel(
+		static void execute_depthwise_convolution_weights_gradient_kernel(
 			::boost::compute::mapped_view<float>& inputView,
-			::boost::compute::mapped_view<float>& kernelView,
-			::boost::compute::mapped_view<float>& biasView,
-			::boost::compute::mapped_view<float>& resultView,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& kernelGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t channels,
+			const size_t inputSizeX,
 			const size_t inputSizeY,
-			const size_t inputSizeZ,
-			const size_t kernels,
 			const size_t kernelSizeX,
 			const size_t kernelSizeY,
-			const size_t kernelSizeZ,
 			const size_t stridesX,
 			const size_t stridesY,
-			const size_t stridesZ,
 			const size_t strideSizeX,
 			const size_t strideSizeY,
-			const size_t strideSizeZ,
+			const size_t paddingX,
+			const size_t paddingY,
+			const size_t dilationX,
+			const size_t dilationY,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, kernelView.get_buffer());
-			kernel.set_arg(2, biasView.get_buffer());
-			kernel.set_arg(3, resultView.get_buffer());
-			kernel.set_arg(4, static_cast<int>(inputSizeY));
-			kernel.set_arg(5, static_cast<int>(inputSizeZ));
-			kernel.set_arg(6, static_cast<int>(kernelSizeX));
-			kernel.set_arg(7, static_cast<int>(kernelSizeY));
-			kernel.set_arg(8, static_cast<int>(kernelSizeZ));
-			kernel.set_arg(9, static_cast<int>(stridesX));
-			kernel.set_arg(10, static_cast<int>(stridesY));
-			kernel.set_arg(11, static_cast<int>(stridesZ));
-			kernel.set_arg(12, static_cast<int>(strideSizeX));
-			kernel.set_arg(13, static_cast<int>(strideSizeY));
-			kernel.set_arg(14, static_cast<int>(strideSizeZ));
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, kernelGradientView.get_buffer());
+			kernel.set_arg(3, biasGradientView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(inputSizeX));
+			kernel.set_arg(5, static_cast<int>(inputSizeY));
+			kernel.set_arg(6, static_cast<int>(stridesX));
+			kernel.set_arg(7, static_cast<int>(stridesY));
+			kernel.set_arg(8, static_cast<int>(strideSizeX));
+			kernel.set_arg(9, static_cast<int>(strideSizeY));
+			kernel.set_arg(10, static_cast<int>(paddingX));
+			kernel.set_arg(11, static_cast<int>(paddingY));
+			kernel.set_arg(12, static_cast<int>(dilationX));
+			kernel.set_arg(13, static_cast<int>(dilationY));
+
+			const size_t map_global_work_size[3] = { channels, kernelSizeX, kernelSizeY };
+
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
+				kernel,
+				3,
+				0,
+				map_global_work_size,
+				nullptr));
 
-			queue.enqueue_1d_range_kernel(kernel, 0, kernels, 0);
-			queue.finish();
+			dispatch.finish(kernelGradientView, biasGradientView);
 		}
 
-		static inline std::string get_3d_convolution_kernel_name()
+		static inline std::string get_depthwise_convolution_weights_gradient_kernel_name()
 		{
-			return "neural_net_3d_convolution_kernel";
+			return "neural_net_depthwise_convolution_weights_gradient_kernel";
 		}
 
-		static void execute_1d_max_pooling_kernel(
+		static void execute_pointwise_convolution_kernel(
 			::boost::compute::mapped_view<float>& inputView,
+			::boost::compute::mapped_view<float>& weightsView,
+			::boost::compute::mapped_view<float>& biasView,
 			::boost::compute::mapped_view<float>& resultView,
-			::boost::compute::mapped_view<float>& maskView,
-			const size_t coreSizeX,
-			const size_t stridesX,
-			const size_t strideSizeX,
+			const size_t kernels,
+			const size_t channels,
+			const size_t positions,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, resultView.get_buffer());
-			kernel.set_arg(2, maskView.get_buffer());
-			kernel.set_arg(3, static_cast<int>(coreSizeX));
-			kernel.set_arg(4, static_cast<int>(strideSizeX));
+			kernel.set_arg(1, weightsView.get_buffer());
+			kernel.set_arg(2, biasView.get_buffer());
+			kernel.set_arg(3, resultView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(channels));
+
+			const size_t map_global_work_size[2] = { kernels, positions };
 
-			queue.enqueue_1d_range_kernel(
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
 				kernel,
+				2,
 				0,
-				stridesX,
-				0);
+				map_global_work_size,
+				nullptr));
 
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_1d_max_pooling_kernel_name()
+		static inline std::string get_pointwise_convolution_kernel_name()
 		{
-			return "neural_net_1d_max_pooling_kernel";
+			return "neural_net_pointwise_convolution_kernel";
 		}
 
-		static void execute_2d_max_pooling_kernel(
-			::boost::compute::mapped_view<float>& inputView,
+		static void execute_pointwise_convolution_gradient_kernel(
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& weightsView,
 			::boost::compute::mapped_view<float>& resultView,
-			::boost::compute::mapped_view<float>& maskView,
-			const size_t inputSizeY,
-			const size_t coreSizeX,
-			const size_t coreSizeY,
-			const size_t stridesX,
-			const size_t stridesY,
-			const size_t strideSizeX,
-			const size_t strideSizeY,
+			const size_t kernels,
+			const size_t channels,
+			const size_t positions,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
-			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, resultView.get_buffer());
-			kernel.set_arg(2, maskView.get_buffer());
-			kernel.set_arg(3, static_cast<int>(inputSizeY));
-			kernel.set_arg(4, static_cast<int>(coreSizeX));
-			kernel.set_arg(5, static_cast<int>(coreSizeY));
-			kernel.set_arg(6, static_cast<int>(strideSizeX));
-			kernel.set_arg(7, static_cast<int>(strideSizeY));
+			kernel.set_arg(0, gradientView.get_buffer());
+			kernel.set_arg(1, weightsView.get_buffer());
+			kernel.set_arg(2, resultView.get_buffer());
+			kernel.set_arg(3, static_cast<int>(kernels));
 
-			const size_t map_global_work_size[2] = { stridesX, stridesY };
+			const size_t map_global_work_size[2] = { channels, positions };
 
-			queue.enqueue_nd_range_kernel(
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
 				kernel,
 				2,
 				0,
 				map_global_work_size,
-				nullptr);
+				nullptr));
 
-			queue.finish();
+			dispatch.finish(resultView);
 		}
 
-		static inline std::string get_2d_max_pooling_kernel_name()
+		static inline std::string get_pointwise_convolution_gradient_kernel_name()
 		{
-			return "neural_net_2d_max_pooling_kernel";
+			return "neural_net_pointwise_convolution_gradient_kernel";
 		}
 
-		static void execute_3d_max_pooling_kernel(
+		static void execute_pointwise_convolution_weights_gradient_kernel(
 			::boost::compute::mapped_view<float>& inputView,
-			::boost::compute::mapped_view<float>& resultView,
-			::boost::compute::mapped_view<float>& maskView,
-			const size_t inputSizeY,
-			const size_t inputSizeZ,
-			const size_t coreSizeX,
-			const size_t coreSizeY,
-			const size_t coreSizeZ,
-			const size_t stridesX,
-			const size_t stridesY,
-			const size_t stridesZ,
-			const size_t strideSizeX,
-			const size_t strideSizeY,
-			const size_t strideSizeZ,
+			::boost::compute::mapped_view<float>& gradientView,
+			::boost::compute::mapped_view<float>& weightsGradientView,
+			::boost::compute::mapped_view<float>& biasGradientView,
+			const size_t kernels,
+			const size_t channels,
+			const size_t positions,
 			const ::boost::compute::program& program,
 			const std::string& kernelName,
 			::boost::compute::command_queue& queue)
 		{
+			kernel_dispatch dispatch(kernelName, queue);
+
 			auto kernel = program.create_kernel(kernelName);
 
 			kernel.set_arg(0, inputView.get_buffer());
-			kernel.set_arg(1, resultView.get_buffer());
-			kernel.set_arg(2, maskView.get_buffer());
-			kernel.set_arg(3, static_cast<int>(inputSizeY));
-			kernel.set_arg(4, static_cast<int>(inputSizeZ));
-			kernel.set_arg(5, static_cast<int>(coreSizeX));
-			kernel.set_arg(6, static_cast<int>(coreSizeY));
-			kernel.set_arg(7, static_cast<int>(coreSizeZ));
-			kernel.set_arg(8, static_cast<int>(strideSizeX));
-			kernel.set_arg(9, static_cast<int>(strideSizeY));
-			kernel.set_arg(10, static_cast<int>(strideSizeZ));
+			kernel.set_arg(1, gradientView.get_buffer());
+			kernel.set_arg(2, weightsGradientView.get_buffer());
+			kernel.set_arg(3, biasGradientView.get_buffer());
+			kernel.set_arg(4, static_cast<int>(positions));
 
-			const size_t map_global_work_size[3] = { stridesX, stridesY, stridesZ };
+			const size_t map_global_work_size[2] = { kernels, channels };
 
-			queue.enqueue_nd_range_kernel(
+			dispatch.enqueued(queue.enqueue_nd_range_kernel(
 				kernel,
-				3,
+				2,
 				0,
 				map_global_work_size,
-				nullptr);
+				nullptr));
 
-			queue.finish();
+			dispatch.finish(weightsGradientView, biasGradientView);
 		}
 
-		static inline std::string get_3d_max_pooling_kernel_name()
+		static inline std::string get_pointwise_convolution_weights_gradient_kernel_name()
 		{
-			return "neural_net_3d_max_pooling_kernel";
+			return "neural_net_pointwise_convolution_weights_gradient_kernel";
 		}
 
 	};
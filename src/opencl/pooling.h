@@ -24,6 +24,8 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+
 #include "layer_kernels.h"
 
 namespace neural_network {
@@ -32,11 +34,11 @@ namespace detail {
 
 	struct max_pooling
 	{
-		template < typename Input, typename Output>
+		template < typename Input, typename Output, typename Index>
 		static void process_1d(
 			const typename Input& input,
 			typename Output& result,
-			typename Input& mask,
+			std::vector<Index>& argmax,
 			const size_t coreSizeX,
 			const size_t strideSizeX,
 			const ::boost::compute::program& program,
@@ -46,25 +48,27 @@ namespace detail {
 		{
 			auto inputView = input.get_device_view(context);
 			auto resultView = result.get_device_view(context);
-			auto maskView = mask.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
 
 			layer_kernels::execute_1d_max_pooling_kernel(
 				inputView,
 				resultView,
-				maskView,
+				argmaxView,
 				coreSizeX,
 				result.size<0>(),
 				strideSizeX,
+				Input::data_size,
+				1,
 				program,
 				kernelName,
 				queue);
 		}
 
-		template < typename Input, typename Output>
+		template < typename Input, typename Output, typename Index>
 		static void process_2d(
 			const typename Input& input,
 			typename Output& result,
-			typename Input& mask,
+			std::vector<Index>& argmax,
 			const size_t coreSizeX,
 			const size_t coreSizeY,
 			const size_t strideSizeX,
@@ -76,12 +80,12 @@ namespace detail {
 		{
 			auto inputView = input.get_device_view(context);
 			auto resultView = result.get_device_view(context);
-			auto maskView = mask.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
 
 			layer_kernels::execute_2d_max_pooling_kernel(
 				inputView,
 				resultView,
-				maskView,
+				argmaxView,
 				input.size<1>(),
 				coreSizeX,
 				coreSizeY,
@@ -89,16 +93,18 @@ namespace detail {
 				result.size<1>(),
 				strideSizeX,
 				strideSizeY,
+				Input::data_size,
+				1,
 				program,
 				kernelName,
 				queue);
 		}
 
-		template < typename Input, typename Output>
+		template < typename Input, typename Output, typename Index>
 		static void process_3d(
 			const typename Input& input,
 			typename Output& result,
-			typename Input& mask,
+			std::vector<Index>& argmax,
 			const size_t coreSizeX,
 			const size_t coreSizeY,
 			const size_t coreSizeZ,
@@ -112,12 +118,12 @@ namespace detail {
 		{
 			auto inputView = input.get_device_view(context);
 			auto resultView = result.get_device_view(context);
-			auto maskView = mask.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
 
 			layer_kernels::execute_3d_max_pooling_kernel(
 				inputView,
 				resultView,
-				maskView,
+				argmaxView,
 				input.size<1>(),
 				input.size<2>(),
 				coreSizeX,
@@ -129,6 +135,473 @@ namespace detail {
 				strideSizeX,
 				strideSizeY,
 				strideSizeZ,
+				Input::data_size,
+				1,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput, typename Index>
+		static void process_batch_1d(
+			const typename BatchInput& input,
+			typename BatchOutput& result,
+			std::vector<Index>& argmax,
+			const size_t coreSizeX,
+			const size_t strideSizeX,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
+
+			layer_kernels::execute_1d_max_pooling_kernel(
+				inputView,
+				resultView,
+				argmaxView,
+				coreSizeX,
+				result.size<1>(),
+				strideSizeX,
+				input.size<1>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput, typename Index>
+		static void process_batch_2d(
+			const typename BatchInput& input,
+			typename BatchOutput& result,
+			std::vector<Index>& argmax,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
+
+			layer_kernels::execute_2d_max_pooling_kernel(
+				inputView,
+				resultView,
+				argmaxView,
+				input.size<2>(),
+				coreSizeX,
+				coreSizeY,
+				result.size<1>(),
+				result.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				input.size<1>() * input.size<2>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput, typename Index>
+		static void process_batch_3d(
+			const typename BatchInput& input,
+			typename BatchOutput& result,
+			std::vector<Index>& argmax,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			::boost::compute::mapped_view<Index> argmaxView(argmax.data(), argmax.size(), context);
+
+			layer_kernels::execute_3d_max_pooling_kernel(
+				inputView,
+				resultView,
+				argmaxView,
+				input.size<2>(),
+				input.size<3>(),
+				coreSizeX,
+				coreSizeY,
+				coreSizeZ,
+				result.size<1>(),
+				result.size<2>(),
+				result.size<3>(),
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				input.size<1>() * input.size<2>() * input.size<3>(),
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput>
+		static void compute_batch_gradient_1d(
+			const typename BatchInput& input,
+			const typename BatchOutput& gradient,
+			typename BatchInput& result,
+			const size_t coreSizeX,
+			const size_t strideSizeX,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_1d_max_pooling_gradient_kernel(
+				inputView,
+				gradientView,
+				resultView,
+				input.size<1>(),
+				coreSizeX,
+				gradient.size<1>(),
+				strideSizeX,
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput>
+		static void compute_batch_gradient_2d(
+			const typename BatchInput& input,
+			const typename BatchOutput& gradient,
+			typename BatchInput& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_2d_max_pooling_gradient_kernel(
+				inputView,
+				gradientView,
+				resultView,
+				input.size<1>(),
+				input.size<2>(),
+				coreSizeX,
+				coreSizeY,
+				gradient.size<1>(),
+				strideSizeX,
+				strideSizeY,
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename BatchInput, typename BatchOutput>
+		static void compute_batch_gradient_3d(
+			const typename BatchInput& input,
+			const typename BatchOutput& gradient,
+			typename BatchInput& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_3d_max_pooling_gradient_kernel(
+				inputView,
+				gradientView,
+				resultView,
+				input.size<1>(),
+				input.size<2>(),
+				input.size<3>(),
+				coreSizeX,
+				coreSizeY,
+				coreSizeZ,
+				gradient.size<1>(),
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				input.size<0>(),
+				program,
+				kernelName,
+				queue);
+		}
+	};
+
+	struct average_pooling
+	{
+		template < typename Input, typename Output>
+		static void process_1d(
+			const typename Input& input,
+			typename Output& result,
+			const size_t coreSizeX,
+			const size_t strideSizeX,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_1d_average_pooling_kernel(
+				inputView,
+				resultView,
+				coreSizeX,
+				result.size<0>(),
+				strideSizeX,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void process_2d(
+			const typename Input& input,
+			typename Output& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_2d_average_pooling_kernel(
+				inputView,
+				resultView,
+				input.size<1>(),
+				coreSizeX,
+				coreSizeY,
+				result.size<0>(),
+				result.size<1>(),
+				strideSizeX,
+				strideSizeY,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void process_3d(
+			const typename Input& input,
+			typename Output& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_3d_average_pooling_kernel(
+				inputView,
+				resultView,
+				input.size<1>(),
+				input.size<2>(),
+				coreSizeX,
+				coreSizeY,
+				coreSizeZ,
+				result.size<0>(),
+				result.size<1>(),
+				result.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void compute_gradient_1d(
+			const typename Output& gradient,
+			typename Input& result,
+			const size_t coreSizeX,
+			const size_t strideSizeX,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_1d_average_pooling_gradient_kernel(
+				gradientView,
+				resultView,
+				result.size<0>(),
+				coreSizeX,
+				gradient.size<0>(),
+				strideSizeX,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void compute_gradient_2d(
+			const typename Output& gradient,
+			typename Input& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_2d_average_pooling_gradient_kernel(
+				gradientView,
+				resultView,
+				result.size<0>(),
+				result.size<1>(),
+				coreSizeX,
+				coreSizeY,
+				gradient.size<0>(),
+				gradient.size<1>(),
+				strideSizeX,
+				strideSizeY,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void compute_gradient_3d(
+			const typename Output& gradient,
+			typename Input& result,
+			const size_t coreSizeX,
+			const size_t coreSizeY,
+			const size_t coreSizeZ,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t strideSizeZ,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_3d_average_pooling_gradient_kernel(
+				gradientView,
+				resultView,
+				result.size<0>(),
+				result.size<1>(),
+				result.size<2>(),
+				coreSizeX,
+				coreSizeY,
+				coreSizeZ,
+				gradient.size<0>(),
+				gradient.size<1>(),
+				gradient.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				strideSizeZ,
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void process_global(
+			const typename Input& input,
+			typename Output& result,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_global_average_pooling_kernel(
+				inputView,
+				resultView,
+				input.size<0>(),
+				input.size<1>(),
+				scale,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template < typename Input, typename Output>
+		static void compute_global_gradient(
+			const typename Output& gradient,
+			typename Input& result,
+			const float scale,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_global_average_pooling_gradient_kernel(
+				gradientView,
+				resultView,
+				result.size<0>(),
+				result.size<1>(),
+				scale,
 				program,
 				kernelName,
 				queue);
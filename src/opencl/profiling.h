@@ -0,0 +1,428 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#pragma warning (push)
+#pragma warning (disable: 4512)
+
+#include <boost/compute/container/mapped_view.hpp>
+#include <boost/compute/core.hpp>
+
+#pragma warning (pop)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace neural_network {
+namespace opencl {
+
+	enum class profiling_operation_type
+	{
+		host,
+		kernel,
+		map,
+		unmap
+	};
+
+	struct profiling_record
+	{
+		const void* layer;
+		std::string layerName;
+		std::string operation;
+		profiling_operation_type type;
+		cl_ulong start;
+		cl_ulong end;
+	};
+
+	// Labels the OpenCL commands enqueued by the current thread with the layer which
+	// issues them. Scopes can be nested, the innermost one wins.
+	class profiling_scope
+	{
+	public:
+		template <class Layer>
+		explicit profiling_scope(const Layer& layer)
+			: m_layer(std::addressof(layer)), m_name(typeid(Layer).name()), m_previous(current())
+		{
+			current() = this;
+		}
+
+		~profiling_scope()
+		{
+			current() = m_previous;
+		}
+
+		static const profiling_scope* get_current()
+		{
+			return current();
+		}
+
+		const void* get_layer() const
+		{
+			return m_layer;
+		}
+
+		const char* get_name() const
+		{
+			return m_name;
+		}
+
+	private:
+		profiling_scope(const profiling_scope&) = delete;
+		profiling_scope& operator=(const profiling_scope&) = delete;
+
+		static const profiling_scope*& current()
+		{
+			thread_local const profiling_scope* scope = nullptr;
+			return scope;
+		}
+
+		const void* m_layer;
+		const char* m_name;
+		const profiling_scope* m_previous;
+	};
+
+	// Collects host and device timestamps of the layer kernels. Device timestamps are
+	// only available for the command queues created with profiling enabled, see
+	// make_profiling_queue.
+	class profiler
+	{
+	public:
+		profiler()
+			: m_enabled(false), m_mutex(), m_records()
+		{}
+
+		void enable()
+		{
+			m_enabled = true;
+		}
+
+		void disable()
+		{
+			m_enabled = false;
+		}
+
+		bool is_enabled() const
+		{
+			return m_enabled;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_records.clear();
+		}
+
+		void add_records(
+			const std::vector<profiling_record>& records)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_records.insert(m_records.end(), records.begin(), records.end());
+		}
+
+		std::vector<profiling_record> get_records() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_records;
+		}
+
+		// Writes total time, in milliseconds, spent by every layer on the host side of the
+		// dispatch, in the kernels and in the transfers of the results back to the host.
+		void write_report(
+			std::ostream& out) const
+		{
+			struct totals
+			{
+				size_t order;
+				std::string name;
+				size_t count[4];
+				cl_ulong time[4];
+			};
+
+			auto records = get_records();
+
+			std::map<const void*, totals> layers;
+			std::map<std::pair<const void*, std::string>, std::pair<size_t, cl_ulong>> kernels;
+
+			for (const auto& record : records)
+			{
+				auto it = layers.find(record.layer);
+				if (it == layers.end())
+				{
+					totals t = { layers.size(), record.layerName, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } };
+					it = layers.insert(std::make_pair(record.layer, t)).first;
+				}
+
+				const size_t type = static_cast<size_t>(record.type);
+				it->second.count[type] += 1;
+				it->second.time[type] += record.end - record.start;
+
+				if (profiling_operation_type::kernel == record.type)
+				{
+					auto& kernel = kernels[std::make_pair(record.layer, record.operation)];
+					kernel.first += 1;
+					kernel.second += record.end - record.start;
+				}
+			}
+
+			std::vector<const totals*> ordered;
+			for (const auto& layer : layers)
+			{
+				ordered.push_back(&layer.second);
+			}
+
+			std::sort(ordered.begin(), ordered.end(), [](const totals* a, const totals* b) { return a->order < b->order; });
+
+			auto ms = [](const cl_ulong ns) { return static_cast<double>(ns) / 1000000.0; };
+
+			for (const auto* layer : ordered)
+			{
+				out << layer->name << std::endl
+					<< "\thost: " << ms(layer->time[0]) << " ms, " << layer->count[0] << " dispatches" << std::endl
+					<< "\tkernels: " << ms(layer->time[1]) << " ms, " << layer->count[1] << " launches" << std::endl
+					<< "\ttransfers: " << ms(layer->time[2] + layer->time[3]) << " ms, " << (layer->count[2] + layer->count[3]) << " maps and unmaps" << std::endl;
+
+				for (const auto& kernel : kernels)
+				{
+					if (layers.find(kernel.first.first)->second.order == layer->order)
+					{
+						out << "\t\t" << kernel.first.second << ": " << ms(kernel.second.second) << " ms, " << kernel.second.first << " launches" << std::endl;
+					}
+				}
+			}
+		}
+
+		// Writes the records in the Chrome trace event format, which can be opened in
+		// chrome://tracing or Perfetto. Host and device clocks are not related, so their
+		// events are written as two separate processes.
+		void write_trace(
+			std::ostream& out) const
+		{
+			auto records = get_records();
+
+			cl_ulong hostBase = ~static_cast<cl_ulong>(0);
+			cl_ulong deviceBase = ~static_cast<cl_ulong>(0);
+
+			std::map<const void*, size_t> threads;
+
+			for (const auto& record : records)
+			{
+				cl_ulong& base = (profiling_operation_type::host == record.type) ? hostBase : deviceBase;
+				base = std::min(base, record.start);
+
+				threads.insert(std::make_pair(record.layer, threads.size()));
+			}
+
+			static const char* categories[] = { "host", "kernel", "map", "unmap" };
+
+			out << "{\"traceEvents\":[";
+
+			bool first = true;
+			for (const auto& record : records)
+			{
+				const bool host = (profiling_operation_type::host == record.type);
+				const cl_ulong base = host ? hostBase : deviceBase;
+
+				out << (first ? "" : ",") << std::endl
+					<< "{\"name\":\"" << escape(record.operation) << "\""
+					<< ",\"cat\":\"" << categories[static_cast<size_t>(record.type)] << "\""
+					<< ",\"ph\":\"X\""
+					<< ",\"ts\":" << (static_cast<double>(record.start - base) / 1000.0)
+					<< ",\"dur\":" << (static_cast<double>(record.end - record.start) / 1000.0)
+					<< ",\"pid\":" << (host ? 1 : 0)
+					<< ",\"tid\":" << threads[record.layer]
+					<< ",\"args\":{\"layer\":\"" << escape(record.layerName) << "\"}}";
+
+				first = false;
+			}
+
+			out << std::endl << "]}" << std::endl;
+		}
+
+	private:
+		static std::string escape(
+			const std::string& value)
+		{
+			std::string result;
+			result.reserve(value.size());
+
+			for (const char c : value)
+			{
+				if (('"' == c) || ('\\' == c))
+				{
+					result.push_back('\\');
+				}
+
+				result.push_back(c);
+			}
+
+			return result;
+		}
+
+		std::atomic<bool> m_enabled;
+		mutable std::mutex m_mutex;
+		std::vector<profiling_record> m_records;
+	};
+
+	inline profiler& get_profiler()
+	{
+		static profiler instance;
+		return instance;
+	}
+
+	inline ::boost::compute::command_queue make_profiling_queue(
+		const ::boost::compute::context& context,
+		const ::boost::compute::device& device)
+	{
+		return ::boost::compute::command_queue(
+			context,
+			device,
+			::boost::compute::command_queue::enable_profiling);
+	}
+
+namespace detail {
+
+	// Tracks a single call of layer_kernels::execute_* function. Kernels are launched
+	// through the dispatch, which then maps the result buffers back into the host
+	// memory and waits for the queue to complete.
+	class kernel_dispatch
+	{
+	public:
+		kernel_dispatch(
+			const std::string& kernelName,
+			::boost::compute::command_queue& queue)
+			: m_kernelName(kernelName), m_queue(queue), m_enabled(get_profiler().is_enabled()), m_hostStart(0), m_events()
+		{
+			if (m_enabled)
+			{
+				m_hostStart = get_host_time();
+			}
+		}
+
+		void enqueued(
+			const ::boost::compute::event& e)
+		{
+			if (m_enabled)
+			{
+				m_events.push_back(std::make_pair(profiling_operation_type::kernel, e));
+			}
+		}
+
+		template <class... Views>
+		void finish(
+			Views&... results)
+		{
+			read(results...);
+
+			m_queue.finish();
+
+			if (m_enabled)
+			{
+				collect();
+			}
+		}
+
+	private:
+		kernel_dispatch(const kernel_dispatch&) = delete;
+		kernel_dispatch& operator=(const kernel_dispatch&) = delete;
+
+		void read()
+		{
+		}
+
+		template <class... Views>
+		void read(
+			::boost::compute::mapped_view<float>& view,
+			Views&... views)
+		{
+			const auto& buffer = view.get_buffer();
+
+			::boost::compute::event mapEvent;
+			void* ptr = m_queue.enqueue_map_buffer(buffer, CL_MAP_READ, 0, buffer.size(), mapEvent);
+			auto unmapEvent = m_queue.enqueue_unmap_buffer(buffer, ptr);
+
+			if (m_enabled)
+			{
+				m_events.push_back(std::make_pair(profiling_operation_type::map, mapEvent));
+				m_events.push_back(std::make_pair(profiling_operation_type::unmap, unmapEvent));
+			}
+
+			read(views...);
+		}
+
+		void collect()
+		{
+			const auto* scope = profiling_scope::get_current();
+			const void* layer = (nullptr == scope) ? nullptr : scope->get_layer();
+			const std::string layerName = (nullptr == scope) ? std::string() : std::string(scope->get_name());
+
+			std::vector<profiling_record> records;
+
+			profiling_record host = { layer, layerName, m_kernelName, profiling_operation_type::host, m_hostStart, get_host_time() };
+			records.push_back(host);
+
+			if (0 != (m_queue.get_properties() & CL_QUEUE_PROFILING_ENABLE))
+			{
+				for (const auto& e : m_events)
+				{
+					profiling_record record = {
+						layer,
+						layerName,
+						(profiling_operation_type::kernel == e.first) ? m_kernelName : m_kernelName + " result",
+						e.first,
+						e.second.get_profiling_info<cl_ulong>(CL_PROFILING_COMMAND_START),
+						e.second.get_profiling_info<cl_ulong>(CL_PROFILING_COMMAND_END)
+					};
+
+					records.push_back(record);
+				}
+			}
+
+			get_profiler().add_records(records);
+		}
+
+		static cl_ulong get_host_time()
+		{
+			return static_cast<cl_ulong>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		const std::string& m_kernelName;
+		::boost::compute::command_queue& m_queue;
+		const bool m_enabled;
+		cl_ulong m_hostStart;
+		std::vector<std::pair<profiling_operation_type, ::boost::compute::event>> m_events;
+	};
+
+}
+}
+}
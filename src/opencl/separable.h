@@ -0,0 +1,229 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include "layer_kernels.h"
+
+namespace neural_network {
+namespace opencl {
+namespace detail {
+
+	struct separable_convolution
+	{
+		template <typename Input, typename Output, typename Weights, typename Bias>
+		static void process_depthwise(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Bias& bias,
+			typename Output& result,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t paddingX,
+			const size_t paddingY,
+			const size_t dilationX,
+			const size_t dilationY,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto biasView = bias.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_depthwise_convolution_kernel(
+				inputView,
+				weightsView,
+				biasView,
+				resultView,
+				input.size<0>(),
+				input.size<1>(),
+				input.size<2>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				result.size<1>(),
+				result.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				paddingX,
+				paddingY,
+				dilationX,
+				dilationY,
+				program,
+				kernelName,
+				queue);
+		}
+
+		template <typename Input, typename Output, typename Weights, typename Bias>
+		static void compute_depthwise_gradient(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Output& gradient,
+			typename Input& result,
+			typename Weights& weightsGradient,
+			typename Bias& biasGradient,
+			const size_t strideSizeX,
+			const size_t strideSizeY,
+			const size_t paddingX,
+			const size_t paddingY,
+			const size_t dilationX,
+			const size_t dilationY,
+			const ::boost::compute::program& program,
+			const std::string& gradientKernelName,
+			const std::string& weightsGradientKernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			auto weightsGradientView = weightsGradient.get_device_view(context);
+			auto biasGradientView = biasGradient.get_device_view(context);
+
+			layer_kernels::execute_depthwise_convolution_gradient_kernel(
+				gradientView,
+				weightsView,
+				resultView,
+				input.size<0>(),
+				input.size<1>(),
+				input.size<2>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				gradient.size<1>(),
+				gradient.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				paddingX,
+				paddingY,
+				dilationX,
+				dilationY,
+				program,
+				gradientKernelName,
+				queue);
+
+			layer_kernels::execute_depthwise_convolution_weights_gradient_kernel(
+				inputView,
+				gradientView,
+				weightsGradientView,
+				biasGradientView,
+				input.size<0>(),
+				input.size<1>(),
+				input.size<2>(),
+				weights.size<1>(),
+				weights.size<2>(),
+				gradient.size<1>(),
+				gradient.size<2>(),
+				strideSizeX,
+				strideSizeY,
+				paddingX,
+				paddingY,
+				dilationX,
+				dilationY,
+				program,
+				weightsGradientKernelName,
+				queue);
+		}
+
+		template <typename Input, typename Output, typename Weights, typename Bias>
+		static void process_pointwise(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Bias& bias,
+			typename Output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto biasView = bias.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+
+			layer_kernels::execute_pointwise_convolution_kernel(
+				inputView,
+				weightsView,
+				biasView,
+				resultView,
+				weights.size<0>(),
+				weights.size<1>(),
+				input.size<1>(),
+				program,
+				kernelName,
+				queue);
+		}
+
+		template <typename Input, typename Output, typename Weights, typename Bias>
+		static void compute_pointwise_gradient(
+			const typename Input& input,
+			const typename Weights& weights,
+			const typename Output& gradient,
+			typename Input& result,
+			typename Weights& weightsGradient,
+			typename Bias& biasGradient,
+			const ::boost::compute::program& program,
+			const std::string& gradientKernelName,
+			const std::string& weightsGradientKernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto inputView = input.get_device_view(context);
+			auto weightsView = weights.get_device_view(context);
+			auto gradientView = gradient.get_device_view(context);
+			auto resultView = result.get_device_view(context);
+			auto weightsGradientView = weightsGradient.get_device_view(context);
+			auto biasGradientView = biasGradient.get_device_view(context);
+
+			layer_kernels::execute_pointwise_convolution_gradient_kernel(
+				gradientView,
+				weightsView,
+				resultView,
+				weights.size<0>(),
+				weights.size<1>(),
+				input.size<1>(),
+				program,
+				gradientKernelName,
+				queue);
+
+			layer_kernels::execute_pointwise_convolution_weights_gradient_kernel(
+				inputView,
+				gradientView,
+				weightsGradientView,
+				biasGradientView,
+				weights.size<0>(),
+				weights.size<1>(),
+				input.size<1>(),
+				program,
+				weightsGradientKernelName,
+				queue);
+		}
+	};
+
+}
+}
+}
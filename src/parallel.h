@@ -0,0 +1,645 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#elif defined(__linux__)
+
+#include <pthread.h>
+#include <sched.h>
+
+#endif
+
+namespace neural_network {
+namespace parallel {
+
+	// Smallest number of multiply-add operations worth scheduling as a separate task.
+	enum : size_t { min_task_work = 16384 };
+
+	enum class execution_mode
+	{
+		sequential,
+		parallel
+	};
+
+namespace detail {
+
+	inline bool set_thread_affinity(
+		std::thread& thread,
+		const size_t cpu)
+	{
+#if defined(_WIN32)
+		return (cpu < 8 * sizeof(DWORD_PTR))
+			&& (0 != ::SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << cpu));
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+
+		return 0 == ::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+		return true;
+#endif
+	}
+
+	// The calling thread takes part in the parallel work, so by default a pool has one worker
+	// less than the number of hardware threads.
+	inline size_t default_pool_size()
+	{
+		return std::max<unsigned int>(2u, std::thread::hardware_concurrency()) - 1;
+	}
+}
+
+	// Work-stealing thread pool. Every worker owns a task queue, takes new tasks from the back of
+	// its own queue and steals from the front of the other queues when it runs out of work.
+	// Workers are pinned to the given CPUs in round-robin order when affinity is not empty.
+	class thread_pool
+	{
+	public:
+		typedef std::function<void()> task_type;
+
+		explicit thread_pool(
+			const size_t size,
+			const std::vector<size_t>& affinity = std::vector<size_t>())
+			: m_queues(), m_workers(), m_mutex(), m_ready(), m_pending(0), m_next(0), m_stop(false)
+		{
+			for (size_t i = 0; i < size; ++i)
+			{
+				m_queues.push_back(std::make_unique<task_queue>());
+			}
+
+			for (size_t i = 0; i < size; ++i)
+			{
+				m_workers.emplace_back(&thread_pool::run, this, i);
+
+				if (!affinity.empty() && !detail::set_thread_affinity(m_workers.back(), affinity[i % affinity.size()]))
+				{
+					stop();
+					throw std::invalid_argument("Failed to set thread affinity.");
+				}
+			}
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		~thread_pool()
+		{
+			stop();
+		}
+
+		size_t size() const
+		{
+			return m_workers.size();
+		}
+
+		// Without workers the task runs on the calling thread.
+		void submit(
+			task_type task)
+		{
+			if (m_queues.empty())
+			{
+				task();
+				return;
+			}
+
+			const size_t index = (current_worker().first == this)
+				? current_worker().second
+				: (m_next++ % m_queues.size());
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_pending;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+				m_queues[index]->tasks.push_back(std::move(task));
+			}
+
+			m_ready.notify_one();
+		}
+
+	private:
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_ready.notify_all();
+
+			for (auto& worker : m_workers)
+			{
+				worker.join();
+			}
+		}
+
+		struct task_queue
+		{
+			std::mutex mutex;
+			std::deque<task_type> tasks;
+		};
+
+		static std::pair<const thread_pool*, size_t>& current_worker()
+		{
+			static thread_local std::pair<const thread_pool*, size_t> worker(nullptr, 0);
+			return worker;
+		}
+
+		bool try_pop(
+			const size_t index,
+			task_type& task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+				if (!m_queues[index]->tasks.empty())
+				{
+					task = std::move(m_queues[index]->tasks.back());
+					m_queues[index]->tasks.pop_back();
+					--m_pending;
+					return true;
+				}
+			}
+
+			for (size_t i = 1; i < m_queues.size(); ++i)
+			{
+				task_queue& victim = *m_queues[(index + i) % m_queues.size()];
+
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.tasks.empty())
+				{
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					--m_pending;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void run(
+			const size_t index)
+		{
+			current_worker() = std::make_pair(this, index);
+
+			task_type task;
+			while (true)
+			{
+				if (try_pop(index, task))
+				{
+					task();
+					task = nullptr;
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_ready.wait(lock, [this]() { return m_stop || (0 < m_pending); });
+
+				if (m_stop && (0 == m_pending))
+					return;
+			}
+		}
+
+		std::vector<std::unique_ptr<task_queue>> m_queues;
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_ready;
+		std::atomic<size_t> m_pending;
+		std::atomic<size_t> m_next;
+		bool m_stop;
+	};
+
+	// Thread pool together with the execution mode of the layers that use it. Networks, ensembles
+	// and layers accept a context to run their loops on its pool, and nested parallel loops and
+	// task groups reuse the same workers instead of starting new threads.
+	class execution_context
+	{
+	public:
+		execution_context()
+			: m_pool(std::make_shared<thread_pool>(detail::default_pool_size())), m_mode(execution_mode::parallel)
+		{
+		}
+
+		explicit execution_context(
+			const size_t threads,
+			const std::vector<size_t>& affinity = std::vector<size_t>())
+			: m_pool(std::make_shared<thread_pool>((0 < threads) ? (threads - 1) : detail::default_pool_size(), affinity)), m_mode(execution_mode::parallel)
+		{
+		}
+
+		execution_context(
+			std::shared_ptr<thread_pool> pool,
+			const execution_mode mode)
+			: m_pool(pool), m_mode(mode)
+		{
+		}
+
+		execution_context(const execution_context&) = delete;
+		execution_context& operator=(const execution_context&) = delete;
+
+		thread_pool& get_pool() const
+		{
+			return *m_pool;
+		}
+
+		// Number of threads that run a parallel loop, including the calling thread. The thread
+		// count passed to the constructor includes the calling thread as well.
+		size_t concurrency() const
+		{
+			return m_pool->size() + 1;
+		}
+
+		execution_mode get_mode() const
+		{
+			return m_mode;
+		}
+
+		void set_mode(
+			const execution_mode mode)
+		{
+			m_mode = mode;
+		}
+
+	private:
+		std::shared_ptr<thread_pool> m_pool;
+		std::atomic<execution_mode> m_mode;
+	};
+
+namespace detail {
+
+	inline execution_context*& current_context()
+	{
+		static thread_local execution_context* context = nullptr;
+		return context;
+	}
+
+	struct parallel_for_state
+	{
+		parallel_for_state(
+			const size_t chunks)
+			: next(0), done(0), chunks(chunks), mutex(), finished(), error()
+		{
+		}
+
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		const size_t chunks;
+
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+
+	template <class Function>
+	void run_chunks(
+		parallel_for_state& state,
+		const Function& function,
+		const size_t count,
+		const size_t grain)
+	{
+		for (size_t chunk = state.next++; chunk < state.chunks; chunk = state.next++)
+		{
+			try
+			{
+				const size_t last = std::min<size_t>(count, (chunk + 1) * grain);
+
+				for (size_t i = chunk * grain; i < last; ++i)
+				{
+					function(i);
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				if (!state.error)
+					state.error = std::current_exception();
+			}
+
+			if (state.chunks == ++state.done)
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.finished.notify_all();
+			}
+		}
+	}
+}
+
+	// Context used by the layers when no other context is current. Its pool is created on first
+	// use, and the layers run sequentially until set_execution_mode enables the parallel mode.
+	inline execution_context& get_default_context()
+	{
+		static execution_context instance(
+			std::make_shared<thread_pool>(detail::default_pool_size()),
+			execution_mode::sequential);
+
+		return instance;
+	}
+
+	inline thread_pool& get_thread_pool()
+	{
+		return get_default_context().get_pool();
+	}
+
+	inline void set_execution_mode(
+		const execution_mode mode)
+	{
+		get_default_context().set_mode(mode);
+	}
+
+	inline execution_mode get_execution_mode()
+	{
+		return get_default_context().get_mode();
+	}
+
+	inline execution_context& get_current_context()
+	{
+		execution_context* context = detail::current_context();
+		return (nullptr != context) ? *context : get_default_context();
+	}
+
+	// Makes the context current on the calling thread until the end of the scope.
+	class context_scope
+	{
+	public:
+		explicit context_scope(
+			execution_context& context)
+			: m_previous(detail::current_context())
+		{
+			detail::current_context() = &context;
+		}
+
+		context_scope(const context_scope&) = delete;
+		context_scope& operator=(const context_scope&) = delete;
+
+		~context_scope()
+		{
+			detail::current_context() = m_previous;
+		}
+
+	private:
+		execution_context* m_previous;
+	};
+
+	// Number of loop iterations in one task for a loop of Count iterations with Work operations
+	// per iteration. Loops that fit into a single task are not split.
+	template <const size_t Count, const size_t Work>
+	struct grain_size
+	{
+		enum : size_t {
+			min_grain = (Work < min_task_work) ? ((min_task_work + Work - 1) / Work) : 1,
+			value = (min_grain < Count) ? min_grain : Count
+		};
+
+		enum : bool { is_parallel = (value < Count) };
+	};
+
+	// Calls function(i) for every i in [0, count). Chunks of grain iterations are handed out
+	// to the pool workers and to the calling thread. The first exception is rethrown.
+	template <class Function>
+	void parallel_for(
+		thread_pool& pool,
+		const size_t count,
+		const size_t grain,
+		const Function& function)
+	{
+		const size_t chunks = (count + grain - 1) / grain;
+		auto state = std::make_shared<detail::parallel_for_state>(chunks);
+
+		const size_t helpers = std::min<size_t>(pool.size(), chunks - 1);
+		for (size_t i = 0; i < helpers; ++i)
+		{
+			pool.submit([state, &function, count, grain]() { detail::run_chunks(*state, function, count, grain); });
+		}
+
+		detail::run_chunks(*state, function, count, grain);
+
+		std::exception_ptr error;
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->finished.wait(lock, [&state]() { return state->chunks == state->done; });
+
+			error = state->error;
+			state->error = nullptr;
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	// Runs the loop on the pool of the context. The context stays current in the tasks, so nested
+	// loops use the same workers.
+	template <class Function>
+	void parallel_for(
+		execution_context& context,
+		const size_t count,
+		const size_t grain,
+		const Function& function)
+	{
+		parallel_for(
+			context.get_pool(),
+			count,
+			grain,
+			[&context, &function](const size_t i)
+			{
+				context_scope scope(context);
+				function(i);
+			});
+	}
+
+	// Loop over a compile-time range of Count iterations with Work operations each. It runs on
+	// the calling thread in the sequential mode or when the whole loop fits into one task.
+	template <const size_t Count, const size_t Work, class Function>
+	void parallel_for(
+		execution_context& context,
+		const Function& function)
+	{
+		typedef grain_size<Count, Work> grain;
+
+		if (grain::is_parallel && (execution_mode::parallel == context.get_mode()))
+		{
+			parallel_for(context, Count, grain::value, function);
+		}
+		else
+		{
+			for (size_t i = 0; i < Count; ++i)
+			{
+				function(i);
+			}
+		}
+	}
+
+	template <const size_t Count, const size_t Work, class Function>
+	void parallel_for(
+		const Function& function)
+	{
+		parallel_for<Count, Work>(get_current_context(), function);
+	}
+
+	// Group of tasks that run on the pool of a context. The wait method runs the tasks that
+	// were not picked up by the workers on the calling thread, waits for the rest to finish and
+	// rethrows the first exception.
+	class task_group
+	{
+	public:
+		explicit task_group(
+			execution_context& context = get_current_context())
+			: m_context(context), m_state(std::make_shared<state>()), m_tasks()
+		{
+		}
+
+		task_group(const task_group&) = delete;
+		task_group& operator=(const task_group&) = delete;
+
+		~task_group()
+		{
+			try
+			{
+				wait();
+			}
+			catch (...)
+			{
+			}
+		}
+
+		template <class Function>
+		void run(
+			Function function)
+		{
+			auto task = std::make_shared<task_record>(function);
+			m_tasks.push_back(task);
+
+			auto groupState = m_state;
+			execution_context& context = m_context;
+
+			context.get_pool().submit([groupState, task, &context]() { execute(*groupState, *task, context); });
+		}
+
+		void wait()
+		{
+			for (auto& task : m_tasks)
+			{
+				execute(*m_state, *task, m_context);
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(m_state->mutex);
+				m_state->finished.wait(lock, [this]() { return m_tasks.size() == m_state->done; });
+			}
+
+			m_tasks.clear();
+			m_state->done = 0;
+
+			std::exception_ptr error = m_state->error;
+			m_state->error = nullptr;
+
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+	private:
+		struct state
+		{
+			state()
+				: mutex(), finished(), done(0), error()
+			{
+			}
+
+			std::mutex mutex;
+			std::condition_variable finished;
+			size_t done;
+			std::exception_ptr error;
+		};
+
+		struct task_record
+		{
+			template <class Function>
+			explicit task_record(
+				Function function)
+				: started(false), function(function)
+			{
+			}
+
+			std::atomic<bool> started;
+			std::function<void()> function;
+		};
+
+		// Every task is executed once, either by a worker or by the thread that waits for the group.
+		static void execute(
+			state& groupState,
+			task_record& task,
+			execution_context& context)
+		{
+			if (task.started.exchange(true))
+				return;
+
+			std::exception_ptr error;
+			try
+			{
+				context_scope scope(context);
+				task.function();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(groupState.mutex);
+			if (error && !groupState.error)
+				groupState.error = error;
+
+			++groupState.done;
+			groupState.finished.notify_all();
+		}
+
+		execution_context& m_context;
+		std::shared_ptr<state> m_state;
+		std::vector<std::shared_ptr<task_record>> m_tasks;
+	};
+}
+}
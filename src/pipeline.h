@@ -0,0 +1,904 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "network.h"
+#include "parallel.h"
+
+namespace neural_network {
+
+namespace detail {
+
+	// Moves the first Count layers of the tail into a network made of the head layers.
+	template <const size_t Count, class Head, class Tail>
+	struct split_layers;
+
+	template <const size_t Count, class... Head, class Layer, class... Tail>
+	struct split_layers<Count, layer_list<Head...>, layer_list<Layer, Tail...>>
+		: public split_layers<(Count - 1), layer_list<Head..., Layer>, layer_list<Tail...>>
+	{
+	};
+
+	template <class... Head, class Layer, class... Tail>
+	struct split_layers<0, layer_list<Head...>, layer_list<Layer, Tail...>>
+	{
+		typedef typename network<Head...> head;
+		typedef typename layer_list<Layer, Tail...> tail;
+	};
+
+	template <class Tensor>
+	Tensor copy_tensor(
+		const Tensor& value)
+	{
+		Tensor result;
+		value.transform(result, [](const typename Tensor::number_type v) { return v; });
+
+		return result;
+	}
+
+	// Blocking queue of a fixed capacity between two pipeline stages. Once the queue is closed,
+	// push and pop fail, so the remaining stages stop when one of the stages fails.
+	template <class Value>
+	class bounded_queue
+	{
+	public:
+		explicit bounded_queue(
+			const size_t capacity)
+			: m_values(), m_capacity(capacity), m_closed(false), m_mutex(), m_changed()
+		{
+		}
+
+		bool push(
+			const Value& value)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [this]() { return m_closed || (m_values.size() < m_capacity); });
+
+			if (m_closed)
+				return false;
+
+			m_values.push_back(value);
+			m_changed.notify_all();
+
+			return true;
+		}
+
+		bool pop(
+			Value& value)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [this]() { return m_closed || !m_values.empty(); });
+
+			if (m_closed)
+				return false;
+
+			value = m_values.front();
+			m_values.pop_front();
+			m_changed.notify_all();
+
+			return true;
+		}
+
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+			m_changed.notify_all();
+		}
+
+		void reset()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_values.clear();
+			m_closed = false;
+		}
+
+	private:
+		std::deque<Value> m_values;
+		const size_t m_capacity;
+		bool m_closed;
+
+		std::mutex m_mutex;
+		std::condition_variable m_changed;
+	};
+
+	// Part of the network that runs on one thread of a pipeline. Layers keep the activations of
+	// the last processed input, so the stage has a copy of its network for every micro-batch that
+	// waits for its gradient, and the backward pass of a micro-batch reads the activations of its
+	// own copy. All copies have the same weights during a batch. The layers of the first copy
+	// accumulate the updates of the micro-batches, which are applied to every copy after the last
+	// micro-batch. The first copy is the network of the stage, and the other copies follow its
+	// weights when it is read.
+	template <class Network>
+	class pipeline_stage
+	{
+	public:
+		typedef typename Network::input input;
+		typedef typename Network::output output;
+		typedef typename Network::number_type number_type;
+
+		explicit pipeline_stage(
+			const size_t copies)
+			: m_networks(copies), m_size(0), m_pending(false)
+		{
+		}
+
+		Network& get_network()
+		{
+			return m_networks.front();
+		}
+
+		const Network& get_network() const
+		{
+			return m_networks.front();
+		}
+
+		// A batch that did not reach its update leaves a partial update in the layers, which is
+		// dropped together with the activations of the copies.
+		void begin(
+			const size_t size)
+		{
+			if (m_pending)
+				synchronize(0);
+
+			m_size = size;
+			m_pending = true;
+		}
+
+		const output& forward(
+			const size_t index,
+			const input& input)
+		{
+			return get_copy(index).process(input);
+		}
+
+		const input& backward(
+			const size_t index,
+			const output& gradient)
+		{
+			return get_copy(index).compute_gradient(gradient);
+		}
+
+		void update(
+			const size_t index,
+			const number_type rate)
+		{
+			get_copy(index).accumulate_update(m_networks.front(), rate);
+
+			if (index + 1 < m_size)
+				return;
+
+			for (size_t copy = 1; copy < m_networks.size(); ++copy)
+			{
+				m_networks[copy].apply_update(m_networks.front());
+			}
+
+			m_networks.front().apply_update(m_networks.front());
+			m_pending = false;
+		}
+
+		void read(
+			std::istream& in)
+		{
+			Network::serializer::read(in, m_networks.front());
+
+			synchronize(1);
+			m_pending = false;
+		}
+
+		void write(
+			std::ostream& out) const
+		{
+			Network::serializer::write(out, m_networks.front());
+		}
+
+	private:
+		Network& get_copy(
+			const size_t index)
+		{
+			return m_networks[index % m_networks.size()];
+		}
+
+		// Reads the weights of the first copy into the copies starting with the given one.
+		void synchronize(
+			const size_t first)
+		{
+			std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			Network::serializer::write(stream, m_networks.front());
+
+			for (size_t copy = first; copy < m_networks.size(); ++copy)
+			{
+				stream.clear();
+				stream.seekg(0);
+
+				Network::serializer::read(stream, m_networks[copy]);
+			}
+		}
+
+		std::vector<Network> m_networks;
+		size_t m_size;
+		bool m_pending;
+	};
+
+	template <class Input, class Output, class InputBatch, class OutputBatch>
+	class pipeline_processing_job
+	{
+	public:
+		typedef std::false_type is_training;
+
+		pipeline_processing_job(
+			const InputBatch& inputs,
+			OutputBatch& results,
+			parallel::execution_context& context)
+			: m_inputs(inputs), m_results(results), m_context(context)
+		{
+		}
+
+		size_t size() const
+		{
+			return InputBatch::metrics::dimension_size;
+		}
+
+		parallel::execution_context& get_context() const
+		{
+			return m_context;
+		}
+
+		bool receive(
+			const size_t index,
+			Input& value)
+		{
+			get_batch_item(m_inputs, index, value);
+			return true;
+		}
+
+		void complete(
+			const size_t index,
+			const Output& result)
+		{
+			set_batch_item(result, index, m_results);
+		}
+
+	private:
+		const InputBatch& m_inputs;
+		OutputBatch& m_results;
+		parallel::execution_context& m_context;
+	};
+
+	template <class Input, class Output, class InputBatch, class OutputBatch, class Loss>
+	class pipeline_training_job
+	{
+	public:
+		typedef std::true_type is_training;
+		typedef typename Input::number_type number_type;
+
+		pipeline_training_job(
+			const InputBatch& inputs,
+			const OutputBatch& truth,
+			Loss& loss,
+			const number_type rate,
+			parallel::execution_context& context)
+			: m_inputs(inputs), m_truth(truth), m_loss(loss), m_rate(rate), m_context(context)
+		{
+		}
+
+		size_t size() const
+		{
+			return InputBatch::metrics::dimension_size;
+		}
+
+		number_type get_rate() const
+		{
+			return m_rate;
+		}
+
+		parallel::execution_context& get_context() const
+		{
+			return m_context;
+		}
+
+		bool receive(
+			const size_t index,
+			Input& value)
+		{
+			get_batch_item(m_inputs, index, value);
+			return true;
+		}
+
+		bool send(
+			const Input&)
+		{
+			return true;
+		}
+
+		const Output& compute_loss_gradient(
+			const size_t index,
+			const Output& result)
+		{
+			Output truth;
+			get_batch_item(m_truth, index, truth);
+
+			return m_loss.compute_gradient(result, truth);
+		}
+
+	private:
+		const InputBatch& m_inputs;
+		const OutputBatch& m_truth;
+		Loss& m_loss;
+		const number_type m_rate;
+		parallel::execution_context& m_context;
+	};
+
+	// Stages of a pipeline connected by bounded queues of activations and gradients. Every stage
+	// reads its inputs from the previous stage, or from the job for the first stage. The stages
+	// follow the one forward, one backward schedule: a stage runs ahead of its gradients by the
+	// number of stages after it, and then alternates forward and backward passes.
+	template <class Network, class... Networks>
+	class pipeline_chain : protected pipeline_chain<Networks...>
+	{
+	public:
+		typedef typename pipeline_chain<Network, Networks...> this_type;
+		typedef typename pipeline_chain<Networks...> base_type;
+
+		typedef typename Network::input input;
+		typedef typename base_type::output output;
+
+		typedef typename Network::number_type number_type;
+
+		static_assert(std::is_same<typename Network::output, typename base_type::input>::value, "Output of a pipeline stage does not match input of the next stage. Stages cannot be split at a layout conversion.");
+
+		enum : size_t { stage_count = base_type::stage_count + 1 };
+
+		explicit pipeline_chain(
+			const size_t capacity)
+			: base_type(capacity), m_stage(base_type::stage_count + 1), m_inputs(capacity), m_gradients(capacity)
+		{
+		}
+
+		const output& process(
+			const input& input)
+		{
+			return base_type::process(
+				m_stage.get_network().process(input));
+		}
+
+		void reset()
+		{
+			m_inputs.reset();
+			m_gradients.reset();
+
+			base_type::reset();
+		}
+
+		template <class Job>
+		void start_next(
+			parallel::task_group& tasks,
+			Job& job)
+		{
+			base_type::start(tasks, job);
+		}
+
+		template <class Job, class Source>
+		void run(
+			Job& job,
+			Source& source)
+		{
+			parallel::context_scope scope(job.get_context());
+
+			try
+			{
+				if (!this->run_stage(job, source, typename Job::is_training()))
+					this->stop();
+			}
+			catch (...)
+			{
+				this->stop();
+				throw;
+			}
+		}
+
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t {
+				serialized_data_size =
+					base_type::serializer::serialized_data_size
+					+ Network::serializer::serialized_data_size
+			};
+
+			static void read(
+				std::istream& in,
+				value& chain)
+			{
+				chain.m_stage.read(in);
+				base_type::serializer::read(in, chain);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& chain)
+			{
+				chain.m_stage.write(out);
+				base_type::serializer::write(out, chain);
+			}
+		};
+
+	protected:
+		template <class Job>
+		void start(
+			parallel::task_group& tasks,
+			Job& job)
+		{
+			tasks.run([this, &job]() { this->run(job, *this); });
+
+			base_type::start(tasks, job);
+		}
+
+		void close()
+		{
+			m_inputs.close();
+			m_gradients.close();
+		}
+
+		bool receive(
+			const size_t,
+			input& value)
+		{
+			return m_inputs.pop(value);
+		}
+
+		bool send(
+			const input& gradient)
+		{
+			return m_gradients.push(detail::copy_tensor(gradient));
+		}
+
+		detail::bounded_queue<input> m_inputs;
+		detail::bounded_queue<input> m_gradients;
+
+	private:
+		void stop()
+		{
+			this->close();
+			base_type::close();
+		}
+
+		template <class Job, class Source>
+		bool run_stage(
+			Job& job,
+			Source& source,
+			std::false_type)
+		{
+			for (size_t index = 0; index < job.size(); ++index)
+			{
+				input value;
+				if (!source.receive(index, value))
+					return false;
+
+				if (!base_type::m_inputs.push(detail::copy_tensor(m_stage.get_network().process(value))))
+					return false;
+			}
+
+			return true;
+		}
+
+		template <class Job, class Source>
+		bool run_stage(
+			Job& job,
+			Source& source,
+			std::true_type)
+		{
+			const size_t count = job.size();
+			const size_t warmup = std::min<size_t>(base_type::stage_count, count);
+
+			m_stage.begin(count);
+
+			size_t forward = 0;
+			for (; forward < warmup; ++forward)
+			{
+				if (!this->forward(forward, source))
+					return false;
+			}
+
+			for (size_t backward = 0; backward < count; ++backward)
+			{
+				if ((forward < count) && !this->forward(forward++, source))
+					return false;
+
+				typename Network::output gradient;
+				if (!base_type::m_gradients.pop(gradient))
+					return false;
+
+				if (!source.send(m_stage.backward(backward, gradient)))
+					return false;
+
+				m_stage.update(backward, job.get_rate());
+			}
+
+			return true;
+		}
+
+		template <class Source>
+		bool forward(
+			const size_t index,
+			Source& source)
+		{
+			input value;
+			if (!source.receive(index, value))
+				return false;
+
+			return base_type::m_inputs.push(detail::copy_tensor(m_stage.forward(index, value)));
+		}
+
+		detail::pipeline_stage<Network> m_stage;
+	};
+
+	template <class Network>
+	class pipeline_chain<Network>
+	{
+	public:
+		typedef typename pipeline_chain<Network> this_type;
+
+		typedef typename Network::input input;
+		typedef typename Network::output output;
+
+		typedef typename Network::number_type number_type;
+
+		enum : size_t { stage_count = 1 };
+
+		explicit pipeline_chain(
+			const size_t capacity)
+			: m_stage(1), m_inputs(capacity), m_gradients(capacity)
+		{
+		}
+
+		const output& process(
+			const input& input)
+		{
+			return m_stage.get_network().process(input);
+		}
+
+		void reset()
+		{
+			m_inputs.reset();
+			m_gradients.reset();
+		}
+
+		template <class Job>
+		void start_next(
+			parallel::task_group&,
+			Job&)
+		{
+		}
+
+		template <class Job, class Source>
+		void run(
+			Job& job,
+			Source& source)
+		{
+			parallel::context_scope scope(job.get_context());
+
+			try
+			{
+				if (!this->run_stage(job, source, typename Job::is_training()))
+					this->close();
+			}
+			catch (...)
+			{
+				this->close();
+				throw;
+			}
+		}
+
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = Network::serializer::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& chain)
+			{
+				chain.m_stage.read(in);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& chain)
+			{
+				chain.m_stage.write(out);
+			}
+		};
+
+	protected:
+		template <class Job>
+		void start(
+			parallel::task_group& tasks,
+			Job& job)
+		{
+			tasks.run([this, &job]() { this->run(job, *this); });
+		}
+
+		void close()
+		{
+			m_inputs.close();
+			m_gradients.close();
+		}
+
+		bool receive(
+			const size_t,
+			input& value)
+		{
+			return m_inputs.pop(value);
+		}
+
+		bool send(
+			const input& gradient)
+		{
+			return m_gradients.push(detail::copy_tensor(gradient));
+		}
+
+		detail::bounded_queue<input> m_inputs;
+		detail::bounded_queue<input> m_gradients;
+
+	private:
+		template <class Job, class Source>
+		bool run_stage(
+			Job& job,
+			Source& source,
+			std::false_type)
+		{
+			for (size_t index = 0; index < job.size(); ++index)
+			{
+				input value;
+				if (!source.receive(index, value))
+					return false;
+
+				job.complete(index, m_stage.get_network().process(value));
+			}
+
+			return true;
+		}
+
+		template <class Job, class Source>
+		bool run_stage(
+			Job& job,
+			Source& source,
+			std::true_type)
+		{
+			const size_t count = job.size();
+
+			m_stage.begin(count);
+
+			for (size_t index = 0; index < count; ++index)
+			{
+				input value;
+				if (!source.receive(index, value))
+					return false;
+
+				const output& gradient = job.compute_loss_gradient(index, m_stage.forward(index, value));
+
+				if (!source.send(m_stage.backward(index, gradient)))
+					return false;
+
+				m_stage.update(index, job.get_rate());
+			}
+
+			return true;
+		}
+
+		detail::pipeline_stage<Network> m_stage;
+	};
+
+	template <const size_t Offset, class Layers, class Stages, const size_t... Cuts>
+	struct split_pipeline;
+
+	template <const size_t Offset, class... Layers, class... Stages, const size_t Cut, const size_t... Cuts>
+	struct split_pipeline<Offset, layer_list<Layers...>, layer_list<Stages...>, Cut, Cuts...>
+	{
+		static_assert(Offset < Cut, "Pipeline cut points must be in increasing order.");
+		static_assert(Cut < Offset + sizeof...(Layers), "Pipeline cut point must be before the last layer of the network.");
+
+		typedef typename split_layers<(Cut - Offset), layer_list<>, layer_list<Layers...>> split;
+
+		typedef typename split_pipeline<
+			Cut,
+			typename split::tail,
+			layer_list<Stages..., typename split::head>,
+			Cuts...>::type type;
+	};
+
+	template <const size_t Offset, class... Layers, class... Stages>
+	struct split_pipeline<Offset, layer_list<Layers...>, layer_list<Stages...>>
+	{
+		typedef typename pipeline_chain<Stages..., network<Layers...>> type;
+	};
+}
+
+	// Network split into stages before the layers with the given indices. Batches of inputs are
+	// divided into micro-batches of one input, which flow through the stages, so every stage works
+	// on a different micro-batch on its own thread. Gradients of the micro-batches are averaged, and
+	// the weights are updated once per batch. A stage keeps a copy of its layers for every
+	// micro-batch in flight, which is one more than the number of stages after it.
+	template <class Network, const size_t... Cuts>
+	class pipeline;
+
+	template <class... Layers, const size_t... Cuts>
+	class pipeline<network<Layers...>, Cuts...>
+	{
+	public:
+		typedef typename pipeline<network<Layers...>, Cuts...> this_type;
+		typedef typename network<Layers...> network_type;
+		typedef typename detail::split_pipeline<0, detail::layer_list<Layers...>, detail::layer_list<>, Cuts...>::type chain_type;
+
+		typedef typename network_type::input input;
+		typedef typename network_type::output output;
+
+		typedef typename network_type::number_type number_type;
+
+		enum : size_t { stage_count = chain_type::stage_count };
+
+		pipeline()
+			: m_chain(std::make_unique<chain_type>(stage_count)), m_context(std::make_unique<parallel::execution_context>(stage_count))
+		{
+		}
+
+		explicit pipeline(
+			const network_type& network)
+			: pipeline()
+		{
+			std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+
+			network_type::serializer::write(stream, network);
+			this_type::serializer::read(stream, *this);
+		}
+
+		pipeline(pipeline&&) = default;
+		pipeline& operator=(pipeline&&) = default;
+
+		const output& process(
+			const input& input)
+		{
+			return m_chain->process(input);
+		}
+
+		template <class InputBatch, class OutputBatch>
+		void process(
+			const InputBatch& inputs,
+			OutputBatch& results)
+		{
+			static_assert(detail::is_batch_of<InputBatch, typename input::metrics>::value, "Input batch does not match network input.");
+			static_assert(detail::is_batch_of<OutputBatch, typename output::metrics>::value, "Result batch does not match network output.");
+			static_assert(InputBatch::metrics::dimension_size == OutputBatch::metrics::dimension_size, "Input and result batch sizes do not match.");
+
+			detail::pipeline_processing_job<input, output, InputBatch, OutputBatch> job(
+				inputs,
+				results,
+				parallel::get_current_context());
+
+			this->run(job);
+		}
+
+		template <class InputBatch, class OutputBatch, class Loss>
+		void train(
+			const InputBatch& inputs,
+			const OutputBatch& truth,
+			Loss& loss,
+			const number_type rate)
+		{
+			static_assert(detail::is_batch_of<InputBatch, typename input::metrics>::value, "Input batch does not match network input.");
+			static_assert(detail::is_batch_of<OutputBatch, typename output::metrics>::value, "Truth batch does not match network output.");
+			static_assert(InputBatch::metrics::dimension_size == OutputBatch::metrics::dimension_size, "Input and truth batch sizes do not match.");
+
+			detail::pipeline_training_job<input, output, InputBatch, OutputBatch, Loss> job(
+				inputs,
+				truth,
+				loss,
+				-std::abs(rate) / static_cast<number_type>(InputBatch::metrics::dimension_size),
+				parallel::get_current_context());
+
+			this->run(job);
+		}
+
+		template <class InputBatch, class OutputBatch>
+		void process(
+			const InputBatch& inputs,
+			OutputBatch& results,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->process(inputs, results);
+		}
+
+		template <class InputBatch, class OutputBatch, class Loss>
+		void train(
+			const InputBatch& inputs,
+			const OutputBatch& truth,
+			Loss& loss,
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->train(inputs, truth, loss, rate);
+		}
+
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = chain_type::serializer::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& pipeline)
+			{
+				chain_type::serializer::read(in, *pipeline.m_chain);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& pipeline)
+			{
+				chain_type::serializer::write(out, *pipeline.m_chain);
+			}
+		};
+
+	private:
+		// The first stage runs on the calling thread, the other stages on the workers of the pipeline.
+		template <class Job>
+		void run(
+			Job& job)
+		{
+			m_chain->reset();
+
+			parallel::task_group tasks(*m_context);
+			m_chain->start_next(tasks, job);
+			m_chain->run(job, job);
+
+			tasks.wait();
+		}
+
+		std::unique_ptr<chain_type> m_chain;
+		std::unique_ptr<parallel::execution_context> m_context;
+	};
+
+	template <const size_t... Cuts, class... Layers>
+	pipeline<network<Layers...>, Cuts...> make_pipeline(
+		const network<Layers...>& net)
+	{
+		typedef pipeline<network<Layers...>, Cuts...> pipeline_type;
+		return (pipeline_type(net));
+	}
+}
\ No newline at end of file
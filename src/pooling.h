@@ -24,8 +24,17 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include "layer.h"
 #include "core.h"
+#include "layout.h"
+#include "parallel.h"
 #include "serialization.h"
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -38,14 +47,159 @@ namespace neural_network {
 	
 namespace detail {
 
-	template <class Metrics>
+	template <const size_t CoreSize>
+	struct argmax_index
+	{
+		static_assert(0 < CoreSize && CoreSize <= 65536, "Max pooling core is too large for argmax index.");
+
+		typedef typename std::conditional<
+			(CoreSize <= 256),
+			std::uint8_t,
+			std::uint16_t
+		>::type type;
+	};
+
+	// Finds the maximum of every column of a row major matrix, and the first row that holds it.
+	template <class Number, class Index>
+	void column_max(
+		const Number* values,
+		const size_t rows,
+		const size_t columns,
+		const size_t first,
+		Number* max,
+		Index* argmax)
+	{
+		for (size_t j = first; j < columns; ++j)
+		{
+			Number best = values[j];
+			size_t row = 0;
+
+			for (size_t i = 1; i < rows; ++i)
+			{
+				const Number e = values[i * columns + j];
+				if (best < e)
+				{
+					best = e;
+					row = i;
+				}
+			}
+
+			max[j] = best;
+			argmax[j] = static_cast<Index>(row);
+		}
+	}
+
+#if defined(__AVX2__)
+	// Compares 8 columns at a time with the same ordered comparison, so the results match the
+	// scalar search, including the first row of equal values.
+	template <class Index>
+	void column_max(
+		const float* values,
+		const size_t rows,
+		const size_t columns,
+		const size_t first,
+		float* max,
+		Index* argmax)
+	{
+		size_t j = first;
+		for (; j + 8 <= columns; j += 8)
+		{
+			__m256 best = _mm256_loadu_ps(values + j);
+			__m256 row = _mm256_setzero_ps();
+
+			for (size_t i = 1; i < rows; ++i)
+			{
+				const __m256 e = _mm256_loadu_ps(values + i * columns + j);
+				const __m256 greater = _mm256_cmp_ps(best, e, _CMP_LT_OQ);
+
+				best = _mm256_blendv_ps(best, e, greater);
+				row = _mm256_blendv_ps(row, _mm256_set1_ps(static_cast<float>(i)), greater);
+			}
+
+			float bestRows[8];
+			_mm256_storeu_ps(max + j, best);
+			_mm256_storeu_ps(bestRows, row);
+
+			for (size_t k = 0; k < 8; ++k)
+			{
+				argmax[j + k] = static_cast<Index>(bestRows[k]);
+			}
+		}
+
+		column_max<float, Index>(values, rows, columns, j, max, argmax);
+	}
+#endif
+
+	// Sums the window of every output of a pooling row, and scales the sums. Output k reads the
+	// values at k * stride + offset for every offset of the window, in the order of the offsets.
+	template <class Number>
+	void pooling_window_sums(
+		const Number* input,
+		const size_t* offsets,
+		const size_t windowSize,
+		const size_t stride,
+		const size_t first,
+		const size_t count,
+		const Number scale,
+		Number* result)
+	{
+		for (size_t k = first; k < count; ++k)
+		{
+			const Number* base = input + k * stride;
+
+			Number sum = 0.0f;
+			for (size_t w = 0; w < windowSize; ++w)
+			{
+				sum += base[offsets[w]];
+			}
+
+			result[k] = sum * scale;
+		}
+	}
+
+#if defined(__AVX2__)
+	// Every lane sums the window of one output in the order of the offsets, so the vectorized
+	// sums match the scalar sums and the device kernels bit for bit.
+	inline void pooling_window_sums(
+		const float* input,
+		const size_t* offsets,
+		const size_t windowSize,
+		const size_t stride,
+		const size_t first,
+		const size_t count,
+		const float scale,
+		float* result)
+	{
+		const __m256i lanes = _mm256_mullo_epi32(
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32(static_cast<int>(stride)));
+
+		size_t k = first;
+		for (; k + 8 <= count; k += 8)
+		{
+			const float* base = input + k * stride;
+
+			__m256 sum = _mm256_setzero_ps();
+			for (size_t w = 0; w < windowSize; ++w)
+			{
+				sum = _mm256_add_ps(sum, _mm256_i32gather_ps(base + offsets[w], lanes, 4));
+			}
+
+			_mm256_storeu_ps(result + k, _mm256_mul_ps(sum, _mm256_set1_ps(scale)));
+		}
+
+		pooling_window_sums<float>(input, offsets, windowSize, stride, k, count, scale, result);
+	}
+#endif
+
+	template <class Metrics, class Number>
 	class scalar_max_pooling
 	{
 	public:
-		typedef typename scalar_max_pooling<Metrics> this_type;
+		typedef typename scalar_max_pooling<Metrics, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef algebra::metrics<1>::tensor_type output;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::metrics<1>::template tensor_of<Number>::type output;
 
 		static_assert(Metrics::rank == 1, "Invalid metric rank for scalar max pooling.");
 
@@ -56,22 +210,18 @@ namespace detail {
 		typedef typename input::number_type number_type;
 
 		scalar_max_pooling()
-			: m_mask()
+			: m_argmax(0)
 		{}
 	
 		void process(
 			const input& input,
 			output& result)
 		{
-			m_mask(0) = 0.0f;
-
 			number_type max = input(0);
 			size_t imax = 0;
 
 			for (size_t i = 1; i < input.size<0>(); ++i)
 			{
-				m_mask(i) = 0.0f;
-
 				auto e = input(i);
 				if (max < e)
 				{
@@ -80,7 +230,7 @@ namespace detail {
 				}
 			}
 
-			m_mask(imax) = 1.0f;
+			m_argmax = imax;
 			result(0) = max;
 		}
 
@@ -88,10 +238,8 @@ namespace detail {
 			const output& grad,
 			input& result)
 		{
-			for (size_t i = 0; i < result.size<0>(); ++i)
-			{
-				result(i) = (0.0f < m_mask(i)) ? grad(0) : 0.0f;
-			}
+			result.fill(0.0f);
+			result(m_argmax) = grad(0);
 		}
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -108,20 +256,20 @@ namespace detail {
 #endif
 
 	private:
-		input m_mask;
+		size_t m_argmax;
 	};
 
-	template <class Metrics>
+	template <class Metrics, class Number>
 	class generic_max_pooling
 	{
 	public:
-		typedef typename generic_max_pooling<Metrics> this_type;
+		typedef typename generic_max_pooling<Metrics, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename Metrics::shrink::type::tensor_type output;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename Metrics::shrink::type::template tensor_of<Number>::type output;
 
-		typedef typename algebra::metrics<Metrics::dimension_size, output::data_size>::tensor_type reshaped_input;
-		typedef typename algebra::metrics<output::data_size>::tensor_type reshaped_output;
+		typedef typename algebra::metrics<Metrics::dimension_size, output::data_size>::template tensor_of<Number>::type reshaped_input;
+		typedef typename algebra::metrics<output::data_size>::template tensor_of<Number>::type reshaped_output;
 
 		static_assert(2 <= Metrics::rank, "Metric rank is too small for generic max pooling.");
 
@@ -130,9 +278,10 @@ namespace detail {
 			"Input and output tensor value types do not match.");
 
 		typedef typename input::number_type number_type;
+		typedef typename argmax_index<Metrics::dimension_size>::type index_type;
 
 		generic_max_pooling()
-			: m_mask()
+			: m_argmax(output::data_size)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 			, m_kernelProgram(), m_processKernelName()
 #endif
@@ -142,31 +291,13 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			reshaped_input rin = input.reshape<reshaped_input::metrics>();
-			reshaped_output rout = result.reshape<reshaped_output::metrics>();
-
-			for (size_t j = 0; j < rin.size<1>(); ++j)
-			{
-				m_mask(0, j) = 0.0f;
-
-				number_type max = rin(0, j);
-				size_t imax = 0;
-
-				for (size_t i = 1; i < rin.size<0>(); ++i)
-				{
-					m_mask(i, j) = 0.0f;
-
-					auto e = rin(i, j);
-					if (max < e)
-					{
-						max = e;
-						imax = i;
-					}
-				}
-
-				m_mask(imax, j) = 1.0f;
-				rout(j) = max;
-			}
+			column_max(
+				input.data(),
+				Metrics::dimension_size,
+				output::data_size,
+				0,
+				result.data(),
+				m_argmax.data());
 		}
 
 		void compute_gradient(
@@ -176,12 +307,11 @@ namespace detail {
 			reshaped_input rresult = result.reshape<reshaped_input::metrics>();
 			reshaped_output rgrad = grad.reshape<reshaped_output::metrics>();
 
-			for (size_t i = 0; i < rresult.size<0>(); ++i)
+			rresult.fill(0.0f);
+
+			for (size_t j = 0; j < rresult.size<1>(); ++j)
 			{
-				for (size_t j = 0; j < rresult.size<1>(); ++j)
-				{
-					rresult(i, j) = (0.0f < m_mask(i, j)) ? rgrad(j) : 0.0f;
-				}
+				rresult(m_argmax[j], j) = rgrad(j);
 			}
 		}
 
@@ -208,8 +338,6 @@ namespace detail {
 				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
 			>* = 0)
 		{
-			m_mask.fill(0.0f);
-
 			reshaped_input rin = input.reshape<reshaped_input::metrics>();
 			auto rout = result.reshape<typename reshaped_output::metrics::template expand<1>::type>();
 
@@ -220,7 +348,7 @@ namespace detail {
 			opencl::detail::max_pooling::process_2d(
 				rin,
 				rout,
-				m_mask,
+				m_argmax,
 				rin.size<0>(),
 				1,
 				rin.size<0>(),
@@ -238,13 +366,13 @@ namespace detail {
 			{
 				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
 
-				m_processKernelName = opencl::detail::layer_kernels::get_2d_max_pooling_kernel_name();
+				m_processKernelName = opencl::detail::layer_kernels::get_2d_max_pooling_kernel_name<index_type>();
 			}
 		}
 
 #endif
 	private:
-		reshaped_input m_mask;
+		std::vector<index_type> m_argmax;
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
@@ -255,37 +383,42 @@ namespace detail {
 #endif
 	};
 
-	template <class Metrics>
+	template <class Metrics, class Number>
 	struct max_pooling_impl
 	{
 		typedef typename std::conditional<
 			Metrics::rank == 1, 
-			scalar_max_pooling<Metrics>,
-			generic_max_pooling<Metrics>
+			scalar_max_pooling<Metrics, Number>,
+			generic_max_pooling<Metrics, Number>
 		>::type type;
 	};
 
-	template <class Metrics, class Core, class Stride>
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, class Number>
 	class max_pooling_1d
 	{
 	public:
 		static_assert(Metrics::rank == 1, "Invalid metric rank for 1D max pooling.");
 
-		typedef typename max_pooling_1d<Metrics, Core, Stride> this_type;
+		typedef typename max_pooling_1d<Metrics, Core, Stride, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::tensor_type output;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics::template tensor_of<Number>::type output;
 
 		static_assert(
 			std::is_same<typename input::number_type, typename input::number_type>::value,
 			"Input and output tensor value types do not match.");
 
 		typedef typename input::number_type number_type;
+		typedef typename argmax_index<Core::data_size>::type index_type;
+
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
 
 		max_pooling_1d()
-			: m_mask()
+			: m_argmax(output::data_size)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_processKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
 #endif
 		{}
 
@@ -293,28 +426,27 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			m_mask.fill(0.0f);
-
-			for (size_t stride = 0; stride < result.size<0>(); ++stride)
+			parallel::parallel_for<output::data_size, Core::data_size>([this, &input, &result](const size_t stride)
 			{
-				const size_t baseX = stride * algebra::detail::dimension<Stride, 0>::size;
+				const size_t firstX = window_x::begin(stride);
+				const size_t lastX = window_x::end(stride);
 
-				number_type max = input(baseX);
-				size_t maxX = baseX;
+				number_type max = input(window_x::offset(stride, firstX));
+				size_t maxX = firstX;
 
-				for (size_t x = 1; x < algebra::detail::dimension<Core, 0>::size; ++x)
+				for (size_t x = firstX + 1; x < lastX; ++x)
 				{
-					auto e = input(baseX + x);
+					auto e = input(window_x::offset(stride, x));
 					if (max < e)
 					{
 						max = e;
-						maxX = baseX + x;
+						maxX = x;
 					}
 				}
 
 				result(stride) = max;
-				m_mask(maxX) += 1.0f;
-			}
+				m_argmax[stride] = static_cast<index_type>(maxX);
+			});
 		}
 
 		void compute_gradient(
@@ -325,17 +457,7 @@ namespace detail {
 
 			for (size_t stride = 0; stride < grad.size<0>(); ++stride)
 			{
-				number_type g = grad(stride);
-
-				const size_t baseX = stride * algebra::detail::dimension<Stride, 0>::size;
-
-				for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
-				{
-					if (0.0f < m_mask(baseX + x))
-					{
-						result(baseX + x) += g;
-					}
-				}
+				result(window_x::offset(stride, m_argmax[stride])) += grad(stride);
 			}
 		}
 
@@ -347,7 +469,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -359,11 +481,9 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size) && is_dense
 			>* = 0)
 		{
-			m_mask.fill(0.0f);
-
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
@@ -371,7 +491,7 @@ namespace detail {
 			opencl::detail::max_pooling::process_1d(
 				input,
 				result,
-				m_mask,
+				m_argmax,
 				algebra::detail::dimension<Core, 0>::size,
 				algebra::detail::dimension<Stride, 0>::size,
 				m_kernelProgram,
@@ -380,6 +500,53 @@ namespace detail {
 				queue);
 		}
 
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			std::vector<index_type> argmax(BatchOutput::data_size);
+
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::max_pooling::process_batch_1d(
+				input,
+				result,
+				argmax,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void compute_batch_gradient(
+			const BatchInput& input,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::max_pooling::compute_batch_gradient_1d(
+				input,
+				gradient,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
 		void initialize_opencl(
 			const ::boost::compute::context& context)
 		{
@@ -387,45 +554,59 @@ namespace detail {
 			{
 				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
 
-				m_processKernelName = opencl::detail::layer_kernels::get_1d_max_pooling_kernel_name();
+				m_processKernelName = opencl::detail::layer_kernels::get_1d_max_pooling_kernel_name<index_type>();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_1d_max_pooling_gradient_kernel_name();
 			}
 		}
 
 #endif
 
 	private:
-		input m_mask;
+		std::vector<index_type> m_argmax;
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	private:
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
+		std::string m_gradientKernelName;
 
 #endif
 	};
 
-	template <class Metrics, class Core, class Stride>
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, class Number>
 	class max_pooling_2d
 	{
 	public:
 		static_assert(Metrics::rank == 2, "Invalid metric rank for 2D max pooling.");
 
-		typedef typename max_pooling_2d<Metrics, Core, Stride> this_type;
+		typedef typename max_pooling_2d<Metrics, Core, Stride, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::tensor_type output;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics::template tensor_of<Number>::type output;
 
 		static_assert(
 			std::is_same<typename input::number_type, typename input::number_type>::value,
 			"Input and output tensor value types do not match.");
 
 		typedef typename input::number_type number_type;
+		typedef typename argmax_index<Core::data_size>::type index_type;
+
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 1> window_y;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		enum : size_t {
+			output_rows = algebra::detail::dimension<typename output::metrics, 0>::size,
+			output_row_size = output::data_size / output_rows,
+			row_work = output_row_size * Core::data_size
+		};
 
 		max_pooling_2d()
-			: m_mask()
+			: m_argmax(output::data_size)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_processKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
 #endif
 		{}
 
@@ -433,37 +614,39 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			m_mask.fill(0.0f);
-
-			for (size_t strideX = 0; strideX < result.size<0>(); ++strideX)
+			parallel::parallel_for<output_rows, row_work>([this, &input, &result](const size_t strideX)
 			{
+				size_t index = strideX * output_row_size;
+
 				for (size_t strideY = 0; strideY < result.size<1>(); ++strideY)
 				{
-					const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-					const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+					const size_t firstX = window_x::begin(strideX);
+					const size_t lastX = window_x::end(strideX);
+					const size_t firstY = window_y::begin(strideY);
+					const size_t lastY = window_y::end(strideY);
 
-					number_type max = input(baseX, baseY);
-					size_t maxX = baseX;
-					size_t maxY = baseY;
+					number_type max = input(window_x::offset(strideX, firstX), window_y::offset(strideY, firstY));
+					size_t maxOffset = (firstX * algebra::detail::dimension<Core, 1>::size) + firstY;
 
-					for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+					for (size_t x = firstX; x < lastX; ++x)
 					{
-						for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+						const size_t inputX = window_x::offset(strideX, x);
+
+						for (size_t y = firstY; y < lastY; ++y)
 						{
-							auto e = input(baseX + x, baseY + y);
+							auto e = input(inputX, window_y::offset(strideY, y));
 							if (max < e)
 							{
 								max = e;
-								maxX = baseX + x;
-								maxY = baseY + y;
+								maxOffset = (x * algebra::detail::dimension<Core, 1>::size) + y;
 							}
 						}
 					}
 
 					result(strideX, strideY) = max;
-					m_mask(maxX, maxY) += 1.0f;
+					m_argmax[index++] = static_cast<index_type>(maxOffset);
 				}
-			}
+			});
 		}
 
 		void compute_gradient(
@@ -472,27 +655,29 @@ namespace detail {
 		{
 			result.fill(0.0f);
 
-			for (size_t strideX = 0; strideX < grad.size<0>(); ++strideX)
+			// Input rows are updated independently, every element still receives its terms in
+			// the order of the output positions.
+			parallel::parallel_for<algebra::detail::dimension<Metrics, 0>::size, row_work>([this, &grad, &result](const size_t inputX)
 			{
-				for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
-				{
-					number_type g = grad(strideX, strideY);
+				const size_t lastX = window_x::last_position(inputX);
 
-					const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-					const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+				for (size_t strideX = window_x::first_position(inputX); strideX < lastX; ++strideX)
+				{
+					size_t index = strideX * output_row_size;
 
-					for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+					for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
 					{
-						for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+						const size_t offset = m_argmax[index++];
+
+						if (window_x::offset(strideX, offset / algebra::detail::dimension<Core, 1>::size) == inputX)
 						{
-							if (0.0f < m_mask(baseX + x, baseY + y))
-							{
-								result(baseX + x, baseY + y) += g;
-							}
+							result(
+								inputX,
+								window_y::offset(strideY, offset % algebra::detail::dimension<Core, 1>::size)) += grad(strideX, strideY);
 						}
 					}
 				}
-			}
+			});
 		}
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -503,7 +688,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -515,11 +700,9 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size) && is_dense
 			>* = 0)
 		{
-			m_mask.fill(0.0f);
-
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
@@ -527,7 +710,33 @@ namespace detail {
 			opencl::detail::max_pooling::process_2d(
 				input,
 				result,
-				m_mask,
+				m_argmax,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			std::vector<index_type> argmax(BatchOutput::data_size);
+
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::max_pooling::process_batch_2d(
+				input,
+				result,
+				argmax,
 				algebra::detail::dimension<Core, 0>::size,
 				algebra::detail::dimension<Core, 1>::size,
 				algebra::detail::dimension<Stride, 0>::size,
@@ -538,6 +747,31 @@ namespace detail {
 				queue);
 		}
 
+		template <class BatchInput, class BatchOutput>
+		void compute_batch_gradient(
+			const BatchInput& input,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::max_pooling::compute_batch_gradient_2d(
+				input,
+				gradient,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
 		void initialize_opencl(
 			const ::boost::compute::context& context)
 		{
@@ -545,45 +779,60 @@ namespace detail {
 			{
 				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
 
-				m_processKernelName = opencl::detail::layer_kernels::get_2d_max_pooling_kernel_name();
+				m_processKernelName = opencl::detail::layer_kernels::get_2d_max_pooling_kernel_name<index_type>();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_2d_max_pooling_gradient_kernel_name();
 			}
 		}
 
 #endif
 
 	private:
-		input m_mask;
+		std::vector<index_type> m_argmax;
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 	private:
 		::boost::compute::program m_kernelProgram;
 		std::string m_processKernelName;
+		std::string m_gradientKernelName;
 
 #endif
 	};
 
-	template <class Metrics, class Core, class Stride>
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, class Number>
 	class max_pooling_3d
 	{
 	public:
 		static_assert(Metrics::rank == 3, "Invalid metric rank for 3D max pooling.");
 
-		typedef typename max_pooling_3d<Metrics, Core, Stride> this_type;
+		typedef typename max_pooling_3d<Metrics, Core, Stride, Padding, Dilation, Number> this_type;
 
-		typedef typename Metrics::tensor_type input;
-		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::tensor_type output;
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics::template tensor_of<Number>::type output;
 
 		static_assert(
 			std::is_same<typename input::number_type, typename input::number_type>::value,
 			"Input and output tensor value types do not match.");
 
 		typedef typename input::number_type number_type;
+		typedef typename argmax_index<Core::data_size>::type index_type;
+
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 1> window_y;
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, 2> window_z;
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		enum : size_t {
+			output_rows = algebra::detail::dimension<typename output::metrics, 0>::size,
+			output_row_size = output::data_size / output_rows,
+			row_work = output_row_size * Core::data_size
+		};
 
 		max_pooling_3d()
-			: m_mask()
+			: m_argmax(output::data_size)
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
-			, m_kernelProgram(), m_processKernelName()
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
 #endif
 		{}
 
@@ -591,46 +840,52 @@ namespace detail {
 			const input& input,
 			output& result)
 		{
-			m_mask.fill(0.0f);
-
-			for (size_t strideX = 0; strideX < result.size<0>(); ++strideX)
+			parallel::parallel_for<output_rows, row_work>([this, &input, &result](const size_t strideX)
 			{
+				size_t index = strideX * output_row_size;
+
 				for (size_t strideY = 0; strideY < result.size<1>(); ++strideY)
 				{
 					for (size_t strideZ = 0; strideZ < result.size<2>(); ++strideZ)
 					{
-						const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-						const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
-						const size_t baseZ = strideZ * algebra::detail::dimension<Stride, 2>::size;
-
-						number_type max = input(baseX, baseY, baseZ);
-						size_t maxX = baseX;
-						size_t maxY = baseY;
-						size_t maxZ = baseZ;
-
-						for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+						const size_t firstX = window_x::begin(strideX);
+						const size_t lastX = window_x::end(strideX);
+						const size_t firstY = window_y::begin(strideY);
+						const size_t lastY = window_y::end(strideY);
+						const size_t firstZ = window_z::begin(strideZ);
+						const size_t lastZ = window_z::end(strideZ);
+
+						number_type max = input(
+							window_x::offset(strideX, firstX),
+							window_y::offset(strideY, firstY),
+							window_z::offset(strideZ, firstZ));
+						size_t maxOffset = (((firstX * algebra::detail::dimension<Core, 1>::size) + firstY) * algebra::detail::dimension<Core, 2>::size) + firstZ;
+
+						for (size_t x = firstX; x < lastX; ++x)
 						{
-							for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+							const size_t inputX = window_x::offset(strideX, x);
+
+							for (size_t y = firstY; y < lastY; ++y)
 							{
-								for (size_t z = 0; z < algebra::detail::dimension<Core, 2>::size; ++z)
+								const size_t inputY = window_y::offset(strideY, y);
+
+								for (size_t z = firstZ; z < lastZ; ++z)
 								{
-									auto e = input(baseX + x, baseY + y, baseZ + z);
+									auto e = input(inputX, inputY, window_z::offset(strideZ, z));
 									if (max < e)
 									{
 										max = e;
-										maxX = baseX + x;
-										maxY = baseY + y;
-										maxZ = baseZ + z;
+										maxOffset = (((x * algebra::detail::dimension<Core, 1>::size) + y) * algebra::detail::dimension<Core, 2>::size) + z;
 									}
 								}
 							}
 						}
 
 						result(strideX, strideY, strideZ) = max;
-						m_mask(maxX, maxY, maxZ) += 1.0f;
+						m_argmax[index++] = static_cast<index_type>(maxOffset);
 					}
 				}
-			}
+			});
 		}
 
 		void compute_gradient(
@@ -639,34 +894,31 @@ namespace detail {
 		{
 			result.fill(0.0f);
 
-			for (size_t strideX = 0; strideX < grad.size<0>(); ++strideX)
+			parallel::parallel_for<algebra::detail::dimension<Metrics, 0>::size, row_work>([this, &grad, &result](const size_t inputX)
 			{
-				for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
-				{
-					for (size_t strideZ = 0; strideZ < grad.size<2>(); ++strideZ)
-					{
-						number_type g = grad(strideX, strideY, strideZ);
+				const size_t lastX = window_x::last_position(inputX);
 
-						const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
-						const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
-						const size_t baseZ = strideZ * algebra::detail::dimension<Stride, 2>::size;
+				for (size_t strideX = window_x::first_position(inputX); strideX < lastX; ++strideX)
+				{
+					size_t index = strideX * output_row_size;
 
-						for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+					for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
+					{
+						for (size_t strideZ = 0; strideZ < grad.size<2>(); ++strideZ)
 						{
-							for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+							const size_t offset = m_argmax[index++];
+
+							if (window_x::offset(strideX, offset / (algebra::detail::dimension<Core, 1>::size * algebra::detail::dimension<Core, 2>::size)) == inputX)
 							{
-								for (size_t z = 0; z < algebra::detail::dimension<Core, 2>::size; ++z)
-								{
-									if (0.0f < m_mask(baseX + x, baseY + y, baseZ + z))
-									{
-										result(baseX + x, baseY + y, baseZ + z) += g;
-									}
-								}
+								result(
+									inputX,
+									window_y::offset(strideY, (offset / algebra::detail::dimension<Core, 2>::size) % algebra::detail::dimension<Core, 1>::size),
+									window_z::offset(strideZ, offset % algebra::detail::dimension<Core, 2>::size)) += grad(strideX, strideY, strideZ);
 							}
 						}
 					}
 				}
-			}
+			});
 		}
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
@@ -677,7 +929,7 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue&,
 			std::enable_if_t<
-				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size) || !is_dense
 			>* = 0)
 		{
 			this->process(input, result);
@@ -689,11 +941,9 @@ namespace detail {
 			output& result,
 			::boost::compute::command_queue& queue,
 			std::enable_if_t<
-				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size) && is_dense
 			>* = 0)
 		{
-			m_mask.fill(0.0f);
-
 			auto context = queue.get_context();
 
 			initialize_opencl(context);
@@ -701,7 +951,7 @@ namespace detail {
 			opencl::detail::max_pooling::process_3d(
 				input,
 				result,
-				m_mask,
+				m_argmax,
 				algebra::detail::dimension<Core, 0>::size,
 				algebra::detail::dimension<Core, 1>::size,
 				algebra::detail::dimension<Core, 2>::size,
@@ -714,94 +964,1127 @@ namespace detail {
 				queue);
 		}
 
-		void initialize_opencl(
-			const ::boost::compute::context& context)
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
 		{
-			if (0 == m_processKernelName.size())
-			{
-				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+			std::vector<index_type> argmax(BatchOutput::data_size);
 
-				m_processKernelName = opencl::detail::layer_kernels::get_3d_max_pooling_kernel_name();
-			}
-		}
-
-#endif
-
-	private:
-		input m_mask;
-
-#ifdef NEURAL_NET_ENABLE_OPEN_CL
-
-	private:
-		::boost::compute::program m_kernelProgram;
-		std::string m_processKernelName;
+			auto context = queue.get_context();
 
-#endif
-	};
+			initialize_opencl(context);
 
-	template <class Metrics, class Core, class Stride>
+			opencl::detail::max_pooling::process_batch_3d(
+				input,
+				result,
+				argmax,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Core, 2>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void compute_batch_gradient(
+			const BatchInput& input,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue& queue)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::max_pooling::compute_batch_gradient_3d(
+				input,
+				gradient,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Core, 2>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_3d_max_pooling_kernel_name<index_type>();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_3d_max_pooling_gradient_kernel_name();
+			}
+		}
+
+#endif
+
+	private:
+		std::vector<index_type> m_argmax;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+
+#endif
+	};
+
+	template <class Metrics, class Core, class Stride, typename _Layer>
+	struct pooling_core_serializer
+	{
+		typedef typename _Layer value_type;
+
+		typedef typename serialization::metrics_serializer<Metrics> _metrics_serializer;
+		typedef typename serialization::metrics_serializer<Core> _core_serializer;
+		typedef typename serialization::metrics_serializer<Stride> _stride_serializer;
+
+		enum : size_t {
+			serialized_data_size =
+			_metrics_serializer::serialized_data_size
+			+ _core_serializer::serialized_data_size
+			+ _stride_serializer::serialized_data_size
+		};
+
+		static void read(
+			std::istream& in,
+			value_type&)
+		{
+			_metrics_serializer::read(in);
+			_core_serializer::read(in);
+			_stride_serializer::read(in);
+		}
+
+		static void write(
+			std::ostream& out,
+			const value_type&)
+		{
+			_metrics_serializer::write(out);
+			_core_serializer::write(out);
+			_stride_serializer::write(out);
+		}
+	};
+
+	// Max pooling of a tensor with the channel dimension stored last. Every channel is pooled
+	// independently, and the innermost loops run over the channels, which are contiguous in memory.
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, class Number>
+	class max_pooling_channels_last
+	{
+	public:
+		static_assert(2 <= Metrics::rank && Metrics::rank <= 3, "Channels last max pooling is supported only for 2D or 3D tensors.");
+		static_assert(1 == algebra::detail::dimension<Core, (Core::rank - 1)>::size, "Core must not span the channel dimension.");
+		static_assert(1 == algebra::detail::dimension<Stride, (Stride::rank - 1)>::size, "Stride must be 1 in the channel dimension.");
+		static_assert(0 == algebra::detail::dimension<Padding, (Padding::rank - 1)>::size, "Channel dimension must not be padded.");
+		static_assert(1 == algebra::detail::dimension<Dilation, (Dilation::rank - 1)>::size, "Channel dimension must not be dilated.");
+
+		typedef typename max_pooling_channels_last<Metrics, Core, Stride, Padding, Dilation, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_padding<Metrics, Core, Stride, Padding, Dilation, Metrics::rank>::metrics::template tensor_of<Number>::type output;
+
+		typedef typename input::number_type number_type;
+		typedef typename argmax_index<Core::data_size>::type index_type;
+
+		typedef typename extend_channels_last_shape<Metrics, 1>::type volume_metrics;
+		typedef typename extend_channels_last_shape<Core, 1>::type volume_core;
+		typedef typename extend_channels_last_shape<Stride, 1>::type volume_stride;
+		typedef typename extend_channels_last_shape<Padding, 0>::type volume_padding;
+		typedef typename extend_channels_last_shape<Dilation, 1>::type volume_dilation;
+		typedef typename extend_channels_last_shape<typename output::metrics, 1>::type volume_output;
+
+		typedef typename algebra::detail::core_window<volume_metrics, volume_core, volume_stride, volume_padding, volume_dilation, 0> window_x;
+		typedef typename algebra::detail::core_window<volume_metrics, volume_core, volume_stride, volume_padding, volume_dilation, 1> window_y;
+
+		enum : size_t { channels = algebra::detail::dimension<Metrics, (Metrics::rank - 1)>::size };
+
+		enum : bool { is_dense = algebra::detail::is_dense_core<Padding, Dilation>::value };
+
+		max_pooling_channels_last()
+			: m_argmax(output::data_size)
+		{}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			auto in = input.reshape<volume_metrics>();
+			auto out = result.reshape<volume_output>();
+
+			index_type* argmax = m_argmax.data();
+
+			for (size_t strideX = 0; strideX < out.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < out.size<1>(); ++strideY)
+				{
+					const size_t firstX = window_x::begin(strideX);
+					const size_t lastX = window_x::end(strideX);
+					const size_t firstY = window_y::begin(strideY);
+					const size_t lastY = window_y::end(strideY);
+
+					number_type* max = std::addressof(out(strideX, strideY, 0));
+					const number_type* first = std::addressof(in(window_x::offset(strideX, firstX), window_y::offset(strideY, firstY), 0));
+					const index_type firstOffset = static_cast<index_type>((firstX * window_y::core_size) + firstY);
+
+					for (size_t channel = 0; channel < channels; ++channel)
+					{
+						max[channel] = first[channel];
+						argmax[channel] = firstOffset;
+					}
+
+					for (size_t x = firstX; x < lastX; ++x)
+					{
+						const size_t inputX = window_x::offset(strideX, x);
+
+						for (size_t y = firstY; y < lastY; ++y)
+						{
+							const number_type* e = std::addressof(in(inputX, window_y::offset(strideY, y), 0));
+							const index_type offset = static_cast<index_type>((x * window_y::core_size) + y);
+
+							for (size_t channel = 0; channel < channels; ++channel)
+							{
+								if (max[channel] < e[channel])
+								{
+									max[channel] = e[channel];
+									argmax[channel] = offset;
+								}
+							}
+						}
+					}
+
+					argmax += channels;
+				}
+			}
+		}
+
+		void compute_gradient(
+			const output& grad,
+			input& result)
+		{
+			result.fill(0.0f);
+
+			auto gradient = grad.reshape<volume_output>();
+			auto inputGradient = result.reshape<volume_metrics>();
+
+			const index_type* argmax = m_argmax.data();
+
+			for (size_t strideX = 0; strideX < gradient.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < gradient.size<1>(); ++strideY)
+				{
+					const number_type* g = std::addressof(gradient(strideX, strideY, 0));
+
+					for (size_t channel = 0; channel < channels; ++channel)
+					{
+						const size_t offset = argmax[channel];
+
+						inputGradient(
+							window_x::offset(strideX, offset / window_y::core_size),
+							window_y::offset(strideY, offset % window_y::core_size),
+							channel) += g[channel];
+					}
+
+					argmax += channels;
+				}
+			}
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&)
+		{
+			this->process(input, result);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void process_batch(
+			const BatchInput& batch,
+			BatchOutput& result,
+			::boost::compute::command_queue&)
+		{
+			this_type pooling;
+
+			input item;
+			output itemResult;
+
+			for (size_t i = 0; i < BatchInput::metrics::dimension_size; ++i)
+			{
+				get_batch_item(batch, i, item);
+				pooling.process(item, itemResult);
+				set_batch_item(itemResult, i, result);
+			}
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void compute_batch_gradient(
+			const BatchInput& batch,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue&)
+		{
+			this_type pooling;
+
+			input item;
+			input itemResult;
+			output itemOutput;
+			output itemGradient;
+
+			for (size_t i = 0; i < BatchInput::metrics::dimension_size; ++i)
+			{
+				get_batch_item(batch, i, item);
+				get_batch_item(gradient, i, itemGradient);
+				pooling.process(item, itemOutput);
+				pooling.compute_gradient(itemGradient, itemResult);
+				set_batch_item(itemResult, i, result);
+			}
+		}
+
+#endif
+
+	private:
+		std::vector<index_type> m_argmax;
+	};
+
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, class Layout, class Number>
 	struct max_pooling_core_impl
 	{
 		static_assert(1 <= Metrics::rank == 1 && Metrics::rank <= 3, "Max pooling with core is supported only for 1D, 2D or 3D tensors.");
 
-		typedef typename max_pooling_core_impl<Metrics, Core, Stride> this_type;
+		typedef typename max_pooling_core_impl<Metrics, Core, Stride, Padding, Dilation, Layout, Number> this_type;
+
+		typedef typename std::conditional<
+			std::is_same<Layout, layout::channels_last>::value,
+			max_pooling_channels_last<Metrics, Core, Stride, Padding, Dilation, Number>,
+			typename std::conditional<
+				Metrics::rank == 1,
+				max_pooling_1d<Metrics, Core, Stride, Padding, Dilation, Number>,
+				typename std::conditional<
+					Metrics::rank == 2,
+					max_pooling_2d<Metrics, Core, Stride, Padding, Dilation, Number>,
+					max_pooling_3d<Metrics, Core, Stride, Padding, Dilation, Number>
+				>::type
+			>::type
+		>::type type;
+
+		template <typename _Layer>
+		struct serializer : public pooling_core_serializer<Metrics, Core, Stride, _Layer>
+		{};
+	};
+
+	template <class Metrics, class Core, class Stride, class Number>
+	class average_pooling_1d
+	{
+	public:
+		static_assert(Metrics::rank == 1, "Invalid metric rank for 1D average pooling.");
+
+		typedef typename average_pooling_1d<Metrics, Core, Stride, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::template tensor_of<Number>::type output;
+
+		typedef typename input::number_type number_type;
+
+		average_pooling_1d()
+			: m_offsets(get_window_offsets())
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
+#endif
+		{}
+
+		// Offsets of the window of an output from its first input.
+		static std::vector<size_t> get_window_offsets()
+		{
+			std::vector<size_t> offsets;
+			for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+			{
+				offsets.push_back(x);
+			}
+
+			return offsets;
+		}
+
+		static number_type get_scale()
+		{
+			return 1.0f / static_cast<number_type>(Core::data_size);
+		}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			pooling_window_sums(
+				input.data(),
+				m_offsets.data(),
+				Core::data_size,
+				algebra::detail::dimension<Stride, 0>::size,
+				0,
+				output::data_size,
+				get_scale(),
+				result.data());
+		}
+
+		void compute_gradient(
+			const output& grad,
+			input& result)
+		{
+			const number_type scale = get_scale();
+
+			result.fill(0.0f);
+
+			for (size_t stride = 0; stride < grad.size<0>(); ++stride)
+			{
+				const number_type g = grad(stride) * scale;
+
+				const size_t baseX = stride * algebra::detail::dimension<Stride, 0>::size;
+
+				for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+				{
+					result(baseX + x) += g;
+				}
+			}
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->process(input, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::process_1d(
+				input,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->compute_gradient(grad, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::compute_gradient_1d(
+				grad,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_1d_average_pooling_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_1d_average_pooling_gradient_kernel_name();
+			}
+		}
+
+#endif
+	private:
+		std::vector<size_t> m_offsets;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+
+#endif
+	};
+
+	template <class Metrics, class Core, class Stride, class Number>
+	class average_pooling_2d
+	{
+	public:
+		static_assert(Metrics::rank == 2, "Invalid metric rank for 2D average pooling.");
+
+		typedef typename average_pooling_2d<Metrics, Core, Stride, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::template tensor_of<Number>::type output;
+
+		typedef typename input::number_type number_type;
+
+		average_pooling_2d()
+			: m_offsets(get_window_offsets())
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
+#endif
+		{}
+
+		// Offsets of the window of an output from its first input, in the order of the window.
+		static std::vector<size_t> get_window_offsets()
+		{
+			std::vector<size_t> offsets;
+			for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+			{
+				for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+				{
+					offsets.push_back((x * algebra::detail::dimension<Metrics, 1>::size) + y);
+				}
+			}
+
+			return offsets;
+		}
+
+		static number_type get_scale()
+		{
+			return 1.0f / static_cast<number_type>(Core::data_size);
+		}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			typedef typename output::metrics output_metrics;
+
+			for (size_t strideX = 0; strideX < result.size<0>(); ++strideX)
+			{
+				const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
+
+				pooling_window_sums(
+					input.data() + baseX * algebra::detail::dimension<Metrics, 1>::size,
+					m_offsets.data(),
+					Core::data_size,
+					algebra::detail::dimension<Stride, 1>::size,
+					0,
+					algebra::detail::dimension<output_metrics, 1>::size,
+					get_scale(),
+					result.data() + strideX * algebra::detail::dimension<output_metrics, 1>::size);
+			}
+		}
+
+		void compute_gradient(
+			const output& grad,
+			input& result)
+		{
+			const number_type scale = get_scale();
+
+			result.fill(0.0f);
+
+			for (size_t strideX = 0; strideX < grad.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
+				{
+					const number_type g = grad(strideX, strideY) * scale;
+
+					const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
+					const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+
+					for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+					{
+						for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+						{
+							result(baseX + x, baseY + y) += g;
+						}
+					}
+				}
+			}
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->process(input, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::process_2d(
+				input,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->compute_gradient(grad, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::compute_gradient_2d(
+				grad,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_2d_average_pooling_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_2d_average_pooling_gradient_kernel_name();
+			}
+		}
+
+#endif
+	private:
+		std::vector<size_t> m_offsets;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+
+#endif
+	};
+
+	template <class Metrics, class Core, class Stride, class Number>
+	class average_pooling_3d
+	{
+	public:
+		static_assert(Metrics::rank == 3, "Invalid metric rank for 3D average pooling.");
+
+		typedef typename average_pooling_3d<Metrics, Core, Stride, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::detail::apply_core_with_stride<Metrics, Core, Stride, Metrics::rank>::metrics::template tensor_of<Number>::type output;
+
+		typedef typename input::number_type number_type;
+
+		average_pooling_3d()
+			: m_offsets(get_window_offsets())
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
+#endif
+		{}
+
+		// Offsets of the window of an output from its first input, in the order of the window.
+		static std::vector<size_t> get_window_offsets()
+		{
+			std::vector<size_t> offsets;
+			for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+			{
+				for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+				{
+					for (size_t z = 0; z < algebra::detail::dimension<Core, 2>::size; ++z)
+					{
+						offsets.push_back((((x * algebra::detail::dimension<Metrics, 1>::size) + y) * algebra::detail::dimension<Metrics, 2>::size) + z);
+					}
+				}
+			}
+
+			return offsets;
+		}
+
+		static number_type get_scale()
+		{
+			return 1.0f / static_cast<number_type>(Core::data_size);
+		}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			typedef typename output::metrics output_metrics;
+
+			for (size_t strideX = 0; strideX < result.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < result.size<1>(); ++strideY)
+				{
+					const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
+					const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+
+					pooling_window_sums(
+						input.data() + ((baseX * algebra::detail::dimension<Metrics, 1>::size) + baseY) * algebra::detail::dimension<Metrics, 2>::size,
+						m_offsets.data(),
+						Core::data_size,
+						algebra::detail::dimension<Stride, 2>::size,
+						0,
+						algebra::detail::dimension<output_metrics, 2>::size,
+						get_scale(),
+						result.data() + ((strideX * algebra::detail::dimension<output_metrics, 1>::size) + strideY) * algebra::detail::dimension<output_metrics, 2>::size);
+				}
+			}
+		}
+
+		void compute_gradient(
+			const output& grad,
+			input& result)
+		{
+			const number_type scale = get_scale();
+
+			result.fill(0.0f);
+
+			for (size_t strideX = 0; strideX < grad.size<0>(); ++strideX)
+			{
+				for (size_t strideY = 0; strideY < grad.size<1>(); ++strideY)
+				{
+					for (size_t strideZ = 0; strideZ < grad.size<2>(); ++strideZ)
+					{
+						const number_type g = grad(strideX, strideY, strideZ) * scale;
+
+						const size_t baseX = strideX * algebra::detail::dimension<Stride, 0>::size;
+						const size_t baseY = strideY * algebra::detail::dimension<Stride, 1>::size;
+						const size_t baseZ = strideZ * algebra::detail::dimension<Stride, 2>::size;
+
+						for (size_t x = 0; x < algebra::detail::dimension<Core, 0>::size; ++x)
+						{
+							for (size_t y = 0; y < algebra::detail::dimension<Core, 1>::size; ++y)
+							{
+								for (size_t z = 0; z < algebra::detail::dimension<Core, 2>::size; ++z)
+								{
+									result(baseX + x, baseY + y, baseZ + z) += g;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->process(input, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::process_3d(
+				input,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Core, 2>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			this->compute_gradient(grad, result);
+		}
+
+		template <const size_t ResultSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(ResultSize < opencl::detail::layer_kernels::min_pooling_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::average_pooling::compute_gradient_3d(
+				grad,
+				result,
+				algebra::detail::dimension<Core, 0>::size,
+				algebra::detail::dimension<Core, 1>::size,
+				algebra::detail::dimension<Core, 2>::size,
+				algebra::detail::dimension<Stride, 0>::size,
+				algebra::detail::dimension<Stride, 1>::size,
+				algebra::detail::dimension<Stride, 2>::size,
+				get_scale(),
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_3d_average_pooling_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_3d_average_pooling_gradient_kernel_name();
+			}
+		}
+
+#endif
+	private:
+		std::vector<size_t> m_offsets;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+
+#endif
+	};
+
+	template <class Metrics, class Core, class Stride, class Number>
+	struct average_pooling_core_impl
+	{
+		static_assert(1 <= Metrics::rank && Metrics::rank <= 3, "Average pooling with core is supported only for 1D, 2D or 3D tensors.");
+
+		typedef typename average_pooling_core_impl<Metrics, Core, Stride, Number> this_type;
+
+		typedef typename std::conditional<
+			Metrics::rank == 1,
+			average_pooling_1d<Metrics, Core, Stride, Number>,
+			typename std::conditional<
+				Metrics::rank == 2,
+				average_pooling_2d<Metrics, Core, Stride, Number>,
+				average_pooling_3d<Metrics, Core, Stride, Number>
+			>::type
+		>::type type;
+
+		template <typename _Layer>
+		struct serializer : public pooling_core_serializer<Metrics, Core, Stride, _Layer>
+		{};
+	};
+
+	template <class Metrics, class Number>
+	class global_average_pooling_impl
+	{
+	public:
+		static_assert(2 <= Metrics::rank && Metrics::rank <= 4, "Global average pooling is supported only for 1D, 2D or 3D tensors with channels.");
+
+		typedef typename global_average_pooling_impl<Metrics, Number> this_type;
+
+		typedef typename Metrics::template tensor_of<Number>::type input;
+		typedef typename algebra::metrics<Metrics::dimension_size>::template tensor_of<Number>::type output;
+
+		enum : size_t { pooling_size = Metrics::data_size / Metrics::dimension_size };
+
+		typedef typename algebra::metrics<Metrics::dimension_size, pooling_size>::template tensor_of<Number>::type reshaped_input;
+
+		typedef typename input::number_type number_type;
+
+		global_average_pooling_impl()
+			: m_offsets(get_window_offsets())
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName()
+#endif
+		{}
+
+		static std::vector<size_t> get_window_offsets()
+		{
+			std::vector<size_t> offsets;
+			for (size_t i = 0; i < pooling_size; ++i)
+			{
+				offsets.push_back(i);
+			}
+
+			return offsets;
+		}
+
+		static number_type get_scale()
+		{
+			return 1.0f / static_cast<number_type>(pooling_size);
+		}
+
+		void process(
+			const input& input,
+			output& result)
+		{
+			pooling_window_sums(
+				input.data(),
+				m_offsets.data(),
+				pooling_size,
+				pooling_size,
+				0,
+				Metrics::dimension_size,
+				get_scale(),
+				result.data());
+		}
+
+		void compute_gradient(
+			const output& grad,
+			input& result)
+		{
+			const number_type scale = get_scale();
+
+			reshaped_input rresult = result.reshape<typename reshaped_input::metrics>();
+
+			for (size_t channel = 0; channel < rresult.size<0>(); ++channel)
+			{
+				const number_type g = grad(channel) * scale;
+
+				for (size_t i = 0; i < rresult.size<1>(); ++i)
+				{
+					rresult(channel, i) = g;
+				}
+			}
+		}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		template <const size_t InputSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(InputSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			this->process(input, result);
+		}
+
+		template <const size_t InputSize>
+		void dispatch_process(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(InputSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			reshaped_input rin = input.reshape<typename reshaped_input::metrics>();
 
-		typedef typename std::conditional<
-			Metrics::rank == 1,
-			max_pooling_1d<Metrics, Core, Stride>,
-			typename std::conditional<
-				Metrics::rank == 2,
-				max_pooling_2d<Metrics, Core, Stride>,
-				max_pooling_3d<Metrics, Core, Stride>
-			>::type
-		>::type type;
+			opencl::detail::average_pooling::process_global(
+				rin,
+				result,
+				get_scale(),
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+		}
 
-		template <typename _Layer>
-		struct serializer
+		template <const size_t InputSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(InputSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
 		{
-			typedef typename _Layer value_type;
+			this->compute_gradient(grad, result);
+		}
 
-			typedef typename serialization::metrics_serializer<Metrics> _metrics_serializer;
-			typedef typename serialization::metrics_serializer<Core> _core_serializer;
-			typedef typename serialization::metrics_serializer<Stride> _stride_serializer;
+		template <const size_t InputSize>
+		void dispatch_compute_gradient(
+			const output& grad,
+			input& result,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(InputSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
 
-			enum : size_t {
-				serialized_data_size =
-				_metrics_serializer::serialized_data_size
-				+ _core_serializer::serialized_data_size
-				+ _stride_serializer::serialized_data_size
-			};
+			initialize_opencl(context);
 
-			static void read(
-				std::istream& in,
-				value_type&)
-			{
-				_metrics_serializer::read(in);
-				_core_serializer::read(in);
-				_stride_serializer::read(in);
-			}
+			reshaped_input rresult = result.reshape<typename reshaped_input::metrics>();
 
-			static void write(
-				std::ostream& out,
-				const value_type&)
+			opencl::detail::average_pooling::compute_global_gradient(
+				grad,
+				rresult,
+				get_scale(),
+				m_kernelProgram,
+				m_gradientKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
 			{
-				_metrics_serializer::write(out);
-				_core_serializer::write(out);
-				_stride_serializer::write(out);
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_global_average_pooling_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_global_average_pooling_gradient_kernel_name();
 			}
-		};
+		}
+
+#endif
+	private:
+		std::vector<size_t> m_offsets;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+
+#endif
 	};
 
 }
 
-	template <class InputMetrics>
-	class max_pooling : public layer_base<InputMetrics, typename detail::max_pooling_impl<InputMetrics>::type::output::metrics>
+	template <class InputMetrics, class Number = float>
+	class max_pooling : public layer_base<InputMetrics, typename detail::max_pooling_impl<InputMetrics, Number>::type::output::metrics, Number>
 	{
 	public:
-		typedef typename max_pooling<InputMetrics> this_type;
-		typedef typename detail::max_pooling_impl<InputMetrics>::type impl;
+		typedef typename max_pooling<InputMetrics, Number> this_type;
+		typedef typename detail::max_pooling_impl<InputMetrics, Number>::type impl;
+
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics, Number> base_type;
 
-		typedef typename layer_base<InputMetrics, typename impl::output::metrics> base_type;
+		typedef typename detail::layer_memory<false, false> memory_traits;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::max_pooling_layer,
@@ -828,6 +2111,15 @@ namespace detail {
 			const number_type)
 		{}
 
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
 		struct serializer
 		{
 			typedef this_type value_type;
@@ -880,18 +2172,30 @@ namespace detail {
 		impl m_impl;
 	};
 	
-	template <class InputMetrics, class Core, class Stride>
-	class max_pooling_with_core : public layer_base<InputMetrics, typename detail::max_pooling_core_impl<InputMetrics, Core, Stride>::type::output::metrics>
+	template <
+		class InputMetrics,
+		class Core,
+		class Stride,
+		class Padding = typename algebra::detail::default_padding<InputMetrics::rank>::type,
+		class Dilation = typename algebra::detail::default_dilation<InputMetrics::rank>::type,
+		class Layout = layout::channels_first,
+		class Number = float>
+	class max_pooling_with_core : public layer_base<InputMetrics, typename detail::max_pooling_core_impl<InputMetrics, Core, Stride, Padding, Dilation, Layout, Number>::type::output::metrics, Number>
 	{
 	public:
-		typedef typename max_pooling_with_core<InputMetrics, Core, Stride> this_type;
-		typedef typename detail::max_pooling_core_impl<InputMetrics, Core, Stride>::type impl;
+		typedef typename max_pooling_with_core<InputMetrics, Core, Stride, Padding, Dilation, Layout, Number> this_type;
+		typedef typename detail::max_pooling_core_impl<InputMetrics, Core, Stride, Padding, Dilation, Layout, Number>::type impl;
+
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics, Number> base_type;
 
-		typedef typename layer_base<InputMetrics, typename impl::output::metrics> base_type;
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename Layout input_layout;
+		typedef typename Layout output_layout;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::max_pooling_with_core_layer,
-			typename detail::max_pooling_core_impl<InputMetrics, Core, Stride>::template serializer<this_type>
+			typename detail::max_pooling_core_impl<InputMetrics, Core, Stride, Padding, Dilation, Layout, Number>::template serializer<this_type>
 		> serializer;
 
 		max_pooling_with_core()
@@ -914,6 +2218,39 @@ namespace detail {
 			const number_type)
 		{}
 
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 		const output& process(
@@ -931,6 +2268,208 @@ namespace detail {
 			return this->compute_gradient(gradient);
 		}
 
+		template <class BatchInput, class BatchOutput>
+		void process(
+			const BatchInput& input,
+			BatchOutput& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(detail::is_batch_of<BatchInput, InputMetrics>::value, "Invalid batch input tensor.");
+			static_assert(detail::is_batch_of<BatchOutput, typename impl::output::metrics>::value, "Invalid batch output tensor.");
+			static_assert(BatchInput::metrics::dimension_size == BatchOutput::metrics::dimension_size, "Input and output batch sizes do not match.");
+			static_assert(impl::is_dense, "Batch processing is not supported for padded or dilated max pooling.");
+
+			m_impl.process_batch(input, result, queue);
+		}
+
+		template <class BatchInput, class BatchOutput>
+		void compute_gradient(
+			const BatchInput& input,
+			const BatchOutput& gradient,
+			BatchInput& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(detail::is_batch_of<BatchInput, InputMetrics>::value, "Invalid batch input tensor.");
+			static_assert(detail::is_batch_of<BatchOutput, typename impl::output::metrics>::value, "Invalid batch gradient tensor.");
+			static_assert(BatchInput::metrics::dimension_size == BatchOutput::metrics::dimension_size, "Input and gradient batch sizes do not match.");
+			static_assert(impl::is_dense, "Batch processing is not supported for padded or dilated max pooling.");
+
+			m_impl.compute_batch_gradient(input, gradient, result, queue);
+		}
+
+		void update_weights(
+			const number_type rate,
+			::boost::compute::command_queue&)
+		{
+			this->update_weights(rate);
+		}
+
+#endif
+
+	private:
+		impl m_impl;
+	};
+
+	template <class InputMetrics, class Core, class Stride, class Number = float>
+	class average_pooling_with_core : public layer_base<InputMetrics, typename detail::average_pooling_core_impl<InputMetrics, Core, Stride, Number>::type::output::metrics, Number>
+	{
+	public:
+		typedef typename average_pooling_with_core<InputMetrics, Core, Stride, Number> this_type;
+		typedef typename detail::average_pooling_core_impl<InputMetrics, Core, Stride, Number>::type impl;
+
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::average_pooling_with_core_layer,
+			typename detail::average_pooling_core_impl<InputMetrics, Core, Stride, Number>::template serializer<this_type>
+		> serializer;
+
+		average_pooling_with_core()
+			: base_type(), m_impl()
+		{}
+
+		const output& process(const input& input)
+		{
+			m_impl.process(input, m_output);
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			m_impl.compute_gradient(grad, m_gradient);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type)
+		{}
+
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue& queue)
+		{
+			m_impl.dispatch_process<output::data_size>(input, m_output, queue);
+			return m_output;
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue)
+		{
+			m_impl.dispatch_compute_gradient<output::data_size>(gradient, m_gradient, queue);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate,
+			::boost::compute::command_queue&)
+		{
+			this->update_weights(rate);
+		}
+
+#endif
+
+	private:
+		impl m_impl;
+	};
+
+	template <class InputMetrics, class Number = float>
+	class global_average_pooling : public layer_base<InputMetrics, typename detail::global_average_pooling_impl<InputMetrics, Number>::output::metrics, Number>
+	{
+	public:
+		typedef typename global_average_pooling<InputMetrics, Number> this_type;
+		typedef typename detail::global_average_pooling_impl<InputMetrics, Number> impl;
+
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::global_average_pooling_layer,
+			serialization::metrics_serializer<InputMetrics>
+		> serializer_impl_type;
+
+		global_average_pooling()
+			: base_type(), m_impl()
+		{}
+
+		const output& process(const input& input)
+		{
+			m_impl.process(input, m_output);
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			m_impl.compute_gradient(grad, m_gradient);
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type)
+		{}
+
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type&)
+			{
+				serializer_impl_type::read(in);
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type&)
+			{
+				serializer_impl_type::write(out);
+			}
+		};
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue& queue)
+		{
+			m_impl.dispatch_process<InputMetrics::data_size>(input, m_output, queue);
+			return m_output;
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue)
+		{
+			m_impl.dispatch_compute_gradient<InputMetrics::data_size>(gradient, m_gradient, queue);
+			return m_gradient;
+		}
+
 		void update_weights(
 			const number_type rate,
 			::boost::compute::command_queue&)
@@ -944,19 +2483,43 @@ namespace detail {
 		impl m_impl;
 	};
 
-	template <class Input, class... Args>
-	max_pooling<Input> make_max_pooling_layer(
+	template <class Input, class Number = float, class... Args>
+	max_pooling<Input, Number> make_max_pooling_layer(
+		Args&&... args)
+	{
+		typedef max_pooling<Input, Number> layer_type;
+		return (layer_type(std::forward<Args>(args)...));
+	}
+
+	template <
+		class Input,
+		class Core,
+		class Stride,
+		class Padding = typename algebra::detail::default_padding<Input::rank>::type,
+		class Dilation = typename algebra::detail::default_dilation<Input::rank>::type,
+		class Layout = layout::channels_first,
+		class Number = float,
+		class... Args>
+	max_pooling_with_core<Input, Core, Stride, Padding, Dilation, Layout, Number> make_max_pooling_layer(
+		Args&&... args)
+	{
+		typedef max_pooling_with_core<Input, Core, Stride, Padding, Dilation, Layout, Number> layer_type;
+		return (layer_type(std::forward<Args>(args)...));
+	}
+
+	template <class Input, class Core, class Stride, class Number = float, class... Args>
+	average_pooling_with_core<Input, Core, Stride, Number> make_average_pooling_layer(
 		Args&&... args)
 	{
-		typedef max_pooling<Input> layer_type;
+		typedef average_pooling_with_core<Input, Core, Stride, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 
-	template <class Input, class Core, class Stride, class... Args>
-	max_pooling_with_core<Input, Core, Stride> make_max_pooling_layer(
+	template <class Input, class Number = float, class... Args>
+	global_average_pooling<Input, Number> make_global_average_pooling_layer(
 		Args&&... args)
 	{
-		typedef max_pooling_with_core<Input, Core, Stride> layer_type;
+		typedef global_average_pooling<Input, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 }
\ No newline at end of file
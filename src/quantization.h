@@ -0,0 +1,770 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "layer.h"
+#include "parallel.h"
+#include "serialization.h"
+#include "connected.h"
+#include "convolution.h"
+#include "network.h"
+#include "checkpoint.h"
+
+namespace neural_network {
+
+	// Weights are quantized with one scale for the whole layer, or with a separate scale for
+	// every output neuron or kernel.
+	enum class quantization_granularity
+	{
+		per_tensor,
+		per_channel
+	};
+
+namespace detail {
+
+	template <class Metrics>
+	struct quantized_tensor
+	{
+		typedef typename std::array<std::int8_t, Metrics::data_size> buffer_type;
+
+		quantized_tensor()
+			: m_data(std::make_shared<buffer_type>())
+		{
+			m_data->fill(0);
+		}
+
+		std::int8_t* data()
+		{
+			return m_data->data();
+		}
+
+		const std::int8_t* data() const
+		{
+			return m_data->data();
+		}
+
+		std::shared_ptr<buffer_type> m_data;
+	};
+
+	inline float quantization_scale(
+		const float range)
+	{
+		return (range > 0.0f) ? (range / 127.0f) : 1.0f;
+	}
+
+	inline std::int8_t quantize_value(
+		const float value,
+		const float scale)
+	{
+		const float result = std::round(value / scale);
+		return static_cast<std::int8_t>(std::max(-127.0f, std::min(127.0f, result)));
+	}
+
+	template <class Tensor>
+	float max_magnitude(
+		const Tensor& values)
+	{
+		typedef typename algebra::metrics<Tensor::data_size> flat;
+		typename flat::tensor_type flatValues = values.reshape<flat>();
+
+		float result = 0.0f;
+		for (size_t i = 0; i < flatValues.size<0>(); ++i)
+		{
+			result = std::max(result, std::abs(flatValues(i)));
+		}
+
+		return result;
+	}
+
+	template <class Tensor>
+	void quantize_values(
+		const Tensor& values,
+		const float scale,
+		std::int8_t* result)
+	{
+		typedef typename algebra::metrics<Tensor::data_size> flat;
+		typename flat::tensor_type flatValues = values.reshape<flat>();
+
+		for (size_t i = 0; i < flatValues.size<0>(); ++i)
+		{
+			result[i] = quantize_value(flatValues(i), scale);
+		}
+	}
+
+	// Quantizes a row major matrix of weights, where every row belongs to one output channel.
+	template <const size_t Rows, const size_t Columns, class Weights, class Scales>
+	void quantize_weights(
+		const Weights& weights,
+		const quantization_granularity granularity,
+		Scales& scales,
+		std::int8_t* result)
+	{
+		typedef typename algebra::metrics<Rows * Columns> flat;
+		typename flat::tensor_type flatWeights = weights.reshape<flat>();
+
+		float range = max_magnitude(flatWeights);
+
+		for (size_t row = 0; row < Rows; ++row)
+		{
+			if (quantization_granularity::per_channel == granularity)
+			{
+				range = 0.0f;
+				for (size_t column = 0; column < Columns; ++column)
+				{
+					range = std::max(range, std::abs(flatWeights(row * Columns + column)));
+				}
+			}
+
+			scales(row) = quantization_scale(range);
+
+			for (size_t column = 0; column < Columns; ++column)
+			{
+				result[row * Columns + column] = quantize_value(flatWeights(row * Columns + column), scales(row));
+			}
+		}
+	}
+
+	// Products of 8-bit values are accumulated exactly in 32-bit integers, so the vector and
+	// the scalar versions return the same result.
+	inline std::int32_t dot_product(
+		const std::int8_t* left,
+		const std::int8_t* right,
+		const size_t size)
+	{
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		__m256i sum = _mm256_setzero_si256();
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m256i l = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i)));
+			const __m256i r = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i)));
+
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(l, r));
+		}
+
+		__m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+		total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		std::int32_t result = _mm_cvtsi128_si32(total);
+#else
+		std::int32_t partial[4] = { 0, 0, 0, 0 };
+		for (; i + 4 <= size; i += 4)
+		{
+			partial[0] += static_cast<std::int32_t>(left[i]) * right[i];
+			partial[1] += static_cast<std::int32_t>(left[i + 1]) * right[i + 1];
+			partial[2] += static_cast<std::int32_t>(left[i + 2]) * right[i + 2];
+			partial[3] += static_cast<std::int32_t>(left[i + 3]) * right[i + 3];
+		}
+
+		std::int32_t result = partial[0] + partial[1] + partial[2] + partial[3];
+#endif
+
+		for (; i < size; ++i)
+		{
+			result += static_cast<std::int32_t>(left[i]) * right[i];
+		}
+
+		return result;
+	}
+
+	// Maps every output position and core tap of a convolution to the offset of the input value
+	// under the tap. Taps that fall into the padding are mapped past the end of the input.
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, const size_t Dimension, const bool Last = (Metrics::rank == Dimension)>
+	struct convolution_taps
+	{
+		typedef typename algebra::detail::core_window<Metrics, Core, Stride, Padding, Dilation, Dimension> window;
+		typedef typename convolution_taps<Metrics, Core, Stride, Padding, Dilation, Dimension + 1> next;
+
+		enum : size_t { positions = window::output_size * next::positions };
+
+		static std::vector<size_t> make_table()
+		{
+			std::vector<size_t> table(positions * Core::data_size);
+			fill(0, 0, 0, true, table);
+
+			return table;
+		}
+
+		static void fill(
+			const size_t position,
+			const size_t tap,
+			const size_t offset,
+			const bool inside,
+			std::vector<size_t>& table)
+		{
+			for (size_t p = 0; p < window::output_size; ++p)
+			{
+				const size_t first = window::begin(p);
+				const size_t last = window::end(p);
+
+				for (size_t c = 0; c < window::core_size; ++c)
+				{
+					const bool covered = inside && (first <= c) && (c < last);
+
+					next::fill(
+						position * window::output_size + p,
+						tap * window::core_size + c,
+						offset * window::input_size + (covered ? window::offset(p, c) : 0),
+						covered,
+						table);
+				}
+			}
+		}
+	};
+
+	template <class Metrics, class Core, class Stride, class Padding, class Dilation, const size_t Dimension>
+	struct convolution_taps<Metrics, Core, Stride, Padding, Dilation, Dimension, true>
+	{
+		enum : size_t { positions = 1 };
+
+		static void fill(
+			const size_t position,
+			const size_t tap,
+			const size_t offset,
+			const bool inside,
+			std::vector<size_t>& table)
+		{
+			table[position * Core::data_size + tap] = inside ? offset : Metrics::data_size;
+		}
+	};
+}
+
+namespace serialization {
+
+	template <class Metrics>
+	struct quantized_tensor_serializer : public detail::serializer_base
+	{
+		typedef typename metrics_serializer<Metrics> MetricsSerializer;
+		typedef typename neural_network::detail::quantized_tensor<Metrics> value_type;
+
+		enum : size_t { serialized_data_size = MetricsSerializer::serialized_data_size + Metrics::data_size };
+
+		static void read(
+			std::istream& in,
+			value_type& result)
+		{
+			MetricsSerializer::read(in);
+
+			value_type value;
+			if (!in.read(reinterpret_cast<char*>(value.data()), Metrics::data_size))
+				throw_io_error("Failed to read quantized tensor values.");
+
+			result = value;
+		}
+
+		static void write(
+			std::ostream& out,
+			const value_type& tensor)
+		{
+			MetricsSerializer::write(out);
+
+			if (!out.write(reinterpret_cast<const char*>(tensor.data()), Metrics::data_size))
+				throw_io_error("Failed to write quantized tensor values.");
+		}
+	};
+}
+
+	// Fully connected layer for inference with 8-bit weights and inputs. The layer reads the
+	// weights of a trained fully_connected layer and processes them in floating point while it
+	// is calibrated, until quantize is called.
+	template <typename InputMetrics, typename OutputMetrics>
+	class quantized_fully_connected : public layer_base<InputMetrics, OutputMetrics>
+	{
+	public:
+		typedef typename quantized_fully_connected<InputMetrics, OutputMetrics> this_type;
+		typedef typename layer_base<InputMetrics, OutputMetrics> base_type;
+		typedef typename fully_connected<InputMetrics, OutputMetrics> float_layer;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename float_layer::reshaped_input reshaped_input;
+		typedef typename float_layer::reshaped_output reshaped_output;
+
+		typedef typename float_layer::weights_type float_weights_type;
+		typedef typename float_layer::bias_type bias_type;
+		typedef typename reshaped_output::tensor_type scales_type;
+		typedef typename detail::quantized_tensor<typename float_weights_type::metrics> weights_type;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::quantized_fully_connected_layer,
+			serialization::composite_serializer<
+				serialization::value_serializer<number_type>,
+				serialization::tensor_serializer<scales_type>,
+				serialization::tensor_serializer<bias_type>,
+				serialization::quantized_tensor_serializer<typename float_weights_type::metrics>>
+		> serializer_impl_type;
+
+		quantized_fully_connected()
+			: base_type(), m_weights(), m_scales(), m_bias(), m_inputScale(1.0f), m_input(), m_calibration()
+		{
+		}
+
+		const output& process(const input& input)
+		{
+			reshaped_input::tensor_type rin = input.reshape<reshaped_input>();
+			reshaped_output::tensor_type rout = m_output.reshape<reshaped_output>();
+
+			if (m_calibration)
+			{
+				this->calibrate(rin, rout);
+				return m_output;
+			}
+
+			detail::quantize_values(rin, m_inputScale, m_input.data());
+
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, &rout](const size_t j)
+			{
+				const std::int32_t sum = detail::dot_product(
+					m_weights.data() + j * reshaped_input::data_size,
+					m_input.data(),
+					reshaped_input::data_size);
+
+				rout(j) = static_cast<number_type>(sum) * m_inputScale * m_scales(j) + m_bias(j);
+			});
+
+			return m_output;
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		// Quantizes the weights and takes the input scale from the largest input processed since
+		// the weights were read. Does nothing if the layer is already quantized.
+		void quantize(
+			const quantization_granularity granularity)
+		{
+			if (!m_calibration)
+				return;
+
+			detail::quantize_weights<reshaped_output::data_size, reshaped_input::data_size>(
+				m_calibration->m_weights,
+				granularity,
+				m_scales,
+				m_weights.data());
+
+			m_inputScale = detail::quantization_scale(m_calibration->m_range);
+			m_calibration.reset();
+		}
+
+		// Reads either a quantized layer, or the weights of a fully_connected layer to calibrate.
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& layer)
+			{
+				const serialization::chunk_header header = serialization::read_chunk_header(in);
+
+				if (serializer_impl_type::matches(header))
+				{
+					serializer_impl_type::read_content(in, layer.m_inputScale, layer.m_scales, layer.m_bias, layer.m_weights);
+					layer.m_calibration.reset();
+				}
+				else if (float_layer::serializer_impl_type::matches(header))
+				{
+					number_type regularization = 0.0f;
+					std::shared_ptr<calibration> state = std::make_shared<calibration>();
+
+					float_layer::serializer_impl_type::read_content(in, state->m_weights, layer.m_bias, regularization);
+					layer.m_calibration = state;
+				}
+				else
+				{
+					serialization::detail::serializer_base::throw_io_error("Invalid chunk type.");
+				}
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& layer)
+			{
+				if (layer.m_calibration)
+					serialization::detail::serializer_base::throw_io_error("Layer is not quantized.");
+
+				serializer_impl_type::write(out, layer.m_inputScale, layer.m_scales, layer.m_bias, layer.m_weights);
+			}
+		};
+
+	private:
+		struct calibration
+		{
+			calibration()
+				: m_weights(), m_range(0.0f)
+			{
+			}
+
+			float_weights_type m_weights;
+			number_type m_range;
+		};
+
+		void calibrate(
+			const typename reshaped_input::tensor_type& rin,
+			typename reshaped_output::tensor_type& rout)
+		{
+			const float_weights_type& weights = m_calibration->m_weights;
+			m_calibration->m_range = std::max(m_calibration->m_range, detail::max_magnitude(rin));
+
+			parallel::parallel_for<reshaped_output::data_size, reshaped_input::data_size>([this, &weights, &rin, &rout](const size_t j)
+			{
+				number_type sum = 0.0f;
+				for (size_t i = 0; i < rin.size<0>(); ++i)
+				{
+					sum += weights(j, i) * rin(i);
+				}
+
+				rout(j) = sum + m_bias(j);
+			});
+		}
+
+	private:
+		weights_type m_weights;
+		scales_type m_scales;
+		bias_type m_bias;
+		number_type m_inputScale;
+		detail::quantized_tensor<reshaped_input> m_input;
+		std::shared_ptr<calibration> m_calibration;
+	};
+
+	// Convolution layer for inference with 8-bit weights and inputs. Only the channels first
+	// layout is supported. The input values under the core at every output position are gathered
+	// into a row, so that every output value is a dot product of two contiguous rows.
+	template <
+		class InputMetrics,
+		class Core,
+		class Stride,
+		const size_t Kernels,
+		class Padding = typename algebra::detail::default_padding<InputMetrics::rank>::type,
+		class Dilation = typename algebra::detail::default_dilation<InputMetrics::rank>::type>
+	class quantized_convolution
+		: public layer_base<
+			InputMetrics,
+			typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels, Padding, Dilation, layout::channels_first, float>::type::output::metrics>
+	{
+	public:
+		typedef typename quantized_convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation> this_type;
+		typedef typename detail::convolution_impl<InputMetrics, Core, Stride, Kernels, Padding, Dilation, layout::channels_first, float>::type impl;
+		typedef typename layer_base<InputMetrics, typename impl::output::metrics> base_type;
+
+		typedef typename layout::channels_first input_layout;
+		typedef typename layout::channels_first output_layout;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename impl::convolution_metrics convolution_metrics;
+		typedef typename impl::kernel_weights float_weights_type;
+		typedef typename impl::bias bias_type;
+		typedef typename impl::bias scales_type;
+		typedef typename algebra::metrics<Kernels, Core::data_size> weights_metrics;
+		typedef typename detail::quantized_tensor<weights_metrics> weights_type;
+
+		typedef typename detail::convolution_taps<InputMetrics, Core, Stride, Padding, Dilation, 0> taps;
+
+		static_assert(taps::positions == convolution_metrics::data_size, "Invalid number of convolution positions.");
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::quantized_convolution_layer,
+			serialization::composite_serializer<
+				serialization::value_serializer<number_type>,
+				serialization::tensor_serializer<scales_type>,
+				serialization::tensor_serializer<bias_type>,
+				serialization::quantized_tensor_serializer<weights_metrics>>
+		> serializer_impl_type;
+
+		quantized_convolution()
+			: base_type(), m_weights(), m_scales(), m_bias(), m_inputScale(1.0f), m_input(), m_patches(), m_calibration()
+		{
+		}
+
+		const output& process(const input& input)
+		{
+			if (m_calibration)
+			{
+				m_calibration->m_range = std::max(m_calibration->m_range, detail::max_magnitude(input));
+				m_calibration->m_impl.process(input, m_output);
+
+				return m_output;
+			}
+
+			detail::quantize_values(input, m_inputScale, m_input.data());
+
+			const std::vector<size_t>& table = gather_table();
+
+			parallel::parallel_for<convolution_metrics::data_size, Core::data_size>([this, &table](const size_t position)
+			{
+				const size_t first = position * Core::data_size;
+
+				for (size_t tap = 0; tap < Core::data_size; ++tap)
+				{
+					m_patches.data()[first + tap] = m_input.data()[table[first + tap]];
+				}
+			});
+
+			typedef typename algebra::metrics<output::data_size> flat;
+			typename flat::tensor_type result = m_output.reshape<flat>();
+
+			parallel::parallel_for<Kernels, impl::kernel_work>([this, &result](const size_t kernel)
+			{
+				const number_type scale = m_inputScale * m_scales(kernel);
+
+				for (size_t position = 0; position < convolution_metrics::data_size; ++position)
+				{
+					const std::int32_t sum = detail::dot_product(
+						m_weights.data() + kernel * Core::data_size,
+						m_patches.data() + position * Core::data_size,
+						Core::data_size);
+
+					result(kernel * convolution_metrics::data_size + position) = static_cast<number_type>(sum) * scale + m_bias(kernel);
+				}
+			});
+
+			return m_output;
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		void quantize(
+			const quantization_granularity granularity)
+		{
+			if (!m_calibration)
+				return;
+
+			detail::quantize_weights<Kernels, Core::data_size>(
+				m_calibration->m_impl.m_weights.m_kernels,
+				granularity,
+				m_scales,
+				m_weights.data());
+
+			m_inputScale = detail::quantization_scale(m_calibration->m_range);
+			m_calibration.reset();
+		}
+
+		// Reads either a quantized layer, or the weights of a convolution layer to calibrate.
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& layer)
+			{
+				typedef typename impl::weights_type::serializer_impl_type float_serializer;
+
+				const serialization::chunk_header header = serialization::read_chunk_header(in);
+
+				if (serializer_impl_type::matches(header))
+				{
+					serializer_impl_type::read_content(in, layer.m_inputScale, layer.m_scales, layer.m_bias, layer.m_weights);
+					layer.m_calibration.reset();
+				}
+				else if (float_serializer::matches(header))
+				{
+					std::shared_ptr<calibration> state = std::make_shared<calibration>();
+
+					float_serializer::read_content(in, state->m_impl.m_weights.m_kernels, state->m_impl.m_weights.m_bias);
+					state->m_impl.invalidate_cache();
+
+					layer.m_bias = state->m_impl.m_weights.m_bias;
+					layer.m_calibration = state;
+				}
+				else
+				{
+					serialization::detail::serializer_base::throw_io_error("Invalid chunk type.");
+				}
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& layer)
+			{
+				if (layer.m_calibration)
+					serialization::detail::serializer_base::throw_io_error("Layer is not quantized.");
+
+				serializer_impl_type::write(out, layer.m_inputScale, layer.m_scales, layer.m_bias, layer.m_weights);
+			}
+		};
+
+	private:
+		struct calibration
+		{
+			calibration()
+				: m_impl(), m_range(0.0f)
+			{
+			}
+
+			impl m_impl;
+			number_type m_range;
+		};
+
+		static const std::vector<size_t>& gather_table()
+		{
+			static const std::vector<size_t> table = taps::make_table();
+			return table;
+		}
+
+	private:
+		weights_type m_weights;
+		scales_type m_scales;
+		bias_type m_bias;
+		number_type m_inputScale;
+
+		// The value past the end of the input stays zero and stands for the padding.
+		detail::quantized_tensor<algebra::metrics<InputMetrics::data_size + 1>> m_input;
+		detail::quantized_tensor<algebra::metrics<convolution_metrics::data_size, Core::data_size>> m_patches;
+		std::shared_ptr<calibration> m_calibration;
+	};
+
+namespace detail {
+
+	template <class Layer>
+	struct quantized_layer
+	{
+		typedef Layer type;
+	};
+
+	template <class InputMetrics, class OutputMetrics>
+	struct quantized_layer<fully_connected<InputMetrics, OutputMetrics>>
+	{
+		typedef quantized_fully_connected<InputMetrics, OutputMetrics> type;
+	};
+
+	template <class InputMetrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation>
+	struct quantized_layer<convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation, layout::channels_first>>
+	{
+		typedef quantized_convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation> type;
+	};
+
+	template <class... Layers>
+	struct quantized_layer<network<Layers...>>
+	{
+		typedef network<typename quantized_layer<Layers>::type...> type;
+	};
+
+	// A checkpoint is serialized in the format of its network, so the network takes its place.
+	template <class Network>
+	struct quantized_layer<checkpoint<Network>>
+	{
+		typedef typename quantized_layer<Network>::type type;
+	};
+
+	struct layer_quantizer
+	{
+		layer_quantizer(
+			const quantization_granularity granularity)
+			: m_granularity(granularity)
+		{
+		}
+
+		template <class Layer>
+		void operator()(Layer&)
+		{
+		}
+
+		template <class... Layers>
+		void operator()(network<Layers...>& layer)
+		{
+			layer.visit(*this);
+		}
+
+		template <class InputMetrics, class OutputMetrics>
+		void operator()(quantized_fully_connected<InputMetrics, OutputMetrics>& layer)
+		{
+			layer.quantize(m_granularity);
+		}
+
+		template <class InputMetrics, class Core, class Stride, const size_t Kernels, class Padding, class Dilation>
+		void operator()(quantized_convolution<InputMetrics, Core, Stride, Kernels, Padding, Dilation>& layer)
+		{
+			layer.quantize(m_granularity);
+		}
+
+		quantization_granularity m_granularity;
+	};
+}
+
+	// Converts a trained network for quantized inference. Fully connected and channels first
+	// convolution layers are replaced with their quantized versions, and the input scale of every
+	// such layer is taken from the largest input it sees while the calibration batch is processed.
+	// Layers of network ensembles are not quantized.
+	template <class Network, class Batch>
+	typename detail::quantized_layer<Network>::type quantize(
+		const Network& network,
+		const Batch& calibration,
+		const quantization_granularity granularity = quantization_granularity::per_channel)
+	{
+		static_assert(detail::is_batch_of<Batch, typename Network::input::metrics>::value, "Calibration batch does not match network input.");
+
+		typedef typename detail::quantized_layer<Network>::type result_type;
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		serialization::write(stream, network);
+
+		result_type result;
+		serialization::read(stream, result);
+
+		typename Network::input item;
+		for (size_t i = 0; i < Batch::metrics::dimension_size; ++i)
+		{
+			detail::get_batch_item(calibration, i, item);
+			result.process(item);
+		}
+
+		detail::layer_quantizer quantizer(granularity);
+		quantizer(result);
+
+		return result;
+	}
+}
\ No newline at end of file
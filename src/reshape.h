@@ -69,12 +69,14 @@ namespace detail {
 	};
 }
 
-	template <typename InputMetrics, typename OutputMetrics>
-	class reshape : public layer_base<InputMetrics, OutputMetrics>
+	template <typename InputMetrics, typename OutputMetrics, typename Number = float>
+	class reshape : public layer_base<InputMetrics, OutputMetrics, Number>
 	{
 	public:
-		typedef typename reshape<InputMetrics, OutputMetrics> this_type;
-		typedef typename layer_base<InputMetrics, OutputMetrics> base_type;
+		typedef typename reshape<InputMetrics, OutputMetrics, Number> this_type;
+		typedef typename layer_base<InputMetrics, OutputMetrics, Number> base_type;
+
+		typedef typename detail::layer_memory<false, false, false, true> memory_traits;
 
 		typedef typename serialization::chunk_serializer<
 			serialization::chunk_types::reshape_layer,
@@ -97,6 +99,15 @@ namespace detail {
 			const number_type)
 		{}
 
+		void accumulate_update(
+			this_type&,
+			const number_type)
+		{}
+
+		void apply_update(
+			const this_type&)
+		{}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 		const output& process(
@@ -123,11 +134,11 @@ namespace detail {
 #endif
 	};
 
-	template <class Input, class Output, class... Args>
-	reshape<Input, Output> make_reshape_layer(
+	template <class Input, class Output, class Number = float, class... Args>
+	reshape<Input, Output, Number> make_reshape_layer(
 		Args&&... args)
 	{
-		typedef reshape<Input, Output> layer_type;
+		typedef reshape<Input, Output, Number> layer_type;
 		return (layer_type(std::forward<Args>(args)...));
 	}
 }
\ No newline at end of file
@@ -0,0 +1,1061 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include "layer.h"
+#include "core.h"
+#include "serialization.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+#include "opencl/convolution.h"
+#include "opencl/separable.h"
+#include "opencl/fusion.h"
+
+#endif
+
+namespace neural_network {
+
+namespace detail {
+
+	// Depthwise convolution works on a (channels, x, y) view of the input. One dimensional
+	// channels are extended with a unit Y dimension, so both cases share the same loops and kernels.
+	template <typename Metrics, typename Core, typename Stride, typename Padding, typename Dilation, const size_t Rank = Metrics::rank>
+	struct planar_core
+	{
+		static_assert(2 == Rank, "Depthwise convolution is supported only for 1D or 2D channels.");
+
+		typedef typename Metrics input_metrics;
+		typedef typename Core core_metrics;
+		typedef typename Stride stride_metrics;
+		typedef typename Padding padding_metrics;
+		typedef typename Dilation dilation_metrics;
+	};
+
+	template <typename Metrics, typename Core, typename Stride, typename Padding, typename Dilation>
+	struct planar_core<Metrics, Core, Stride, Padding, Dilation, 1>
+	{
+		typedef typename algebra::metrics<Metrics::dimension_size, 1> input_metrics;
+		typedef typename algebra::metrics<Core::dimension_size, 1> core_metrics;
+		typedef typename algebra::metrics<Stride::dimension_size, 1> stride_metrics;
+		typedef typename algebra::padding<Padding::dimension_size, 0> padding_metrics;
+		typedef typename algebra::metrics<Dilation::dimension_size, 1> dilation_metrics;
+	};
+
+	template <typename InputMetrics, typename Core, typename Stride, typename Padding, typename Dilation>
+	struct depthwise_convolution_metrics
+	{
+		static_assert(2 <= InputMetrics::rank && InputMetrics::rank <= 3, "Depthwise convolution is supported only for 2D or 3D tensors.");
+
+		typedef typename InputMetrics::base_type spatial_metrics;
+		typedef typename algebra::detail::apply_core_with_padding<spatial_metrics, Core, Stride, Padding, Dilation, spatial_metrics::rank>::metrics convolution_metrics;
+		typedef typename convolution_metrics::template expand<InputMetrics::dimension_size>::type output_metrics;
+
+		typedef typename planar_core<spatial_metrics, Core, Stride, Padding, Dilation> planar;
+		typedef typename algebra::detail::core_window<
+			typename planar::input_metrics,
+			typename planar::core_metrics,
+			typename planar::stride_metrics,
+			typename planar::padding_metrics,
+			typename planar::dilation_metrics,
+			0> window_x;
+		typedef typename algebra::detail::core_window<
+			typename planar::input_metrics,
+			typename planar::core_metrics,
+			typename planar::stride_metrics,
+			typename planar::padding_metrics,
+			typename planar::dilation_metrics,
+			1> window_y;
+
+		typedef typename algebra::detail::apply_core_with_padding<
+			typename planar::input_metrics,
+			typename planar::core_metrics,
+			typename planar::stride_metrics,
+			typename planar::padding_metrics,
+			typename planar::dilation_metrics,
+			2>::metrics planar_convolution_metrics;
+
+		typedef typename planar::input_metrics::template expand<InputMetrics::dimension_size>::type planar_input;
+		typedef typename planar_convolution_metrics::template expand<InputMetrics::dimension_size>::type planar_output;
+		typedef typename planar::core_metrics::template expand<InputMetrics::dimension_size>::type planar_kernels;
+	};
+
+	// Computes the outputs of one row of a depthwise convolution channel. The input and the
+	// kernels are the (x, y) planes of the channel, and output k of the row is at strideY = k.
+	template <class WindowX, class WindowY, class Number>
+	void depthwise_row(
+		const Number* input,
+		const Number* kernels,
+		const size_t strideX,
+		const size_t first,
+		const size_t count,
+		const Number bias,
+		Number* result)
+	{
+		const size_t firstX = WindowX::begin(strideX);
+		const size_t lastX = WindowX::end(strideX);
+
+		for (size_t strideY = first; strideY < count; ++strideY)
+		{
+			const size_t firstY = WindowY::begin(strideY);
+			const size_t lastY = WindowY::end(strideY);
+
+			Number sum = 0.0f;
+
+			for (size_t x = firstX; x < lastX; ++x)
+			{
+				const Number* row = input + WindowX::offset(strideX, x) * WindowY::input_size;
+
+				for (size_t y = firstY; y < lastY; ++y)
+				{
+					sum += kernels[x * WindowY::core_size + y] * row[WindowY::offset(strideY, y)];
+				}
+			}
+
+			result[strideY] = sum + bias;
+		}
+	}
+
+#if defined(__AVX2__)
+	// Computes 8 outputs at a time when none of their cores is clipped by the padding. Every lane
+	// accumulates its core in the scalar order, so the outputs match the scalar loop bit for bit.
+	template <class WindowX, class WindowY>
+	void depthwise_row(
+		const float* input,
+		const float* kernels,
+		const size_t strideX,
+		const size_t first,
+		const size_t count,
+		const float bias,
+		float* result)
+	{
+		const size_t firstX = WindowX::begin(strideX);
+		const size_t lastX = WindowX::end(strideX);
+
+		const __m256i lanes = _mm256_mullo_epi32(
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32(static_cast<int>(WindowY::stride_size)));
+
+		size_t k = first;
+		for (; k + 8 <= count; k += 8)
+		{
+			if (0 != WindowY::begin(k) || WindowY::core_size != WindowY::end(k + 7))
+			{
+				depthwise_row<WindowX, WindowY, float>(input, kernels, strideX, k, k + 8, bias, result);
+				continue;
+			}
+
+			__m256 sum = _mm256_setzero_ps();
+
+			for (size_t x = firstX; x < lastX; ++x)
+			{
+				const float* row = input + WindowX::offset(strideX, x) * WindowY::input_size;
+
+				for (size_t y = 0; y < WindowY::core_size; ++y)
+				{
+					const __m256 values = _mm256_i32gather_ps(row + WindowY::offset(k, y), lanes, 4);
+
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(kernels[x * WindowY::core_size + y]), values));
+				}
+			}
+
+			_mm256_storeu_ps(result + k, _mm256_add_ps(sum, _mm256_set1_ps(bias)));
+		}
+
+		depthwise_row<WindowX, WindowY, float>(input, kernels, strideX, k, count, bias, result);
+	}
+#endif
+
+}
+
+	// Convolution that applies a separate kernel to every input channel. The first dimension of
+	// the input tensor enumerates channels, Core, Stride, Padding and Dilation describe the remaining ones.
+	template <
+		class InputMetrics,
+		class Core,
+		class Stride,
+		class Padding = typename algebra::detail::default_padding<InputMetrics::rank - 1>::type,
+		class Dilation = typename algebra::detail::default_dilation<InputMetrics::rank - 1>::type,
+		class Number = float>
+	class depthwise_convolution
+		: public layer_base<
+			InputMetrics,
+			typename detail::depthwise_convolution_metrics<InputMetrics, Core, Stride, Padding, Dilation>::output_metrics,
+			Number>
+	{
+	public:
+		typedef typename depthwise_convolution<InputMetrics, Core, Stride, Padding, Dilation, Number> this_type;
+		typedef typename detail::depthwise_convolution_metrics<InputMetrics, Core, Stride, Padding, Dilation> impl;
+		typedef typename layer_base<InputMetrics, typename impl::output_metrics, Number> base_type;
+
+		typedef typename detail::layer_memory<true, false> memory_traits;
+
+		typedef typename impl::window_x window_x;
+		typedef typename impl::window_y window_y;
+		typedef typename impl::planar_input planar_input;
+		typedef typename impl::planar_output planar_output;
+		typedef typename impl::planar_kernels planar_kernels;
+
+		typedef typename Core::template expand<InputMetrics::dimension_size>::type::template tensor_of<Number>::type kernel_weights;
+		typedef typename algebra::metrics<InputMetrics::dimension_size>::template tensor_of<Number>::type bias;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::depthwise_convolution_layer,
+			serialization::composite_serializer<
+				serialization::tensor_serializer<kernel_weights>,
+				serialization::tensor_serializer<bias>>
+		> serializer_impl_type;
+
+		depthwise_convolution()
+			: base_type(), m_input(), m_kernels(), m_kernelGradient(), m_bias(), m_biasGradient(), m_accumulatedUpdate()
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
+#endif
+		{
+		}
+
+		depthwise_convolution(
+			std::function<number_type()> initializer)
+				: base_type(), m_input(), m_kernels(initializer), m_kernelGradient(), m_bias(initializer), m_biasGradient(), m_accumulatedUpdate()
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+				, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
+#endif
+		{
+		}
+
+		const output& process(const input& input)
+		{
+			m_input = input;
+
+			auto rin = m_input.reshape<planar_input>();
+			auto rout = m_output.reshape<planar_output>();
+			auto rkernels = m_kernels.reshape<planar_kernels>();
+
+			for (size_t channel = 0; channel < rout.size<0>(); ++channel)
+			{
+				const number_type* channelInput = rin.data() + channel * rin.size<1>() * rin.size<2>();
+				const number_type* channelKernels = rkernels.data() + channel * rkernels.size<1>() * rkernels.size<2>();
+
+				for (size_t strideX = 0; strideX < rout.size<1>(); ++strideX)
+				{
+					detail::depthwise_row<window_x, window_y>(
+						channelInput,
+						channelKernels,
+						strideX,
+						0,
+						rout.size<2>(),
+						m_bias(channel),
+						rout.data() + (channel * rout.size<1>() + strideX) * rout.size<2>());
+				}
+			}
+
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			auto rin = m_input.reshape<planar_input>();
+			auto rgradResult = m_gradient.reshape<planar_input>();
+			auto rgrad = grad.reshape<planar_output>();
+			auto rkernels = m_kernels.reshape<planar_kernels>();
+			auto rkernelGradient = m_kernelGradient.reshape<planar_kernels>();
+
+			rgradResult.fill(0.0f);
+			rkernelGradient.fill(0.0f);
+
+			for (size_t channel = 0; channel < rgrad.size<0>(); ++channel)
+			{
+				number_type sum = 0.0f;
+
+				for (size_t strideX = 0; strideX < rgrad.size<1>(); ++strideX)
+				{
+					const size_t firstX = window_x::begin(strideX);
+					const size_t lastX = window_x::end(strideX);
+
+					for (size_t strideY = 0; strideY < rgrad.size<2>(); ++strideY)
+					{
+						const size_t firstY = window_y::begin(strideY);
+						const size_t lastY = window_y::end(strideY);
+
+						number_type g = rgrad(channel, strideX, strideY);
+						sum += g;
+
+						for (size_t x = firstX; x < lastX; ++x)
+						{
+							const size_t inputX = window_x::offset(strideX, x);
+
+							for (size_t y = firstY; y < lastY; ++y)
+							{
+								const size_t inputY = window_y::offset(strideY, y);
+
+								rgradResult(channel, inputX, inputY) += g * rkernels(channel, x, y);
+								rkernelGradient(channel, x, y) += g * rin(channel, inputX, inputY);
+							}
+						}
+					}
+				}
+
+				m_biasGradient(channel) = sum;
+			}
+
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate)
+		{
+			typedef typename algebra::metrics<kernel_weights::data_size> flat;
+
+			auto rkernels = m_kernels.reshape<flat>();
+			auto rkernelGradient = m_kernelGradient.reshape<flat>();
+
+			for (size_t i = 0; i < rkernels.size<0>(); ++i)
+			{
+				rkernels(i) += rkernelGradient(i) * rate;
+			}
+
+			for (size_t channel = 0; channel < m_bias.size<0>(); ++channel)
+			{
+				m_bias(channel) += m_biasGradient(channel) * rate;
+			}
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its micro-batches.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			target.m_accumulatedUpdate.add(0, m_kernelGradient, rate);
+			target.m_accumulatedUpdate.add(1, m_biasGradient, rate);
+			target.m_accumulatedUpdate.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			source.m_accumulatedUpdate.add_to(0, m_kernels);
+			source.m_accumulatedUpdate.add_to(1, m_bias);
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type& layer)
+			{
+				serializer_impl_type::read(in, layer.m_kernels, layer.m_bias);
+				layer.m_accumulatedUpdate.clear();
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type& layer)
+			{
+				serializer_impl_type::write(out, layer.m_kernels, layer.m_bias);
+			}
+		};
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue& queue)
+		{
+			return this->dispatch_process<planar_output::data_size>(input, queue);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue)
+		{
+			return this->dispatch_compute_gradient<planar_output::data_size>(gradient, queue);
+		}
+
+		void update_weights(
+			const number_type rate,
+			::boost::compute::command_queue& queue)
+		{
+			this->dispatch_update_weights<planar_output::data_size>(rate, queue);
+		}
+
+		enum : bool { supports_fused_epilogue = !(planar_output::data_size < opencl::detail::layer_kernels::min_matrix_size) };
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(supports_fused_epilogue, "Layer is too small to be processed on the device.");
+
+			m_input = input;
+
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::layer_kernels::get_depthwise_convolution_kernel_name();
+			}
+
+			process_on_device(
+				result,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
+	private:
+		template <const size_t TensorSize>
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			return this->process(input);
+		}
+
+		template <const size_t TensorSize>
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			m_input = input;
+
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			process_on_device(
+				m_output,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+
+			return m_output;
+		}
+
+		template <const size_t TensorSize>
+		const input& dispatch_compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			return this->compute_gradient(gradient);
+		}
+
+		template <const size_t TensorSize>
+		const input& dispatch_compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			auto rin = m_input.reshape<planar_input>();
+			auto rgradResult = m_gradient.reshape<planar_input>();
+			auto rgrad = gradient.reshape<planar_output>();
+			auto rkernels = m_kernels.reshape<planar_kernels>();
+			auto rkernelGradient = m_kernelGradient.reshape<planar_kernels>();
+
+			opencl::detail::separable_convolution::compute_depthwise_gradient(
+				rin,
+				rkernels,
+				rgrad,
+				rgradResult,
+				rkernelGradient,
+				m_biasGradient,
+				window_x::stride_size,
+				window_y::stride_size,
+				window_x::padding_size,
+				window_y::padding_size,
+				window_x::dilation_size,
+				window_y::dilation_size,
+				m_kernelProgram,
+				m_gradientKernelName,
+				m_weightsGradientKernelName,
+				context,
+				queue);
+
+			return m_gradient;
+		}
+
+		template <const size_t TensorSize>
+		void dispatch_update_weights(
+			const number_type rate,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			this->update_weights(rate);
+		}
+
+		template <const size_t TensorSize>
+		void dispatch_update_weights(
+			const number_type rate,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::update_weights(
+				m_kernelGradient,
+				m_kernels,
+				m_biasGradient,
+				m_bias,
+				rate,
+				m_kernelProgram,
+				m_weightsKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_depthwise_convolution_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_depthwise_convolution_gradient_kernel_name();
+				m_weightsGradientKernelName = opencl::detail::layer_kernels::get_depthwise_convolution_weights_gradient_kernel_name();
+				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
+			}
+		}
+
+		void process_on_device(
+			output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto rin = m_input.reshape<planar_input>();
+			auto rout = result.reshape<planar_output>();
+			auto rkernels = m_kernels.reshape<planar_kernels>();
+
+			opencl::detail::separable_convolution::process_depthwise(
+				rin,
+				rkernels,
+				m_bias,
+				rout,
+				window_x::stride_size,
+				window_y::stride_size,
+				window_x::padding_size,
+				window_y::padding_size,
+				window_x::dilation_size,
+				window_y::dilation_size,
+				program,
+				kernelName,
+				context,
+				queue);
+		}
+
+#endif
+
+	private:
+		input m_input;
+		kernel_weights m_kernels;
+		kernel_weights m_kernelGradient;
+		bias m_bias;
+		bias m_biasGradient;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+		std::string m_weightsGradientKernelName;
+		std::string m_weightsKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
+
+#endif
+	};
+
+	// 1x1 convolution that mixes input channels at every position. The layer is computed as a
+	// (kernels x channels) by (channels x positions) matrix product.
+	template <class InputMetrics, const size_t Kernels, class Number = float>
+	class pointwise_convolution
+		: public layer_base<
+			InputMetrics,
+			typename InputMetrics::base_type::template expand<Kernels>::type,
+			Number>
+	{
+	public:
+		static_assert(2 <= InputMetrics::rank, "Pointwise convolution requires a channel dimension.");
+
+		typedef typename pointwise_convolution<InputMetrics, Kernels, Number> this_type;
+		typedef typename layer_base<InputMetrics, typename InputMetrics::base_type::template expand<Kernels>::type, Number> base_type;
+
+		typedef typename detail::layer_memory<true, false> memory_traits;
+
+		enum : size_t {
+			channels = InputMetrics::dimension_size,
+			positions = InputMetrics::base_type::data_size
+		};
+
+		typedef typename algebra::metrics<channels, positions> planar_input;
+		typedef typename algebra::metrics<Kernels, positions> planar_output;
+
+		typedef typename algebra::metrics<Kernels, channels>::template tensor_of<Number>::type weights_type;
+		typedef typename algebra::metrics<Kernels>::template tensor_of<Number>::type bias_type;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::pointwise_convolution_layer,
+			serialization::composite_serializer<
+				serialization::tensor_serializer<weights_type>,
+				serialization::tensor_serializer<bias_type>>
+		> serializer_impl_type;
+
+		pointwise_convolution()
+			: base_type(), m_input(), m_weights(), m_weightsGradient(), m_bias(), m_biasGradient(), m_accumulatedUpdate()
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+			, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
+#endif
+		{
+		}
+
+		pointwise_convolution(
+			std::function<number_type()> initializer)
+				: base_type(), m_input(), m_weights(initializer), m_weightsGradient(), m_bias(initializer), m_biasGradient(), m_accumulatedUpdate()
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+				, m_kernelProgram(), m_processKernelName(), m_gradientKernelName(), m_weightsGradientKernelName(), m_weightsKernelName(), m_fusedKernelProgram(), m_fusedKernelName()
+#endif
+		{
+		}
+
+		const output& process(const input& input)
+		{
+			m_input = input;
+
+			auto rin = m_input.reshape<planar_input>();
+			auto rout = m_output.reshape<planar_output>();
+
+			rout.fill(0.0f);
+
+			for (size_t kernel = 0; kernel < Kernels; ++kernel)
+			{
+				for (size_t channel = 0; channel < channels; ++channel)
+				{
+					const number_type w = m_weights(kernel, channel);
+
+					for (size_t pos = 0; pos < positions; ++pos)
+					{
+						rout(kernel, pos) += w * rin(channel, pos);
+					}
+				}
+
+				const number_type b = m_bias(kernel);
+
+				for (size_t pos = 0; pos < positions; ++pos)
+				{
+					rout(kernel, pos) += b;
+				}
+			}
+
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			auto rin = m_input.reshape<planar_input>();
+			auto rgradResult = m_gradient.reshape<planar_input>();
+			auto rgrad = grad.reshape<planar_output>();
+
+			rgradResult.fill(0.0f);
+
+			for (size_t kernel = 0; kernel < Kernels; ++kernel)
+			{
+				for (size_t channel = 0; channel < channels; ++channel)
+				{
+					const number_type w = m_weights(kernel, channel);
+
+					number_type sum = 0.0f;
+					for (size_t pos = 0; pos < positions; ++pos)
+					{
+						const number_type g = rgrad(kernel, pos);
+
+						rgradResult(channel, pos) += g * w;
+						sum += g * rin(channel, pos);
+					}
+
+					m_weightsGradient(kernel, channel) = sum;
+				}
+
+				number_type sum = 0.0f;
+				for (size_t pos = 0; pos < positions; ++pos)
+				{
+					sum += rgrad(kernel, pos);
+				}
+
+				m_biasGradient(kernel) = sum;
+			}
+
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate)
+		{
+			for (size_t kernel = 0; kernel < Kernels; ++kernel)
+			{
+				for (size_t channel = 0; channel < channels; ++channel)
+				{
+					m_weights(kernel, channel) += m_weightsGradient(kernel, channel) * rate;
+				}
+
+				m_bias(kernel) += m_biasGradient(kernel) * rate;
+			}
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its micro-batches.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			target.m_accumulatedUpdate.add(0, m_weightsGradient, rate);
+			target.m_accumulatedUpdate.add(1, m_biasGradient, rate);
+			target.m_accumulatedUpdate.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			source.m_accumulatedUpdate.add_to(0, m_weights);
+			source.m_accumulatedUpdate.add_to(1, m_bias);
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type& layer)
+			{
+				serializer_impl_type::read(in, layer.m_weights, layer.m_bias);
+				layer.m_accumulatedUpdate.clear();
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type& layer)
+			{
+				serializer_impl_type::write(out, layer.m_weights, layer.m_bias);
+			}
+		};
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+		const output& process(
+			const input& input,
+			::boost::compute::command_queue& queue)
+		{
+			return this->dispatch_process<planar_output::data_size>(input, queue);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue)
+		{
+			return this->dispatch_compute_gradient<planar_output::data_size>(gradient, queue);
+		}
+
+		void update_weights(
+			const number_type rate,
+			::boost::compute::command_queue& queue)
+		{
+			this->dispatch_update_weights<planar_output::data_size>(rate, queue);
+		}
+
+		enum : bool { supports_fused_epilogue = !(planar_output::data_size < opencl::detail::layer_kernels::min_matrix_size) };
+
+		template <class Epilogue>
+		void process_fused(
+			const input& input,
+			output& result,
+			::boost::compute::command_queue& queue)
+		{
+			static_assert(supports_fused_epilogue, "Layer is too small to be processed on the device.");
+
+			m_input = input;
+
+			auto context = queue.get_context();
+
+			if (0 == m_fusedKernelName.size())
+			{
+				m_fusedKernelProgram = opencl::detail::kernel_fusion::make_program<Epilogue>(context);
+				m_fusedKernelName = opencl::detail::layer_kernels::get_pointwise_convolution_kernel_name();
+			}
+
+			process_on_device(
+				result,
+				m_fusedKernelProgram,
+				m_fusedKernelName,
+				context,
+				queue);
+		}
+
+	private:
+		template <const size_t TensorSize>
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			return this->process(input);
+		}
+
+		template <const size_t TensorSize>
+		const output& dispatch_process(
+			const input& input,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			m_input = input;
+
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			process_on_device(
+				m_output,
+				m_kernelProgram,
+				m_processKernelName,
+				context,
+				queue);
+
+			return m_output;
+		}
+
+		template <const size_t TensorSize>
+		const input& dispatch_compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			return this->compute_gradient(gradient);
+		}
+
+		template <const size_t TensorSize>
+		const input& dispatch_compute_gradient(
+			const output& gradient,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			auto rin = m_input.reshape<planar_input>();
+			auto rgradResult = m_gradient.reshape<planar_input>();
+			auto rgrad = gradient.reshape<planar_output>();
+
+			opencl::detail::separable_convolution::compute_pointwise_gradient(
+				rin,
+				m_weights,
+				rgrad,
+				rgradResult,
+				m_weightsGradient,
+				m_biasGradient,
+				m_kernelProgram,
+				m_gradientKernelName,
+				m_weightsGradientKernelName,
+				context,
+				queue);
+
+			return m_gradient;
+		}
+
+		template <const size_t TensorSize>
+		void dispatch_update_weights(
+			const number_type rate,
+			::boost::compute::command_queue&,
+			std::enable_if_t<
+				(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			this->update_weights(rate);
+		}
+
+		template <const size_t TensorSize>
+		void dispatch_update_weights(
+			const number_type rate,
+			::boost::compute::command_queue& queue,
+			std::enable_if_t<
+				!(TensorSize < opencl::detail::layer_kernels::min_matrix_size)
+			>* = 0)
+		{
+			auto context = queue.get_context();
+
+			initialize_opencl(context);
+
+			opencl::detail::convolution::update_weights(
+				m_weightsGradient,
+				m_weights,
+				m_biasGradient,
+				m_bias,
+				rate,
+				m_kernelProgram,
+				m_weightsKernelName,
+				context,
+				queue);
+		}
+
+		void initialize_opencl(
+			const ::boost::compute::context& context)
+		{
+			if (0 == m_processKernelName.size())
+			{
+				m_kernelProgram = opencl::detail::layer_kernels::make_program(context);
+
+				m_processKernelName = opencl::detail::layer_kernels::get_pointwise_convolution_kernel_name();
+				m_gradientKernelName = opencl::detail::layer_kernels::get_pointwise_convolution_gradient_kernel_name();
+				m_weightsGradientKernelName = opencl::detail::layer_kernels::get_pointwise_convolution_weights_gradient_kernel_name();
+				m_weightsKernelName = opencl::detail::layer_kernels::get_update_weights_kernel_name();
+			}
+		}
+
+		void process_on_device(
+			output& result,
+			const ::boost::compute::program& program,
+			const std::string& kernelName,
+			const ::boost::compute::context& context,
+			::boost::compute::command_queue& queue)
+		{
+			auto rin = m_input.reshape<planar_input>();
+			auto rout = result.reshape<planar_output>();
+
+			opencl::detail::separable_convolution::process_pointwise(
+				rin,
+				m_weights,
+				m_bias,
+				rout,
+				program,
+				kernelName,
+				context,
+				queue);
+		}
+
+#endif
+
+	private:
+		input m_input;
+		weights_type m_weights;
+		weights_type m_weightsGradient;
+		bias_type m_bias;
+		bias_type m_biasGradient;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
+
+#ifdef NEURAL_NET_ENABLE_OPEN_CL
+
+	private:
+		::boost::compute::program m_kernelProgram;
+		std::string m_processKernelName;
+		std::string m_gradientKernelName;
+		std::string m_weightsGradientKernelName;
+		std::string m_weightsKernelName;
+		::boost::compute::program m_fusedKernelProgram;
+		std::string m_fusedKernelName;
+
+#endif
+	};
+
+	template <
+		class Input,
+		class Core,
+		class Stride,
+		class Padding = typename algebra::detail::default_padding<Input::rank - 1>::type,
+		class Dilation = typename algebra::detail::default_dilation<Input::rank - 1>::type,
+		class Number = float,
+		class... Args>
+	depthwise_convolution<Input, Core, Stride, Padding, Dilation, Number> make_depthwise_convolution_layer(
+		Args&&... args)
+	{
+		typedef depthwise_convolution<Input, Core, Stride, Padding, Dilation, Number> layer_type;
+		return (layer_type(std::forward<Args>(args)...));
+	}
+
+	template <class Input, const size_t Kernels, class Number = float, class... Args>
+	pointwise_convolution<Input, Kernels, Number> make_pointwise_convolution_layer(
+		Args&&... args)
+	{
+		typedef pointwise_convolution<Input, Kernels, Number> layer_type;
+		return (layer_type(std::forward<Args>(args)...));
+	}
+}
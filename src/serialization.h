@@ -54,6 +54,30 @@ namespace serialization {
 		ensemble_layer,
 
 		tanh_activation_layer,
+
+		average_pooling_with_core_layer,
+
+		global_average_pooling_layer,
+
+		depthwise_convolution_layer,
+
+		pointwise_convolution_layer,
+
+		layout_conversion_layer,
+
+		quantized_fully_connected_layer,
+
+		quantized_convolution_layer,
+
+		half_fully_connected_layer,
+
+		bfloat16_fully_connected_layer,
+
+		sparse_fully_connected_layer,
+
+		embedding_layer,
+
+		batch_normalization_layer,
 	};
 
 namespace detail {
@@ -145,6 +169,27 @@ namespace detail {
 		}
 	};
 
+	struct chunk_header
+	{
+		unsigned int size;
+		unsigned int type;
+	};
+
+	// Reads the header of the next chunk, so that a reader accepting several formats can choose
+	// the chunk serializer that reads the content.
+	inline chunk_header read_chunk_header(
+		std::istream& in)
+	{
+		chunk_header header = { 0, 0 };
+		if (!in.read(reinterpret_cast<char*>(std::addressof(header.size)), sizeof(header.size)))
+			detail::serializer_base::throw_io_error("Failure to read chunk size.");
+
+		if (!in.read(reinterpret_cast<char*>(std::addressof(header.type)), sizeof(header.type)))
+			detail::serializer_base::throw_io_error("Failure to read chunk type.");
+
+		return header;
+	}
+
 	template <const chunk_types ChunkType, typename ValueSerializer>
 	struct chunk_serializer : public detail::serializer_base
 	{
@@ -174,6 +219,20 @@ namespace detail {
 			ValueSerializer::read(in, args...);
 		}
 
+		static bool matches(
+			const chunk_header& header)
+		{
+			return (this_type::serialized_data_size == header.size) && (ChunkType == header.type);
+		}
+
+		template <class... Values>
+		static void read_content(
+			std::istream& in,
+			Values&... args)
+		{
+			ValueSerializer::read(in, args...);
+		}
+
 		template <class... Values>
 		static void write(
 			std::ostream& out,
@@ -239,7 +298,7 @@ namespace detail {
 		{
 			MetricsSerializer::read(in);
 
-			typedef typename neural_network::algebra::metrics<Tensor::data_size>::tensor_type flat;
+			typedef typename neural_network::algebra::metrics<Tensor::data_size>::template tensor_of<number_type>::type flat;
 			flat flatValue;
 
 			for (size_t i = 0; i < flatValue.size<0>(); ++i)
@@ -258,7 +317,7 @@ namespace detail {
 			MetricsSerializer::write(out);
 
 			typedef typename neural_network::algebra::metrics<Tensor::data_size> flat;
-			flat::tensor_type flatValue = tensor.reshape<flat>();
+			typename flat::template tensor_of<number_type>::type flatValue = tensor.reshape<flat>();
 
 			for (size_t i = 0; i < flatValue.size<0>(); ++i)
 			{
@@ -0,0 +1,684 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "layer.h"
+#include "parallel.h"
+#include "serialization.h"
+#include "connected.h"
+#include "layout.h"
+#include "network.h"
+#include "checkpoint.h"
+
+namespace neural_network {
+
+namespace detail {
+
+#if defined(__AVX2__)
+	inline float horizontal_sum(
+		const __m256 value)
+	{
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+
+		return _mm_cvtss_f32(sum);
+	}
+#endif
+
+	// Sums the products of the weight blocks of a row with the input values that start at the
+	// columns of the blocks.
+	template <const size_t BlockSize>
+	float sparse_dot_product(
+		const float* values,
+		const std::uint32_t* columns,
+		const float* input,
+		const size_t blocks)
+	{
+		float result = 0.0f;
+		for (size_t k = 0; k < blocks; ++k)
+		{
+			const float* block = values + k * BlockSize;
+			const float* x = input + columns[k];
+
+			for (size_t b = 0; b < BlockSize; ++b)
+			{
+				result += block[b] * x[b];
+			}
+		}
+
+		return result;
+	}
+
+#if defined(__AVX2__)
+	// Gathers the input values of eight single weights at a time.
+	template <>
+	inline float sparse_dot_product<1>(
+		const float* values,
+		const std::uint32_t* columns,
+		const float* input,
+		const size_t blocks)
+	{
+		__m256 sum = _mm256_setzero_ps();
+
+		size_t k = 0;
+		for (; k + 8 <= blocks; k += 8)
+		{
+			const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + k));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(values + k), _mm256_i32gather_ps(input, index, 4)));
+		}
+
+		float result = horizontal_sum(sum);
+		for (; k < blocks; ++k)
+		{
+			result += values[k] * input[columns[k]];
+		}
+
+		return result;
+	}
+
+	// Every block of eight weights multiplies eight contiguous input values.
+	template <>
+	inline float sparse_dot_product<8>(
+		const float* values,
+		const std::uint32_t* columns,
+		const float* input,
+		const size_t blocks)
+	{
+		__m256 sum = _mm256_setzero_ps();
+
+		for (size_t k = 0; k < blocks; ++k)
+		{
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(values + k * 8), _mm256_loadu_ps(input + columns[k])));
+		}
+
+		return horizontal_sum(sum);
+	}
+#endif
+
+	// Splits every row of a row major matrix into blocks of BlockSize consecutive weights, and keeps
+	// the Kept blocks of every row that have the largest sum of squared weights. The kept blocks of
+	// a row are sorted by their first column, and the weights of the last block of a row that fall
+	// past its end are zero. With blocks of one weight this is magnitude pruning.
+	template <const size_t Rows, const size_t Columns, const size_t BlockSize, const size_t Kept, class Weights, class Values, class Indices>
+	void prune_blocks(
+		const Weights& weights,
+		Values& values,
+		Indices& columns)
+	{
+		enum : size_t { blocks = (Columns + BlockSize - 1) / BlockSize };
+
+		static_assert(0 < Kept && Kept <= blocks, "Invalid number of kept blocks.");
+
+		auto rweights = weights.reshape<algebra::metrics<Rows, Columns>>();
+		auto rvalues = values.reshape<algebra::metrics<Rows, Kept, BlockSize>>();
+		auto rcolumns = columns.reshape<algebra::metrics<Rows, Kept>>();
+
+		std::vector<float> scores(blocks);
+		std::vector<size_t> order(blocks);
+
+		for (size_t row = 0; row < Rows; ++row)
+		{
+			for (size_t block = 0; block < blocks; ++block)
+			{
+				float score = 0.0f;
+				for (size_t column = block * BlockSize; column < std::min(Columns, (block + 1) * BlockSize); ++column)
+				{
+					score += rweights(row, column) * rweights(row, column);
+				}
+
+				scores[block] = score;
+			}
+
+			std::iota(order.begin(), order.end(), 0);
+			std::nth_element(
+				order.begin(),
+				order.begin() + (Kept - 1),
+				order.end(),
+				[&scores](const size_t l, const size_t r)
+				{
+					return (scores[l] > scores[r]) || ((scores[l] == scores[r]) && (l < r));
+				});
+
+			std::sort(order.begin(), order.begin() + Kept);
+
+			for (size_t k = 0; k < Kept; ++k)
+			{
+				const size_t first = order[k] * BlockSize;
+				rcolumns(row, k) = static_cast<std::uint32_t>(first);
+
+				for (size_t b = 0; b < BlockSize; ++b)
+				{
+					rvalues(row, k, b) = (first + b < Columns) ? rweights(row, first + b) : 0.0f;
+				}
+			}
+		}
+	}
+}
+
+	// Fully connected layer for inference with pruned weights. Every output neuron keeps the same
+	// number of blocks of BlockSize consecutive weights, chosen by magnitude when the weights of a
+	// trained fully_connected layer are read, and Sparsity is the percentage of the blocks of a row
+	// that are pruned. The kept blocks are stored row by row with the column of their first weight,
+	// so the serialized size of the layer is fixed by its type.
+	template <typename InputMetrics, typename OutputMetrics, const size_t Sparsity, const size_t BlockSize = 1>
+	class sparse_fully_connected : public layer_base<InputMetrics, OutputMetrics>
+	{
+	public:
+		static_assert(Sparsity < 100, "Sparsity must be a percentage below 100.");
+		static_assert(0 < BlockSize, "Block size must be positive.");
+
+		typedef typename sparse_fully_connected<InputMetrics, OutputMetrics, Sparsity, BlockSize> this_type;
+		typedef typename layer_base<InputMetrics, OutputMetrics> base_type;
+		typedef typename fully_connected<InputMetrics, OutputMetrics> float_layer;
+
+		typedef typename detail::layer_memory<false, false> memory_traits;
+
+		typedef typename float_layer::reshaped_input reshaped_input;
+		typedef typename float_layer::reshaped_output reshaped_output;
+
+		enum : size_t {
+			row_blocks = (reshaped_input::data_size + BlockSize - 1) / BlockSize,
+			kept_blocks = row_blocks - (row_blocks * Sparsity) / 100,
+			padded_input_size = row_blocks * BlockSize
+		};
+
+		typedef typename algebra::metrics<reshaped_output::data_size, kept_blocks, BlockSize>::tensor_type values_type;
+		typedef typename algebra::metrics<reshaped_output::data_size, kept_blocks>::template tensor_of<std::uint32_t>::type columns_type;
+		typedef typename float_layer::bias_type bias_type;
+
+		typedef typename serialization::chunk_serializer<
+			serialization::chunk_types::sparse_fully_connected_layer,
+			serialization::composite_serializer<
+				serialization::tensor_serializer<values_type>,
+				serialization::tensor_serializer<columns_type>,
+				serialization::tensor_serializer<bias_type>>
+		> serializer_impl_type;
+
+		sparse_fully_connected()
+			: base_type(), m_values(), m_columns(), m_bias(), m_input()
+		{
+		}
+
+		const output& process(const input& input)
+		{
+			auto rin = input.reshape<reshaped_input>();
+			auto rout = m_output.reshape<reshaped_output>();
+
+			std::copy(rin.data(), rin.data() + reshaped_input::data_size, m_input.data());
+
+			parallel::parallel_for<reshaped_output::data_size, kept_blocks * BlockSize>([this, &rout](const size_t j)
+			{
+				rout(j) = detail::sparse_dot_product<BlockSize>(
+					m_values.data() + j * kept_blocks * BlockSize,
+					m_columns.data() + j * kept_blocks,
+					m_input.data(),
+					kept_blocks) + m_bias(j);
+			});
+
+			return m_output;
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		// Reads either a sparse layer, or prunes the weights of a fully_connected layer.
+		struct serializer
+		{
+			typedef this_type value;
+
+			enum : size_t { serialized_data_size = serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value& layer)
+			{
+				const serialization::chunk_header header = serialization::read_chunk_header(in);
+
+				if (serializer_impl_type::matches(header))
+				{
+					serializer_impl_type::read_content(in, layer.m_values, layer.m_columns, layer.m_bias);
+
+					const std::uint32_t* columns = layer.m_columns.data();
+					for (size_t i = 0; i < columns_type::data_size; ++i)
+					{
+						if (padded_input_size < static_cast<size_t>(columns[i]) + BlockSize)
+							serialization::detail::serializer_base::throw_io_error("Invalid sparse block column.");
+					}
+				}
+				else if (float_layer::serializer_impl_type::matches(header))
+				{
+					typename float_layer::weights_type weights;
+					number_type regularization = 0.0f;
+
+					float_layer::serializer_impl_type::read_content(in, weights, layer.m_bias, regularization);
+
+					detail::prune_blocks<reshaped_output::data_size, reshaped_input::data_size, BlockSize, kept_blocks>(
+						weights,
+						layer.m_values,
+						layer.m_columns);
+				}
+				else
+				{
+					serialization::detail::serializer_base::throw_io_error("Invalid chunk type.");
+				}
+			}
+
+			static void write(
+				std::ostream& out,
+				const value& layer)
+			{
+				serializer_impl_type::write(out, layer.m_values, layer.m_columns, layer.m_bias);
+			}
+		};
+
+	private:
+		values_type m_values;
+		columns_type m_columns;
+		bias_type m_bias;
+
+		// The values past the end of the input stay zero for the last block of a row.
+		typename algebra::metrics<padded_input_size>::tensor_type m_input;
+	};
+
+	// Fully connected layer for sparse inputs, such as one-hot or bag of words features. The weights
+	// of every input value are stored as a row, so that process reads only the rows of the nonzero
+	// input values, and compute_gradient and update_weights touch only those rows. The gradient of
+	// the layer input has the indices of the last input. The regularization decays all rows, so the
+	// weights are stored divided by a common scale, which the update multiplies by the decay and the
+	// passes multiply into the values of the rows they read. The scale is applied to the rows when it
+	// gets small, and the layer is serialized with scaled weights as a fully_connected layer.
+	template <typename InputMetrics, typename OutputMetrics, typename Number = float>
+	class sparse_input_fully_connected
+	{
+	public:
+		typedef typename sparse_input_fully_connected<InputMetrics, OutputMetrics, Number> this_type;
+		typedef typename fully_connected<InputMetrics, OutputMetrics, Number> dense_layer;
+
+		typedef typename algebra::sparse_tensor<InputMetrics, Number> input;
+		typedef typename OutputMetrics::template tensor_of<Number>::type output;
+		typedef typename input::entry entry_type;
+		typedef Number number_type;
+
+		typedef typename detail::layer_memory<true, false, false> memory_traits;
+
+		typedef typename dense_layer::reshaped_input reshaped_input;
+		typedef typename dense_layer::reshaped_output reshaped_output;
+
+		typedef typename algebra::metrics<
+			reshaped_input::data_size,
+			reshaped_output::data_size>::template tensor_of<number_type>::type weights_type;
+		typedef typename dense_layer::bias_type bias_type;
+
+		sparse_input_fully_connected(
+			const number_type regularization = 0.000001f)
+				: m_output(), m_gradient(), m_input(), m_weights(), m_bias(), m_outputGradient(), m_rows(), m_accumulatedUpdate(), m_scale(1), m_regularization(regularization)
+		{
+		}
+
+		// Draws the weights in the order of a fully_connected layer with the same initializer.
+		sparse_input_fully_connected(
+			std::function<number_type()> initializer,
+			const number_type regularization = 0.000001f)
+				: m_output(), m_gradient(), m_input(), m_weights(), m_bias(), m_outputGradient(), m_rows(), m_accumulatedUpdate(), m_scale(1), m_regularization(regularization)
+		{
+			typename dense_layer::weights_type weights(initializer);
+			detail::transpose<reshaped_output::data_size, reshaped_input::data_size>(weights, m_weights);
+
+			m_bias = bias_type(initializer);
+		}
+
+		const output& get_output() const
+		{
+			return m_output;
+		}
+
+		const input& get_gradient() const
+		{
+			return m_gradient;
+		}
+
+		const output& process(const input& input)
+		{
+			m_input = input;
+
+			number_type* result = m_output.data();
+			std::copy(m_bias.data(), m_bias.data() + reshaped_output::data_size, result);
+
+			for (size_t k = 0; k < input.size(); ++k)
+			{
+				const entry_type& e = input[k];
+				const number_type* row = m_weights.data() + e.index * reshaped_output::data_size;
+				const number_type value = e.value * m_scale;
+
+				for (size_t j = 0; j < reshaped_output::data_size; ++j)
+				{
+					result[j] += value * row[j];
+				}
+			}
+
+			return m_output;
+		}
+
+		const input& compute_gradient(const output& grad)
+		{
+			const number_type* gradient = grad.data();
+			std::copy(gradient, gradient + reshaped_output::data_size, m_outputGradient.data());
+
+			m_gradient.clear();
+			m_rows.clear();
+
+			for (size_t k = 0; k < m_input.size(); ++k)
+			{
+				const entry_type& e = m_input[k];
+				const number_type* row = m_weights.data() + e.index * reshaped_output::data_size;
+
+				number_type sum = 0.0f;
+				for (size_t j = 0; j < reshaped_output::data_size; ++j)
+				{
+					sum += row[j] * gradient[j];
+				}
+
+				m_gradient.push_back(e.index, sum * m_scale);
+				m_rows.push_back(e);
+			}
+
+			// Repeated indices of the input update their row once, with the sum of their values.
+			std::sort(m_rows.begin(), m_rows.end(), [](const entry_type& left, const entry_type& right)
+			{
+				return left.index < right.index;
+			});
+
+			size_t count = 0;
+			for (size_t k = 0; k < m_rows.size(); ++k)
+			{
+				if ((0 < count) && (m_rows[count - 1].index == m_rows[k].index))
+				{
+					m_rows[count - 1].value += m_rows[k].value;
+				}
+				else
+				{
+					m_rows[count++] = m_rows[k];
+				}
+			}
+
+			m_rows.resize(count);
+
+			return m_gradient;
+		}
+
+		void update_weights(
+			const number_type rate)
+		{
+			const number_type* gradient = m_outputGradient.data();
+			const number_type decay = 1 + m_regularization * rate;
+
+			m_scale *= decay;
+			const number_type inverse = 1 / m_scale;
+
+			for (const entry_type& e : m_rows)
+			{
+				number_type* row = m_weights.data() + e.index * reshaped_output::data_size;
+
+				for (size_t j = 0; j < reshaped_output::data_size; ++j)
+				{
+					row[j] += e.value * (gradient[j] * rate) * inverse;
+				}
+			}
+
+			for (size_t j = 0; j < m_bias.size<0>(); ++j)
+			{
+				m_bias(j) = m_bias(j) * decay + gradient[j] * rate;
+			}
+
+			normalize_scale();
+		}
+
+		// Adds the update of the last backward pass to the update that the target accumulates for
+		// a batch, so that copies of the layer with the same weights can process its micro-batches.
+		// The bias is kept in the slot after the last row.
+		void accumulate_update(
+			this_type& target,
+			const number_type rate)
+		{
+			detail::accumulated_update<number_type>& update = target.m_accumulatedUpdate;
+			const number_type* gradient = m_outputGradient.data();
+
+			for (const entry_type& e : m_rows)
+			{
+				number_type* sum = update.row(e.index, reshaped_output::data_size);
+
+				for (size_t j = 0; j < reshaped_output::data_size; ++j)
+				{
+					sum[j] += e.value * (gradient[j] * rate);
+				}
+			}
+
+			update.add(reshaped_input::data_size, m_outputGradient, rate);
+			update.add_rate(rate);
+		}
+
+		// Applies the update accumulated by the source, which is this layer or a copy of it with the
+		// same weights, with the regularization of all accumulated passes. The update of a single
+		// pass matches update_weights. A layer that applies its own update also clears it.
+		void apply_update(
+			const this_type& source)
+		{
+			const detail::accumulated_update<number_type>& update = source.m_accumulatedUpdate;
+			const number_type decay = 1 + m_regularization * update.rate();
+
+			m_scale *= decay;
+			const number_type inverse = 1 / m_scale;
+
+			auto apply = [this, inverse](const size_t index, const number_type* sum)
+			{
+				if (reshaped_input::data_size == index)
+					return;
+
+				number_type* row = m_weights.data() + index * reshaped_output::data_size;
+
+				for (size_t j = 0; j < reshaped_output::data_size; ++j)
+				{
+					row[j] += sum[j] * inverse;
+				}
+			};
+
+			update.for_each(apply);
+
+			const number_type* bias = update.find(reshaped_input::data_size);
+
+			for (size_t j = 0; j < m_bias.size<0>(); ++j)
+			{
+				m_bias(j) = m_bias(j) * decay + ((nullptr == bias) ? number_type(0) : bias[j]);
+			}
+
+			normalize_scale();
+
+			if (&source == this)
+				m_accumulatedUpdate.clear();
+		}
+
+		const output& process(
+			const input& input,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->process(input);
+		}
+
+		const input& compute_gradient(
+			const output& gradient,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			return this->compute_gradient(gradient);
+		}
+
+		void update_weights(
+			const number_type rate,
+			parallel::execution_context& context)
+		{
+			parallel::context_scope scope(context);
+			this->update_weights(rate);
+		}
+
+		struct serializer
+		{
+			typedef this_type value_type;
+
+			enum : size_t { serialized_data_size = dense_layer::serializer_impl_type::serialized_data_size };
+
+			static void read(
+				std::istream& in,
+				value_type& layer)
+			{
+				typename dense_layer::weights_type weights;
+				dense_layer::serializer_impl_type::read(in, weights, layer.m_bias, layer.m_regularization);
+
+				detail::transpose<reshaped_output::data_size, reshaped_input::data_size>(weights, layer.m_weights);
+				layer.m_accumulatedUpdate.clear();
+				layer.m_scale = 1;
+			}
+
+			static void write(
+				std::ostream& out,
+				const value_type& layer)
+			{
+				typename dense_layer::weights_type weights;
+				detail::transpose<reshaped_input::data_size, reshaped_output::data_size>(layer.m_weights, weights);
+
+				if (number_type(1) != layer.m_scale)
+				{
+					const number_type scale = layer.m_scale;
+					weights.transform(weights, [scale](const number_type value) { return value * scale; });
+				}
+
+				dense_layer::serializer_impl_type::write(out, weights, layer.m_bias, layer.m_regularization);
+			}
+		};
+
+	private:
+		// Applies the scale to the rows, so that the scale does not underflow in a long training.
+		void normalize_scale()
+		{
+			if (!(m_scale < minimum_scale()))
+				return;
+
+			const number_type scale = m_scale;
+			m_weights.transform(m_weights, [scale](const number_type value) { return value * scale; });
+
+			m_scale = 1;
+		}
+
+		static number_type minimum_scale()
+		{
+			return number_type(0.001);
+		}
+
+		output m_output;
+		input m_gradient;
+
+		input m_input;
+		weights_type m_weights;
+		bias_type m_bias;
+
+		bias_type m_outputGradient;
+		std::vector<entry_type> m_rows;
+		detail::accumulated_update<number_type> m_accumulatedUpdate;
+
+		number_type m_scale;
+		number_type m_regularization;
+	};
+
+	template <class Input, class Output, class Number = float, class... Args>
+	sparse_input_fully_connected<Input, Output, Number> make_sparse_input_fully_connected_layer(
+		Args&&... args)
+	{
+		typedef sparse_input_fully_connected<Input, Output, Number> _Ltype;
+		return (_Ltype(std::forward<Args>(args)...));
+	}
+
+namespace detail {
+
+	template <class Layer, const size_t Sparsity, const size_t BlockSize>
+	struct sparse_layer
+	{
+		typedef Layer type;
+	};
+
+	template <class InputMetrics, class OutputMetrics, const size_t Sparsity, const size_t BlockSize>
+	struct sparse_layer<fully_connected<InputMetrics, OutputMetrics>, Sparsity, BlockSize>
+	{
+		typedef sparse_fully_connected<InputMetrics, OutputMetrics, Sparsity, BlockSize> type;
+	};
+
+	template <const size_t Sparsity, const size_t BlockSize, class... Layers>
+	struct sparse_layer<network<Layers...>, Sparsity, BlockSize>
+	{
+		typedef network<typename sparse_layer<Layers, Sparsity, BlockSize>::type...> type;
+	};
+
+	// A checkpoint is serialized in the format of its network, so the network takes its place.
+	template <class Network, const size_t Sparsity, const size_t BlockSize>
+	struct sparse_layer<checkpoint<Network>, Sparsity, BlockSize>
+	{
+		typedef typename sparse_layer<Network, Sparsity, BlockSize>::type type;
+	};
+}
+
+	// Converts a trained network for sparse inference. Fully connected layers are replaced with
+	// sparse layers that keep the blocks of weights with the largest magnitude in every row. Layers
+	// of network ensembles are not pruned.
+	template <const size_t Sparsity, const size_t BlockSize = 1, class Network>
+	typename detail::sparse_layer<Network, Sparsity, BlockSize>::type prune(
+		const Network& network)
+	{
+		typedef typename detail::sparse_layer<Network, Sparsity, BlockSize>::type result_type;
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		serialization::write(stream, network);
+
+		result_type result;
+		serialization::read(stream, result);
+
+		return result;
+	}
+}
\ No newline at end of file
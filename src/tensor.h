@@ -27,6 +27,7 @@ SOFTWARE.
 #include <memory>
 #include <array>
 #include <functional>
+#include <vector>
 
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
@@ -65,8 +66,11 @@ namespace detail {
 
 }
 
+	template <class Number, const size_t... Metrics>
+	class basic_tensor;
+
 	template <const size_t... Metrics>
-	class tensor;
+	using tensor = basic_tensor<float, Metrics...>;
 
 	template <const size_t Size, const size_t... Args>
 	struct metrics : public metrics<Args...>
@@ -79,6 +83,12 @@ namespace detail {
 
 		typedef typename tensor< Size, Args...> tensor_type;
 
+		template <class Number>
+		struct tensor_of
+		{
+			typedef typename basic_tensor<Number, Size, Args...> type;
+		};
+
 		enum { 
 			rank = base_type::rank + 1,
 			dimension_size = Size,
@@ -119,6 +129,12 @@ namespace detail {
 
 		typedef typename tensor< Size> tensor_type;
 
+		template <class Number>
+		struct tensor_of
+		{
+			typedef typename basic_tensor<Number, Size> type;
+		};
+
 		enum { 
 			rank = 1,
 			dimension_size = Size,
@@ -141,11 +157,13 @@ namespace detail {
 		}
 	};
 
-	template <const size_t... Metrics>
-	class tensor
+	// Tensor of values of the given number type. Storage number types, such as half, convert to
+	// and from float, so the code that reads the values computes in float.
+	template <class Number, const size_t... Metrics>
+	class basic_tensor
 	{
 	public:
-		typedef typename tensor<Metrics...> this_type;
+		typedef typename basic_tensor<Number, Metrics...> this_type;
 		typedef typename metrics<Metrics...> metrics;
 
 		enum { 
@@ -153,17 +171,17 @@ namespace detail {
 			dimension_size = metrics::dimension_size,
 			data_size = metrics::data_size };
 
-		typedef float number_type;
+		typedef Number number_type;
 		typedef typename std::array<number_type, data_size> buffer_type;
 		typedef typename std::shared_ptr<buffer_type> buffer_ptr;
 
-		tensor()
+		basic_tensor()
 			: m_pData(std::make_shared<buffer_type>())
 		{
-			m_pData->fill(0.0f);
+			m_pData->fill(number_type());
 		}
 
-		tensor(std::function<number_type()> initializer)
+		basic_tensor(std::function<number_type()> initializer)
 			: m_pData(std::make_shared<buffer_type>())
 		{
 			std::generate(
@@ -171,11 +189,11 @@ namespace detail {
 				initializer);
 		}
 
-		tensor(const this_type& other)
+		basic_tensor(const this_type& other)
 			: m_pData(other.m_pData)
 		{}
 
-		tensor(const buffer_ptr& ptr)
+		basic_tensor(const buffer_ptr& ptr)
 			: m_pData(ptr)
 		{}
 
@@ -231,11 +249,11 @@ namespace detail {
 		}
 
 		template <class Other>
-		typename Other::tensor_type reshape() const
+		typename Other::template tensor_of<Number>::type reshape() const
 		{
 			static_assert(metrics::data_size == Other::data_size, "Reshape data size must match this data size.");
 
-			return Other::tensor_type(m_pData);
+			return typename Other::template tensor_of<Number>::type(m_pData);
 		}
 
 		void fill(const number_type val)
@@ -243,6 +261,16 @@ namespace detail {
 			m_pData->fill(val);
 		}
 
+		number_type* data()
+		{
+			return m_pData->data();
+		}
+
+		const number_type* data() const
+		{
+			return m_pData->data();
+		}
+
 #ifdef NEURAL_NET_ENABLE_OPEN_CL
 
 		::boost::compute::mapped_view<number_type> get_device_view(
@@ -269,5 +297,95 @@ namespace detail {
 		std::shared_ptr<buffer_type> m_pData;
 	};
 
+	// Tensor of the given metrics that stores only its nonzero values, as pairs of the flat index
+	// of a value and the value. Copies of a sparse tensor share the values.
+	template <class Metrics, class Number = float>
+	class sparse_tensor
+	{
+	public:
+		typedef typename sparse_tensor<Metrics, Number> this_type;
+		typedef typename Metrics metrics;
+
+		enum {
+			rank = metrics::rank,
+			dimension_size = metrics::dimension_size,
+			data_size = metrics::data_size };
+
+		typedef Number number_type;
+		typedef typename metrics::template tensor_of<number_type>::type dense_type;
+
+		struct entry
+		{
+			size_t index;
+			number_type value;
+		};
+
+		typedef typename std::vector<entry> buffer_type;
+
+		sparse_tensor()
+			: m_pData(std::make_shared<buffer_type>())
+		{}
+
+		explicit sparse_tensor(const dense_type& dense)
+			: m_pData(std::make_shared<buffer_type>())
+		{
+			const number_type* values = dense.data();
+			for (size_t i = 0; i < data_size; ++i)
+			{
+				if (number_type() != values[i])
+				{
+					this->push_back(i, values[i]);
+				}
+			}
+		}
+
+		void push_back(
+			const size_t index,
+			const number_type value)
+		{
+			if (false == (index < data_size))
+				throw std::invalid_argument("Index out of range.");
+
+			entry e = { index, value };
+			m_pData->push_back(e);
+		}
+
+		void clear()
+		{
+			m_pData->clear();
+		}
+
+		size_t size() const
+		{
+			return m_pData->size();
+		}
+
+		const entry& operator[](const size_t i) const
+		{
+			return (*m_pData)[i];
+		}
+
+		entry& operator[](const size_t i)
+		{
+			return (*m_pData)[i];
+		}
+
+		dense_type to_dense() const
+		{
+			dense_type result;
+			number_type* values = result.data();
+
+			for (const entry& e : *m_pData)
+			{
+				values[e.index] += e.value;
+			}
+
+			return result;
+		}
+
+	private:
+		std::shared_ptr<buffer_type> m_pData;
+	};
+
 }
 }
\ No newline at end of file
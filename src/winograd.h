@@ -0,0 +1,367 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include "tensor.h"
+#include "parallel.h"
+
+namespace neural_network {
+namespace detail {
+
+	// Winograd minimal filtering F(2x2, 3x3) for 2D convolution with a 3x3 core and 1x1 stride.
+	// Every 4x4 input tile produces a 2x2 output tile with 16 instead of 36 multiplications per
+	// kernel. Transformed kernels are cached until the weights change. See Lavin and Gray,
+	// "Fast Algorithms for Convolutional Neural Networks".
+	template <class KernelWeights>
+	class winograd_f2x2_3x3
+	{
+	public:
+		typedef typename KernelWeights::number_type number_type;
+
+		enum : size_t {
+			kernels = KernelWeights::metrics::dimension_size,
+			tile_size = 4,
+			output_tile_size = 2
+		};
+
+		static_assert(
+			std::is_same<typename KernelWeights::metrics, typename algebra::metrics<kernels, 3, 3>>::value,
+			"Winograd F(2x2, 3x3) requires 3x3 kernels.");
+
+		typedef typename algebra::metrics<kernels, tile_size, tile_size>::template tensor_of<number_type>::type transformed_weights;
+
+		winograd_f2x2_3x3()
+			: m_forward(), m_backward(), m_valid(false)
+		{
+		}
+
+		void invalidate()
+		{
+			m_valid = false;
+		}
+
+		template <class Input, class Bias, class Output>
+		void process(
+			const KernelWeights& weights,
+			const Bias& bias,
+			const Input& input,
+			Output& result)
+		{
+			transform_weights(weights);
+
+			typedef tile_rows<algebra::detail::dimension<typename Output::metrics, 1>::size, algebra::detail::dimension<typename Output::metrics, 2>::size> rows;
+
+			parallel::parallel_for<rows::count, rows::work>([this, &bias, &input, &result](const size_t row)
+			{
+				number_type d[tile_size][tile_size];
+				number_type v[tile_size][tile_size];
+				number_type m[tile_size][tile_size];
+				number_type y[output_tile_size][output_tile_size];
+
+				const size_t tileX = row * output_tile_size;
+
+				for (size_t tileY = 0; tileY < result.size<2>(); tileY += output_tile_size)
+				{
+					load_tile(input, tileX, tileY, d);
+					transform_input(d, v);
+
+					for (size_t kernel = 0; kernel < kernels; ++kernel)
+					{
+						for (size_t i = 0; i < tile_size; ++i)
+						{
+							for (size_t j = 0; j < tile_size; ++j)
+							{
+								m[i][j] = m_forward(kernel, i, j) * v[i][j];
+							}
+						}
+
+						transform_output(m, y);
+
+						store_tile(y, bias(kernel), kernel, tileX, tileY, result);
+					}
+				}
+			});
+		}
+
+		// Gradient of a valid 3x3 correlation is a full correlation of the gradient with the
+		// flipped kernels, so it is computed with the same tiles on the gradient padded by 2.
+		// Products for all kernels are summed before the output transform.
+		template <class Gradient, class Result>
+		void compute_gradient(
+			const KernelWeights& weights,
+			const Gradient& gradient,
+			Result& result)
+		{
+			transform_weights(weights);
+
+			typedef tile_rows<algebra::detail::dimension<typename Result::metrics, 0>::size, algebra::detail::dimension<typename Result::metrics, 1>::size> rows;
+
+			parallel::parallel_for<rows::count, rows::work>([this, &gradient, &result](const size_t row)
+			{
+				number_type d[tile_size][tile_size];
+				number_type v[tile_size][tile_size];
+				number_type m[tile_size][tile_size];
+				number_type y[output_tile_size][output_tile_size];
+
+				const size_t tileX = row * output_tile_size;
+
+				for (size_t tileY = 0; tileY < result.size<1>(); tileY += output_tile_size)
+				{
+					for (size_t i = 0; i < tile_size; ++i)
+					{
+						for (size_t j = 0; j < tile_size; ++j)
+						{
+							m[i][j] = 0.0f;
+						}
+					}
+
+					for (size_t kernel = 0; kernel < kernels; ++kernel)
+					{
+						load_gradient_tile(gradient, kernel, tileX, tileY, d);
+						transform_input(d, v);
+
+						for (size_t i = 0; i < tile_size; ++i)
+						{
+							for (size_t j = 0; j < tile_size; ++j)
+							{
+								m[i][j] += m_backward(kernel, i, j) * v[i][j];
+							}
+						}
+					}
+
+					transform_output(m, y);
+
+					for (size_t i = 0; i < output_tile_size && (tileX + i) < result.size<0>(); ++i)
+					{
+						for (size_t j = 0; j < output_tile_size && (tileY + j) < result.size<1>(); ++j)
+						{
+							result(tileX + i, tileY + j) = y[i][j];
+						}
+					}
+				}
+			});
+		}
+
+	private:
+		// Rows of output tiles are independent and are processed in parallel.
+		template <const size_t Rows, const size_t Columns>
+		struct tile_rows
+		{
+			enum : size_t {
+				count = (Rows + output_tile_size - 1) / output_tile_size,
+				work = ((Columns + output_tile_size - 1) / output_tile_size) * kernels * tile_size * tile_size
+			};
+		};
+
+		void transform_weights(
+			const KernelWeights& weights)
+		{
+			if (m_valid)
+				return;
+
+			number_type g[3][3];
+			number_type u[tile_size][tile_size];
+
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				for (size_t i = 0; i < 3; ++i)
+				{
+					for (size_t j = 0; j < 3; ++j)
+					{
+						g[i][j] = weights(kernel, i, j);
+					}
+				}
+
+				transform_kernel(g, u);
+				store_kernel(u, kernel, m_forward);
+
+				for (size_t i = 0; i < 3; ++i)
+				{
+					for (size_t j = 0; j < 3; ++j)
+					{
+						g[i][j] = weights(kernel, 2 - i, 2 - j);
+					}
+				}
+
+				transform_kernel(g, u);
+				store_kernel(u, kernel, m_backward);
+			}
+
+			m_valid = true;
+		}
+
+		// U = G g G', G = [1 0 0; 1/2 1/2 1/2; 1/2 -1/2 1/2; 0 0 1]
+		static void transform_kernel(
+			const number_type g[3][3],
+			number_type u[tile_size][tile_size])
+		{
+			number_type t[tile_size][3];
+
+			for (size_t j = 0; j < 3; ++j)
+			{
+				t[0][j] = g[0][j];
+				t[1][j] = 0.5f * (g[0][j] + g[1][j] + g[2][j]);
+				t[2][j] = 0.5f * (g[0][j] - g[1][j] + g[2][j]);
+				t[3][j] = g[2][j];
+			}
+
+			for (size_t i = 0; i < tile_size; ++i)
+			{
+				u[i][0] = t[i][0];
+				u[i][1] = 0.5f * (t[i][0] + t[i][1] + t[i][2]);
+				u[i][2] = 0.5f * (t[i][0] - t[i][1] + t[i][2]);
+				u[i][3] = t[i][2];
+			}
+		}
+
+		// V = B' d B, B' = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1]
+		static void transform_input(
+			const number_type d[tile_size][tile_size],
+			number_type v[tile_size][tile_size])
+		{
+			number_type t[tile_size][tile_size];
+
+			for (size_t j = 0; j < tile_size; ++j)
+			{
+				t[0][j] = d[0][j] - d[2][j];
+				t[1][j] = d[1][j] + d[2][j];
+				t[2][j] = d[2][j] - d[1][j];
+				t[3][j] = d[1][j] - d[3][j];
+			}
+
+			for (size_t i = 0; i < tile_size; ++i)
+			{
+				v[i][0] = t[i][0] - t[i][2];
+				v[i][1] = t[i][1] + t[i][2];
+				v[i][2] = t[i][2] - t[i][1];
+				v[i][3] = t[i][1] - t[i][3];
+			}
+		}
+
+		// Y = A' m A, A' = [1 1 1 0; 0 1 -1 -1]
+		static void transform_output(
+			const number_type m[tile_size][tile_size],
+			number_type y[output_tile_size][output_tile_size])
+		{
+			number_type t[output_tile_size][tile_size];
+
+			for (size_t j = 0; j < tile_size; ++j)
+			{
+				t[0][j] = m[0][j] + m[1][j] + m[2][j];
+				t[1][j] = m[1][j] - m[2][j] - m[3][j];
+			}
+
+			for (size_t i = 0; i < output_tile_size; ++i)
+			{
+				y[i][0] = t[i][0] + t[i][1] + t[i][2];
+				y[i][1] = t[i][1] - t[i][2] - t[i][3];
+			}
+		}
+
+		static void store_kernel(
+			const number_type u[tile_size][tile_size],
+			const size_t kernel,
+			transformed_weights& result)
+		{
+			for (size_t i = 0; i < tile_size; ++i)
+			{
+				for (size_t j = 0; j < tile_size; ++j)
+				{
+					result(kernel, i, j) = u[i][j];
+				}
+			}
+		}
+
+		// Elements past the end of the input are read as zero, so odd output sizes are handled
+		// by partial tiles.
+		template <class Input>
+		static void load_tile(
+			const Input& input,
+			const size_t tileX,
+			const size_t tileY,
+			number_type d[tile_size][tile_size])
+		{
+			for (size_t i = 0; i < tile_size; ++i)
+			{
+				for (size_t j = 0; j < tile_size; ++j)
+				{
+					const size_t x = tileX + i;
+					const size_t y = tileY + j;
+
+					d[i][j] = (x < input.size<0>() && y < input.size<1>())
+						? input(x, y)
+						: 0.0f;
+				}
+			}
+		}
+
+		template <class Gradient>
+		static void load_gradient_tile(
+			const Gradient& gradient,
+			const size_t kernel,
+			const size_t tileX,
+			const size_t tileY,
+			number_type d[tile_size][tile_size])
+		{
+			for (size_t i = 0; i < tile_size; ++i)
+			{
+				for (size_t j = 0; j < tile_size; ++j)
+				{
+					const size_t x = tileX + i;
+					const size_t y = tileY + j;
+
+					d[i][j] = (2 <= x && x - 2 < gradient.size<1>() && 2 <= y && y - 2 < gradient.size<2>())
+						? gradient(kernel, x - 2, y - 2)
+						: 0.0f;
+				}
+			}
+		}
+
+		template <class Output>
+		static void store_tile(
+			const number_type y[output_tile_size][output_tile_size],
+			const number_type bias,
+			const size_t kernel,
+			const size_t tileX,
+			const size_t tileY,
+			Output& result)
+		{
+			for (size_t i = 0; i < output_tile_size && (tileX + i) < result.size<1>(); ++i)
+			{
+				for (size_t j = 0; j < output_tile_size && (tileY + j) < result.size<2>(); ++j)
+				{
+					result(kernel, tileX + i, tileY + j) = y[i][j] + bias;
+				}
+			}
+		}
+
+		transformed_weights m_forward;
+		transformed_weights m_backward;
+		bool m_valid;
+	};
+
+}
+}
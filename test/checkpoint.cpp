@@ -0,0 +1,233 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <random>
+#include <sstream>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+std::string serialize_checkpoint_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	return stream.str();
+}
+
+template <class Layer>
+void copy_checkpoint_weights(
+	const std::string& weights,
+	Layer& layer)
+{
+	std::stringstream stream(weights, std::ios_base::in | std::ios_base::binary);
+	neural_network::serialization::read(stream, layer);
+}
+
+template <typename Tensor>
+void check_checkpoint_tensors(
+	const Tensor& expected,
+	const Tensor& actual,
+	const char* message)
+{
+	typedef typename neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(e(i) == a(i), message);
+	}
+}
+
+template <class Network, class Reference, class Input, class Output, class Generator>
+void check_checkpoint_training(
+	Network& net,
+	Reference& reference,
+	Generator& random_values,
+	const char* message)
+{
+	neural_network::squared_error_loss<typename Output::metrics, typename Output::number_type> loss;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		Input input(random_values);
+		Output truth(random_values);
+
+		net.train(input, truth, loss, 0.1f);
+		reference.train(input, truth, loss, 0.1f);
+	}
+
+	test::check_true(serialize_checkpoint_weights(reference) == serialize_checkpoint_weights(net), message);
+
+	Input input(random_values);
+	Output grad(random_values);
+
+	check_checkpoint_tensors(reference.process(input), net.process(input), message);
+	check_checkpoint_tensors(reference.compute_gradient(grad), net.compute_gradient(grad), message);
+}
+
+void test_checkpoint()
+{
+	scenario sc("Test for neural_network::checkpoint class");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	typedef neural_network::algebra::metrics<4> m4;
+	typedef neural_network::algebra::metrics<8> m8;
+	typedef neural_network::algebra::metrics<16> m16;
+	typedef neural_network::algebra::metrics<3, 5> m3x5;
+
+	auto reference = neural_network::make_network(
+		neural_network::make_fully_connected_layer<m3x5, m16>(random_values),
+		neural_network::make_relu_activation_layer<m16>(),
+		neural_network::make_fully_connected_layer<m16, m8>(random_values),
+		neural_network::make_relu_activation_layer<m8>(),
+		neural_network::make_fully_connected_layer<m8, m8>(random_values),
+		neural_network::make_tanh_activation_layer<m8>(),
+		neural_network::make_fully_connected_layer<m8, m8>(random_values),
+		neural_network::make_fully_connected_layer<m8, m8>(random_values),
+		neural_network::make_tanh_activation_layer<m8>(),
+		neural_network::make_fully_connected_layer<m8, m8>(random_values),
+		neural_network::make_fully_connected_layer<m8, m4>(random_values),
+		neural_network::make_logistic_activation_layer<m4>());
+
+	auto make_segment = []()
+	{
+		return neural_network::make_checkpoint(
+			neural_network::make_network(
+				neural_network::make_fully_connected_layer<m8, m8>(),
+				neural_network::make_tanh_activation_layer<m8>(),
+				neural_network::make_fully_connected_layer<m8, m8>()));
+	};
+
+	auto net = neural_network::make_network(
+		neural_network::make_fully_connected_layer<m3x5, m16>(),
+		neural_network::make_relu_activation_layer<m16>(),
+		neural_network::make_fully_connected_layer<m16, m8>(),
+		neural_network::make_relu_activation_layer<m8>(),
+		make_segment(),
+		make_segment(),
+		neural_network::make_fully_connected_layer<m8, m4>(),
+		neural_network::make_logistic_activation_layer<m4>());
+
+	typedef decltype(net) network_type;
+	typedef decltype(reference) reference_type;
+
+	{
+		test::verbose("Checkpoint Tests");
+
+		copy_checkpoint_weights(serialize_checkpoint_weights(reference), net);
+		test::check_true(serialize_checkpoint_weights(reference) == serialize_checkpoint_weights(net), "Checkpoint weights do not match network weights.");
+
+		m3x5::tensor_type input(random_values);
+		check_checkpoint_tensors(reference.process(input), net.process(input), "Invalid checkpoint network output.");
+
+		check_checkpoint_training<network_type, reference_type, m3x5::tensor_type, m4::tensor_type>(
+			net, reference, random_values, "Invalid checkpoint network training.");
+
+		test_layer_serialization("Checkpoint Serialization Tests", net);
+	}
+
+	{
+		test::verbose("Planned Checkpoint Tests");
+
+		typedef network_type::training_memory_plan plan;
+		typedef decltype(make_segment()) segment_type;
+
+		static_assert(segment_type::recompute_size == plan::recompute_size, "Checkpoints must share the recompute region.");
+
+		net.plan_memory(neural_network::memory_mode::training);
+
+		check_checkpoint_training<network_type, reference_type, m3x5::tensor_type, m4::tensor_type>(
+			net, reference, random_values, "Invalid planned checkpoint network training.");
+
+		neural_network::parallel::execution_context context(2);
+		neural_network::squared_error_loss<m4> loss;
+
+		m3x5::tensor_type input(random_values);
+		m4::tensor_type truth(random_values);
+
+		net.train(input, truth, loss, 0.1f, context);
+		reference.train(input, truth, loss, 0.1f);
+
+		test::check_true(serialize_checkpoint_weights(reference) == serialize_checkpoint_weights(net), "Invalid checkpoint network training with a context.");
+	}
+
+	{
+		test::verbose("Double Precision Checkpoint Tests");
+
+		auto doubleReference = neural_network::make_network(
+			neural_network::make_fully_connected_layer<m3x5, m8, double>(random_values),
+			neural_network::make_relu_activation_layer<m8, double>(),
+			neural_network::make_fully_connected_layer<m8, m8, double>(random_values),
+			neural_network::make_tanh_activation_layer<m8, double>(),
+			neural_network::make_fully_connected_layer<m8, m4, double>(random_values),
+			neural_network::make_logistic_activation_layer<m4, double>());
+
+		auto doubleNet = neural_network::make_network(
+			neural_network::make_fully_connected_layer<m3x5, m8, double>(),
+			neural_network::make_relu_activation_layer<m8, double>(),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_fully_connected_layer<m8, m8, double>(),
+					neural_network::make_tanh_activation_layer<m8, double>())),
+			neural_network::make_fully_connected_layer<m8, m4, double>(),
+			neural_network::make_logistic_activation_layer<m4, double>());
+
+		typedef decltype(doubleNet) double_network_type;
+		typedef decltype(doubleReference) double_reference_type;
+
+		test::check_true(
+			std::is_same<double, double_network_type::number_type>::value,
+			"Checkpoint network number type is not double.");
+
+		copy_checkpoint_weights(serialize_checkpoint_weights(doubleReference), doubleNet);
+
+		typedef m3x5::tensor_of<double>::type double_input;
+		typedef m4::tensor_of<double>::type double_output;
+
+		double_input input(random_values);
+		check_checkpoint_tensors(doubleReference.process(input), doubleNet.process(input), "Invalid double precision checkpoint network output.");
+
+		check_checkpoint_training<double_network_type, double_reference_type, double_input, double_output>(
+			doubleNet, doubleReference, random_values, "Invalid double precision checkpoint network training.");
+
+		test_layer_serialization("Double Precision Checkpoint Serialization Tests", doubleNet);
+	}
+
+	sc.pass();
+}
\ No newline at end of file
@@ -24,7 +24,9 @@ SOFTWARE.
 
 #include "stdafx.h"
 
+#include <cmath>
 #include <random>
+#include <sstream>
 
 #include "unittest.h"
 #include "serializationtest.h"
@@ -70,6 +72,175 @@ void test_dense_layer_on_device(
 		openclLayer.process(input, queue));
 }
 
+template <typename Storage>
+void test_mixed_precision_layer()
+{
+	typedef neural_network::algebra::metrics<8> m8;
+	typedef neural_network::algebra::metrics<4> m4;
+
+	typedef neural_network::fully_connected<m8, m4, Storage> layer_type;
+
+	layer_type layer([]() { return 1.0f; }, 0.0f);
+
+	m8::tensor_type input([]() { return 1.0f; });
+	m4::tensor_type gradient([]() { return 1.0f; });
+
+	const float rate = 0.0001f;
+
+	float master = 1.0f;
+	float bias = 1.0f;
+
+	// Updates are smaller than the resolution of the stored weights, so they change the stored
+	// weights only after the master weights have accumulated enough of them.
+	for (int k = 0; k < 100; ++k)
+	{
+		const float stored = static_cast<float>(Storage(master));
+
+		float expected = 0.0f;
+		for (size_t i = 0; i < m8::data_size; ++i)
+		{
+			expected += stored * 1.0f;
+		}
+
+		expected += bias;
+
+		m4::tensor_type output = layer.process(input);
+		for (size_t j = 0; j < m4::data_size; ++j)
+		{
+			test::check_true(std::abs(output(j) - expected) <= 0.00001f * expected, "Invalid output of mixed precision layer.");
+		}
+
+		m8::tensor_type result = layer.compute_gradient(gradient);
+		for (size_t i = 0; i < m8::data_size; ++i)
+		{
+			test::check_true(std::abs(result(i) - 4.0f * stored) <= 0.00001f * stored, "Invalid gradient of mixed precision layer.");
+		}
+
+		layer.update_weights(rate);
+
+		master += (1.0f + 0.0f * master) * rate;
+		bias += (1.0f + 0.0f * bias) * rate;
+	}
+
+	test::check_true(1.0f != static_cast<float>(Storage(master)), "Stored weights were not updated from master weights.");
+
+	test::check_true(
+		neural_network::serialization::model_size(layer) < neural_network::serialization::model_size(neural_network::fully_connected<m8, m4>()),
+		"Model with 16-bit weights is not smaller than the float model.");
+
+	test_layer_serialization("Mixed Precision Fully Connected Layer Serialization Tests", layer);
+}
+
+// Checks the layer against weights that are decayed and updated on every step, with output
+// gradients that are zero for some rows of the weights.
+void test_lazy_decay_layer()
+{
+	typedef neural_network::algebra::metrics<6> m6;
+	typedef neural_network::algebra::metrics<4> m4;
+
+	typedef neural_network::fully_connected<m6, m4> layer_type;
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5f, 0.5f);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	const float regularization = 0.1f;
+	const float rate = -0.05f;
+
+	layer_type layer(random_values, regularization);
+
+	layer_type::weights_type weights;
+	layer_type::bias_type bias;
+
+	auto read_weights = [&layer](layer_type::weights_type& w, layer_type::bias_type& b)
+	{
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		neural_network::serialization::write(stream, layer);
+
+		float r = 0.0f;
+		layer_type::serializer_impl_type::read(stream, w, b, r);
+	};
+
+	read_weights(weights, bias);
+
+	for (size_t k = 0; k < 10; ++k)
+	{
+		m6::tensor_type input(random_values);
+		m4::tensor_type gradient(random_values);
+
+		gradient(k % 4) = 0.0f;
+		if (0 == k % 3)
+		{
+			gradient(3) = 0.0f;
+		}
+
+		m4::tensor_type output = layer.process(input);
+		m6::tensor_type result = layer.compute_gradient(gradient);
+
+		for (size_t j = 0; j < m4::data_size; ++j)
+		{
+			float expected = bias(j);
+			for (size_t i = 0; i < m6::data_size; ++i)
+			{
+				expected += weights(j, i) * input(i);
+			}
+
+			test::check_true(std::abs(output(j) - expected) < 1e-5f, "Invalid output of a layer with decayed rows.");
+		}
+
+		for (size_t i = 0; i < m6::data_size; ++i)
+		{
+			float expected = 0.0f;
+			for (size_t j = 0; j < m4::data_size; ++j)
+			{
+				expected += weights(j, i) * gradient(j);
+			}
+
+			test::check_true(std::abs(result(i) - expected) < 1e-5f, "Invalid gradient of a layer with decayed rows.");
+		}
+
+		layer.update_weights(rate);
+
+		for (size_t j = 0; j < m4::data_size; ++j)
+		{
+			for (size_t i = 0; i < m6::data_size; ++i)
+			{
+				weights(j, i) += (input(i) * gradient(j) + regularization * weights(j, i)) * rate;
+			}
+
+			bias(j) += (gradient(j) + regularization * bias(j)) * rate;
+		}
+	}
+
+	layer_type::weights_type actual;
+	layer_type::bias_type actualBias;
+	read_weights(actual, actualBias);
+
+	for (size_t j = 0; j < m4::data_size; ++j)
+	{
+		for (size_t i = 0; i < m6::data_size; ++i)
+		{
+			test::check_true(std::abs(actual(j, i) - weights(j, i)) < 1e-5f, "Invalid serialized weights of a layer with decayed rows.");
+		}
+	}
+
+	layer_type other;
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+	neural_network::serialization::read(stream, other);
+
+	m6::tensor_type input(random_values);
+	m4::tensor_type expected = layer.process(input);
+	m4::tensor_type output = other.process(input);
+
+	for (size_t j = 0; j < m4::data_size; ++j)
+	{
+		test::check_true(std::abs(output(j) - expected(j)) < 1e-5f, "Invalid output of a layer read with decayed rows.");
+	}
+}
+
 void test_connected()
 {
 	scenario sc("Test for neural_network::fully_connected_layer");
@@ -86,6 +257,19 @@ void test_connected()
 
 	test_layer_serialization("Fully Connected Layer Serialization Tests", layer);
 
+	{
+		test::verbose("Mixed Precision Fully Connected Layer Tests");
+
+		test_mixed_precision_layer<neural_network::algebra::half>();
+		test_mixed_precision_layer<neural_network::algebra::bfloat16>();
+	}
+
+	{
+		test::verbose("Lazy Decay Fully Connected Layer Tests");
+
+		test_lazy_decay_layer();
+	}
+
 	{
 		auto context = find_test_device_context();
 		::boost::compute::command_queue queue(context, context.get_device());
@@ -98,6 +282,8 @@ void test_connected()
 
 			test_dense_layer_on_device<neural_network::fully_connected<m3x2x1, m5x4>>(queue);
 			test_dense_layer_on_device<neural_network::fully_connected<m30x20x10, m5x4>>(queue);
+			test_dense_layer_on_device<neural_network::fully_connected<m30x20x10, m5x4, neural_network::algebra::half>>(queue);
+			test_dense_layer_on_device<neural_network::fully_connected<m30x20x10, m5x4, neural_network::algebra::bfloat16>>(queue);
 		}
 	}
 
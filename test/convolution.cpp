@@ -24,7 +24,10 @@ SOFTWARE.
 
 #include "stdafx.h"
 
+#include <cmath>
+#include <complex>
 #include <random>
+#include <sstream>
 
 #include "unittest.h"
 #include "serializationtest.h"
@@ -147,6 +150,106 @@ void test_3d_convolution_layer_on_device(
 		});
 }
 
+template <typename Tensor>
+void check_tensors_flat(
+	const Tensor& expected,
+	const Tensor& actual)
+{
+	typedef neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	check_tensors_1d(
+		expected.reshape<flat_metrics>(),
+		actual.reshape<flat_metrics>());
+}
+
+template <typename Tensor>
+void check_tensors_close(
+	const Tensor& expected,
+	const Tensor& actual)
+{
+	for (size_t i = 0; i < Tensor::data_size; ++i)
+	{
+		test::check_true(std::abs(expected.data()[i] - actual.data()[i]) < 1e-4f * (1.0f + std::abs(expected.data()[i])), "Unexpected mismatch between C++ and OpenCL weight gradients.");
+	}
+}
+
+template <typename Layer>
+typename Layer::impl::weights_type read_convolution_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	typename Layer::impl::weights_type weights;
+	neural_network::serialization::read(stream, weights);
+
+	return weights;
+}
+
+template <typename Layer, const size_t Batch>
+void test_convolution_layer_batch_on_device(
+	::boost::compute::command_queue& queue)
+{
+	typedef typename Layer::input::metrics::template expand<Batch>::type::tensor_type batch_input;
+	typedef typename Layer::output::metrics::template expand<Batch>::type::tensor_type batch_output;
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5f, 0.5f);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	const unsigned long seedValue = 123;
+
+	gen.seed(seedValue);
+	typename Layer cppLayer(random_values);
+
+	gen.seed(seedValue);
+	typename Layer openclLayer(random_values);
+
+	gen.seed(seedValue);
+	typename Layer gradientLayer(random_values);
+
+	batch_input input(random_values);
+	batch_output grad(random_values);
+
+	batch_output result;
+	batch_input gradientResult;
+
+	openclLayer.process(input, result, queue);
+	openclLayer.compute_gradient(input, grad, gradientResult, queue);
+
+	typename Layer::input itemInput;
+	typename Layer::output itemResult;
+	typename Layer::output itemGrad;
+	typename Layer::input itemGradientResult;
+
+	for (size_t i = 0; i < Batch; ++i)
+	{
+		neural_network::detail::get_batch_item(input, i, itemInput);
+		neural_network::detail::get_batch_item(result, i, itemResult);
+		neural_network::detail::get_batch_item(grad, i, itemGrad);
+		neural_network::detail::get_batch_item(gradientResult, i, itemGradientResult);
+
+		check_tensors_flat(cppLayer.process(itemInput), itemResult);
+		check_tensors_flat(cppLayer.compute_gradient(itemGrad), itemGradientResult);
+
+		// The weight gradient does not depend on the weights, so the updates of every sample add up
+		// to the update with the gradient accumulated over the batch.
+		gradientLayer.process(itemInput);
+		gradientLayer.compute_gradient(itemGrad);
+		gradientLayer.update_weights(1.0f);
+	}
+
+	openclLayer.update_weights(1.0f);
+
+	auto expected = read_convolution_weights(gradientLayer);
+	auto actual = read_convolution_weights(openclLayer);
+
+	check_tensors_close(expected.m_kernels, actual.m_kernels);
+	check_tensors_close(expected.m_bias, actual.m_bias);
+}
+
 void test_convolution()
 {
 	scenario sc("Test for neural_network::convolution_layer class");
@@ -208,6 +311,411 @@ void test_convolution()
 		test_layer_serialization("3D Convolution Layer Serialization Tests", layer);
 	}
 
+	{
+		test::verbose("Convolution With Padding Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::padding<1> p1;
+
+		auto layer = neural_network::make_convolution_layer<m4, m3, m1, 1, p1>([]() { return 1.0f; });
+
+		m4::tensor_type input;
+		input(0) = 1.0f;
+		input(1) = 2.0f;
+		input(2) = 3.0f;
+		input(3) = 4.0f;
+
+		auto output = layer.process(input);
+
+		test::check_true(output.size<1>() == 4, "Invalid size of padded 1D convolution output tensor.");
+		test::check_true(output(0, 0) == 4.0f, "Invalid padded 1D convolution output.");
+		test::check_true(output(0, 1) == 7.0f, "Invalid padded 1D convolution output.");
+		test::check_true(output(0, 2) == 10.0f, "Invalid padded 1D convolution output.");
+		test::check_true(output(0, 3) == 8.0f, "Invalid padded 1D convolution output.");
+
+		neural_network::algebra::metrics<1, 4>::tensor_type grad([]() { return 1.0f; });
+
+		auto result = layer.compute_gradient(grad);
+
+		test::check_true(result(0) == 2.0f, "Invalid padded 1D convolution gradient.");
+		test::check_true(result(1) == 3.0f, "Invalid padded 1D convolution gradient.");
+		test::check_true(result(2) == 3.0f, "Invalid padded 1D convolution gradient.");
+		test::check_true(result(3) == 2.0f, "Invalid padded 1D convolution gradient.");
+	}
+
+	{
+		test::verbose("Convolution With Padding and Dilation Tests");
+
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<10, 10> m10x10;
+		typedef neural_network::algebra::padding<2, 2> p2x2;
+
+		auto layer = neural_network::make_convolution_layer<m10x10, m3x3, m1x1, 3, p2x2, m2x2>(random_values);
+
+		m10x10::tensor_type input(random_values);
+		auto output = layer.process(input);
+
+		test::check_true(output.size<1>() == 10 && output.size<2>() == 10, "Invalid size of dilated 2D convolution output tensor.");
+
+		auto grad = layer.compute_gradient(output);
+		layer.update_weights(0.001f);
+
+		test_layer_serialization("Padded 2D Convolution Layer Serialization Tests", layer);
+
+		typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+		typedef neural_network::algebra::metrics<3, 3, 3> m3x3x3;
+		typedef neural_network::algebra::metrics<11, 11, 3> m11x11x3;
+		typedef neural_network::algebra::padding<1, 1, 1> p1x1x1;
+
+		auto layer3d = neural_network::make_convolution_layer<m11x11x3, m3x3x3, m2x2x1, 2, p1x1x1>(random_values);
+
+		m11x11x3::tensor_type input3d(random_values);
+		auto output3d = layer3d.process(input3d);
+
+		test::check_true(output3d.size<1>() == 6 && output3d.size<2>() == 6 && output3d.size<3>() == 3, "Invalid size of padded 3D convolution output tensor.");
+
+		layer3d.compute_gradient(output3d);
+	}
+
+	{
+		test::verbose("Winograd Convolution Tests");
+
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<12, 11> m12x11;
+		typedef neural_network::algebra::padding<1, 1> p1x1;
+
+		static_assert(neural_network::convolution<m12x11, m3x3, m1x1, 4>::impl::is_winograd, "3x3 convolution with 1x1 stride must use Winograd algorithm.");
+		static_assert(!neural_network::convolution<m12x11, m3x3, m1x1, 4, p1x1>::impl::is_winograd, "Padded convolution must not use Winograd algorithm.");
+		static_assert(!neural_network::convolution<m12x11, m2x2, m1x1, 4>::impl::is_winograd, "2x2 convolution must not use Winograd algorithm.");
+
+		const size_t kernels = 4;
+
+		// Small dyadic values keep both the direct and the Winograd arithmetic exact.
+		size_t counter = 0;
+		auto sequence = [&counter]() { return static_cast<float>(static_cast<int>(counter++ % 7) - 3) * 0.25f; };
+
+		auto layer = neural_network::make_convolution_layer<m12x11, m3x3, m1x1, kernels>(sequence);
+
+		counter = 0;
+		neural_network::algebra::metrics<kernels, 3, 3>::tensor_type weights(sequence);
+		neural_network::algebra::metrics<kernels>::tensor_type bias(sequence);
+
+		size_t inputCounter = 0;
+		m12x11::tensor_type input([&inputCounter]() { return static_cast<float>(static_cast<int>(inputCounter++ % 5) - 2); });
+
+		auto check_output = [&weights, &bias](const m12x11::tensor_type& input, const neural_network::algebra::metrics<kernels, 10, 9>::tensor_type& output)
+		{
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				for (size_t x = 0; x < 10; ++x)
+				{
+					for (size_t y = 0; y < 9; ++y)
+					{
+						float sum = 0.0f;
+						for (size_t i = 0; i < 3; ++i)
+						{
+							for (size_t j = 0; j < 3; ++j)
+							{
+								sum += weights(kernel, i, j) * input(x + i, y + j);
+							}
+						}
+
+						test::check_true(output(kernel, x, y) == sum + bias(kernel), "Invalid Winograd convolution output.");
+					}
+				}
+			}
+		};
+
+		check_output(input, layer.process(input));
+
+		size_t gradCounter = 0;
+		neural_network::algebra::metrics<kernels, 10, 9>::tensor_type grad([&gradCounter]() { return static_cast<float>(static_cast<int>(gradCounter++ % 3) - 1); });
+
+		auto result = layer.compute_gradient(grad);
+
+		neural_network::algebra::metrics<kernels, 3, 3>::tensor_type kernelGradient([]() { return 0.0f; });
+		neural_network::algebra::metrics<kernels>::tensor_type biasGradient([]() { return 0.0f; });
+		m12x11::tensor_type expected([]() { return 0.0f; });
+
+		for (size_t kernel = 0; kernel < kernels; ++kernel)
+		{
+			for (size_t x = 0; x < 10; ++x)
+			{
+				for (size_t y = 0; y < 9; ++y)
+				{
+					biasGradient(kernel) += grad(kernel, x, y);
+
+					for (size_t i = 0; i < 3; ++i)
+					{
+						for (size_t j = 0; j < 3; ++j)
+						{
+							expected(x + i, y + j) += grad(kernel, x, y) * weights(kernel, i, j);
+							kernelGradient(kernel, i, j) += grad(kernel, x, y) * input(x + i, y + j);
+						}
+					}
+				}
+			}
+		}
+
+		for (size_t x = 0; x < 12; ++x)
+		{
+			for (size_t y = 0; y < 11; ++y)
+			{
+				test::check_true(result(x, y) == expected(x, y), "Invalid Winograd convolution gradient.");
+			}
+		}
+
+		layer.update_weights(0.5f);
+
+		for (size_t kernel = 0; kernel < kernels; ++kernel)
+		{
+			for (size_t i = 0; i < 3; ++i)
+			{
+				for (size_t j = 0; j < 3; ++j)
+				{
+					weights(kernel, i, j) += kernelGradient(kernel, i, j) * 0.5f;
+				}
+			}
+
+			bias(kernel) += biasGradient(kernel) * 0.5f;
+		}
+
+		check_output(input, layer.process(input));
+
+		test_layer_serialization("Winograd Convolution Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("FFT Convolution Tests");
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<100> m100;
+		typedef neural_network::algebra::metrics<500> m500;
+
+		static_assert(neural_network::convolution<m500, m100, m4, 3>::impl::is_fft, "Long 1D core must use FFT convolution.");
+		static_assert(!neural_network::convolution<m500, m4, m4, 3>::impl::is_fft, "Short 1D core must not use FFT convolution.");
+
+		static_assert(neural_network::detail::next_fft_size<1>::value == 1, "Invalid FFT size.");
+		static_assert(neural_network::detail::next_fft_size<7>::value == 8, "Invalid FFT size.");
+		static_assert(neural_network::detail::next_fft_size<250>::value == 250, "Invalid FFT size.");
+		static_assert(neural_network::detail::next_fft_size<251>::value == 256, "Invalid FFT size.");
+		static_assert(neural_network::detail::next_fft_size<257>::value == 270, "Invalid FFT size.");
+		static_assert(neural_network::detail::fft_convolution_1d<m500::tensor_type, neural_network::algebra::metrics<3, 100>::tensor_type, 4>::fft_size == 500, "Invalid FFT size.");
+
+		for (const size_t size : { 2, 3, 5, 12, 45, 60, 250 })
+		{
+			std::vector<std::complex<double>> data(size);
+			for (size_t i = 0; i < size; ++i)
+			{
+				data[i] = std::complex<double>(random_values(), random_values());
+			}
+
+			std::vector<std::complex<double>> spectrum(data);
+
+			neural_network::detail::complex_fft<double> fft(size);
+			fft.forward(spectrum.data());
+
+			for (size_t k = 0; k < size; ++k)
+			{
+				std::complex<double> sum(0.0, 0.0);
+				for (size_t i = 0; i < size; ++i)
+				{
+					const double angle = -2.0 * 3.14159265358979323846 * static_cast<double>((i * k) % size) / static_cast<double>(size);
+					sum += data[i] * std::complex<double>(std::cos(angle), std::sin(angle));
+				}
+
+				test::check_true(std::abs(spectrum[k] - sum) < 1e-9, "Invalid mixed radix FFT.");
+			}
+
+			fft.inverse(spectrum.data());
+
+			for (size_t i = 0; i < size; ++i)
+			{
+				test::check_true(std::abs(spectrum[i] - data[i]) < 1e-9, "Invalid inverse mixed radix FFT.");
+			}
+		}
+
+		const size_t kernels = 3;
+		const size_t outputs = 101;
+
+		const unsigned long seedValue = 123;
+
+		gen.seed(seedValue);
+		auto layer = neural_network::make_convolution_layer<m500, m100, m4, kernels>(random_values);
+
+		gen.seed(seedValue);
+		neural_network::algebra::metrics<kernels, 100>::tensor_type weights(random_values);
+		neural_network::algebra::metrics<kernels>::tensor_type bias(random_values);
+
+		m500::tensor_type input(random_values);
+
+		auto check_output = [&weights, &bias](const m500::tensor_type& input, const neural_network::algebra::metrics<kernels, outputs>::tensor_type& output)
+		{
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				for (size_t x = 0; x < outputs; ++x)
+				{
+					float sum = 0.0f;
+					for (size_t i = 0; i < 100; ++i)
+					{
+						sum += weights(kernel, i) * input(x * 4 + i);
+					}
+
+					test::check_true(std::abs(output(kernel, x) - (sum + bias(kernel))) < 1e-4f, "Invalid FFT convolution output.");
+				}
+			}
+		};
+
+		check_output(input, layer.process(input));
+
+		neural_network::algebra::metrics<kernels, outputs>::tensor_type grad(random_values);
+
+		auto result = layer.compute_gradient(grad);
+
+		neural_network::algebra::metrics<kernels, 100>::tensor_type kernelGradient([]() { return 0.0f; });
+		neural_network::algebra::metrics<kernels>::tensor_type biasGradient([]() { return 0.0f; });
+		m500::tensor_type expected([]() { return 0.0f; });
+
+		for (size_t kernel = 0; kernel < kernels; ++kernel)
+		{
+			for (size_t x = 0; x < outputs; ++x)
+			{
+				biasGradient(kernel) += grad(kernel, x);
+
+				for (size_t i = 0; i < 100; ++i)
+				{
+					expected(x * 4 + i) += grad(kernel, x) * weights(kernel, i);
+					kernelGradient(kernel, i) += grad(kernel, x) * input(x * 4 + i);
+				}
+			}
+		}
+
+		for (size_t x = 0; x < 500; ++x)
+		{
+			test::check_true(std::abs(result(x) - expected(x)) < 1e-4f, "Invalid FFT convolution gradient.");
+		}
+
+		layer.update_weights(0.01f);
+
+		for (size_t kernel = 0; kernel < kernels; ++kernel)
+		{
+			for (size_t i = 0; i < 100; ++i)
+			{
+				weights(kernel, i) += kernelGradient(kernel, i) * 0.01f;
+			}
+
+			bias(kernel) += biasGradient(kernel) * 0.01f;
+		}
+
+		check_output(input, layer.process(input));
+
+		test_layer_serialization("FFT Convolution Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("Channels Last Convolution Tests");
+
+		typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+		typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+		typedef neural_network::algebra::metrics<3, 3, 2> m3x3x2;
+		typedef neural_network::algebra::metrics<11, 11, 3> m11x11x3;
+		typedef neural_network::algebra::padding<1, 1, 0> p1x1x0;
+
+		const size_t kernels = 5;
+		const size_t coreSize = m3x3x2::data_size;
+
+		typedef neural_network::convolution<m11x11x3, m3x3x2, m2x2x1, kernels, p1x1x0> expected_layer;
+		typedef neural_network::convolution<m11x11x3, m3x3x2, m2x2x1, kernels, p1x1x0, m1x1x1, neural_network::layout::channels_last> layer_type;
+
+		static_assert(
+			std::is_same<
+				layer_type::output::metrics,
+				neural_network::algebra::detail::move_first_dimension_last<expected_layer::output::metrics>::type
+			>::value,
+			"Channels last convolution must store the kernel dimension last.");
+
+		std::vector<float> values(kernels * coreSize + kernels);
+		std::generate(values.begin(), values.end(), random_values);
+
+		size_t index = 0;
+		expected_layer expected([&values, &index]() { return values[index++]; });
+
+		// Channels last kernel weights are stored with the kernel index varying fastest.
+		index = 0;
+		layer_type layer([&values, &index, kernels, coreSize]()
+			{
+				const size_t i = index++;
+				return (i < kernels * coreSize)
+					? values[((i % kernels) * coreSize) + (i / kernels)]
+					: values[i];
+			});
+
+		m11x11x3::tensor_type input(random_values);
+
+		auto check_output = [](const expected_layer::output& expected, const layer_type::output& actual)
+		{
+			for (size_t kernel = 0; kernel < kernels; ++kernel)
+			{
+				for (size_t x = 0; x < 6; ++x)
+				{
+					for (size_t y = 0; y < 6; ++y)
+					{
+						for (size_t z = 0; z < 2; ++z)
+						{
+							test::check_true(std::abs(expected(kernel, x, y, z) - actual(x, y, z, kernel)) < 1e-5f, "Invalid channels last convolution output.");
+						}
+					}
+				}
+			}
+		};
+
+		check_output(expected.process(input), layer.process(input));
+
+		expected_layer::output grad(random_values);
+		layer_type::output gradLast;
+
+		for (size_t kernel = 0; kernel < kernels; ++kernel)
+		{
+			for (size_t x = 0; x < 6; ++x)
+			{
+				for (size_t y = 0; y < 6; ++y)
+				{
+					for (size_t z = 0; z < 2; ++z)
+					{
+						gradLast(x, y, z, kernel) = grad(kernel, x, y, z);
+					}
+				}
+			}
+		}
+
+		auto expectedResult = expected.compute_gradient(grad);
+		auto result = layer.compute_gradient(gradLast);
+
+		for (size_t x = 0; x < 11; ++x)
+		{
+			for (size_t y = 0; y < 11; ++y)
+			{
+				for (size_t z = 0; z < 3; ++z)
+				{
+					test::check_true(std::abs(expectedResult(x, y, z) - result(x, y, z)) < 1e-5f, "Invalid channels last convolution gradient.");
+				}
+			}
+		}
+
+		expected.update_weights(0.01f);
+		layer.update_weights(0.01f);
+
+		check_output(expected.process(input), layer.process(input));
+
+		test_layer_serialization("Channels Last Convolution Layer Serialization Tests", layer);
+	}
+
 	{
 		auto context = find_test_device_context();
 		::boost::compute::command_queue queue(context, context.get_device());
@@ -226,11 +734,15 @@ void test_convolution()
 		{
 			test::verbose("OpenCL 2D Convolution Layer Tests");
 
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
 			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<3, 3> m3x3;
 			typedef neural_network::algebra::metrics<10, 10> m10x10;
+			typedef neural_network::algebra::padding<1, 1> p1x1;
 
 			test_2d_convolution_layer_on_device<neural_network::convolution<m10x10, m2x2, m2x2, 1>>(queue);
 			test_2d_convolution_layer_on_device<neural_network::convolution<m10x10, m2x2, m2x2, 36>>(queue);
+			test_2d_convolution_layer_on_device<neural_network::convolution<m10x10, m3x3, m1x1, 36, p1x1>>(queue);
 		}
 
 		{
@@ -243,6 +755,34 @@ void test_convolution()
 
 			test_3d_convolution_layer_on_device<neural_network::convolution<m11x11x3, m3x3x2, m2x2x2, 1>>(queue);
 			test_3d_convolution_layer_on_device<neural_network::convolution<m11x11x3, m3x3x2, m2x2x2, 19>>(queue);
+
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+			test_3d_convolution_layer_on_device<neural_network::convolution<m11x11x3, m3x3x2, m2x2x2, 19, p0x0x0, m1x1x1, neural_network::layout::channels_last>>(queue);
+		}
+
+		{
+			test::verbose("OpenCL Batched Convolution Layer Tests");
+
+			typedef neural_network::algebra::metrics<2> m2;
+			typedef neural_network::algebra::metrics<3> m3;
+			typedef neural_network::algebra::metrics<9> m9;
+			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<10, 10> m10x10;
+			typedef neural_network::algebra::metrics<2, 2, 1> m2x2x2;
+			typedef neural_network::algebra::metrics<3, 3, 2> m3x3x2;
+			typedef neural_network::algebra::metrics<11, 11, 3> m11x11x3;
+
+			test_convolution_layer_batch_on_device<neural_network::convolution<m9, m3, m2, 1>, 1>(queue);
+			test_convolution_layer_batch_on_device<neural_network::convolution<m9, m3, m2, 96>, 7>(queue);
+			test_convolution_layer_batch_on_device<neural_network::convolution<m10x10, m2x2, m2x2, 36>, 16>(queue);
+			test_convolution_layer_batch_on_device<neural_network::convolution<m11x11x3, m3x3x2, m2x2x2, 19>, 5>(queue);
+
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+			test_convolution_layer_batch_on_device<neural_network::convolution<m11x11x3, m3x3x2, m2x2x2, 19, p0x0x0, m1x1x1, neural_network::layout::channels_last>, 5>(queue);
 		}
 	}
 
@@ -59,5 +59,86 @@ void test_core()
 		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_stride<m17x17x3, m2x2x2, m1x1x1, 3>::metrics, neural_network::algebra::metrics<16, 16, 2>>::value, "Invalid metrics after applying rank 3 core and stride.");
 	}
 
+	{
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<7> m7;
+		typedef neural_network::algebra::padding<0> p0;
+		typedef neural_network::algebra::padding<1> p1;
+
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m7, m3, m2, p0, m1, 1>::metrics, neural_network::algebra::metrics<3>>::value, "Invalid metrics after applying rank 1 core and stride without padding.");
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m7, m3, m1, p1, m1, 1>::metrics, neural_network::algebra::metrics<7>>::value, "Invalid metrics after applying rank 1 core with padding.");
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m7, m3, m2, p1, m1, 1>::metrics, neural_network::algebra::metrics<4>>::value, "Invalid metrics after applying rank 1 core and stride with padding.");
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m7, m3, m1, p0, m2, 1>::metrics, neural_network::algebra::metrics<3>>::value, "Invalid metrics after applying rank 1 core with dilation.");
+	}
+
+	{
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<32, 32> m32x32;
+		typedef neural_network::algebra::padding<1, 1> p1x1;
+		typedef neural_network::algebra::padding<2, 0> p2x0;
+
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m32x32, m3x3, m1x1, p1x1, m1x1, 2>::metrics, neural_network::algebra::metrics<32, 32>>::value, "Invalid metrics after applying rank 2 core with padding.");
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m32x32, m3x3, m2x2, p1x1, m1x1, 2>::metrics, neural_network::algebra::metrics<16, 16>>::value, "Invalid metrics after applying rank 2 core and stride with padding.");
+		static_assert(std::is_same<neural_network::algebra::detail::apply_core_with_padding<m32x32, m3x3, m1x1, p2x0, m2x2, 2>::metrics, neural_network::algebra::metrics<32, 28>>::value, "Invalid metrics after applying rank 2 core with padding and dilation.");
+
+		static_assert(neural_network::algebra::detail::is_dense_core<neural_network::algebra::detail::default_padding<2>::type, neural_network::algebra::detail::default_dilation<2>::type>::value, "Default padding and dilation must produce a dense core.");
+		static_assert(!neural_network::algebra::detail::is_dense_core<p1x1, m1x1>::value, "Padded core must not be dense.");
+		static_assert(!neural_network::algebra::detail::is_dense_core<neural_network::algebra::padding<0, 0>, m2x2>::value, "Dilated core must not be dense.");
+	}
+
+	{
+		typedef neural_network::algebra::metrics<5> m5;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::padding<1> p1;
+
+		typedef neural_network::algebra::detail::core_window<m5, m3, m2, p1, m1, 0> padded;
+
+		test::check_true(padded::begin(0) == 1 && padded::end(0) == 3, "Invalid core window at the leading edge.");
+		test::check_true(padded::begin(1) == 0 && padded::end(1) == 3, "Invalid core window inside the input tensor.");
+		test::check_true(padded::begin(2) == 0 && padded::end(2) == 2, "Invalid core window at the trailing edge.");
+		test::check_true(padded::offset(0, 1) == 0 && padded::offset(2, 1) == 4, "Invalid core window input offset.");
+
+		typedef neural_network::algebra::detail::core_window<m5, m3, m1, p1, m2, 0> dilated;
+
+		test::check_true(dilated::begin(0) == 1 && dilated::end(0) == 3, "Invalid dilated core window at the leading edge.");
+		test::check_true(dilated::begin(1) == 0 && dilated::end(1) == 3, "Invalid dilated core window inside the input tensor.");
+		test::check_true(dilated::begin(2) == 0 && dilated::end(2) == 2, "Invalid dilated core window at the trailing edge.");
+		test::check_true(dilated::offset(2, 1) == 3, "Invalid dilated core window input offset.");
+
+		test::check_true(padded::output_size == 3 && dilated::output_size == 3, "Invalid core window output size.");
+
+		for (size_t inputX = 0; inputX < 5; ++inputX)
+		{
+			for (size_t x = 0; x < 3; ++x)
+			{
+				bool covered = false;
+				for (size_t i = padded::begin(x); i < padded::end(x); ++i)
+				{
+					covered = covered || (padded::offset(x, i) == inputX);
+				}
+
+				const bool mapped = (padded::first_position(inputX) <= x) && (x < padded::last_position(inputX)) && (padded::core_index(x, inputX) < padded::core_size);
+				test::check_true(covered == mapped, "Invalid core window output range for an input position.");
+				test::check_true(!mapped || padded::offset(x, padded::core_index(x, inputX)) == inputX, "Invalid core window index for an input position.");
+
+				covered = false;
+				for (size_t i = dilated::begin(x); i < dilated::end(x); ++i)
+				{
+					covered = covered || (dilated::offset(x, i) == inputX);
+				}
+
+				const bool dilatedMapped = (dilated::first_position(inputX) <= x) && (x < dilated::last_position(inputX)) && (dilated::core_index(x, inputX) < dilated::core_size);
+				test::check_true(covered == dilatedMapped, "Invalid dilated core window output range for an input position.");
+				test::check_true(!dilatedMapped || dilated::offset(x, dilated::core_index(x, inputX)) == inputX, "Invalid dilated core window index for an input position.");
+			}
+		}
+	}
+
 	sc.pass();
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+typename Layer::weights_type read_embedding_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	typename Layer::weights_type weights;
+	typename Layer::number_type* table = weights.data();
+	typename Layer::number_type regularization = 0.0f;
+
+	Layer::serializer_impl_type::read(stream, table, regularization);
+
+	return weights;
+}
+
+template <class Layer, class Generator>
+void check_embedding_training(
+	Layer& layer,
+	Generator& random_values,
+	const float regularization)
+{
+	typedef typename Layer::output output;
+	typedef typename Layer::weights_type weights_type;
+
+	typename Layer::input input;
+	input(0) = 3;
+	input(1) = 7;
+	input(2) = 3;
+	input(3) = 0;
+
+	weights_type before = read_embedding_weights(layer);
+
+	output result = layer.process(input);
+	for (size_t k = 0; k < 4; ++k)
+	{
+		for (size_t d = 0; d < result.size<1>(); ++d)
+		{
+			test::check_true(result(k, d) == before(input(k), d), "Invalid embedding row.");
+		}
+	}
+
+	output gradient(random_values);
+	layer.compute_gradient(gradient);
+
+	const float rate = -0.1f;
+	layer.update_weights(rate);
+
+	weights_type after = read_embedding_weights(layer);
+
+	for (size_t i = 0; i < after.size<0>(); ++i)
+	{
+		for (size_t d = 0; d < after.size<1>(); ++d)
+		{
+			float sum = 0.0f;
+			bool read = false;
+
+			for (size_t k = 0; k < 4; ++k)
+			{
+				if (i == input(k))
+				{
+					sum += gradient(k, d);
+					read = true;
+				}
+			}
+
+			const float expected = read ? (before(i, d) + (sum + regularization * before(i, d)) * rate) : before(i, d);
+			test::check_true(std::abs(after(i, d) - expected) < 1e-5f, "Invalid embedding row after update.");
+		}
+	}
+}
+
+void test_embedding()
+{
+	scenario sc("Test for neural_network::embedding class");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	typedef neural_network::algebra::metrics<4> m4;
+	typedef neural_network::algebra::metrics<3> m3;
+
+	typedef neural_network::embedding<m4, 10, 6> layer_type;
+
+	static_assert(std::is_same<layer_type::output::metrics, neural_network::algebra::metrics<4, 6>>::value, "Invalid output metrics of embedding layer.");
+
+	const float regularization = 0.01f;
+
+	{
+		test::verbose("Embedding Layer Tests");
+
+		layer_type layer(random_values, regularization);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			check_embedding_training(layer, random_values, regularization);
+		}
+
+		layer_type::input input;
+		input(2) = 10;
+
+		test::check_exception<std::invalid_argument>(
+			[&layer, &input]() { layer.process(input); },
+			"Index past the end of the table must throw.");
+
+		test_layer_serialization("Embedding Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("Mapped Embedding Layer Tests");
+
+		const char* path = "embedding_table.bin";
+		std::remove(path);
+
+		{
+			const unsigned int seed = rd();
+
+			gen.seed(seed);
+			layer_type layer(random_values, regularization);
+
+			gen.seed(seed);
+			layer_type mapped(path, random_values, regularization);
+
+			for (int i = 0; i < 3; ++i)
+			{
+				check_embedding_training(mapped, random_values, regularization);
+			}
+
+			std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			neural_network::serialization::write(stream, mapped);
+			neural_network::serialization::read(stream, layer);
+
+			layer_type reopened(path, regularization);
+
+			layer_type::input input;
+			input(0) = 9;
+			input(1) = 3;
+
+			layer_type::output expected = layer.process(input);
+			layer_type::output actual = reopened.process(input);
+
+			for (size_t k = 0; k < 4; ++k)
+			{
+				for (size_t d = 0; d < 6; ++d)
+				{
+					test::check_true(expected(k, d) == actual(k, d), "Invalid row of a reopened embedding table.");
+				}
+			}
+
+			test_layer_serialization("Mapped Embedding Layer Serialization Tests", mapped);
+		}
+
+		test::check_exception<std::ios_base::failure>(
+			[path]() { neural_network::embedding<m4, 20, 6> other(path); },
+			"Table file of a different size must not be mapped.");
+
+		std::remove(path);
+	}
+
+	{
+		test::verbose("Embedding Network Tests");
+
+		auto net = neural_network::make_network(
+			neural_network::make_embedding_layer<m4, 50, 8>(random_values),
+			neural_network::make_fully_connected_layer<neural_network::algebra::metrics<4, 8>, m3>(random_values),
+			neural_network::make_logistic_activation_layer<m3>());
+
+		typedef decltype(net) network_type;
+
+		network_type::input input;
+		input(0) = 42;
+		input(1) = 7;
+		input(2) = 7;
+		input(3) = 0;
+
+		m3::tensor_type truth;
+		truth(2) = 1.0f;
+
+		neural_network::squared_error_loss<m3> loss;
+
+		const float before = loss.compute(net.process(input), truth);
+		for (int i = 0; i < 20; ++i)
+		{
+			net.train(input, truth, loss, 0.5f);
+		}
+
+		test::check_true(loss.compute(net.process(input), truth) < before, "Training of a network with an embedding must reduce the loss.");
+
+		test_layer_serialization("Embedding Network Serialization Tests", net);
+	}
+
+	sc.pass();
+}
\ No newline at end of file
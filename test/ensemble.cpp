@@ -247,5 +247,52 @@ void test_ensemble()
 		test::check_true(finalLoss < initialLoss, "Training did not improve the network.");
 	}
 
+	{
+		test::verbose("OpenCL Multi-Queue Network Ensemble Tests");
+
+		auto context = find_test_device_context();
+
+		std::vector<::boost::compute::command_queue> queues;
+		queues.push_back(::boost::compute::command_queue(context, context.get_device()));
+		queues.push_back(::boost::compute::command_queue(context, context.get_device()));
+
+		typedef neural_network::algebra::metrics<32, 32> m32x32;
+		typedef neural_network::algebra::metrics<3, 32, 32> m3x32x32;
+
+		auto ensemble = neural_network::make_ensemble(
+
+			neural_network::make_network(
+				neural_network::make_fully_connected_layer<m32x32, m32x32>(random_values),
+				neural_network::make_relu_activation_layer<m32x32>()
+			),
+
+			neural_network::make_network(
+				neural_network::make_fully_connected_layer<m32x32, m32x32>(random_values),
+				neural_network::make_logistic_activation_layer<m32x32>()
+			),
+
+			neural_network::make_network(
+				neural_network::make_fully_connected_layer<m32x32, m32x32>(random_values),
+				neural_network::make_tanh_activation_layer<m32x32>()
+			)
+		);
+
+		m32x32::tensor_type input(random_values);
+		m3x32x32::tensor_type gradient(random_values);
+
+		m3x32x32::tensor_type expectedResult;
+		ensemble.process(input).transform(
+			expectedResult,
+			[](const float& v) { return v; });
+
+		m32x32::tensor_type expectedGradient;
+		ensemble.compute_gradient(gradient).transform(
+			expectedGradient,
+			[](const float& v) { return v; });
+
+		check_tensors_3d(expectedResult, ensemble.process(input, queues));
+		check_tensors_2d(expectedGradient, ensemble.compute_gradient(gradient, queues));
+	}
+
 	sc.pass();
 }
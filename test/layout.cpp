@@ -0,0 +1,179 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <random>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+#include "opencltest.h"
+
+template <typename Tensor>
+void check_same_tensors(
+	const Tensor& expected,
+	const Tensor& actual,
+	const char* message)
+{
+	typedef typename neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(e(i) == a(i), message);
+	}
+}
+
+void test_layout()
+{
+	scenario sc("Test for neural_network::layout_conversion class");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	{
+		test::verbose("Layout Conversion Tests");
+
+		typedef neural_network::algebra::metrics<2, 3, 4> m2x3x4;
+		typedef neural_network::algebra::metrics<3, 4, 2> m3x4x2;
+
+		auto toLast = neural_network::make_layout_conversion_layer<m2x3x4, neural_network::layout::channels_last>();
+		auto toFirst = neural_network::make_layout_conversion_layer<m3x4x2, neural_network::layout::channels_first>();
+
+		static_assert(std::is_same<decltype(toLast)::output, m3x4x2::tensor_type>::value, "Invalid channels last conversion output.");
+		static_assert(std::is_same<decltype(toFirst)::output, m2x3x4::tensor_type>::value, "Invalid channels first conversion output.");
+
+		m2x3x4::tensor_type input(random_values);
+
+		auto output = toLast.process(input);
+
+		for (size_t channel = 0; channel < 2; ++channel)
+		{
+			for (size_t x = 0; x < 3; ++x)
+			{
+				for (size_t y = 0; y < 4; ++y)
+				{
+					test::check_true(output(x, y, channel) == input(channel, x, y), "Invalid channels last conversion.");
+				}
+			}
+		}
+
+		check_same_tensors(input, toFirst.process(output), "Invalid channels first conversion.");
+		check_same_tensors(input, toLast.compute_gradient(output), "Invalid channels last conversion gradient.");
+
+		test_layer_serialization("Layout Conversion Layer Serialization Tests", toLast);
+	}
+
+	{
+		test::verbose("Channels Last Network Tests");
+
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<10, 10> m10x10;
+		typedef neural_network::algebra::padding<0, 0> p0x0;
+		typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+		typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+		typedef neural_network::algebra::metrics<3, 3, 1> m3x3x1;
+		typedef neural_network::algebra::metrics<2, 2, 4> m2x2x4;
+		typedef neural_network::algebra::metrics<4, 5, 5> m4x5x5;
+		typedef neural_network::algebra::metrics<5, 5, 4> m5x5x4;
+		typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+		const unsigned long seedValue = 123;
+
+		m10x10::tensor_type input(random_values);
+
+		{
+			gen.seed(seedValue);
+			auto net = neural_network::make_network(
+				neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4, p0x0, m1x1, neural_network::layout::channels_last>(random_values),
+				neural_network::make_relu_activation_layer<m4x5x5>());
+
+			static_assert(
+				std::is_same<decltype(net)::adapter_type, neural_network::layout_conversion<m5x5x4, neural_network::layout::channels_first>>::value,
+				"Network must convert channels last output to channels first.");
+
+			gen.seed(seedValue);
+			auto convolution = neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4, p0x0, m1x1, neural_network::layout::channels_last>(random_values);
+			auto conversion = neural_network::make_layout_conversion_layer<m5x5x4, neural_network::layout::channels_first>();
+			auto relu = neural_network::make_relu_activation_layer<m4x5x5>();
+
+			check_same_tensors(
+				relu.process(conversion.process(convolution.process(input))),
+				net.process(input),
+				"Invalid channels last network output.");
+
+			m4x5x5::tensor_type grad(random_values);
+
+			check_same_tensors(
+				convolution.compute_gradient(conversion.compute_gradient(relu.compute_gradient(grad))),
+				net.compute_gradient(grad),
+				"Invalid channels last network gradient.");
+		}
+
+		{
+			gen.seed(seedValue);
+			auto net = neural_network::make_network(
+				neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4>(random_values),
+				neural_network::make_max_pooling_layer<m5x5x4, m3x3x1, m2x2x1, p0x0x0, m1x1x1, neural_network::layout::channels_last>(),
+				neural_network::make_fully_connected_layer<m2x2x4, m3>(random_values));
+
+			static_assert(
+				std::is_same<decltype(net)::adapter_type, neural_network::layout_conversion<m4x5x5, neural_network::layout::channels_last>>::value,
+				"Network must convert channels first output to channels last.");
+
+			gen.seed(seedValue);
+			auto convolution = neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4>(random_values);
+			auto conversion = neural_network::make_layout_conversion_layer<m4x5x5, neural_network::layout::channels_last>();
+			auto pooling = neural_network::make_max_pooling_layer<m5x5x4, m3x3x1, m2x2x1, p0x0x0, m1x1x1, neural_network::layout::channels_last>();
+			auto connected = neural_network::make_fully_connected_layer<m2x2x4, m3>(random_values);
+
+			check_same_tensors(
+				connected.process(pooling.process(conversion.process(convolution.process(input)))),
+				net.process(input),
+				"Invalid channels last network output.");
+
+			m3::tensor_type grad(random_values);
+
+			check_same_tensors(
+				convolution.compute_gradient(conversion.compute_gradient(pooling.compute_gradient(connected.compute_gradient(grad)))),
+				net.compute_gradient(grad),
+				"Invalid channels last network gradient.");
+
+			test_layer_serialization("Channels Last Network Serialization Tests", net);
+		}
+	}
+
+	sc.pass();
+}
@@ -0,0 +1,223 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <random>
+
+#include "unittest.h"
+
+#include "..\src\ai.h"
+
+template <typename Tensor>
+void check_planned_tensors(
+	const Tensor& expected,
+	const Tensor& actual,
+	const char* message)
+{
+	typedef typename neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(e(i) == a(i), message);
+	}
+}
+
+template <class Network, class Input, class Output, class Generator>
+void check_planned_training(
+	Network& planned,
+	Network& reference,
+	Generator& random_values,
+	const char* message)
+{
+	neural_network::squared_error_loss<typename Output::metrics> loss;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		Input input(random_values);
+		Output truth(random_values);
+
+		planned.train(input, truth, loss, 0.1f);
+		reference.train(input, truth, loss, 0.1f);
+	}
+
+	Input input(random_values);
+	Output grad(random_values);
+
+	check_planned_tensors(reference.process(input), planned.process(input), message);
+	check_planned_tensors(reference.compute_gradient(grad), planned.compute_gradient(grad), message);
+}
+
+void test_memory()
+{
+	scenario sc("Test for neural_network::memory_mode planning");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	const auto seedValue = rd();
+
+	typedef neural_network::algebra::metrics<4> m4;
+	typedef neural_network::algebra::metrics<6> m6;
+	typedef neural_network::algebra::metrics<12> m12;
+	typedef neural_network::algebra::metrics<16> m16;
+	typedef neural_network::algebra::metrics<100> m100;
+	typedef neural_network::algebra::metrics<1, 1> m1x1;
+	typedef neural_network::algebra::metrics<3, 3> m3x3;
+	typedef neural_network::algebra::metrics<10, 10> m10x10;
+	typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+	typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+	typedef neural_network::algebra::metrics<5, 5, 4> m5x5x4;
+	typedef neural_network::algebra::metrics<10, 10, 4> m10x10x4;
+	typedef neural_network::algebra::metrics<4, 10, 10> m4x10x10;
+	typedef neural_network::algebra::metrics<3, 4> m3x4;
+	typedef neural_network::algebra::padding<1, 1> p1x1;
+	typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+	auto make_test_network = [&random_values]()
+	{
+		return neural_network::make_network(
+			neural_network::make_convolution_layer<m10x10, m3x3, m1x1, 4, p1x1>(random_values),
+			neural_network::make_relu_activation_layer<m4x10x10>(),
+			neural_network::make_max_pooling_layer<m10x10x4, m2x2x1, m2x2x1, p0x0x0, m1x1x1, neural_network::layout::channels_last>(),
+			neural_network::make_reshape_layer<m5x5x4, m100>(),
+			neural_network::make_fully_connected_layer<m100, m16>(random_values),
+			neural_network::make_tanh_activation_layer<m16>(),
+			neural_network::make_fully_connected_layer<m16, m4>(random_values),
+			neural_network::make_logistic_activation_layer<m4>());
+	};
+
+	typedef decltype(make_test_network()) network_type;
+
+	{
+		test::verbose("Memory Plan Tests");
+
+		typedef network_type::inference_memory_plan inference_plan;
+		typedef network_type::training_memory_plan training_plan;
+
+		static_assert(inference_plan::buffer_size == training_plan::buffer_size, "Plans must describe the same buffers.");
+		static_assert(inference_plan::arena_size + inference_plan::private_size < training_plan::arena_size + training_plan::private_size, "Inference plan must keep fewer buffers than training plan.");
+		static_assert(training_plan::arena_size + training_plan::private_size < training_plan::buffer_size, "Training plan must share buffers.");
+		static_assert(0 < training_plan::slot_size_0 && 0 < training_plan::slot_size_1, "Training plan must use both slots.");
+
+		static_assert(std::is_same<
+			neural_network::detail::memory_traits_of<neural_network::algebra::metrics<4>::tensor_type>::type,
+			neural_network::detail::layer_memory<true, true, false>>::value,
+			"Types without memory traits must keep their own memory.");
+	}
+
+	{
+		test::verbose("Inference Memory Plan Tests");
+
+		gen.seed(seedValue);
+		auto planned = make_test_network();
+
+		gen.seed(seedValue);
+		auto reference = make_test_network();
+
+		planned.plan_memory(neural_network::memory_mode::inference);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			m10x10::tensor_type input(random_values);
+
+			check_planned_tensors(reference.process(input), planned.process(input), "Invalid output of network planned for inference.");
+		}
+	}
+
+	{
+		test::verbose("Training Memory Plan Tests");
+
+		gen.seed(seedValue);
+		auto planned = make_test_network();
+
+		gen.seed(seedValue);
+		auto reference = make_test_network();
+
+		planned.plan_memory(neural_network::memory_mode::inference);
+		planned.plan_memory(neural_network::memory_mode::training);
+
+		check_planned_training<network_type, m10x10::tensor_type, m4::tensor_type>(
+			planned, reference, random_values, "Invalid network planned for training.");
+	}
+
+	{
+		test::verbose("Ensemble Memory Plan Tests");
+
+		auto make_test_ensemble = [&random_values]()
+		{
+			return neural_network::make_network(
+				neural_network::make_fully_connected_layer<m6, m16>(random_values),
+				neural_network::make_relu_activation_layer<m16>(),
+				neural_network::make_ensemble(
+					neural_network::make_network(
+						neural_network::make_fully_connected_layer<m16, m4>(random_values),
+						neural_network::make_relu_activation_layer<m4>()),
+					neural_network::make_network(
+						neural_network::make_fully_connected_layer<m16, m6>(random_values),
+						neural_network::make_tanh_activation_layer<m6>(),
+						neural_network::make_fully_connected_layer<m6, m4>(random_values),
+						neural_network::make_logistic_activation_layer<m4>()),
+					neural_network::make_network(
+						neural_network::make_fully_connected_layer<m16, m4>(random_values),
+						neural_network::make_tanh_activation_layer<m4>())),
+				neural_network::make_reshape_layer<m3x4, m12>(),
+				neural_network::make_fully_connected_layer<m12, m4>(random_values),
+				neural_network::make_logistic_activation_layer<m4>());
+		};
+
+		typedef decltype(make_test_ensemble()) ensemble_network_type;
+
+		gen.seed(seedValue);
+		auto planned = make_test_ensemble();
+
+		gen.seed(seedValue);
+		auto reference = make_test_ensemble();
+
+		planned.plan_memory(neural_network::memory_mode::training);
+
+		check_planned_training<ensemble_network_type, m6::tensor_type, m4::tensor_type>(
+			planned, reference, random_values, "Invalid ensemble planned for training.");
+
+		neural_network::parallel::execution_context context(2);
+		neural_network::squared_error_loss<m4> loss;
+
+		m6::tensor_type input(random_values);
+		m4::tensor_type truth(random_values);
+
+		planned.train(input, truth, loss, 0.1f, context);
+		reference.train(input, truth, loss, 0.1f);
+
+		check_planned_tensors(reference.process(input), planned.process(input, context), "Invalid ensemble planned for training with a context.");
+	}
+
+	sc.pass();
+}
\ No newline at end of file
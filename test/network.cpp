@@ -84,6 +84,103 @@ void test_network()
 		test_layer_serialization("Network Serialization Tests", net);
 	}
 
+	{
+		test::verbose("C++ Double Precision Network Tests");
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<36> m36;
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<6, 6> m6x6;
+		typedef neural_network::algebra::metrics<2, 6, 6> m2x6x6;
+		typedef neural_network::algebra::padding<1, 1> p1x1;
+		typedef neural_network::layout::channels_first channels_first;
+
+		std::mt19937 floatGen(17);
+		std::mt19937 doubleGen(17);
+
+		auto float_values = [&distr, &floatGen]() { return distr(floatGen); };
+		auto double_values = [&distr, &doubleGen]() { return distr(doubleGen); };
+
+		auto floatNet = neural_network::make_network(
+			neural_network::make_convolution_layer<m6x6, m3x3, m1x1, 2, p1x1, m1x1, channels_first, float>(
+				float_values),
+			neural_network::make_relu_activation_layer<m2x6x6, float>(),
+			neural_network::make_max_pooling_layer<m2x6x6, float>(),
+			neural_network::make_reshape_layer<m6x6, m36, float>(),
+			neural_network::make_fully_connected_layer<m36, m4, float>(
+				float_values),
+			neural_network::make_logistic_activation_layer<m4, float>());
+
+		auto doubleNet = neural_network::make_network(
+			neural_network::make_convolution_layer<m6x6, m3x3, m1x1, 2, p1x1, m1x1, channels_first, double>(
+				double_values),
+			neural_network::make_relu_activation_layer<m2x6x6, double>(),
+			neural_network::make_max_pooling_layer<m2x6x6, double>(),
+			neural_network::make_reshape_layer<m6x6, m36, double>(),
+			neural_network::make_fully_connected_layer<m36, m4, double>(
+				double_values),
+			neural_network::make_logistic_activation_layer<m4, double>());
+
+		typedef decltype(doubleNet) double_network;
+
+		test::check_true(
+			std::is_same<double, double_network::number_type>::value,
+			"Network number type is not double.");
+
+		m6x6::tensor_type floatInput(random_values);
+		m6x6::tensor_of<double>::type doubleInput;
+		neural_network::algebra::convert(floatInput, doubleInput);
+
+		m4::tensor_type floatTruth;
+		floatTruth(1) = 1.0f;
+
+		m4::tensor_of<double>::type doubleTruth;
+		neural_network::algebra::convert(floatTruth, doubleTruth);
+
+		neural_network::squared_error_loss<m4> floatLoss;
+		neural_network::squared_error_loss<m4, double> doubleLoss;
+
+		auto check_outputs = [&](const double tolerance, const char* message)
+		{
+			const auto& floatOutput = floatNet.process(floatInput);
+			const auto& doubleOutput = doubleNet.process(doubleInput);
+
+			for (size_t i = 0; i < m4::data_size; ++i)
+			{
+				test::check_true(std::abs(doubleOutput(i) - floatOutput(i)) < tolerance, message);
+			}
+		};
+
+		check_outputs(1e-6, "Double precision network output does not match float network.");
+
+		const double initialLoss = doubleLoss.compute(doubleNet.process(doubleInput), doubleTruth);
+
+		for (size_t i = 0; i < 20; ++i)
+		{
+			floatNet.train(floatInput, floatTruth, floatLoss, 0.1f);
+			doubleNet.train(doubleInput, doubleTruth, doubleLoss, 0.1);
+		}
+
+		check_outputs(1e-4, "Trained double precision network output does not match float network.");
+
+		test::check_true(
+			doubleLoss.compute(doubleNet.process(doubleInput), doubleTruth) < initialLoss,
+			"Training did not improve the double precision network.");
+
+		test_layer_serialization("Double Precision Network Serialization Tests", doubleNet);
+
+		std::stringstream floatModel;
+		neural_network::serialization::write(floatModel, floatNet);
+
+		test::check_exception<std::ios_base::failure>(
+			[&floatModel, &doubleNet]()
+			{
+				neural_network::serialization::read(floatModel, doubleNet);
+			},
+			"Double precision network should not read a float model.");
+	}
+
 	{
 		test::verbose("OpenCL Network Training Tests");
 
@@ -129,5 +226,118 @@ void test_network()
 		test::check_true(finalLoss < initialLoss, "Training did not improve the network.");
 	}
 
+	{
+		test::verbose("OpenCL Fused Network Tests");
+
+		auto context = find_test_device_context();
+		::boost::compute::command_queue queue(context, context.get_device());
+
+		typedef neural_network::algebra::metrics<16, 32> m16x32;
+		typedef neural_network::algebra::metrics<32, 32> m32x32;
+		typedef neural_network::algebra::metrics<30, 20, 10> m30x20x10;
+
+		auto fusedNet = neural_network::make_network(
+
+			neural_network::make_fully_connected_layer<m30x20x10, m32x32>(
+				random_values),
+
+			neural_network::make_relu_activation_layer<m32x32>(),
+
+			neural_network::make_fully_connected_layer<m32x32, m16x32>(
+				random_values),
+
+			neural_network::make_tanh_activation_layer<m16x32>()
+		);
+
+		m30x20x10::tensor_type input(random_values);
+		m16x32::tensor_type truth(random_values);
+
+		neural_network::squared_error_loss<m16x32> loss;
+
+		m16x32::tensor_type expectedResult;
+		fusedNet.process(input).transform(
+			expectedResult,
+			[](const float& v) { return v; });
+
+		m30x20x10::tensor_type expectedGradient;
+		fusedNet.compute_gradient(
+			loss.compute_gradient(expectedResult, truth)).transform(
+				expectedGradient,
+				[](const float& v) { return v; });
+
+		const auto& result = fusedNet.process(input, queue);
+
+		check_tensors_2d(expectedResult, result);
+		check_tensors_3d(
+			expectedGradient,
+			fusedNet.compute_loss_gradient(result, truth, loss, queue));
+	}
+
+	{
+		test::verbose("OpenCL Network Profiling Tests");
+
+		auto context = find_test_device_context();
+		auto queue = neural_network::opencl::make_profiling_queue(context, context.get_device());
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<28, 28> m28x28;
+		typedef neural_network::algebra::metrics<4, 4> m4x4;
+		typedef neural_network::algebra::metrics<8, 13, 13> m8x13x13;
+
+		auto net = neural_network::make_network(
+			neural_network::make_convolution_layer<m28x28, m4x4, m2x2, 8>(
+				random_values),
+
+			neural_network::make_relu_activation_layer<m8x13x13>(),
+
+			neural_network::make_fully_connected_layer<m8x13x13, m4>(
+				random_values)
+		);
+
+		m28x28::tensor_type input(random_values);
+		m4::tensor_type truth(random_values);
+
+		neural_network::squared_error_loss<m4> loss;
+
+		auto& profiler = neural_network::opencl::get_profiler();
+
+		profiler.clear();
+		profiler.enable();
+
+		net.train(input, truth, loss, 0.001f, queue);
+
+		profiler.disable();
+
+		auto records = profiler.get_records();
+		test::check_true(0 < records.size(), "Expected OpenCL profiling records.");
+
+		size_t kernels = 0;
+		for (const auto& record : records)
+		{
+			test::check_true(record.start <= record.end, "Invalid OpenCL profiling record.");
+			test::check_true(nullptr != record.layer, "OpenCL profiling record has no layer.");
+
+			if (neural_network::opencl::profiling_operation_type::kernel == record.type)
+			{
+				++kernels;
+			}
+		}
+
+		test::check_true(0 < kernels, "Expected OpenCL kernel profiling records.");
+
+		std::stringstream report;
+		profiler.write_report(report);
+		test::check_true(0 < report.str().size(), "Expected OpenCL profiling report.");
+
+		std::stringstream trace;
+		profiler.write_trace(trace);
+		test::check_true(0 == trace.str().find("{\"traceEvents\":["), "Unexpected OpenCL profiling trace format.");
+
+		profiler.clear();
+		net.process(input, queue);
+		test::check_true(0 == profiler.get_records().size(), "Unexpected OpenCL profiling records when profiling is disabled.");
+	}
+
 	sc.pass();
 }
\ No newline at end of file
@@ -0,0 +1,585 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+struct normalization_parameters
+{
+	typename Layer::channel_type gamma;
+	typename Layer::channel_type beta;
+	typename Layer::channel_type mean;
+	typename Layer::channel_type variance;
+	typename Layer::number_type momentum;
+	typename Layer::number_type epsilon;
+};
+
+template <class Layer>
+normalization_parameters<Layer> read_normalization(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	normalization_parameters<Layer> parameters;
+	Layer::serializer_impl_type::read(stream, parameters.gamma, parameters.beta, parameters.mean, parameters.variance, parameters.momentum, parameters.epsilon);
+
+	return parameters;
+}
+
+template <class Layer>
+void write_normalization(
+	const normalization_parameters<Layer>& parameters,
+	Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	Layer::serializer_impl_type::write(stream, parameters.gamma, parameters.beta, parameters.mean, parameters.variance, parameters.momentum, parameters.epsilon);
+
+	neural_network::serialization::read(stream, layer);
+}
+
+template <class Layer, class Generator>
+void check_normalization_training(
+	Layer& layer,
+	Generator& random_values)
+{
+	typedef typename Layer::channel_type channel_type;
+
+	normalization_parameters<Layer> parameters;
+	parameters.gamma = channel_type([&random_values]() { return 1.0f + random_values(); });
+	parameters.beta = channel_type(random_values);
+	parameters.mean = channel_type(random_values);
+	parameters.variance = channel_type([&random_values]() { return 1.0f + random_values(); });
+	parameters.momentum = 0.1f;
+	parameters.epsilon = 0.001f;
+
+	write_normalization(parameters, layer);
+
+	typename Layer::input input(random_values);
+	typename Layer::output gradient(random_values);
+
+	typename Layer::output result = layer.process(input);
+	typename Layer::input inputGradient = layer.compute_gradient(gradient);
+
+	const float* x = input.data();
+	const float* y = result.data();
+	const float* g = gradient.data();
+	const float* dx = inputGradient.data();
+
+	channel_type gammaGradient;
+	channel_type betaGradient;
+
+	for (size_t i = 0; i < Layer::input::data_size; ++i)
+	{
+		const size_t c = Layer::channel_of(i);
+		const float deviation = std::sqrt(parameters.variance(c) + parameters.epsilon);
+		const float normalized = (x[i] - parameters.mean(c)) / deviation;
+
+		test::check_true(std::abs(y[i] - (parameters.gamma(c) * normalized + parameters.beta(c))) < 1e-5f, "Invalid normalized output.");
+		test::check_true(std::abs(dx[i] - g[i] * parameters.gamma(c) / deviation) < 1e-5f, "Invalid normalized input gradient.");
+
+		gammaGradient(c) += g[i] * normalized;
+		betaGradient(c) += g[i];
+	}
+
+	const float rate = -0.1f;
+	layer.update_weights(rate);
+
+	normalization_parameters<Layer> updated = read_normalization(layer);
+
+	for (size_t c = 0; c < Layer::channels; ++c)
+	{
+		test::check_true(std::abs(updated.gamma(c) - (parameters.gamma(c) + gammaGradient(c) * rate)) < 1e-5f, "Invalid scale after update.");
+		test::check_true(std::abs(updated.beta(c) - (parameters.beta(c) + betaGradient(c) * rate)) < 1e-5f, "Invalid shift after update.");
+		test::check_true(updated.mean(c) == parameters.mean(c), "Running mean must not change without a batch.");
+		test::check_true(updated.variance(c) == parameters.variance(c), "Running variance must not change without a batch.");
+	}
+}
+
+// Layer computes in double, so that the gradients of the batch can be compared with central
+// differences of the loss sum(w * y) over the batch.
+template <class Layer, class Generator>
+void check_batch_normalization_gradient(
+	Generator& random_values)
+{
+	typedef typename Layer::channel_type channel_type;
+	typedef typename Layer::input input;
+	typedef typename Layer::output output;
+
+	const size_t size = 4;
+	const size_t count = size * Layer::positions;
+
+	normalization_parameters<Layer> parameters;
+	parameters.gamma = channel_type([&random_values]() { return 1.0 + random_values(); });
+	parameters.beta = channel_type([&random_values]() { return random_values(); });
+	parameters.mean = channel_type([&random_values]() { return random_values(); });
+	parameters.variance = channel_type([&random_values]() { return 1.0 + random_values(); });
+	parameters.momentum = 0.1;
+	parameters.epsilon = 0.001;
+
+	std::vector<Layer> layers(size);
+	std::vector<Layer*> copies(size);
+	std::vector<input> inputs(size);
+	std::vector<output> weights(size);
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		write_normalization(parameters, layers[k]);
+		copies[k] = &layers[k];
+
+		inputs[k] = input([&random_values]() { return random_values(); });
+		weights[k] = output([&random_values]() { return random_values(); });
+	}
+
+	std::vector<const input*> batch(size);
+	std::vector<const output*> results(size);
+
+	auto compute_loss = [&]()
+	{
+		for (size_t k = 0; k < size; ++k)
+		{
+			batch[k] = &inputs[k];
+		}
+
+		Layer::process_batch(copies, batch, results);
+
+		double loss = 0.0;
+		for (size_t k = 0; k < size; ++k)
+		{
+			for (size_t i = 0; i < Layer::output::data_size; ++i)
+			{
+				loss += weights[k].data()[i] * results[k]->data()[i];
+			}
+		}
+
+		return loss;
+	};
+
+	compute_loss();
+
+	channel_type outputMean;
+	channel_type outputVariance;
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		for (size_t i = 0; i < Layer::output::data_size; ++i)
+		{
+			const size_t c = Layer::channel_of(i);
+			const double shifted = results[k]->data()[i] - parameters.beta(c);
+
+			outputMean(c) += results[k]->data()[i] / count;
+			outputVariance(c) += shifted * shifted / count;
+		}
+	}
+
+	channel_type inputMean;
+	channel_type inputVariance;
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		for (size_t i = 0; i < Layer::input::data_size; ++i)
+		{
+			inputMean(Layer::channel_of(i)) += inputs[k].data()[i] / count;
+		}
+	}
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		for (size_t i = 0; i < Layer::input::data_size; ++i)
+		{
+			const size_t c = Layer::channel_of(i);
+			inputVariance(c) += (inputs[k].data()[i] - inputMean(c)) * (inputs[k].data()[i] - inputMean(c)) / count;
+		}
+	}
+
+	for (size_t c = 0; c < Layer::channels; ++c)
+	{
+		const double gamma = parameters.gamma(c);
+		const double expected = gamma * gamma * inputVariance(c) / (inputVariance(c) + parameters.epsilon);
+
+		test::check_true(std::abs(outputMean(c) - parameters.beta(c)) < 1e-9, "Output mean of a batch does not match the shift.");
+		test::check_true(std::abs(outputVariance(c) - expected) < 1e-9, "Output variance of a batch does not match the scale.");
+	}
+
+	std::vector<const output*> gradients(size);
+	std::vector<const input*> inputGradients(size);
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		gradients[k] = &weights[k];
+	}
+
+	Layer::compute_gradient_batch(copies, gradients, inputGradients);
+
+	std::vector<input> expectedGradients(size);
+	for (size_t k = 0; k < size; ++k)
+	{
+		std::copy(inputGradients[k]->data(), inputGradients[k]->data() + Layer::input::data_size, expectedGradients[k].data());
+	}
+
+	// The sum of the updates of the copies with unit rate is the gradient of the scale and shift.
+	Layer total;
+	write_normalization(parameters, total);
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		layers[k].accumulate_update(total, 1.0);
+	}
+
+	total.apply_update(total);
+
+	normalization_parameters<Layer> updated = read_normalization(total);
+
+	for (size_t c = 0; c < Layer::channels; ++c)
+	{
+		test::check_true(std::abs(updated.mean(c) - (parameters.mean(c) + (inputMean(c) - parameters.mean(c)) * 0.1)) < 1e-9, "Running mean does not follow the batch.");
+		test::check_true(std::abs(updated.variance(c) - (parameters.variance(c) + (inputVariance(c) - parameters.variance(c)) * 0.1)) < 1e-9, "Running variance does not follow the batch.");
+	}
+
+	const double step = 1e-5;
+
+	for (size_t k = 0; k < size; ++k)
+	{
+		for (size_t i = 0; i < Layer::input::data_size; ++i)
+		{
+			double* x = inputs[k].data();
+			const double value = x[i];
+
+			x[i] = value + step;
+			const double plus = compute_loss();
+
+			x[i] = value - step;
+			const double minus = compute_loss();
+
+			x[i] = value;
+
+			test::check_true(std::abs((plus - minus) / (2 * step) - expectedGradients[k].data()[i]) < 1e-6, "Input gradient of a batch does not match finite differences.");
+		}
+	}
+
+	auto compute_changed_loss = [&](typename Layer::number_type& parameter, const double value)
+	{
+		const typename Layer::number_type original = parameter;
+		parameter = value;
+
+		for (size_t k = 0; k < size; ++k)
+		{
+			write_normalization(parameters, layers[k]);
+		}
+
+		parameter = original;
+		return compute_loss();
+	};
+
+	for (size_t c = 0; c < Layer::channels; ++c)
+	{
+		const double gammaPlus = compute_changed_loss(parameters.gamma(c), parameters.gamma(c) + step);
+		const double gammaMinus = compute_changed_loss(parameters.gamma(c), parameters.gamma(c) - step);
+
+		test::check_true(std::abs((gammaPlus - gammaMinus) / (2 * step) - (updated.gamma(c) - parameters.gamma(c))) < 1e-6, "Scale gradient of a batch does not match finite differences.");
+
+		const double betaPlus = compute_changed_loss(parameters.beta(c), parameters.beta(c) + step);
+		const double betaMinus = compute_changed_loss(parameters.beta(c), parameters.beta(c) - step);
+
+		test::check_true(std::abs((betaPlus - betaMinus) / (2 * step) - (updated.beta(c) - parameters.beta(c))) < 1e-6, "Shift gradient of a batch does not match finite differences.");
+	}
+}
+
+template <class Network>
+std::string get_serialized_network(
+	const Network& network)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, network);
+
+	return stream.str();
+}
+
+template <class Network, class Folded, class Generator>
+void check_folded_network(
+	Network& network,
+	Folded& folded,
+	Generator& random_values)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+		typename Network::input input(random_values);
+
+		auto expected = network.process(input);
+		auto actual = folded.process(input);
+
+		for (size_t j = 0; j < Network::output::data_size; ++j)
+		{
+			test::check_true(std::abs(expected.data()[j] - actual.data()[j]) < 1e-4f, "Invalid output of a folded network.");
+		}
+	}
+
+	test::check_true(
+		neural_network::serialization::model_size(folded) < neural_network::serialization::model_size(network),
+		"Folded model is not smaller than the original model.");
+}
+
+void test_normalization()
+{
+	scenario sc("Test for neural_network::batch_normalization class");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	typedef neural_network::algebra::metrics<3> m3;
+	typedef neural_network::algebra::metrics<100> m100;
+	typedef neural_network::algebra::padding<0, 0> p0x0;
+	typedef neural_network::algebra::metrics<1, 1> m1x1;
+	typedef neural_network::algebra::metrics<2, 2> m2x2;
+	typedef neural_network::algebra::metrics<2, 3> m2x3;
+	typedef neural_network::algebra::metrics<3, 4> m3x4;
+	typedef neural_network::algebra::metrics<10, 10> m10x10;
+	typedef neural_network::algebra::metrics<4, 5, 5> m4x5x5;
+	typedef neural_network::algebra::metrics<5, 5, 4> m5x5x4;
+
+	{
+		test::verbose("Batch Normalization Layer Tests");
+
+		neural_network::batch_normalization<m3x4> first;
+		neural_network::batch_normalization<m3x4, neural_network::layout::channels_last> last;
+
+		static_assert(3 == decltype(first)::channels && 4 == decltype(first)::positions, "Invalid channels of a channels first layer.");
+		static_assert(4 == decltype(last)::channels && 3 == decltype(last)::positions, "Invalid channels of a channels last layer.");
+
+		test::check_true(1 == first.channel_of(7) && 3 == last.channel_of(7), "Invalid channel of an element.");
+
+		for (int i = 0; i < 3; ++i)
+		{
+			check_normalization_training(first, random_values);
+			check_normalization_training(last, random_values);
+		}
+
+		test_layer_serialization("Batch Normalization Layer Serialization Tests", first);
+		test_layer_serialization("Channels Last Batch Normalization Layer Serialization Tests", last);
+	}
+
+	{
+		test::verbose("Batch Normalization Batch Gradient Tests");
+
+		for (int i = 0; i < 3; ++i)
+		{
+			check_batch_normalization_gradient<neural_network::batch_normalization<m3x4, neural_network::layout::channels_first, double>>(random_values);
+			check_batch_normalization_gradient<neural_network::batch_normalization<m3x4, neural_network::layout::channels_last, double>>(random_values);
+		}
+	}
+
+	{
+		test::verbose("Batch Normalization Running Statistics Tests");
+
+		typedef m2x3::expand<4>::type batch_input;
+
+		auto trainer = neural_network::make_batch_trainer(
+			neural_network::make_network(
+				neural_network::make_batch_normalization_layer<m2x3>()));
+
+		neural_network::squared_error_loss<m2x3> loss;
+
+		const float offset[2] = { 2.0f, -1.0f };
+
+		batch_input::tensor_type truth;
+		for (int i = 0; i < 3000; ++i)
+		{
+			batch_input::tensor_type inputs(random_values);
+			for (size_t k = 0; k < batch_input::dimension_size; ++k)
+			{
+				for (size_t c = 0; c < 2; ++c)
+				{
+					for (size_t p = 0; p < 3; ++p)
+					{
+						inputs(k, c, p) += offset[c];
+					}
+				}
+			}
+
+			trainer.train(inputs, truth, loss, 0.0f);
+		}
+
+		// A network of one layer is serialized in the format of the layer.
+		neural_network::batch_normalization<m2x3> layer;
+
+		std::stringstream stream(get_serialized_network(trainer.get_network()));
+		neural_network::serialization::read(stream, layer);
+
+		auto parameters = read_normalization(layer);
+
+		// Batches normalize with the biased variance of their 4 x 3 values.
+		const float variance = (1.0f / 12.0f) * 11.0f / 12.0f;
+
+		for (size_t c = 0; c < 2; ++c)
+		{
+			test::check_true(std::abs(parameters.mean(c) - offset[c]) < 0.1f, "Running mean does not match the input.");
+			test::check_true(std::abs(parameters.variance(c) - variance) < 0.01f, "Running variance does not match the input.");
+		}
+	}
+
+	{
+		test::verbose("Batch Trainer Tests");
+
+		typedef m10x10::expand<6>::type batch_input;
+		typedef m3::expand<6>::type batch_output;
+
+		auto net = neural_network::make_network(
+			neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4>(random_values),
+			neural_network::make_relu_activation_layer<m4x5x5>(),
+			neural_network::make_reshape_layer<m4x5x5, m100>(),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_fully_connected_layer<m100, m3>(random_values))),
+			neural_network::make_logistic_activation_layer<m3>());
+
+		auto trainer = neural_network::make_batch_trainer(net);
+		auto pipeline = neural_network::make_pipeline(net);
+
+		neural_network::squared_error_loss<m3> loss;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			batch_input::tensor_type inputs(random_values);
+			batch_output::tensor_type truth(random_values);
+
+			trainer.train(inputs, truth, loss, 0.1f);
+			pipeline.train(inputs, truth, loss, 0.1f);
+		}
+
+		test::check_true(
+			get_serialized_network(trainer.get_network()) == get_serialized_network(pipeline),
+			"Network trained on batches does not match the pipeline without batch normalization.");
+	}
+
+	{
+		test::verbose("Batch Normalization Folding Tests");
+
+		auto net = neural_network::make_network(
+			neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4>(random_values),
+			neural_network::make_batch_normalization_layer<m4x5x5>(0.1f),
+			neural_network::make_relu_activation_layer<m4x5x5>(),
+			neural_network::make_reshape_layer<m4x5x5, m100>(),
+			neural_network::make_fully_connected_layer<m100, m3>(random_values),
+			neural_network::make_batch_normalization_layer<m3>(0.1f),
+			neural_network::make_logistic_activation_layer<m3>());
+
+		neural_network::squared_error_loss<m3> loss;
+
+		m10x10::tensor_type input(random_values);
+		m3::tensor_type truth;
+		truth(1) = 1.0f;
+
+		const float before = loss.compute(net.process(input), truth);
+		for (int i = 0; i < 50; ++i)
+		{
+			net.train(input, truth, loss, 0.1f);
+		}
+
+		test::check_true(loss.compute(net.process(input), truth) < before, "Training of a network with batch normalization must reduce the loss.");
+
+		auto folded = neural_network::fold_batch_normalization(net);
+
+		static_assert(
+			std::is_same<
+				decltype(folded),
+				neural_network::network<
+					neural_network::convolution<m10x10, m2x2, m2x2, 4>,
+					neural_network::relu_activation<m4x5x5>,
+					neural_network::reshape<m4x5x5, m100>,
+					neural_network::fully_connected<m100, m3>,
+					neural_network::logistic_activation<m3>>
+			>::value,
+			"Batch normalization layers were not folded.");
+
+		check_folded_network(net, folded, random_values);
+		test_layer_serialization("Folded Network Serialization Tests", folded);
+	}
+
+	{
+		test::verbose("Channels Last Batch Normalization Folding Tests");
+
+		auto net = neural_network::make_network(
+			neural_network::make_batch_normalization_layer<m10x10>(0.1f),
+			neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4, p0x0, m1x1, neural_network::layout::channels_last>(random_values),
+			neural_network::make_batch_normalization_layer<m5x5x4, neural_network::layout::channels_last>(0.1f),
+			neural_network::make_reshape_layer<m5x5x4, m100>(),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_fully_connected_layer<m100, m3>(random_values),
+					neural_network::make_batch_normalization_layer<m3>(0.1f))),
+			neural_network::make_batch_normalization_layer<m3>(0.1f));
+
+		typedef m10x10::expand<5>::type batch_input;
+		typedef m3::expand<5>::type batch_output;
+
+		auto trainer = neural_network::make_batch_trainer(net);
+
+		neural_network::squared_error_loss<m3> loss;
+
+		for (int i = 0; i < 50; ++i)
+		{
+			batch_input::tensor_type inputs(random_values);
+			batch_output::tensor_type truth(random_values);
+
+			trainer.train(inputs, truth, loss, 0.1f);
+		}
+
+		auto& trained = trainer.get_network();
+		auto folded = neural_network::fold_batch_normalization(trained);
+
+		static_assert(
+			std::is_same<
+				decltype(folded),
+				neural_network::network<
+					neural_network::batch_normalization<m10x10>,
+					neural_network::convolution<m10x10, m2x2, m2x2, 4, p0x0, m1x1, neural_network::layout::channels_last>,
+					neural_network::reshape<m5x5x4, m100>,
+					neural_network::network<neural_network::fully_connected<m100, m3>>,
+					neural_network::batch_normalization<m3>>
+			>::value,
+			"Batch normalization layers were not folded.");
+
+		check_folded_network(trained, folded, random_values);
+		test_layer_serialization("Channels Last Folded Network Serialization Tests", folded);
+	}
+
+	sc.pass();
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "unittest.h"
+#include "..\src\number.h"
+
+template <class Number>
+void check_number_conversion(
+	const std::vector<float>& values,
+	const char* message)
+{
+	std::vector<Number> converted(values.size());
+	neural_network::algebra::detail::convert(values.data(), converted.data(), values.size());
+
+	std::vector<float> restored(values.size());
+	neural_network::algebra::detail::convert(converted.data(), restored.data(), values.size());
+
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		test::check_true(Number(values[i]).bits() == converted[i].bits(), message);
+		test::check_true(static_cast<float>(converted[i]) == restored[i], message);
+	}
+}
+
+void test_number()
+{
+	scenario sc("Test for neural_network::algebra::half and bfloat16 numbers");
+
+	typedef neural_network::algebra::half half;
+	typedef neural_network::algebra::bfloat16 bfloat16;
+
+	{
+		test::verbose("Half Conversion Tests");
+
+		test::check_true(0x3c00 == half(1.0f).bits(), "Invalid half value of 1.");
+		test::check_true(0xc000 == half(-2.0f).bits(), "Invalid half value of -2.");
+		test::check_true(0x7bff == half(65504.0f).bits(), "Invalid largest half value.");
+		test::check_true(0x7c00 == half(65520.0f).bits(), "Value above the largest half must round to infinity.");
+		test::check_true(0x0001 == half(std::ldexp(1.0f, -24)).bits(), "Invalid smallest subnormal half value.");
+		test::check_true(0x0000 == half(std::ldexp(1.0f, -25)).bits(), "Half value must round to even.");
+		test::check_true(0x0002 == half(std::ldexp(3.0f, -25)).bits(), "Half value must round to even.");
+		test::check_true(0x3c00 == half(1.0f + std::ldexp(1.0f, -11)).bits(), "Half value must round to even.");
+		test::check_true(0x3c02 == half(1.0f + std::ldexp(3.0f, -11)).bits(), "Half value must round to even.");
+		test::check_true(0xfc00 == half(-std::numeric_limits<float>::infinity()).bits(), "Invalid half infinity.");
+
+		const std::uint16_t nan = half(std::numeric_limits<float>::quiet_NaN()).bits();
+		test::check_true((0x7c00 == (nan & 0x7c00)) && (0 != (nan & 0x03ff)), "Invalid half NaN.");
+
+		for (std::uint32_t bits = 0; bits < 0x10000; ++bits)
+		{
+			const half value = half::from_bits(static_cast<std::uint16_t>(bits));
+			if (std::isnan(static_cast<float>(value)))
+				continue;
+
+			test::check_true(bits == half(static_cast<float>(value)).bits(), "Half value must convert to float exactly.");
+		}
+	}
+
+	{
+		test::verbose("Bfloat16 Conversion Tests");
+
+		test::check_true(0x3f80 == bfloat16(1.0f).bits(), "Invalid bfloat16 value of 1.");
+		test::check_true(0xc000 == bfloat16(-2.0f).bits(), "Invalid bfloat16 value of -2.");
+		test::check_true(0x3f80 == bfloat16(1.0f + std::ldexp(1.0f, -8)).bits(), "Bfloat16 value must round to even.");
+		test::check_true(0x3f82 == bfloat16(1.0f + std::ldexp(3.0f, -8)).bits(), "Bfloat16 value must round to even.");
+		test::check_true(0x7f80 == bfloat16(std::numeric_limits<float>::max()).bits(), "Largest float must round to bfloat16 infinity.");
+		test::check_true(0x8000 == bfloat16(-std::numeric_limits<float>::denorm_min()).bits(), "Subnormal values must flush to zero.");
+
+		const std::uint16_t nan = bfloat16(std::numeric_limits<float>::quiet_NaN()).bits();
+		test::check_true((0x7f80 == (nan & 0x7f80)) && (0 != (nan & 0x007f)), "Invalid bfloat16 NaN.");
+
+		for (std::uint32_t bits = 0; bits < 0x10000; ++bits)
+		{
+			const bfloat16 value = bfloat16::from_bits(static_cast<std::uint16_t>(bits));
+			if (std::isnan(static_cast<float>(value)) || (0 == (bits & 0x7f80)))
+				continue;
+
+			test::check_true(bits == bfloat16(static_cast<float>(value)).bits(), "Bfloat16 value must convert to float exactly.");
+		}
+	}
+
+	{
+		test::verbose("Tensor Conversion Tests");
+
+		std::random_device rd;
+		std::mt19937 gen(rd());
+		std::uniform_real_distribution<float> distr(-20.0f, 20.0f);
+
+		std::vector<float> values(101);
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			values[i] = std::ldexp(distr(gen), static_cast<int>(i % 40) - 20);
+		}
+
+		check_number_conversion<half>(values, "Invalid half conversion.");
+		check_number_conversion<bfloat16>(values, "Invalid bfloat16 conversion.");
+
+		neural_network::algebra::basic_tensor<float, 5, 7> source([&distr, &gen]() { return distr(gen); });
+		neural_network::algebra::basic_tensor<half, 5, 7> converted;
+		neural_network::algebra::basic_tensor<float, 5, 7> restored;
+
+		neural_network::algebra::convert(source, converted);
+		neural_network::algebra::convert(converted, restored);
+
+		for (size_t i = 0; i < 5; ++i)
+		{
+			for (size_t j = 0; j < 7; ++j)
+			{
+				test::check_true(std::abs(source(i, j) - restored(i, j)) <= std::ldexp(std::abs(source(i, j)), -11), "Invalid tensor conversion.");
+			}
+		}
+	}
+
+	sc.pass();
+}
\ No newline at end of file
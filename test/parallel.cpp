@@ -0,0 +1,404 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "unittest.h"
+
+#include "..\src\ai.h"
+
+#include "opencltest.h"
+
+template <typename Tensor>
+void check_parallel_tensors(
+	const Tensor& expected,
+	const Tensor& actual,
+	const char* message)
+{
+	typedef neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(e(i) == a(i), message);
+	}
+}
+
+template <typename Layer>
+void check_parallel_layer(
+	Layer& sequential,
+	Layer& parallel,
+	const typename Layer::input& input,
+	const typename Layer::output& grad)
+{
+	neural_network::parallel::set_execution_mode(neural_network::parallel::execution_mode::sequential);
+
+	auto expectedOutput = sequential.process(input);
+	auto expectedGradient = sequential.compute_gradient(grad);
+
+	neural_network::parallel::set_execution_mode(neural_network::parallel::execution_mode::parallel);
+
+	check_parallel_tensors(expectedOutput, parallel.process(input), "Parallel layer output does not match sequential output.");
+	check_parallel_tensors(expectedGradient, parallel.compute_gradient(grad), "Parallel layer gradient does not match sequential gradient.");
+
+	neural_network::parallel::set_execution_mode(neural_network::parallel::execution_mode::sequential);
+}
+
+template <typename Layer>
+void check_parallel_training(
+	Layer& sequential,
+	Layer& parallel,
+	const typename Layer::input& input,
+	const typename Layer::output& grad)
+{
+	check_parallel_layer(sequential, parallel, input, grad);
+
+	sequential.update_weights(0.1f);
+	auto expectedOutput = sequential.process(input);
+
+	neural_network::parallel::set_execution_mode(neural_network::parallel::execution_mode::parallel);
+
+	parallel.update_weights(0.1f);
+	check_parallel_tensors(expectedOutput, parallel.process(input), "Parallel layer weights do not match sequential weights.");
+
+	neural_network::parallel::set_execution_mode(neural_network::parallel::execution_mode::sequential);
+}
+
+template <typename Layer>
+void check_context_training(
+	Layer& sequential,
+	Layer& parallel,
+	neural_network::parallel::execution_context& context,
+	const typename Layer::input& input,
+	const typename Layer::output& grad)
+{
+	auto expectedOutput = sequential.process(input);
+	auto expectedGradient = sequential.compute_gradient(grad);
+
+	check_parallel_tensors(expectedOutput, parallel.process(input, context), "Output computed with an execution context does not match sequential output.");
+	check_parallel_tensors(expectedGradient, parallel.compute_gradient(grad, context), "Gradient computed with an execution context does not match sequential gradient.");
+
+	sequential.update_weights(0.1f);
+	parallel.update_weights(0.1f, context);
+
+	check_parallel_tensors(sequential.process(input), parallel.process(input, context), "Weights updated with an execution context do not match sequential weights.");
+}
+
+void test_parallel()
+{
+	scenario sc("Test for neural_network::parallel namespace");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	{
+		test::verbose("Thread Pool Tests");
+
+		static_assert(neural_network::parallel::grain_size<48, 19600>::value == 1, "Large items must be scheduled one per task.");
+		static_assert(neural_network::parallel::grain_size<256, 512>::value == 32, "Small items must be grouped into tasks.");
+		static_assert(!neural_network::parallel::grain_size<16, 9>::is_parallel, "Small loops must not be split.");
+
+		neural_network::parallel::thread_pool pool(3);
+
+		std::vector<int> counts(1000, 0);
+		neural_network::parallel::parallel_for(pool, counts.size(), 7, [&counts](const size_t i) { ++counts[i]; });
+
+		for (size_t i = 0; i < counts.size(); ++i)
+		{
+			test::check_true(1 == counts[i], "Every loop iteration must run exactly once.");
+		}
+
+		test::check_exception<std::invalid_argument>(
+			[&pool]()
+			{
+				neural_network::parallel::parallel_for(pool, 100, 1, [](const size_t i)
+				{
+					if (i == 42)
+						throw std::invalid_argument("Failure in a parallel loop.");
+				});
+			},
+			"Exception in a parallel loop must be rethrown.");
+
+		test::check_true(
+			neural_network::parallel::execution_mode::sequential == neural_network::parallel::get_execution_mode(),
+			"Layers must run sequentially by default.");
+	}
+
+	{
+		test::verbose("Execution Context Tests");
+
+		neural_network::parallel::execution_context context(3);
+		test::check_true(3 == context.concurrency(), "Invalid execution context thread count.");
+		test::check_true(neural_network::parallel::execution_mode::parallel == context.get_mode(), "Execution context must run layers in parallel.");
+
+		neural_network::parallel::execution_context pinned(2, std::vector<size_t>(1, 0));
+		test::check_true(2 == pinned.concurrency(), "Invalid pinned execution context thread count.");
+
+		std::vector<int> counts(100, 0);
+		neural_network::parallel::parallel_for<100, neural_network::parallel::min_task_work>(context, [&counts](const size_t i) { ++counts[i]; });
+
+		std::vector<int> nested(64, 0);
+
+		{
+			neural_network::parallel::task_group tasks(context);
+
+			for (size_t i = 0; i < 8; ++i)
+			{
+				tasks.run([i, &nested, &context]()
+				{
+					test::check_true(&context == &neural_network::parallel::get_current_context(), "Execution context must be current in a task.");
+
+					neural_network::parallel::task_group inner;
+					for (size_t j = 0; j < 8; ++j)
+					{
+						inner.run([i, j, &nested]() { ++nested[i * 8 + j]; });
+					}
+
+					inner.wait();
+				});
+			}
+
+			tasks.wait();
+		}
+
+		for (size_t i = 0; i < counts.size(); ++i)
+		{
+			test::check_true(1 == counts[i], "Every loop iteration must run exactly once.");
+		}
+
+		for (size_t i = 0; i < nested.size(); ++i)
+		{
+			test::check_true(1 == nested[i], "Every nested task must run exactly once.");
+		}
+
+		test::check_exception<std::invalid_argument>(
+			[&context]()
+			{
+				neural_network::parallel::task_group tasks(context);
+				tasks.run([]() {});
+				tasks.run([]() { throw std::invalid_argument("Failure in a task."); });
+				tasks.wait();
+			},
+			"Exception in a task must be rethrown.");
+	}
+
+	const unsigned long seedValue = 123;
+
+	{
+		test::verbose("Parallel Convolution Tests");
+
+		{
+			typedef neural_network::algebra::metrics<4096> m4096;
+			typedef neural_network::algebra::metrics<9> m9;
+			typedef neural_network::algebra::metrics<1> m1;
+			typedef neural_network::algebra::padding<4> p4;
+
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_convolution_layer<m4096, m9, m1, 48, p4, m1>(random_values);
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_convolution_layer<m4096, m9, m1, 48, p4, m1>(random_values);
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_training(sequential, parallel, input, grad);
+		}
+
+		{
+			typedef neural_network::algebra::metrics<28, 28> m28x28;
+			typedef neural_network::algebra::metrics<5, 5> m5x5;
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
+			typedef neural_network::algebra::padding<2, 2> p2x2;
+
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 48, p2x2, m1x1>(random_values);
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 48, p2x2, m1x1>(random_values);
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_training(sequential, parallel, input, grad);
+		}
+
+		{
+			typedef neural_network::algebra::metrics<32, 32> m32x32;
+			typedef neural_network::algebra::metrics<3, 3> m3x3;
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
+
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_convolution_layer<m32x32, m3x3, m1x1, 48>(random_values);
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_convolution_layer<m32x32, m3x3, m1x1, 48>(random_values);
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_training(sequential, parallel, input, grad);
+		}
+
+		{
+			typedef neural_network::algebra::metrics<4, 16, 16> m4x16x16;
+			typedef neural_network::algebra::metrics<2, 3, 3> m2x3x3;
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::metrics<1, 2, 2> m1x2x2;
+			typedef neural_network::algebra::padding<0, 2, 2> p0x2x2;
+
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_convolution_layer<m4x16x16, m2x3x3, m1x1x1, 16, p0x2x2, m1x2x2>(random_values);
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_convolution_layer<m4x16x16, m2x3x3, m1x1x1, 16, p0x2x2, m1x2x2>(random_values);
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_training(sequential, parallel, input, grad);
+		}
+	}
+
+	{
+		test::verbose("Parallel Max Pooling Tests");
+
+		{
+			typedef neural_network::algebra::metrics<32768> m32768;
+			typedef neural_network::algebra::metrics<4> m4;
+
+			auto sequential = neural_network::make_max_pooling_layer<m32768, m4, m4>();
+			auto parallel = neural_network::make_max_pooling_layer<m32768, m4, m4>();
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_layer(sequential, parallel, input, grad);
+		}
+
+		{
+			typedef neural_network::algebra::metrics<256, 256> m256x256;
+			typedef neural_network::algebra::metrics<3, 3> m3x3;
+			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
+			typedef neural_network::algebra::padding<1, 1> p1x1;
+
+			auto sequential = neural_network::make_max_pooling_layer<m256x256, m3x3, m2x2, p1x1, m1x1>();
+			auto parallel = neural_network::make_max_pooling_layer<m256x256, m3x3, m2x2, p1x1, m1x1>();
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_layer(sequential, parallel, input, grad);
+		}
+
+		{
+			typedef neural_network::algebra::metrics<8, 64, 64> m8x64x64;
+			typedef neural_network::algebra::metrics<2, 3, 3> m2x3x3;
+			typedef neural_network::algebra::metrics<2, 2, 2> m2x2x2;
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::padding<0, 1, 1> p0x1x1;
+
+			auto sequential = neural_network::make_max_pooling_layer<m8x64x64, m2x3x3, m2x2x2, p0x1x1, m1x1x1>();
+			auto parallel = neural_network::make_max_pooling_layer<m8x64x64, m2x3x3, m2x2x2, p0x1x1, m1x1x1>();
+
+			decltype(sequential)::input input(random_values);
+			decltype(sequential)::output grad(random_values);
+
+			check_parallel_layer(sequential, parallel, input, grad);
+		}
+	}
+
+	{
+		test::verbose("Parallel Fully Connected Tests");
+
+		typedef neural_network::algebra::metrics<512> m512;
+		typedef neural_network::algebra::metrics<256> m256;
+
+		gen.seed(seedValue);
+		auto sequential = neural_network::make_fully_connected_layer<m512, m256>(random_values);
+		gen.seed(seedValue);
+		auto parallel = neural_network::make_fully_connected_layer<m512, m256>(random_values);
+
+		m512::tensor_type input(random_values);
+		m256::tensor_type grad(random_values);
+
+		check_parallel_training(sequential, parallel, input, grad);
+	}
+
+	{
+		test::verbose("Execution Context Network Tests");
+
+		typedef neural_network::algebra::metrics<28, 28> m28x28;
+		typedef neural_network::algebra::metrics<5, 5> m5x5;
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::padding<2, 2> p2x2;
+		typedef neural_network::algebra::metrics<16, 28, 28> m16x28x28;
+		typedef neural_network::algebra::metrics<1, 2, 2> m1x2x2;
+		typedef neural_network::algebra::metrics<16, 14, 14> m16x14x14;
+
+		neural_network::parallel::execution_context context;
+
+		m28x28::tensor_type input(random_values);
+
+		{
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_network(
+				neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values),
+				neural_network::make_max_pooling_layer<m16x28x28, m1x2x2, m1x2x2>());
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_network(
+				neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values),
+				neural_network::make_max_pooling_layer<m16x28x28, m1x2x2, m1x2x2>());
+
+			m16x14x14::tensor_type grad(random_values);
+
+			check_context_training(sequential, parallel, context, input, grad);
+		}
+
+		{
+			gen.seed(seedValue);
+			auto sequential = neural_network::make_ensemble(
+				neural_network::make_network(neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values)),
+				neural_network::make_network(neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values)));
+
+			gen.seed(seedValue);
+			auto parallel = neural_network::make_ensemble(
+				neural_network::make_network(neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values)),
+				neural_network::make_network(neural_network::make_convolution_layer<m28x28, m5x5, m1x1, 16, p2x2, m1x1>(random_values)));
+
+			decltype(sequential)::output grad(random_values);
+
+			check_context_training(sequential, parallel, context, input, grad);
+		}
+	}
+
+	sc.pass();
+}
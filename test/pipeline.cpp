@@ -0,0 +1,305 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+std::string get_serialized_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	return stream.str();
+}
+
+template <typename Tensor>
+void check_pipeline_tensors(
+	const Tensor& expected,
+	const Tensor& actual,
+	const float tolerance,
+	const char* message)
+{
+	typedef neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(std::abs(e(i) - a(i)) <= tolerance, message);
+	}
+}
+
+template <typename Metrics>
+class failing_loss
+{
+public:
+	typedef typename Metrics::tensor_type tensor_type;
+
+	failing_loss(
+		const size_t failAt)
+		: m_loss(), m_calls(0), m_failAt(failAt)
+	{
+	}
+
+	const tensor_type& compute_gradient(
+		const tensor_type& result,
+		const tensor_type& truth)
+	{
+		if (m_failAt == m_calls++)
+			throw std::runtime_error("Loss failure.");
+
+		return m_loss.compute_gradient(result, truth);
+	}
+
+private:
+	neural_network::squared_error_loss<Metrics> m_loss;
+	size_t m_calls;
+	const size_t m_failAt;
+};
+
+void test_pipeline()
+{
+	scenario sc("Test for neural_network::pipeline class");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	typedef neural_network::algebra::metrics<5, 4> m5x4;
+	typedef neural_network::algebra::metrics<12> m12;
+	typedef neural_network::algebra::metrics<8> m8;
+	typedef neural_network::algebra::metrics<3> m3;
+
+	typedef m5x4::expand<6>::type batch_input;
+	typedef m3::expand<6>::type batch_output;
+
+	auto net = neural_network::make_network(
+
+		neural_network::make_fully_connected_layer<m5x4, m12>(
+			random_values, 0.00003f),
+
+		neural_network::make_relu_activation_layer<m12>(),
+
+		neural_network::make_fully_connected_layer<m12, m8>(
+			random_values, 0.00005f),
+
+		neural_network::make_relu_activation_layer<m8>(),
+
+		neural_network::make_fully_connected_layer<m8, m3>(
+			random_values, 0.00005f),
+
+		neural_network::make_logistic_activation_layer<m3>()
+	);
+
+	batch_input::tensor_type inputs(random_values);
+	batch_output::tensor_type truth(random_values);
+
+	{
+		test::verbose("Pipeline Stage Tests");
+
+		auto pipeline = neural_network::make_pipeline<2, 4>(net);
+
+		static_assert(3 == decltype(pipeline)::stage_count, "Pipeline must have a stage for every cut point and one more.");
+		static_assert(1 == decltype(neural_network::make_pipeline<>(net))::stage_count, "Pipeline without cut points must have one stage.");
+
+		test::check_true(get_serialized_weights(net) == get_serialized_weights(pipeline), "Pipeline weights do not match network weights.");
+
+		m5x4::tensor_type input(random_values);
+		check_pipeline_tensors(net.process(input), pipeline.process(input), 0.0f, "Pipeline output does not match network output.");
+
+		test_layer_serialization("Pipeline Serialization Tests", pipeline);
+	}
+
+	{
+		test::verbose("Pipeline Processing Tests");
+
+		auto pipeline = neural_network::make_pipeline<1, 3, 5>(net);
+
+		batch_output::tensor_type results;
+		pipeline.process(inputs, results);
+
+		for (size_t i = 0; i < batch_input::dimension_size; ++i)
+		{
+			m5x4::tensor_type input;
+			m3::tensor_type result;
+
+			neural_network::detail::get_batch_item(inputs, i, input);
+			neural_network::detail::get_batch_item(results, i, result);
+
+			check_pipeline_tensors(net.process(input), result, 0.0f, "Pipeline batch output does not match network output.");
+		}
+	}
+
+	{
+		test::verbose("Pipeline Training Tests");
+
+		neural_network::squared_error_loss<m3> loss;
+
+		auto pipeline = neural_network::make_pipeline<2, 4>(net);
+		auto single = neural_network::make_pipeline<>(net);
+		decltype(net) reference;
+
+		m5x4::tensor_type input;
+		m3::tensor_type target;
+
+		neural_network::detail::get_batch_item(inputs, 0, input);
+		neural_network::detail::get_batch_item(truth, 0, target);
+
+		typedef m5x4::expand<1>::type single_input;
+		typedef m3::expand<1>::type single_output;
+
+		single_input::tensor_type singleInput = input.reshape<single_input>();
+		single_output::tensor_type singleTruth = target.reshape<single_output>();
+
+		auto copy = neural_network::make_pipeline<3>(net);
+		copy.train(singleInput, singleTruth, loss, 0.1f);
+
+		std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+		neural_network::serialization::write(stream, net);
+		neural_network::serialization::read(stream, reference);
+
+		reference.train(input, target, loss, 0.1f);
+
+		test::check_true(get_serialized_weights(reference) == get_serialized_weights(copy), "Pipeline trained with a single micro-batch does not match network training.");
+
+		neural_network::parallel::execution_context context(2);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			pipeline.train(inputs, truth, loss, 0.1f, context);
+			single.train(inputs, truth, loss, 0.1f);
+		}
+
+		test::check_true(get_serialized_weights(pipeline) == get_serialized_weights(single), "Pipeline stages do not accumulate the same gradients as a single stage.");
+
+		typedef m5x4::expand<2>::type pair_input;
+		typedef m3::expand<2>::type pair_output;
+
+		pair_input::tensor_type pairInput;
+		pair_output::tensor_type pairTruth;
+
+		neural_network::detail::set_batch_item(input, 0, pairInput);
+		neural_network::detail::set_batch_item(input, 1, pairInput);
+		neural_network::detail::set_batch_item(target, 0, pairTruth);
+		neural_network::detail::set_batch_item(target, 1, pairTruth);
+
+		auto pair = neural_network::make_pipeline<2, 4>(net);
+		pair.train(pairInput, pairTruth, loss, 0.1f);
+
+		check_pipeline_tensors(reference.process(input), pair.process(input), 0.00001f, "Pipeline does not average the gradients of a batch.");
+	}
+
+	{
+		test::verbose("Pipeline Layer Update Tests");
+
+		typedef neural_network::algebra::metrics<10, 10> m10x10;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<4, 5, 5> m4x5x5;
+		typedef neural_network::algebra::metrics<100> m100;
+
+		typedef m10x10::expand<6>::type image_batch;
+
+		auto layers = neural_network::make_network(
+			neural_network::make_convolution_layer<m10x10, m2x2, m2x2, 4>(random_values),
+			neural_network::make_batch_normalization_layer<m4x5x5>(0.1f),
+			neural_network::make_relu_activation_layer<m4x5x5>(),
+			neural_network::make_reshape_layer<m4x5x5, m100>(),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_fully_connected_layer<m100, m8>(random_values, 0.00005f),
+					neural_network::make_relu_activation_layer<m8>())),
+			neural_network::make_fully_connected_layer<m8, m3>(random_values, 0.00005f),
+			neural_network::make_logistic_activation_layer<m3>());
+
+		neural_network::squared_error_loss<m3> loss;
+
+		image_batch::tensor_type images(random_values);
+
+		m10x10::tensor_type image;
+		m3::tensor_type target;
+
+		neural_network::detail::get_batch_item(images, 0, image);
+		neural_network::detail::get_batch_item(truth, 0, target);
+
+		auto copy = neural_network::make_pipeline<1, 4>(layers);
+		copy.train(image.reshape<m10x10::expand<1>::type>(), target.reshape<m3::expand<1>::type>(), loss, 0.1f);
+
+		decltype(layers) reference;
+		std::stringstream stream(get_serialized_weights(layers), std::ios_base::in | std::ios_base::binary);
+		neural_network::serialization::read(stream, reference);
+
+		reference.train(image, target, loss, 0.1f);
+
+		test::check_true(get_serialized_weights(reference) == get_serialized_weights(copy), "Pipeline update of a single micro-batch does not match the layer update.");
+
+		auto pipeline = neural_network::make_pipeline<1, 4>(layers);
+		auto single = neural_network::make_pipeline<>(layers);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			pipeline.train(images, truth, loss, 0.1f);
+			single.train(images, truth, loss, 0.1f);
+		}
+
+		test::check_true(get_serialized_weights(pipeline) == get_serialized_weights(single), "Pipeline stages do not keep the activations of their micro-batches.");
+	}
+
+	{
+		test::verbose("Pipeline Error Tests");
+
+		auto pipeline = neural_network::make_pipeline<2, 4>(net);
+
+		failing_loss<m3> failing(3);
+		test::check_exception<std::runtime_error>(
+			[&pipeline, &inputs, &truth, &failing]() { pipeline.train(inputs, truth, failing, 0.1f); },
+			"Pipeline did not rethrow the stage failure.");
+
+		auto single = neural_network::make_pipeline<>(net);
+
+		std::stringstream stream(get_serialized_weights(pipeline), std::ios_base::in | std::ios_base::binary);
+		neural_network::serialization::read(stream, single);
+
+		neural_network::squared_error_loss<m3> loss;
+		pipeline.train(inputs, truth, loss, 0.1f);
+		single.train(inputs, truth, loss, 0.1f);
+
+		test::check_true(get_serialized_weights(pipeline) == get_serialized_weights(single), "Pipeline cannot be trained after a stage failure.");
+	}
+
+	sc.pass();
+}
\ No newline at end of file
@@ -33,6 +33,44 @@ SOFTWARE.
 
 #include "opencltest.h"
 
+template <typename Expected, typename Layer>
+void test_channels_last_pooling_layer(
+	Expected& expected,
+	Layer& layer)
+{
+	static_assert(std::is_same<typename Expected::input, typename Layer::input>::value, "Input tensors do not match.");
+	static_assert(std::is_same<typename Expected::output, typename Layer::output>::value, "Output tensors do not match.");
+
+	typedef typename neural_network::algebra::metrics<Layer::input::data_size> flat_input;
+	typedef typename neural_network::algebra::metrics<Layer::output::data_size> flat_output;
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5f, 0.5f);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	typename Layer::input input(random_values);
+
+	auto output = layer.process(input).reshape<flat_output>();
+	auto expectedOutput = expected.process(input).reshape<flat_output>();
+
+	for (size_t i = 0; i < flat_output::data_size; ++i)
+	{
+		test::check_true(output(i) == expectedOutput(i), "Invalid channels last max pooling output.");
+	}
+
+	typename Layer::output grad(random_values);
+
+	auto result = layer.compute_gradient(grad).reshape<flat_input>();
+	auto expectedResult = expected.compute_gradient(grad).reshape<flat_input>();
+
+	for (size_t i = 0; i < flat_input::data_size; ++i)
+	{
+		test::check_true(result(i) == expectedResult(i), "Invalid channels last max pooling gradient.");
+	}
+}
+
 template <typename Layer, typename Process, typename Gradient>
 void test_pooling_layer_on_device(
 	Process process,
@@ -191,6 +229,83 @@ void test_4d_generic_pooling_layer_on_device(
 	});
 }
 
+template <typename Tensor>
+void check_tensors_flat(
+	const Tensor& expected,
+	const Tensor& actual)
+{
+	typedef neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	check_tensors_1d(
+		expected.reshape<flat_metrics>(),
+		actual.reshape<flat_metrics>());
+}
+
+template <typename Layer>
+void test_global_pooling_layer_on_device(
+	::boost::compute::command_queue& queue)
+{
+	test_pooling_layer_on_device<Layer>(
+		[&queue](Layer& cppLayer, Layer& openclLayer, const typename Layer::input& input)
+		{
+			check_tensors_1d(
+				cppLayer.process(input),
+				openclLayer.process(input, queue));
+		},
+		[&queue](Layer& cppLayer, Layer& openclLayer, const typename Layer::output& gradient)
+		{
+			check_tensors_flat(
+				cppLayer.compute_gradient(gradient),
+				openclLayer.compute_gradient(gradient, queue));
+		});
+}
+
+template <typename Layer, const size_t Batch>
+void test_pooling_layer_batch_on_device(
+	::boost::compute::command_queue& queue)
+{
+	typedef typename Layer::input::metrics::template expand<Batch>::type::tensor_type batch_input;
+	typedef typename Layer::output::metrics::template expand<Batch>::type::tensor_type batch_output;
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5f, 0.5f);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	const unsigned long seedValue = 123;
+
+	typename Layer cppLayer;
+	typename Layer openclLayer;
+
+	gen.seed(seedValue);
+
+	batch_input input(random_values);
+	batch_output grad(random_values);
+
+	batch_output result;
+	batch_input gradientResult;
+
+	openclLayer.process(input, result, queue);
+	openclLayer.compute_gradient(input, grad, gradientResult, queue);
+
+	typename Layer::input itemInput;
+	typename Layer::output itemResult;
+	typename Layer::output itemGrad;
+	typename Layer::input itemGradientResult;
+
+	for (size_t i = 0; i < Batch; ++i)
+	{
+		neural_network::detail::get_batch_item(input, i, itemInput);
+		neural_network::detail::get_batch_item(result, i, itemResult);
+		neural_network::detail::get_batch_item(grad, i, itemGrad);
+		neural_network::detail::get_batch_item(gradientResult, i, itemGradientResult);
+
+		check_tensors_flat(cppLayer.process(itemInput), itemResult);
+		check_tensors_flat(cppLayer.compute_gradient(itemGrad), itemGradientResult);
+	}
+}
+
 void test_pooling()
 {
 	scenario sc("Test for neural_network::*_pooling layers");
@@ -304,6 +419,120 @@ void test_pooling()
 		test_layer_serialization("1D Max Pooling With Core Layer Serialization Tests", layer);
 	}
 
+	{
+		test::verbose("Max Pooling With Overlapping Core Gradient Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<5> m5;
+
+		auto layer = neural_network::make_max_pooling_layer<m5, m3, m1>();
+
+		m5::tensor_type input;
+		input(0) = 1.0f;
+		input(1) = 3.0f;
+		input(2) = 2.0f;
+		input(3) = 5.0f;
+		input(4) = 0.0f;
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp(0) == 3.0f, "Invalid 1D max pooling output.");
+		test::check_true(tmp(1) == 5.0f, "Invalid 1D max pooling output.");
+		test::check_true(tmp(2) == 5.0f, "Invalid 1D max pooling output.");
+
+		m3::tensor_type grad;
+		grad(0) = 1.0f;
+		grad(1) = 2.0f;
+		grad(2) = 4.0f;
+
+		auto result = layer.compute_gradient(grad);
+
+		test::check_true(result(0) == 0.0f, "Invalid 1D max pooling gradient.");
+		test::check_true(result(1) == 1.0f, "Invalid 1D max pooling gradient.");
+		test::check_true(result(2) == 0.0f, "Invalid 1D max pooling gradient.");
+		test::check_true(result(3) == 6.0f, "Invalid 1D max pooling gradient.");
+		test::check_true(result(4) == 0.0f, "Invalid 1D max pooling gradient.");
+	}
+
+	{
+		test::verbose("Max Pooling With Padding Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<5> m5;
+		typedef neural_network::algebra::padding<1> p1;
+
+		auto layer = neural_network::make_max_pooling_layer<m5, m3, m2, p1>();
+
+		m5::tensor_type input;
+		input(0) = -1.0f;
+		input(1) = -5.0f;
+		input(2) = -2.0f;
+		input(3) = -4.0f;
+		input(4) = -3.0f;
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp(0) == -1.0f, "Invalid padded 1D max pooling output.");
+		test::check_true(tmp(1) == -2.0f, "Invalid padded 1D max pooling output.");
+		test::check_true(tmp(2) == -3.0f, "Invalid padded 1D max pooling output.");
+
+		m3::tensor_type grad;
+		grad(0) = 1.0f;
+		grad(1) = 2.0f;
+		grad(2) = 4.0f;
+
+		auto result = layer.compute_gradient(grad);
+
+		test::check_true(result(0) == 1.0f, "Invalid padded 1D max pooling gradient.");
+		test::check_true(result(1) == 0.0f, "Invalid padded 1D max pooling gradient.");
+		test::check_true(result(2) == 2.0f, "Invalid padded 1D max pooling gradient.");
+		test::check_true(result(3) == 0.0f, "Invalid padded 1D max pooling gradient.");
+		test::check_true(result(4) == 4.0f, "Invalid padded 1D max pooling gradient.");
+
+		test_layer_serialization("Padded Max Pooling With Core Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("Max Pooling With Dilation Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<5> m5;
+		typedef neural_network::algebra::padding<0> p0;
+
+		auto layer = neural_network::make_max_pooling_layer<m5, m2, m1, p0, m2>();
+
+		m5::tensor_type input;
+		input(0) = 1.0f;
+		input(1) = 3.0f;
+		input(2) = 2.0f;
+		input(3) = 5.0f;
+		input(4) = 0.0f;
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp(0) == 2.0f, "Invalid dilated 1D max pooling output.");
+		test::check_true(tmp(1) == 5.0f, "Invalid dilated 1D max pooling output.");
+		test::check_true(tmp(2) == 2.0f, "Invalid dilated 1D max pooling output.");
+
+		m3::tensor_type grad;
+		grad(0) = 1.0f;
+		grad(1) = 2.0f;
+		grad(2) = 4.0f;
+
+		auto result = layer.compute_gradient(grad);
+
+		test::check_true(result(0) == 0.0f, "Invalid dilated 1D max pooling gradient.");
+		test::check_true(result(1) == 0.0f, "Invalid dilated 1D max pooling gradient.");
+		test::check_true(result(2) == 5.0f, "Invalid dilated 1D max pooling gradient.");
+		test::check_true(result(3) == 2.0f, "Invalid dilated 1D max pooling gradient.");
+		test::check_true(result(4) == 0.0f, "Invalid dilated 1D max pooling gradient.");
+	}
+
 	{
 		test::verbose("2D Max Pooling With Core Tests");
 
@@ -349,6 +578,215 @@ void test_pooling()
 		test_layer_serialization("3D Max Pooling With Core Layer Serialization Tests", layer);
 	}
 
+	{
+		test::verbose("2D and 3D Max Pooling With Padding Tests");
+
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<7, 8> m7x8;
+		typedef neural_network::algebra::padding<1, 1> p1x1;
+
+		auto layer = neural_network::make_max_pooling_layer<m7x8, m3x3, m1x1, p1x1>();
+
+		m7x8::tensor_type input(random_values);
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 7, "Invalid size of padded 2D max pooling output tensor.");
+		test::check_true(tmp.size<1>() == 8, "Invalid size of padded 2D max pooling output tensor.");
+
+		layer.compute_gradient(tmp);
+
+		typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+		typedef neural_network::algebra::metrics<3, 3, 3> m3x3x3;
+		typedef neural_network::algebra::metrics<2, 2, 2> m2x2x2;
+		typedef neural_network::algebra::metrics<18, 18, 3> m18x18x3;
+		typedef neural_network::algebra::padding<1, 1, 1> p1x1x1;
+
+		auto layer3d = neural_network::make_max_pooling_layer<m18x18x3, m3x3x3, m2x2x1, p1x1x1, m2x2x2>();
+
+		m18x18x3::tensor_type input3d(random_values);
+
+		auto tmp3d = layer3d.process(input3d);
+
+		test::check_true(tmp3d.size<0>() == 8, "Invalid size of padded and dilated 3D max pooling output tensor.");
+		test::check_true(tmp3d.size<1>() == 8, "Invalid size of padded and dilated 3D max pooling output tensor.");
+		test::check_true(tmp3d.size<2>() == 1, "Invalid size of padded and dilated 3D max pooling output tensor.");
+
+		layer3d.compute_gradient(tmp3d);
+	}
+
+	{
+		test::verbose("Channels Last Max Pooling Tests");
+
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 1> m2x1;
+		typedef neural_network::algebra::metrics<3, 1> m3x1;
+		typedef neural_network::algebra::metrics<9, 4> m9x4;
+		typedef neural_network::algebra::padding<0, 0> p0x0;
+		typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+		typedef neural_network::algebra::metrics<2, 1, 1> m2x1x1;
+		typedef neural_network::algebra::metrics<3, 2, 1> m3x2x1;
+		typedef neural_network::algebra::metrics<8, 7, 5> m8x7x5;
+		typedef neural_network::algebra::padding<1, 0, 0> p1x0x0;
+
+		auto expected2d = neural_network::make_max_pooling_layer<m9x4, m3x1, m2x1>();
+		auto layer2d = neural_network::make_max_pooling_layer<m9x4, m3x1, m2x1, p0x0, m1x1, neural_network::layout::channels_last>();
+
+		test_channels_last_pooling_layer(expected2d, layer2d);
+
+		auto expected3d = neural_network::make_max_pooling_layer<m8x7x5, m3x2x1, m2x1x1, p1x0x0>();
+		auto layer3d = neural_network::make_max_pooling_layer<m8x7x5, m3x2x1, m2x1x1, p1x0x0, m1x1x1, neural_network::layout::channels_last>();
+
+		test_channels_last_pooling_layer(expected3d, layer3d);
+
+		test_layer_serialization("Channels Last Max Pooling Layer Serialization Tests", layer3d);
+	}
+
+	{
+		test::verbose("1D Average Pooling With Core Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<5> m5;
+
+		auto layer = neural_network::make_average_pooling_layer<m5, m3, m1>();
+
+		m5::tensor_type input;
+		for (size_t i = 0; i < input.size<0>(); ++i)
+		{
+			input(i) = static_cast<float>(i + 1);
+		}
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 3, "Invalid size of 1D average pooling output tensor.");
+		test::check_true(tmp(0) == 2.0f, "Invalid 1D average pooling output.");
+		test::check_true(tmp(1) == 3.0f, "Invalid 1D average pooling output.");
+		test::check_true(tmp(2) == 4.0f, "Invalid 1D average pooling output.");
+
+		m3::tensor_type grad;
+		grad(0) = 3.0f;
+		grad(1) = 6.0f;
+		grad(2) = 9.0f;
+
+		auto result = layer.compute_gradient(grad);
+
+		test::check_true(result(0) == 1.0f, "Invalid 1D average pooling gradient.");
+		test::check_true(result(1) == 3.0f, "Invalid 1D average pooling gradient.");
+		test::check_true(result(2) == 6.0f, "Invalid 1D average pooling gradient.");
+		test::check_true(result(3) == 5.0f, "Invalid 1D average pooling gradient.");
+		test::check_true(result(4) == 3.0f, "Invalid 1D average pooling gradient.");
+
+		layer.update_weights(0.1f);
+
+		test_layer_serialization("1D Average Pooling With Core Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("2D Average Pooling With Core Tests");
+
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 2> m3x2;
+		typedef neural_network::algebra::metrics<7, 8> m7x8;
+
+		auto layer = neural_network::make_average_pooling_layer<m7x8, m3x2, m2x2>();
+
+		m7x8::tensor_type input(random_values);
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 3, "Invalid size of 2D average pooling output tensor.");
+		test::check_true(tmp.size<1>() == 4, "Invalid size of 2D average pooling output tensor.");
+
+		layer.compute_gradient(tmp);
+		layer.update_weights(0.1f);
+
+		test_layer_serialization("2D Average Pooling With Core Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("3D Average Pooling With Core Tests");
+
+		typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+		typedef neural_network::algebra::metrics<3, 3, 3> m3x3x3;
+		typedef neural_network::algebra::metrics<19, 19, 3> m19x19x3;
+
+		auto layer = neural_network::make_average_pooling_layer<m19x19x3, m3x3x3, m2x2x1>();
+
+		m19x19x3::tensor_type input(random_values);
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 9, "Invalid size of 3D average pooling output tensor.");
+		test::check_true(tmp.size<1>() == 9, "Invalid size of 3D average pooling output tensor.");
+		test::check_true(tmp.size<2>() == 1, "Invalid size of 3D average pooling output tensor.");
+
+		layer.compute_gradient(tmp);
+		layer.update_weights(0.1f);
+
+		test_layer_serialization("3D Average Pooling With Core Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("Global Average Pooling Tests");
+
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<2, 3> m2x3;
+
+		auto layer = neural_network::make_global_average_pooling_layer<m2x3>();
+
+		m2x3::tensor_type input;
+		for (size_t c = 0; c < input.size<0>(); ++c)
+		{
+			for (size_t i = 0; i < input.size<1>(); ++i)
+			{
+				input(c, i) = static_cast<float>(c * input.size<1>() + i + 1);
+			}
+		}
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 2, "Invalid size of global average pooling output tensor.");
+		test::check_true(tmp(0) == 2.0f, "Invalid global average pooling output.");
+		test::check_true(tmp(1) == 5.0f, "Invalid global average pooling output.");
+
+		m2::tensor_type grad;
+		grad(0) = 3.0f;
+		grad(1) = 6.0f;
+
+		auto result = layer.compute_gradient(grad);
+
+		for (size_t i = 0; i < result.size<1>(); ++i)
+		{
+			test::check_true(result(0, i) == 1.0f, "Invalid global average pooling gradient.");
+			test::check_true(result(1, i) == 2.0f, "Invalid global average pooling gradient.");
+		}
+
+		layer.update_weights(0.1f);
+
+		test_layer_serialization("Global Average Pooling Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("3D Global Average Pooling Tests");
+
+		typedef neural_network::algebra::metrics<5, 6, 7, 3> m5x6x7x3;
+
+		auto layer = neural_network::make_global_average_pooling_layer<m5x6x7x3>();
+
+		m5x6x7x3::tensor_type input(random_values);
+
+		auto tmp = layer.process(input);
+
+		test::check_true(tmp.size<0>() == 5, "Invalid size of global average pooling output tensor.");
+
+		layer.compute_gradient(tmp);
+		layer.update_weights(0.1f);
+
+		test_layer_serialization("3D Global Average Pooling Layer Serialization Tests", layer);
+	}
+
 	{
 		auto context = find_test_device_context();
 		::boost::compute::command_queue queue(context, context.get_device());
@@ -408,13 +846,17 @@ void test_pooling()
 		{
 			test::verbose("OpenCL 2D Pooling With Core Layer Tests");
 
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
 			typedef neural_network::algebra::metrics<2, 2> m2x2;
 			typedef neural_network::algebra::metrics<3, 2> m3x2;
+			typedef neural_network::algebra::metrics<3, 3> m3x3;
 			typedef neural_network::algebra::metrics<7, 8> m7x8;
 			typedef neural_network::algebra::metrics<17, 18> m17x18;
+			typedef neural_network::algebra::padding<1, 1> p1x1;
 
 			test_2d_pooling_layer_on_device<neural_network::max_pooling_with_core<m7x8, m3x2, m2x2>>(queue);
 			test_2d_pooling_layer_on_device<neural_network::max_pooling_with_core<m17x18, m3x2, m2x2>>(queue);
+			test_2d_pooling_layer_on_device<neural_network::max_pooling_with_core<m17x18, m3x3, m1x1, p1x1>>(queue);
 		}
 
 		{
@@ -429,6 +871,75 @@ void test_pooling()
 
 			test_3d_pooling_layer_on_device<neural_network::max_pooling_with_core<m9x9x3, m3x3x3, m2x2x1>>(queue);
 			test_3d_pooling_layer_on_device<neural_network::max_pooling_with_core<m19x19x3, m3x3x3, m2x2x1>>(queue);
+
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::metrics<3, 3, 1> m3x3x1;
+			typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+			test_3d_pooling_layer_on_device<neural_network::max_pooling_with_core<m19x19x3, m3x3x1, m2x2x1, p0x0x0, m1x1x1, neural_network::layout::channels_last>>(queue);
+		}
+
+		{
+			test::verbose("OpenCL Average Pooling With Core Layer Tests");
+
+			typedef neural_network::algebra::metrics<1> m1;
+			typedef neural_network::algebra::metrics<3> m3;
+			typedef neural_network::algebra::metrics<4> m4;
+			typedef neural_network::algebra::metrics<48> m48;
+			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<3, 2> m3x2;
+			typedef neural_network::algebra::metrics<7, 8> m7x8;
+			typedef neural_network::algebra::metrics<17, 18> m17x18;
+			typedef neural_network::algebra::metrics<2, 2, 2> m2x2x2;
+			typedef neural_network::algebra::metrics<3, 3, 2> m3x3x2;
+			typedef neural_network::algebra::metrics<9, 9, 4> m9x9x4;
+			typedef neural_network::algebra::metrics<19, 19, 4> m19x19x4;
+
+			test_1d_pooling_layer_on_device<neural_network::average_pooling_with_core<m4, m3, m1>>(queue);
+			test_1d_pooling_layer_on_device<neural_network::average_pooling_with_core<m48, m3, m1>>(queue);
+			test_2d_pooling_layer_on_device<neural_network::average_pooling_with_core<m7x8, m3x2, m2x2>>(queue);
+			test_2d_pooling_layer_on_device<neural_network::average_pooling_with_core<m17x18, m3x2, m2x2>>(queue);
+			test_3d_pooling_layer_on_device<neural_network::average_pooling_with_core<m9x9x4, m3x3x2, m2x2x2>>(queue);
+			test_3d_pooling_layer_on_device<neural_network::average_pooling_with_core<m19x19x4, m3x3x2, m2x2x2>>(queue);
+		}
+
+		{
+			test::verbose("OpenCL Global Average Pooling Layer Tests");
+
+			typedef neural_network::algebra::metrics<4, 20> m4x20;
+			typedef neural_network::algebra::metrics<8, 256> m8x256;
+			typedef neural_network::algebra::metrics<16, 8, 8> m16x8x8;
+			typedef neural_network::algebra::metrics<32, 7, 7, 3> m32x7x7x3;
+
+			test_global_pooling_layer_on_device<neural_network::global_average_pooling<m4x20>>(queue);
+			test_global_pooling_layer_on_device<neural_network::global_average_pooling<m8x256>>(queue);
+			test_global_pooling_layer_on_device<neural_network::global_average_pooling<m16x8x8>>(queue);
+			test_global_pooling_layer_on_device<neural_network::global_average_pooling<m32x7x7x3>>(queue);
+		}
+
+		{
+			test::verbose("OpenCL Batched Pooling With Core Layer Tests");
+
+			typedef neural_network::algebra::metrics<1> m1;
+			typedef neural_network::algebra::metrics<3> m3;
+			typedef neural_network::algebra::metrics<48> m48;
+			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<3, 2> m3x2;
+			typedef neural_network::algebra::metrics<17, 18> m17x18;
+			typedef neural_network::algebra::metrics<2, 2, 1> m2x2x1;
+			typedef neural_network::algebra::metrics<3, 3, 3> m3x3x3;
+			typedef neural_network::algebra::metrics<9, 9, 3> m9x9x3;
+
+			test_pooling_layer_batch_on_device<neural_network::max_pooling_with_core<m48, m3, m1>, 1>(queue);
+			test_pooling_layer_batch_on_device<neural_network::max_pooling_with_core<m48, m3, m1>, 9>(queue);
+			test_pooling_layer_batch_on_device<neural_network::max_pooling_with_core<m17x18, m3x2, m2x2>, 16>(queue);
+			test_pooling_layer_batch_on_device<neural_network::max_pooling_with_core<m9x9x3, m3x3x3, m2x2x1>, 4>(queue);
+
+			typedef neural_network::algebra::metrics<1, 1, 1> m1x1x1;
+			typedef neural_network::algebra::metrics<3, 3, 1> m3x3x1;
+			typedef neural_network::algebra::padding<0, 0, 0> p0x0x0;
+
+			test_pooling_layer_batch_on_device<neural_network::max_pooling_with_core<m9x9x3, m3x3x1, m2x2x1, p0x0x0, m1x1x1, neural_network::layout::channels_last>, 4>(queue);
 		}
 	}
 
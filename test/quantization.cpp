@@ -0,0 +1,249 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+std::string serialize_quantized_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	return stream.str();
+}
+
+template <class Layer>
+void read_quantized_weights(
+	const std::string& weights,
+	Layer& layer)
+{
+	std::stringstream stream(weights, std::ios_base::in | std::ios_base::binary);
+	neural_network::serialization::read(stream, layer);
+}
+
+template <class Network, class Quantized, class Batch>
+void check_quantized_network(
+	Network& net,
+	Quantized& quantized,
+	const Batch& batch,
+	const float tolerance,
+	const char* message)
+{
+	typedef typename Network::input input;
+	typedef typename Network::output output;
+	typedef typename neural_network::algebra::metrics<output::data_size> flat_metrics;
+
+	for (size_t i = 0; i < Batch::metrics::dimension_size; ++i)
+	{
+		input item;
+		neural_network::detail::get_batch_item(batch, i, item);
+
+		auto expected = net.process(item).reshape<flat_metrics>();
+		auto actual = quantized.process(item).reshape<flat_metrics>();
+
+		for (size_t j = 0; j < flat_metrics::data_size; ++j)
+		{
+			test::check_true(std::abs(expected(j) - actual(j)) <= tolerance * std::max(1.0f, std::abs(expected(j))), message);
+		}
+	}
+}
+
+template <class Quantized, class Batch>
+void check_quantized_serialization(
+	Quantized& quantized,
+	const Batch& batch,
+	const char* message)
+{
+	typedef typename Quantized::input input;
+	typedef typename Quantized::output output;
+	typedef typename neural_network::algebra::metrics<output::data_size> flat_metrics;
+
+	Quantized other;
+	read_quantized_weights(serialize_quantized_weights(quantized), other);
+
+	test::check_true(serialize_quantized_weights(quantized) == serialize_quantized_weights(other), message);
+
+	input item;
+	neural_network::detail::get_batch_item(batch, 0, item);
+
+	auto expected = quantized.process(item).reshape<flat_metrics>();
+	auto actual = other.process(item).reshape<flat_metrics>();
+
+	for (size_t j = 0; j < flat_metrics::data_size; ++j)
+	{
+		test::check_true(expected(j) == actual(j), message);
+	}
+}
+
+void test_quantization()
+{
+	scenario sc("Test for neural_network::quantize function");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	{
+		test::verbose("Quantized Dot Product Tests");
+
+		std::uniform_int_distribution<int> values(-127, 127);
+
+		for (size_t size = 1; size < 70; size += 3)
+		{
+			std::vector<std::int8_t> left(size);
+			std::vector<std::int8_t> right(size);
+
+			std::int32_t expected = 0;
+			for (size_t i = 0; i < size; ++i)
+			{
+				left[i] = static_cast<std::int8_t>(values(gen));
+				right[i] = static_cast<std::int8_t>((i % 2) ? -127 : values(gen));
+
+				expected += left[i] * right[i];
+			}
+
+			test::check_true(expected == neural_network::detail::dot_product(left.data(), right.data(), size), "Invalid quantized dot product.");
+		}
+	}
+
+	{
+		test::verbose("Quantized Fully Connected Network Tests");
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<8> m8;
+		typedef neural_network::algebra::metrics<16> m16;
+		typedef neural_network::algebra::metrics<3, 5> m3x5;
+		typedef neural_network::algebra::metrics<32, 3, 5> batch_metrics;
+
+		auto net = neural_network::make_network(
+			neural_network::make_fully_connected_layer<m3x5, m16>(random_values),
+			neural_network::make_relu_activation_layer<m16>(),
+			neural_network::make_fully_connected_layer<m16, m8>(random_values),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_tanh_activation_layer<m8>(),
+					neural_network::make_fully_connected_layer<m8, m8>(random_values))),
+			neural_network::make_fully_connected_layer<m8, m4>(random_values));
+
+		batch_metrics::tensor_type batch(random_values);
+
+		auto perChannel = neural_network::quantize(net, batch);
+		auto perTensor = neural_network::quantize(net, batch, neural_network::quantization_granularity::per_tensor);
+
+		check_quantized_network(net, perChannel, batch, 0.05f, "Invalid per channel quantized network output.");
+		check_quantized_network(net, perTensor, batch, 0.05f, "Invalid per tensor quantized network output.");
+
+		test::check_true(
+			neural_network::serialization::model_size(perChannel) < neural_network::serialization::model_size(net),
+			"Quantized model is not smaller than the original model.");
+
+		check_quantized_serialization(perChannel, batch, "Invalid quantized network serialization.");
+		test_layer_serialization("Quantized Fully Connected Serialization Tests", perChannel);
+
+		neural_network::quantized_fully_connected<m16, m8> layer;
+		read_quantized_weights(serialize_quantized_weights(neural_network::make_fully_connected_layer<m16, m8>(random_values)), layer);
+
+		test::check_exception<std::ios_base::failure>(
+			[&layer]() { serialize_quantized_weights(layer); },
+			"Layer that is not quantized must not be written.");
+
+		test::check_exception<std::ios_base::failure>(
+			[&layer, &random_values]() { read_quantized_weights(serialize_quantized_weights(neural_network::make_fully_connected_layer<m8, m4>(random_values)), layer); },
+			"Layer of a different size must not be read.");
+	}
+
+	{
+		test::verbose("Quantized Convolution Network Tests");
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<1, 1> m1x1;
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<10, 10> m10x10;
+		typedef neural_network::algebra::metrics<3, 10, 10> m3x10x10;
+		typedef neural_network::algebra::metrics<1, 2, 2> m1x2x2;
+		typedef neural_network::algebra::metrics<3, 3, 3> m3x3x3;
+		typedef neural_network::algebra::metrics<2, 1, 5, 5> m2x1x5x5;
+		typedef neural_network::algebra::metrics<16, 10, 10> batch_metrics;
+		typedef neural_network::algebra::padding<2, 2> p2x2;
+		typedef neural_network::algebra::padding<0, 1, 1> p0x1x1;
+
+		auto net = neural_network::make_network(
+			neural_network::make_convolution_layer<m10x10, m3x3, m1x1, 3, p2x2, m2x2>(random_values),
+			neural_network::make_relu_activation_layer<m3x10x10>(),
+			neural_network::make_convolution_layer<m3x10x10, m3x3x3, m1x2x2, 2, p0x1x1>(random_values),
+			neural_network::make_fully_connected_layer<m2x1x5x5, m4>(random_values));
+
+		batch_metrics::tensor_type batch(random_values);
+
+		auto perChannel = neural_network::quantize(net, batch);
+		auto perTensor = neural_network::quantize(net, batch, neural_network::quantization_granularity::per_tensor);
+
+		check_quantized_network(net, perChannel, batch, 0.1f, "Invalid per channel quantized convolution network output.");
+		check_quantized_network(net, perTensor, batch, 0.1f, "Invalid per tensor quantized convolution network output.");
+
+		check_quantized_serialization(perChannel, batch, "Invalid quantized convolution network serialization.");
+		test_layer_serialization("Quantized Convolution Serialization Tests", perChannel);
+	}
+
+	{
+		test::verbose("Quantized Strided Convolution Tests");
+
+		typedef neural_network::algebra::metrics<2> m2;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<9> m9;
+		typedef neural_network::algebra::metrics<4, 5> m4x5;
+		typedef neural_network::algebra::metrics<8, 9> batch_metrics;
+		typedef neural_network::algebra::padding<1> p1;
+
+		auto net = neural_network::make_network(
+			neural_network::make_convolution_layer<m9, m3, m2, 4, p1>(random_values),
+			neural_network::make_tanh_activation_layer<m4x5>());
+
+		batch_metrics::tensor_type batch(random_values);
+
+		auto quantized = neural_network::quantize(net, batch);
+
+		check_quantized_network(net, quantized, batch, 0.05f, "Invalid quantized strided convolution output.");
+		check_quantized_serialization(quantized, batch, "Invalid quantized strided convolution serialization.");
+	}
+
+	sc.pass();
+}
\ No newline at end of file
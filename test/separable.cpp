@@ -0,0 +1,244 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "stdafx.h"
+
+#include <random>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\separable.h"
+
+#include "opencltest.h"
+
+template <typename Tensor>
+void check_tensors_flat(
+	const Tensor& expected,
+	const Tensor& actual)
+{
+	typedef neural_network::algebra::metrics<Tensor::data_size> flat_metrics;
+
+	check_tensors_1d(
+		expected.reshape<flat_metrics>(),
+		actual.reshape<flat_metrics>());
+}
+
+template <typename Layer>
+void test_separable_layer_on_device(
+	::boost::compute::command_queue& queue)
+{
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5f, 0.5f);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	const unsigned long seedValue = 123;
+
+	gen.seed(seedValue);
+	typename Layer cppLayer(random_values);
+
+	gen.seed(seedValue);
+	typename Layer openclLayer(random_values);
+
+	typename Layer::input input(random_values);
+	typename Layer::output grad(random_values);
+
+	check_tensors_flat(
+		cppLayer.process(input),
+		openclLayer.process(input, queue));
+
+	check_tensors_flat(
+		cppLayer.compute_gradient(grad),
+		openclLayer.compute_gradient(grad, queue));
+
+	cppLayer.update_weights(0.001f);
+	openclLayer.update_weights(0.001f, queue);
+
+	check_tensors_flat(
+		cppLayer.process(input),
+		openclLayer.process(input, queue));
+}
+
+void test_separable()
+{
+	scenario sc("Test for neural_network::depthwise_convolution and neural_network::pointwise_convolution classes");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	{
+		test::verbose("1D Depthwise Convolution Tests");
+
+		typedef neural_network::algebra::metrics<1> m1;
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<2, 4> m2x4;
+		typedef neural_network::algebra::padding<1> p1;
+
+		auto layer = neural_network::make_depthwise_convolution_layer<m2x4, m3, m1, p1>([]() { return 1.0f; });
+
+		m2x4::tensor_type input;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			input(0, i) = static_cast<float>(i + 1);
+			input(1, i) = static_cast<float>(4 - i);
+		}
+
+		auto output = layer.process(input);
+
+		test::check_true(output.size<0>() == 2 && output.size<1>() == 4, "Invalid size of depthwise convolution output tensor.");
+		test::check_true(output(0, 0) == 4.0f && output(0, 1) == 7.0f && output(0, 2) == 10.0f && output(0, 3) == 8.0f, "Invalid depthwise convolution output.");
+		test::check_true(output(1, 0) == 8.0f && output(1, 1) == 10.0f && output(1, 2) == 7.0f && output(1, 3) == 4.0f, "Invalid depthwise convolution output.");
+
+		m2x4::tensor_type grad([]() { return 1.0f; });
+
+		auto result = layer.compute_gradient(grad);
+
+		for (size_t channel = 0; channel < 2; ++channel)
+		{
+			test::check_true(result(channel, 0) == 2.0f, "Invalid depthwise convolution gradient.");
+			test::check_true(result(channel, 1) == 3.0f, "Invalid depthwise convolution gradient.");
+			test::check_true(result(channel, 2) == 3.0f, "Invalid depthwise convolution gradient.");
+			test::check_true(result(channel, 3) == 2.0f, "Invalid depthwise convolution gradient.");
+		}
+
+		test_layer_serialization("1D Depthwise Convolution Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("2D Depthwise Convolution Tests");
+
+		typedef neural_network::algebra::metrics<2, 2> m2x2;
+		typedef neural_network::algebra::metrics<3, 3> m3x3;
+		typedef neural_network::algebra::metrics<3, 10, 10> m3x10x10;
+		typedef neural_network::algebra::padding<1, 1> p1x1;
+
+		auto layer = neural_network::make_depthwise_convolution_layer<m3x10x10, m3x3, m2x2, p1x1>(random_values);
+
+		m3x10x10::tensor_type input(random_values);
+		auto output = layer.process(input);
+
+		test::check_true(output.size<0>() == 3 && output.size<1>() == 5 && output.size<2>() == 5, "Invalid size of depthwise convolution output tensor.");
+
+		auto grad = layer.compute_gradient(output);
+		layer.update_weights(0.001f);
+
+		test_layer_serialization("2D Depthwise Convolution Layer Serialization Tests", layer);
+	}
+
+	{
+		test::verbose("Pointwise Convolution Tests");
+
+		typedef neural_network::algebra::metrics<2, 3> m2x3;
+
+		auto layer = neural_network::make_pointwise_convolution_layer<m2x3, 2>([]() { return 1.0f; });
+
+		m2x3::tensor_type input;
+		for (size_t i = 0; i < 3; ++i)
+		{
+			input(0, i) = static_cast<float>(i + 1);
+			input(1, i) = static_cast<float>(i + 4);
+		}
+
+		auto output = layer.process(input);
+
+		for (size_t kernel = 0; kernel < 2; ++kernel)
+		{
+			test::check_true(output(kernel, 0) == 6.0f, "Invalid pointwise convolution output.");
+			test::check_true(output(kernel, 1) == 8.0f, "Invalid pointwise convolution output.");
+			test::check_true(output(kernel, 2) == 10.0f, "Invalid pointwise convolution output.");
+		}
+
+		m2x3::tensor_type grad([]() { return 1.0f; });
+
+		auto result = layer.compute_gradient(grad);
+
+		for (size_t channel = 0; channel < 2; ++channel)
+		{
+			for (size_t i = 0; i < 3; ++i)
+			{
+				test::check_true(result(channel, i) == 2.0f, "Invalid pointwise convolution gradient.");
+			}
+		}
+
+		test_layer_serialization("Pointwise Convolution Layer Serialization Tests", layer);
+
+		typedef neural_network::algebra::metrics<4, 6, 5> m4x6x5;
+
+		auto layer3d = neural_network::make_pointwise_convolution_layer<m4x6x5, 7>(random_values);
+
+		m4x6x5::tensor_type input3d(random_values);
+		auto output3d = layer3d.process(input3d);
+
+		test::check_true(output3d.size<0>() == 7 && output3d.size<1>() == 6 && output3d.size<2>() == 5, "Invalid size of pointwise convolution output tensor.");
+
+		layer3d.compute_gradient(output3d);
+		layer3d.update_weights(0.001f);
+	}
+
+	{
+		auto context = find_test_device_context();
+		::boost::compute::command_queue queue(context, context.get_device());
+
+		{
+			test::verbose("OpenCL Depthwise Convolution Layer Tests");
+
+			typedef neural_network::algebra::metrics<1> m1;
+			typedef neural_network::algebra::metrics<5> m5;
+			typedef neural_network::algebra::metrics<1, 1> m1x1;
+			typedef neural_network::algebra::metrics<2, 2> m2x2;
+			typedef neural_network::algebra::metrics<3, 3> m3x3;
+			typedef neural_network::algebra::metrics<32, 64> m32x64;
+			typedef neural_network::algebra::metrics<8, 18, 18> m8x18x18;
+			typedef neural_network::algebra::metrics<8, 20, 20> m8x20x20;
+			typedef neural_network::algebra::metrics<16, 10, 10> m16x10x10;
+			typedef neural_network::algebra::padding<2> p2;
+			typedef neural_network::algebra::padding<1, 1> p1x1;
+			typedef neural_network::algebra::padding<2, 2> p2x2;
+
+			test_separable_layer_on_device<neural_network::depthwise_convolution<m16x10x10, m2x2, m2x2>>(queue);
+			test_separable_layer_on_device<neural_network::depthwise_convolution<m32x64, m5, m1, p2>>(queue);
+			test_separable_layer_on_device<neural_network::depthwise_convolution<m8x18x18, m3x3, m1x1, p1x1>>(queue);
+			test_separable_layer_on_device<neural_network::depthwise_convolution<m8x20x20, m3x3, m1x1, p2x2, m2x2>>(queue);
+		}
+
+		{
+			test::verbose("OpenCL Pointwise Convolution Layer Tests");
+
+			typedef neural_network::algebra::metrics<4, 5, 5> m4x5x5;
+			typedef neural_network::algebra::metrics<16, 10, 10> m16x10x10;
+			typedef neural_network::algebra::metrics<24, 64> m24x64;
+
+			test_separable_layer_on_device<neural_network::pointwise_convolution<m4x5x5, 3>>(queue);
+			test_separable_layer_on_device<neural_network::pointwise_convolution<m16x10x10, 12>>(queue);
+			test_separable_layer_on_device<neural_network::pointwise_convolution<m24x64, 32>>(queue);
+		}
+	}
+
+	sc.pass();
+}
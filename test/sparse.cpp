@@ -0,0 +1,433 @@
+/*
+
+Copyright (c) 2020-2021 svm-git
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "unittest.h"
+#include "serializationtest.h"
+
+#include "..\src\ai.h"
+
+template <class Layer>
+std::string serialize_sparse_weights(
+	const Layer& layer)
+{
+	std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	neural_network::serialization::write(stream, layer);
+
+	return stream.str();
+}
+
+template <class Layer>
+void read_sparse_weights(
+	const std::string& weights,
+	Layer& layer)
+{
+	std::stringstream stream(weights, std::ios_base::in | std::ios_base::binary);
+	neural_network::serialization::read(stream, layer);
+}
+
+// Computes the output of a fully connected layer that keeps the blocks of weights with the
+// largest sum of squares in every row, from the weights of the dense layer.
+template <const size_t BlockSize, const size_t Kept, class Layer>
+typename Layer::output pruned_layer_output(
+	const Layer& layer,
+	const typename Layer::input& input)
+{
+	typedef typename Layer::reshaped_input reshaped_input;
+	typedef typename Layer::reshaped_output reshaped_output;
+
+	typename Layer::weights_type weights;
+	typename Layer::bias_type bias;
+	float regularization = 0.0f;
+
+	std::stringstream stream(serialize_sparse_weights(layer), std::ios_base::in | std::ios_base::binary);
+	Layer::serializer_impl_type::read(stream, weights, bias, regularization);
+
+	const size_t columns = reshaped_input::data_size;
+	const size_t blocks = (columns + BlockSize - 1) / BlockSize;
+
+	auto rin = input.reshape<reshaped_input>();
+
+	typename Layer::output result;
+	auto rout = result.reshape<reshaped_output>();
+
+	for (size_t row = 0; row < reshaped_output::data_size; ++row)
+	{
+		std::vector<std::pair<float, size_t>> scores;
+		for (size_t block = 0; block < blocks; ++block)
+		{
+			float score = 0.0f;
+			for (size_t column = block * BlockSize; column < std::min(columns, (block + 1) * BlockSize); ++column)
+			{
+				score += weights(row, column) * weights(row, column);
+			}
+
+			scores.push_back(std::make_pair(-score, block));
+		}
+
+		std::sort(scores.begin(), scores.end());
+
+		float sum = bias(row);
+		for (size_t k = 0; k < Kept; ++k)
+		{
+			const size_t block = scores[k].second;
+			for (size_t column = block * BlockSize; column < std::min(columns, (block + 1) * BlockSize); ++column)
+			{
+				sum += weights(row, column) * rin(column);
+			}
+		}
+
+		rout(row) = sum;
+	}
+
+	return result;
+}
+
+template <class Expected, class Actual>
+void check_sparse_output(
+	const Expected& expected,
+	const Actual& actual,
+	const char* message)
+{
+	typedef typename neural_network::algebra::metrics<Expected::data_size> flat_metrics;
+
+	auto e = expected.reshape<flat_metrics>();
+	auto a = actual.reshape<flat_metrics>();
+
+	for (size_t i = 0; i < flat_metrics::data_size; ++i)
+	{
+		test::check_true(std::abs(e(i) - a(i)) <= 1e-5f * std::max(1.0f, std::abs(e(i))), message);
+	}
+}
+
+template <const size_t BlockSize>
+void test_sparse_dot_product(
+	std::mt19937& gen)
+{
+	std::uniform_real_distribution<float> distr(-1.0f, 1.0f);
+	std::uniform_int_distribution<std::uint32_t> offsets(0, 64);
+
+	std::vector<float> input(64 + BlockSize);
+	for (auto& value : input)
+	{
+		value = distr(gen);
+	}
+
+	for (size_t blocks = 0; blocks < 40; ++blocks)
+	{
+		std::vector<float> values(blocks * BlockSize);
+		std::vector<std::uint32_t> columns(blocks);
+
+		double expected = 0.0;
+		for (size_t k = 0; k < blocks; ++k)
+		{
+			columns[k] = offsets(gen);
+			for (size_t b = 0; b < BlockSize; ++b)
+			{
+				values[k * BlockSize + b] = distr(gen);
+				expected += static_cast<double>(values[k * BlockSize + b]) * input[columns[k] + b];
+			}
+		}
+
+		const float actual = neural_network::detail::sparse_dot_product<BlockSize>(values.data(), columns.data(), input.data(), blocks);
+		test::check_true(std::abs(expected - actual) < 1e-4, "Invalid sparse dot product.");
+	}
+}
+
+void test_sparse()
+{
+	scenario sc("Test for neural_network::prune function");
+
+	std::random_device rd;
+	std::mt19937 gen(rd());
+	std::uniform_real_distribution<float> distr(-0.5, 0.5);
+
+	auto random_values = [&distr, &gen]() { return distr(gen); };
+
+	{
+		test::verbose("Sparse Dot Product Tests");
+
+		test_sparse_dot_product<1>(gen);
+		test_sparse_dot_product<4>(gen);
+		test_sparse_dot_product<8>(gen);
+	}
+
+	{
+		test::verbose("Sparse Fully Connected Layer Tests");
+
+		typedef neural_network::algebra::metrics<6> m6;
+		typedef neural_network::algebra::metrics<4, 5> m4x5;
+
+		auto layer = neural_network::make_fully_connected_layer<m4x5, m6>(random_values);
+
+		auto dense = neural_network::prune<0>(layer);
+		auto magnitude = neural_network::prune<80>(layer);
+		auto blocks = neural_network::prune<50, 8>(layer);
+
+		typedef decltype(dense) dense_layer;
+		typedef decltype(magnitude) magnitude_layer;
+		typedef decltype(blocks) block_layer;
+
+		test::check_true(20 == dense_layer::kept_blocks, "Invalid number of kept weights.");
+		test::check_true(4 == magnitude_layer::kept_blocks, "Invalid number of kept weights.");
+		test::check_true(2 == block_layer::kept_blocks, "Invalid number of kept blocks.");
+
+		for (size_t i = 0; i < 10; ++i)
+		{
+			m4x5::tensor_type input(random_values);
+
+			check_sparse_output(layer.process(input), dense.process(input), "Invalid output of a sparse layer without pruning.");
+			check_sparse_output(pruned_layer_output<1, 4>(layer, input), magnitude.process(input), "Invalid output of a magnitude pruned layer.");
+			check_sparse_output(pruned_layer_output<8, 2>(layer, input), blocks.process(input), "Invalid output of a block pruned layer.");
+		}
+
+		test_layer_serialization("Sparse Fully Connected Serialization Tests", magnitude);
+		test_layer_serialization("Block Sparse Fully Connected Serialization Tests", blocks);
+
+		magnitude_layer other;
+		read_sparse_weights(serialize_sparse_weights(magnitude), other);
+		test::check_true(serialize_sparse_weights(magnitude) == serialize_sparse_weights(other), "Invalid sparse layer serialization.");
+
+		test::check_exception<std::ios_base::failure>(
+			[&blocks, &other]() { read_sparse_weights(serialize_sparse_weights(blocks), other); },
+			"Layer with a different sparsity must not be read.");
+
+		std::string corrupted = serialize_sparse_weights(magnitude);
+		const size_t bias_size = neural_network::serialization::tensor_serializer<magnitude_layer::bias_type>::serialized_data_size;
+		corrupted[corrupted.size() - bias_size - 1] = static_cast<char>(0x7f);
+
+		test::check_exception<std::ios_base::failure>(
+			[&corrupted, &other]() { read_sparse_weights(corrupted, other); },
+			"Block column past the end of the input must not be read.");
+	}
+
+	{
+		test::verbose("Sparse Network Tests");
+
+		typedef neural_network::algebra::metrics<4> m4;
+		typedef neural_network::algebra::metrics<32> m32;
+		typedef neural_network::algebra::metrics<64> m64;
+		typedef neural_network::algebra::metrics<3, 20> m3x20;
+
+		auto net = neural_network::make_network(
+			neural_network::make_fully_connected_layer<m3x20, m64>(random_values),
+			neural_network::make_relu_activation_layer<m64>(),
+			neural_network::make_checkpoint(
+				neural_network::make_network(
+					neural_network::make_fully_connected_layer<m64, m32>(random_values),
+					neural_network::make_tanh_activation_layer<m32>())),
+			neural_network::make_fully_connected_layer<m32, m4>(random_values));
+
+		auto dense = neural_network::prune<0, 8>(net);
+		auto sparse = neural_network::prune<90, 8>(net);
+
+		for (size_t i = 0; i < 10; ++i)
+		{
+			m3x20::tensor_type input(random_values);
+			check_sparse_output(net.process(input), dense.process(input), "Invalid output of a sparse network without pruning.");
+		}
+
+		test::check_true(
+			neural_network::serialization::model_size(sparse) * 4 < neural_network::serialization::model_size(net),
+			"Sparse model is not smaller than the original model.");
+
+		test_layer_serialization("Sparse Network Serialization Tests", sparse);
+	}
+
+	{
+		test::verbose("Sparse Input Fully Connected Layer Tests");
+
+		typedef neural_network::algebra::metrics<6> m6;
+		typedef neural_network::algebra::metrics<4, 5> m4x5;
+
+		const unsigned int seed = rd();
+		std::mt19937 dense_gen(seed);
+		std::mt19937 sparse_gen(seed);
+
+		auto dense = neural_network::make_fully_connected_layer<m4x5, m6>([&distr, &dense_gen]() { return distr(dense_gen); }, 0.0f);
+		auto sparse = neural_network::make_sparse_input_fully_connected_layer<m4x5, m6>([&distr, &sparse_gen]() { return distr(sparse_gen); }, 0.0f);
+
+		typedef decltype(sparse) sparse_layer;
+
+		test::check_true(serialize_sparse_weights(dense) == serialize_sparse_weights(sparse), "Sparse input layer must be serialized as a fully connected layer.");
+
+		for (size_t i = 0; i < 10; ++i)
+		{
+			m4x5::tensor_type input;
+			input(i % 4, 1) = distr(gen);
+			input(3, i % 5) = distr(gen);
+			input(0, 4) = distr(gen);
+
+			sparse_layer::input sparse_input(input);
+
+			check_sparse_output(dense.process(input), sparse.process(sparse_input), "Invalid output of a sparse input layer.");
+
+			m6::tensor_type gradient(random_values);
+
+			auto dense_gradient = dense.compute_gradient(gradient).reshape<neural_network::algebra::metrics<m4x5::data_size>>();
+			const sparse_layer::input& sparse_gradient = sparse.compute_gradient(gradient);
+
+			test::check_true(sparse_input.size() == sparse_gradient.size(), "Invalid number of sparse input gradient values.");
+
+			for (size_t k = 0; k < sparse_gradient.size(); ++k)
+			{
+				test::check_true(sparse_input[k].index == sparse_gradient[k].index, "Invalid index of sparse input gradient.");
+				test::check_true(std::abs(dense_gradient(sparse_gradient[k].index) - sparse_gradient[k].value) < 1e-5f, "Invalid sparse input gradient.");
+			}
+
+			dense.update_weights(0.1f);
+			sparse.update_weights(0.1f);
+
+			test::check_true(serialize_sparse_weights(dense) == serialize_sparse_weights(sparse), "Invalid weights of a sparse input layer after update.");
+		}
+
+		{
+			m4x5::tensor_type input;
+			input(1, 1) = 0.75f;
+
+			sparse_layer::input repeated;
+			repeated.push_back(6, 0.5f);
+			repeated.push_back(6, 0.25f);
+
+			check_sparse_output(dense.process(input), sparse.process(repeated), "Invalid output of a sparse input with a repeated index.");
+
+			m6::tensor_type gradient(random_values);
+			dense.compute_gradient(gradient);
+			sparse.compute_gradient(gradient);
+
+			dense.update_weights(0.1f);
+			sparse.update_weights(0.1f);
+
+			sparse_layer other;
+			read_sparse_weights(serialize_sparse_weights(dense), other);
+
+			m4x5::tensor_type all(random_values);
+			check_sparse_output(sparse.process(sparse_layer::input(all)), other.process(sparse_layer::input(all)), "Invalid weights after an update with a repeated index.");
+		}
+
+		test_layer_serialization("Sparse Input Fully Connected Serialization Tests", sparse);
+
+		typedef neural_network::algebra::metrics<3> m3;
+		typedef neural_network::algebra::metrics<16> m16;
+		typedef neural_network::algebra::metrics<100> m100;
+
+		auto net = neural_network::make_network(
+			neural_network::make_sparse_input_fully_connected_layer<m100, m16>(random_values),
+			neural_network::make_relu_activation_layer<m16>(),
+			neural_network::make_fully_connected_layer<m16, m3>(random_values));
+
+		typedef decltype(net) network_type;
+
+		network_type::input input;
+		input.push_back(3, 1.0f);
+		input.push_back(42, 1.0f);
+		input.push_back(97, -0.5f);
+
+		m3::tensor_type truth;
+		truth(1) = 1.0f;
+
+		neural_network::squared_error_loss<m3> loss;
+
+		const float before = loss.compute(net.process(input), truth);
+		for (size_t i = 0; i < 20; ++i)
+		{
+			net.train(input, truth, loss, 0.05f);
+		}
+
+		test::check_true(loss.compute(net.process(input), truth) < before, "Training of a network with a sparse input must reduce the loss.");
+
+		test_layer_serialization("Sparse Input Network Serialization Tests", net);
+	}
+
+	{
+		test::verbose("Sparse Input Fully Connected Regularization Tests");
+
+		typedef neural_network::algebra::metrics<6> m6;
+		typedef neural_network::algebra::metrics<4, 5> m4x5;
+
+		const float regularization = 0.1f;
+		const float rate = -0.5f;
+
+		const unsigned int seed = rd();
+		std::mt19937 dense_gen(seed);
+		std::mt19937 sparse_gen(seed);
+
+		auto dense = neural_network::make_fully_connected_layer<m4x5, m6>([&distr, &dense_gen]() { return distr(dense_gen); }, regularization);
+		auto sparse = neural_network::make_sparse_input_fully_connected_layer<m4x5, m6>([&distr, &sparse_gen]() { return distr(sparse_gen); }, regularization);
+
+		typedef decltype(sparse) sparse_layer;
+
+		m4x5::tensor_type all(random_values);
+
+		// Only the first two rows are read, and the decay of the other rows crosses the point where
+		// the layer applies its scale to the rows.
+		for (size_t i = 0; i < 200; ++i)
+		{
+			m4x5::tensor_type input;
+			input(0, 0) = distr(gen);
+			input(0, 1) = distr(gen);
+
+			check_sparse_output(dense.process(input), sparse.process(sparse_layer::input(input)), "Invalid output of a sparse input layer with regularization.");
+
+			m6::tensor_type gradient(random_values);
+			dense.compute_gradient(gradient);
+			sparse.compute_gradient(gradient);
+
+			dense.update_weights(rate);
+			sparse.update_weights(rate);
+
+			check_sparse_output(dense.process(all), sparse.process(sparse_layer::input(all)), "Rows of a sparse input layer that are not read are not decayed.");
+		}
+
+		sparse_layer other;
+		read_sparse_weights(serialize_sparse_weights(sparse), other);
+
+		check_sparse_output(dense.process(all), other.process(sparse_layer::input(all)), "Invalid serialized weights of a sparse input layer with decayed rows.");
+
+		m4x5::tensor_type idle;
+		idle(3, 4) = 1.0f;
+
+		m4x5::tensor_type zero;
+
+		const m6::tensor_type& idleOutput = sparse.process(sparse_layer::input(idle));
+		const m6::tensor_type biasOutput = dense.process(zero);
+
+		for (size_t j = 0; j < m6::data_size; ++j)
+		{
+			test::check_true(std::abs(idleOutput(j) - biasOutput(j)) < 1e-3f, "Idle row of a sparse input layer is not decayed towards zero.");
+		}
+	}
+
+	sc.pass();
+}
\ No newline at end of file
@@ -197,5 +197,63 @@ void test_tensor()
 		static_assert(std::is_same<expanded::shrink::type::tensor_type, tensor>::value, "Invalid type of expanded tensor shrinked back to 3-dimenstion.");
 	}
 
+	{
+		test::verbose("Number Type Tensor Tests");
+
+		typedef neural_network::algebra::basic_tensor<int, 4, 3> tensor;
+		typedef neural_network::algebra::metrics<12> _Reshaped;
+
+		static_assert(std::is_same<tensor::number_type, int>::value, "Invalid number type of tensor.");
+		static_assert(std::is_same<tensor::metrics::tensor_of<int>::type, tensor>::value, "Invalid tensor type of metrics.");
+		static_assert(std::is_same<neural_network::algebra::tensor<4, 3>, neural_network::algebra::basic_tensor<float, 4, 3>>::value, "Default tensor type must store float values.");
+
+		tensor t([]() { return 7; });
+		t(3, 2) = 32;
+
+		_Reshaped::tensor_of<int>::type r = t.reshape<_Reshaped>();
+		test::check_true(32 == r(11), "Invalid value of reshaped tensor.");
+		test::check_true(7 == r(0), "Invalid value of reshaped tensor.");
+
+		test::check_true(t.data() == r.data(), "Reshaped tensor must share the values.");
+		test::check_true(32 == t.data()[11], "Invalid value in tensor data.");
+
+		tensor z;
+		test::check_true(0 == z(1, 1), "Invalid initial value of tensor.");
+	}
+
+	{
+		test::verbose("Sparse Tensor Tests");
+
+		typedef neural_network::algebra::metrics<4, 3> _Metrics;
+		typedef neural_network::algebra::sparse_tensor<_Metrics> sparse;
+
+		static_assert(std::is_same<sparse::dense_type, neural_network::algebra::tensor<4, 3>>::value, "Invalid dense type of sparse tensor.");
+
+		sparse::dense_type dense;
+		dense(1, 2) = 3.0f;
+		dense(3, 0) = -2.0f;
+
+		sparse s(dense);
+		test::check_true(2 == s.size(), "Invalid number of sparse tensor values.");
+		test::check_true((5 == s[0].index) && (3.0f == s[0].value), "Invalid sparse tensor value.");
+		test::check_true((9 == s[1].index) && (-2.0f == s[1].value), "Invalid sparse tensor value.");
+
+		sparse shared = s;
+		shared.push_back(5, 1.0f);
+		test::check_true(3 == s.size(), "Copy of sparse tensor must share the values.");
+
+		auto restored = s.to_dense();
+		test::check_true(4.0f == restored(1, 2), "Repeated index of sparse tensor must add the values.");
+		test::check_true(-2.0f == restored(3, 0), "Invalid value of dense tensor.");
+		test::check_true(0.0f == restored(0, 0), "Invalid value of dense tensor.");
+
+		test::check_exception<std::invalid_argument>(
+			[&s]() { s.push_back(12, 1.0f); },
+			"Index out of range must throw.");
+
+		s.clear();
+		test::check_true(0 == s.size(), "Sparse tensor must be empty after clear.");
+	}
+
 	sc.pass();
 }
\ No newline at end of file
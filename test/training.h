@@ -53,13 +53,13 @@ void train_test_network_impl(
 	while (retry < 20 && iteration < MaxIterations)
 	{
 		++iteration;
-		float pretrained = loss(
+		typename Input::number_type pretrained = loss(
 			process(input),
 			truth);
 
 		train(input, truth, rate);
 
-		float posttrained = loss(
+		typename Input::number_type posttrained = loss(
 			process(input),
 			truth);
 
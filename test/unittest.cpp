@@ -32,6 +32,8 @@ void run_tests()
 	{
 		test_tensor();
 
+		test_number();
+
 		test_core();
 
 		test_serialization();
@@ -48,10 +50,30 @@ void run_tests()
 
 		test_convolution();
 
+		test_separable();
+
+		test_layout();
+
+		test_parallel();
+
 		test_network();
 
+		test_pipeline();
+
 		test_ensemble();
 
+		test_memory();
+
+		test_checkpoint();
+
+		test_quantization();
+
+		test_sparse();
+
+		test_embedding();
+
+		test_normalization();
+
 		test::log("===========================================");
 		test::log("All unit tests PASS");
 	}
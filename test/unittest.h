@@ -185,14 +185,25 @@ struct scenario
 };
 
 void test_tensor();
+void test_number();
 void test_core();
 void test_activation();
 void test_connected();
 void test_reshape();
 void test_pooling();
 void test_convolution();
+void test_separable();
+void test_layout();
+void test_parallel();
 void test_network();
+void test_pipeline();
 void test_ensemble();
+void test_memory();
+void test_checkpoint();
+void test_quantization();
+void test_sparse();
+void test_embedding();
+void test_normalization();
 void test_loss();
 
 void test_serialization();